@@ -16,11 +16,25 @@ static const getopt_option_t option_list[] = {
     { "output", 'o', GETOPT_OPTION_TYPE_REQUIRED, 0, 'o', "output source file", "C header" },
     { "slang", 'l', GETOPT_OPTION_TYPE_REQUIRED, 0, 'l', "output shader language(s), see above for list", "glsl330:glsl100..." },
     { "bytecode", 'b', GETOPT_OPTION_TYPE_NO_ARG, 0, 'b', "output bytecode (HLSL and Metal)"},
-    { "format", 'f', GETOPT_OPTION_TYPE_REQUIRED, 0, 'f', "output format (default: sokol)", "[sokol|sokol_decl|sokol_impl|bare]" },
+    { "format", 'f', GETOPT_OPTION_TYPE_REQUIRED, 0, 'f', "output format (default: sokol)", "[sokol|sokol_decl|sokol_impl|bare|pack]" },
+    { "reflection", 'R', GETOPT_OPTION_TYPE_REQUIRED, 0, 'R', "write reflection info for all programs to [output].json or [output].refl", "[json|binary]" },
     { "errfmt", 'e', GETOPT_OPTION_TYPE_REQUIRED, 0, 'e', "error message format (default: gcc)", "[gcc|msvc]"},
     { "dump", 'd', GETOPT_OPTION_TYPE_NO_ARG, 0, 'd', "dump debugging information to stderr"},
     { "genver", 'g', GETOPT_OPTION_TYPE_REQUIRED, 0, 'g', "version-stamp for code-generation", "[int]"},
     { "noifdef", 'n', GETOPT_OPTION_TYPE_NO_ARG, 0, 'n', "don't emit #ifdef SOKOL_XXX"},
+    { "compress", 'z', GETOPT_OPTION_TYPE_NO_ARG, 0, 'z', "compress shader source code and bytecode"},
+    { "minify", 'm', GETOPT_OPTION_TYPE_NO_ARG, 0, 'm', "minify generated shader source code (strip whitespace, comments and line directives)"},
+    { "spirv", 's', GETOPT_OPTION_TYPE_REQUIRED, 0, 's', "strip debug info from SPIR-V bytecode, and optionally remap IDs (default: none)", "[none|strip|remap]" },
+    { "link", 'L', GETOPT_OPTION_TYPE_NO_ARG, 0, 'L', "link-time optimization of vertex/fragment shader pairs (remove unused and fold constant varyings)"},
+    { "pack-varyings", 'P', GETOPT_OPTION_TYPE_NO_ARG, 0, 'P', "pack float, vec2 and vec3 varyings into vec4 slots"},
+    { "precision", 'p', GETOPT_OPTION_TYPE_REQUIRED, 0, 'p', "default float precision for mobile shader languages (default: default)", "[default|highp|mediump]" },
+    { "reorder-uniforms", 'U', GETOPT_OPTION_TYPE_NO_ARG, 0, 'U', "reorder uniform block members to minimize padding"},
+    { "compact-uniforms", 'C', GETOPT_OPTION_TYPE_NO_ARG, 0, 'C', "remove uniform block members which a shader doesn't read (per-shader uniform blocks)"},
+    { "hoist-uniforms", 'H', GETOPT_OPTION_TYPE_NO_ARG, 0, 'H', "compute uniform-only expressions on the CPU in generated [block]_prepare() functions"},
+    { "stable-slots", 'S', GETOPT_OPTION_TYPE_NO_ARG, 0, 'S', "give each uniform block and image the same bind slot in all programs of the module"},
+    { "slot-map", 'M', GETOPT_OPTION_TYPE_REQUIRED, 0, 'M', "read and update a bind slot map file shared by several modules (implies --stable-slots)", "[path]"},
+    { "report", 'r', GETOPT_OPTION_TYPE_NO_ARG, 0, 'r', "print statistics about the generated output"},
+    { "opt", 'O', GETOPT_OPTION_TYPE_REQUIRED, 0, 'O', "SPIR-V optimization level (default: default)", "[none|default|perf|size]" },
     { "tmpdir", 't', GETOPT_OPTION_TYPE_REQUIRED, 0, 't', "directory for temporary files (use output dir if not specified)", "[dir]"},
     GETOPT_OPTIONS_END
 };
@@ -45,9 +59,27 @@ static void print_help_string(getopt_context_t& ctx) {
         "  - @hlsl_options options...: HLSL specific compile options\n"
         "  - @msl_options options...: MSL (Metal) specific compile options\n"
         "    valid options are: flip_vert_y and fixup_clipspace\n"
+        "  - @optimize level: SPIR-V optimization level for a @vs or @fs block\n"
+        "    (none, default, perf or size), overrides --opt\n"
+        "  - @precision precision [slang...]: float precision for a @vs or @fs block\n"
+        "    (default, highp or mediump), overrides --precision, ignored by Metal\n"
+        "  - @format attr format: vertex format of a vertex shader input (a lower case\n"
+        "    sg_vertex_format name like ubyte4n), generates a packed vertex struct\n"
+        "  - @instance attr...: per-instance vertex shader inputs, which go into a\n"
+        "    packed instance struct in their own vertex buffer slot\n"
         "  - @end: ends a @vs, @fs or @block code block\n"
         "  - @include_block block_name: include a code block in a @vs or @fs block\n"
-        "  - @program name vs_name fs_name: a named, linked shader program\n\n"
+        "  - @per_frame, @per_material, @per_draw block [member...]: the update frequency\n"
+        "    of uniform block members, splits the uniform block by update frequency\n"
+        "  - @program name vs_name fs_name [priority]: a named, linked shader program,\n"
+        "    programs with a higher priority are created first by prewarm_shaders()\n"
+        "  - @variants vs_or_fs define[:value,value...]...: compile a @vs or @fs block\n"
+        "    as variants, each program using it gets one program per permutation\n"
+        "    (at most 256 permutations per program)\n"
+        "  - @specialize program constant=value...: bake specialization constant values\n"
+        "    (by constant_id or name) into the shaders of a program\n"
+        "  - @move_to_vs program...: move linear fragment shader computations into\n"
+        "    the vertex shader of programs (after the @program tags)\n\n"
         "An input file must contain at least one @vs block, one @fs block\n"
         "and one @program declaration.\n\n"
         "Target shader languages (used with -l --slang):\n"
@@ -63,9 +95,10 @@ static void print_help_string(getopt_context_t& ctx) {
         "  - sokol:         C header which includes both decl and inlined impl\n"
         "  - sokol_decl:    C header with SOKOL_SHDC_DECL wrapped decl and inlined impl\n"
         "  - sokol_impl:    C header with STB-style SOKOL_SHDC_IMPL wrapped impl\n"
-        "  - bare:          raw output of SPIRV-Cross compiler, in text or binary format\n\n"
+        "  - bare:          raw output of SPIRV-Cross compiler, in text or binary format\n"
+        "  - pack:          single binary shader pack file plus a C loader header\n\n"
         "Options:\n\n");
-    char buf[2048];
+    char buf[4096];
     fmt::print(stderr, getopt_create_help_string(&ctx, buf, sizeof(buf)));
 }
 
@@ -166,7 +199,25 @@ args_t args_t::parse(int argc, const char** argv) {
                 case 'f':
                     args.output_format = format_t::from_str(ctx.current_opt_arg);
                     if (args.output_format == format_t::INVALID) {
-                        fmt::print(stderr, "sokol-shdc: unknown output format {}, must be 'sokol', 'sokol_impl', 'sokol_pair' or 'bare'\n", ctx.current_opt_arg);
+                        fmt::print(stderr, "sokol-shdc: unknown output format {}, must be 'sokol', 'sokol_decl', 'sokol_impl', 'bare' or 'pack'\n", ctx.current_opt_arg);
+                        args.valid = false;
+                        args.exit_code = 10;
+                        return args;
+                    }
+                    break;
+                case 'R':
+                    args.reflection_format = reflection_format_t::from_str(ctx.current_opt_arg);
+                    if (args.reflection_format == reflection_format_t::INVALID) {
+                        fmt::print(stderr, "sokol-shdc: unknown reflection format {}, must be 'json' or 'binary'\n", ctx.current_opt_arg);
+                        args.valid = false;
+                        args.exit_code = 10;
+                        return args;
+                    }
+                    break;
+                case 'O':
+                    args.opt_level = opt_level_t::from_str(ctx.current_opt_arg);
+                    if (args.opt_level == opt_level_t::INVALID) {
+                        fmt::print(stderr, "sokol-shdc: unknown optimization level {}, must be 'none', 'default', 'perf' or 'size'\n", ctx.current_opt_arg);
                         args.valid = false;
                         args.exit_code = 10;
                         return args;
@@ -201,6 +252,55 @@ args_t args_t::parse(int argc, const char** argv) {
                 case 'n':
                     args.no_ifdef = true;
                     break;
+                case 'r':
+                    args.report = true;
+                    break;
+                case 'z':
+                    args.compress = true;
+                    break;
+                case 'm':
+                    args.minify = true;
+                    break;
+                case 'L':
+                    args.link = true;
+                    break;
+                case 'P':
+                    args.pack_varyings = true;
+                    break;
+                case 'U':
+                    args.reorder_uniforms = true;
+                    break;
+                case 'C':
+                    args.compact_uniforms = true;
+                    break;
+                case 'H':
+                    args.hoist_uniforms = true;
+                    break;
+                case 'S':
+                    args.stable_slots = true;
+                    break;
+                case 'M':
+                    args.stable_slots = true;
+                    args.slot_map = ctx.current_opt_arg;
+                    break;
+                case 'p':
+                    args.precision = precision_t::from_str(ctx.current_opt_arg);
+                    if (args.precision == precision_t::INVALID) {
+                        fmt::print(stderr, "sokol-shdc: unknown precision {}, must be 'default', 'highp' or 'mediump'\n", ctx.current_opt_arg);
+                        args.valid = false;
+                        args.exit_code = 10;
+                        return args;
+                    }
+                    break;
+                case 's':
+                    args.spirv_strip = spirv_strip_t::from_str(ctx.current_opt_arg);
+                    if (args.spirv_strip == spirv_strip_t::INVALID) {
+                        fmt::print(stderr, "sokol-shdc: unknown SPIR-V release mode {}, must be 'none', 'strip' or 'remap'\n", ctx.current_opt_arg);
+                        args.valid = false;
+                        args.exit_code = 10;
+                        return args;
+                    }
+                    break;
                 case 'h':
                     print_help_string(ctx);
                     args.valid = false;
@@ -225,8 +325,22 @@ void args_t::dump_debug() const {
     fmt::print(stderr, "  slang:  '{}'\n", slang_t::bits_to_str(slang));
     fmt::print(stderr, "  byte_code: {}\n", byte_code);
     fmt::print(stderr, "  output_format: '{}'\n", format_t::to_str(output_format));
+    fmt::print(stderr, "  reflection_format: '{}'\n", reflection_format_t::to_str(reflection_format));
     fmt::print(stderr, "  debug_dump: {}\n", debug_dump);
     fmt::print(stderr, "  no_ifdef: {}\n", no_ifdef);
+    fmt::print(stderr, "  report: {}\n", report);
+    fmt::print(stderr, "  compress: {}\n", compress);
+    fmt::print(stderr, "  minify: {}\n", minify);
+    fmt::print(stderr, "  link: {}\n", link);
+    fmt::print(stderr, "  pack_varyings: {}\n", pack_varyings);
+    fmt::print(stderr, "  reorder_uniforms: {}\n", reorder_uniforms);
+    fmt::print(stderr, "  compact_uniforms: {}\n", compact_uniforms);
+    fmt::print(stderr, "  hoist_uniforms: {}\n", hoist_uniforms);
+    fmt::print(stderr, "  stable_slots: {}\n", stable_slots);
+    fmt::print(stderr, "  slot_map: '{}'\n", slot_map);
+    fmt::print(stderr, "  precision: '{}'\n", precision_t::to_str(precision));
+    fmt::print(stderr, "  spirv_strip: '{}'\n", spirv_strip_t::to_str(spirv_strip));
+    fmt::print(stderr, "  opt_level: '{}'\n", opt_level_t::to_str(opt_level));
     fmt::print(stderr, "  gen_version: {}\n", gen_version);
     fmt::print(stderr, "  error_format: {}\n", errmsg_t::msg_format_to_str(error_format));
     fmt::print(stderr, "\n");
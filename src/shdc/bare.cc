@@ -25,15 +25,11 @@ static const char* slang_file_extension(slang_t::type_t c, bool binary) {
     }
 }
 
-static errmsg_t write_stage(const std::string& file_path,
+static errmsg_t write_stage(const args_t& args,
+                            const std::string& file_path,
                             const spirvcross_source_t& src,
                             const bytecode_blob_t* blob)
 {
-    // write text or binary to output file
-    FILE* f = fopen(file_path.c_str(), "wb");
-    if (!f) {
-        return errmsg_t::error(file_path, 0, fmt::format("failed to open output file '{}'", file_path));
-    }
     const void* write_data;
     size_t write_count;
     if (blob) {
@@ -44,9 +40,27 @@ static errmsg_t write_stage(const std::string& file_path,
         write_data = src.source_code.data();
         write_count = src.source_code.length();
     }
+    // with --compress, write a 32-bit little-endian uncompressed size, followed by an LZ4 block
+    std::vector<uint8_t> lz_data;
+    std::string write_path = file_path;
+    if (args.compress) {
+        const uint32_t raw_size = (uint32_t) write_count;
+        lz_data = { (uint8_t)raw_size, (uint8_t)(raw_size >> 8), (uint8_t)(raw_size >> 16), (uint8_t)(raw_size >> 24) };
+        std::vector<uint8_t> lz_block = lz_t::compress((const uint8_t*)write_data, write_count);
+        lz_data.insert(lz_data.end(), lz_block.begin(), lz_block.end());
+        write_data = lz_data.data();
+        write_count = lz_data.size();
+        write_path = fmt::format("{}.lz", file_path);
+    }
+
+    // write text or binary to output file
+    FILE* f = fopen(write_path.c_str(), "wb");
+    if (!f) {
+        return errmsg_t::error(write_path, 0, fmt::format("failed to open output file '{}'", write_path));
+    }
     size_t written = fwrite(write_data, 1, write_count, f);
     if (written != write_count) {
-        return errmsg_t::error(file_path, 0, fmt::format("failed to write output file '{}'", file_path));
+        return errmsg_t::error(write_path, 0, fmt::format("failed to write output file '{}'", write_path));
     }
     fclose(f);
     return errmsg_t();
@@ -54,7 +68,10 @@ static errmsg_t write_stage(const std::string& file_path,
 
 static errmsg_t write_meta(const std::string& file_path,
                            const spirvcross_t& spirvcross,
-                           const spirvcross_source_t& src)
+                           const spirvcross_source_t& src,
+                           uint64_t hash,
+                           uint64_t program_hash,
+                           uint64_t module_hash)
 {
     FILE* f = fopen(file_path.c_str(), "wb");
     if (!f) {
@@ -62,6 +79,9 @@ static errmsg_t write_meta(const std::string& file_path,
     }
 
     spirvcross.write_reflection_info(f, src, "");
+    fmt::print(f, "hash: {:#018x}\n", hash);
+    fmt::print(f, "program_hash: {:#018x}\n", program_hash);
+    fmt::print(f, "module_hash: {:#018x}\n", module_hash);
 
     fclose(f);
     return errmsg_t();
@@ -71,8 +91,10 @@ static errmsg_t write_shader_sources_and_blobs(const args_t& args,
                                                const input_t& inp,
                                                const spirvcross_t& spirvcross,
                                                const bytecode_t& bytecode,
+                                               const payloads_t& payloads,
                                                slang_t::type_t slang)
 {
+    const uint64_t module_hash = payloads.module_hash(args, inp);
     for (const auto& item: inp.programs) {
         const program_t& prog = item.second;
         int vs_snippet_index = inp.snippet_map.at(prog.vs_name);
@@ -98,21 +120,24 @@ static errmsg_t write_shader_sources_and_blobs(const args_t& args,
         std::string file_path_fs = fmt::format("{}{}{}_fs{}", args.output, mod_prefix(inp), prog.name, slang_file_extension(slang, fs_blob));
 
         errmsg_t err;
-        err = write_stage(file_path_vs, vs_src, vs_blob);
+        err = write_stage(args, file_path_vs, vs_src, vs_blob);
         if (err.valid) {
             return err;
         }
-        err = write_stage(file_path_fs, fs_src, fs_blob);
+        err = write_stage(args, file_path_fs, fs_src, fs_blob);
         if (err.valid) {
             return err;
         }
 
         // write meta files
-        err = write_meta(fmt::format("{}.meta", file_path_vs), spirvcross, vs_src);
+        const uint64_t prog_hash = payloads.program_hash(inp, prog, slang);
+        err = write_meta(fmt::format("{}.meta", file_path_vs), spirvcross, vs_src,
+            payloads.find_payload(slang, vs_snippet_index).hash, prog_hash, module_hash);
         if (err.valid) {
             return err;
         }
-        err = write_meta(fmt::format("{}.meta", file_path_fs), spirvcross, fs_src);
+        err = write_meta(fmt::format("{}.meta", file_path_fs), spirvcross, fs_src,
+            payloads.find_payload(slang, fs_snippet_index).hash, prog_hash, module_hash);
         if (err.valid) {
             return err;
         }
@@ -123,7 +148,8 @@ static errmsg_t write_shader_sources_and_blobs(const args_t& args,
 
 errmsg_t bare_t::gen(const args_t& args, const input_t& inp,
                      const std::array<spirvcross_t,slang_t::NUM>& spirvcross,
-                     const std::array<bytecode_t,slang_t::NUM>& bytecode)
+                     const std::array<bytecode_t,slang_t::NUM>& bytecode,
+                     const payloads_t& payloads)
 {
     for (int i = 0; i < slang_t::NUM; i++) {
         slang_t::type_t slang = (slang_t::type_t) i;
@@ -132,7 +158,7 @@ errmsg_t bare_t::gen(const args_t& args, const input_t& inp,
             if (err.valid) {
                 return err;
             }
-            err = write_shader_sources_and_blobs(args, inp, spirvcross[i], bytecode[i], slang);
+            err = write_shader_sources_and_blobs(args, inp, spirvcross[i], bytecode[i], payloads, slang);
             if (err.valid) {
                 return err;
             }
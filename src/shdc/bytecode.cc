@@ -347,8 +347,8 @@ static bytecode_t d3d_compile(const input_t& inp, const spirvcross_t& spirvcross
 }
 #endif
 
-static bytecode_t wgpu_compile(const input_t& inp, const spirvcross_t& spirvcross) {
-    spirv_t spirv = spirv_t::compile_spirvcross_glsl(inp, slang_t::WGPU, &spirvcross);
+static bytecode_t wgpu_compile(const args_t& args, const input_t& inp, const spirvcross_t& spirvcross) {
+    spirv_t spirv = spirv_t::compile_spirvcross_glsl(args, inp, slang_t::WGPU, &spirvcross);
     bytecode_t bytecode;
     bytecode.errors = spirv.errors;
     for (const spirv_blob_t& spirv_blob: spirv.blobs) {
@@ -378,7 +378,7 @@ bytecode_t bytecode_t::compile(const args_t& args, const input_t& inp, const spi
     }
     #endif
     if (slang == slang_t::WGPU) {
-        bytecode = wgpu_compile(inp, spirvcross);
+        bytecode = wgpu_compile(args, inp, spirvcross);
     }
     return bytecode;
 }
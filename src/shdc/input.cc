@@ -4,6 +4,7 @@
 #include "shdc.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
 #include "fmt/format.h"
 #include "pystring.h"
 
@@ -107,7 +108,20 @@ static const std::string prog_tag = "@program";
 static const std::string glsl_options_tag = "@glsl_options";
 static const std::string hlsl_options_tag = "@hlsl_options";
 static const std::string msl_options_tag = "@msl_options";
+static const std::string optimize_tag = "@optimize";
+static const std::string precision_tag = "@precision";
 static const std::string include_tag = "@include";
+static const std::string per_frame_tag = "@per_frame";
+static const std::string per_material_tag = "@per_material";
+static const std::string per_draw_tag = "@per_draw";
+static const std::string move_to_vs_tag = "@move_to_vs";
+static const std::string variants_tag = "@variants";
+static const std::string specialize_tag = "@specialize";
+static const std::string format_tag = "@format";
+static const std::string instance_tag = "@instance";
+
+/* the max number of variants of a single program */
+static const int max_variants = 256;
 
 static bool normalize_pragma_sokol(std::vector<std::string>& toks, std::string &line, int line_index, input_t& inp) {
     // Returns true if it saw no errors, even if it did nothing.
@@ -175,6 +189,172 @@ static bool validate_type_tag(const std::vector<std::string>& tokens, bool in_sn
     return true;
 }
 
+static bool validate_frequency_tag(const std::vector<std::string>& tokens, bool in_snippet, int line_index, input_t& inp) {
+    if (tokens.size() < 2) {
+        inp.out_error = inp.error(line_index, fmt::format("{} tag must have at least one arg ({} block [member ...])", tokens[0], tokens[0]));
+        return false;
+    }
+    if (in_snippet) {
+        inp.out_error = inp.error(line_index, fmt::format("{} tag cannot be inside a tag block (missing @end?).", tokens[0]));
+        return false;
+    }
+    const std::map<std::string, frequency_t::type_t> empty;
+    const auto it = inp.frequency_map.find(tokens[1]);
+    const std::map<std::string, frequency_t::type_t>& members = (it != inp.frequency_map.end()) ? it->second : empty;
+    if (tokens.size() == 2) {
+        if (members.count("") > 0) {
+            inp.out_error = inp.error(line_index, fmt::format("uniform block '{}' already has an update frequency", tokens[1]));
+            return false;
+        }
+    }
+    for (int i = 2; i < (int)tokens.size(); i++) {
+        if (members.count(tokens[i]) > 0) {
+            inp.out_error = inp.error(line_index, fmt::format("uniform '{}.{}' already has an update frequency", tokens[1], tokens[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool validate_move_to_vs_tag(const std::vector<std::string>& tokens, bool in_snippet, int line_index, input_t& inp) {
+    if (tokens.size() < 2) {
+        inp.out_error = inp.error(line_index, "@move_to_vs tag must have at least one arg (@move_to_vs program [program ...])");
+        return false;
+    }
+    if (in_snippet) {
+        inp.out_error = inp.error(line_index, "@move_to_vs tag cannot be inside a tag block (missing @end?).");
+        return false;
+    }
+    for (int i = 1; i < (int)tokens.size(); i++) {
+        if (inp.programs.count(tokens[i]) == 0) {
+            inp.out_error = inp.error(line_index, fmt::format("@program '{}' not found for @move_to_vs (must be defined before).", tokens[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
+/* check if a string is a valid identifier (can be used in a #define and a C macro name) */
+static bool is_identifier(const std::string& str, bool allow_leading_digit) {
+    if (str.empty() || (!allow_leading_digit && (str[0] >= '0') && (str[0] <= '9'))) {
+        return false;
+    }
+    for (char c: str) {
+        if (!(((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9')) || (c == '_'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* validate a @variants tag and parse the variant defines (NAME or NAME:value,value,...) */
+static bool validate_variants_tag(const std::vector<std::string>& tokens, bool in_snippet, int line_index, input_t& inp, std::vector<variant_t>& out_variants) {
+    if (tokens.size() < 3) {
+        inp.out_error = inp.error(line_index, "@variants tag must have at least two args (@variants vs_or_fs_name NAME[:value,value,...] ...).");
+        return false;
+    }
+    if (in_snippet) {
+        inp.out_error = inp.error(line_index, "@variants tag cannot be inside a tag block (missing @end?).");
+        return false;
+    }
+    if ((inp.vs_map.count(tokens[1]) == 0) && (inp.fs_map.count(tokens[1]) == 0)) {
+        inp.out_error = inp.error(line_index, fmt::format("@vs or @fs '{}' not found for @variants (must be defined before).", tokens[1]));
+        return false;
+    }
+    if (!inp.snippets[inp.snippet_map.at(tokens[1])].variants.empty()) {
+        inp.out_error = inp.error(line_index, fmt::format("@variants for '{}' already defined.", tokens[1]));
+        return false;
+    }
+    out_variants.clear();
+    for (int i = 2; i < (int)tokens.size(); i++) {
+        variant_t variant;
+        std::vector<std::string> parts;
+        pystring::split(tokens[i], parts, ":");
+        variant.name = parts[0];
+        if (parts.size() == 1) {
+            variant.values = { "0", "1" };
+        }
+        else if (parts.size() == 2) {
+            pystring::split(parts[1], variant.values, ",");
+        }
+        if ((parts.size() > 2) || !is_identifier(variant.name, false)) {
+            inp.out_error = inp.error(line_index, fmt::format("invalid @variants define '{}' (must be NAME or NAME:value,value,...).", tokens[i]));
+            return false;
+        }
+        if (variant.values.size() < 2) {
+            inp.out_error = inp.error(line_index, fmt::format("@variants define '{}' must have at least two values.", variant.name));
+            return false;
+        }
+        for (int k = 0; k < (int)variant.values.size(); k++) {
+            if (!is_identifier(variant.values[k], true)) {
+                inp.out_error = inp.error(line_index, fmt::format("invalid value '{}' for @variants define '{}' (must be a number or identifier).", variant.values[k], variant.name));
+                return false;
+            }
+            for (int j = 0; j < k; j++) {
+                if (variant.values[j] == variant.values[k]) {
+                    inp.out_error = inp.error(line_index, fmt::format("duplicate value '{}' for @variants define '{}'.", variant.values[k], variant.name));
+                    return false;
+                }
+            }
+        }
+        for (const variant_t& other: out_variants) {
+            if (other.name == variant.name) {
+                inp.out_error = inp.error(line_index, fmt::format("duplicate @variants define '{}'.", variant.name));
+                return false;
+            }
+        }
+        out_variants.push_back(variant);
+    }
+    return true;
+}
+
+/* check if a string is a specialization constant value (a number, true or false) */
+static bool is_spec_constant_value(const std::string& str) {
+    if ((str == "true") || (str == "false")) {
+        return true;
+    }
+    char* end = nullptr;
+    strtod(str.c_str(), &end);
+    return !str.empty() && (end == (str.c_str() + str.length()));
+}
+
+/* validate a @specialize tag and parse the specialization constant values (constant_id=value or name=value) */
+static bool validate_specialize_tag(const std::vector<std::string>& tokens, bool in_snippet, int line_index, input_t& inp, std::vector<std::pair<std::string, std::string>>& out_values) {
+    if (tokens.size() < 3) {
+        inp.out_error = inp.error(line_index, "@specialize tag must have at least two args (@specialize program constant=value ...).");
+        return false;
+    }
+    if (in_snippet) {
+        inp.out_error = inp.error(line_index, "@specialize tag cannot be inside a tag block (missing @end?).");
+        return false;
+    }
+    if (inp.programs.count(tokens[1]) == 0) {
+        inp.out_error = inp.error(line_index, fmt::format("@program '{}' not found for @specialize (must be defined before).", tokens[1]));
+        return false;
+    }
+    if (!inp.programs.at(tokens[1]).spec_constants.empty()) {
+        inp.out_error = inp.error(line_index, fmt::format("@specialize for @program '{}' already defined.", tokens[1]));
+        return false;
+    }
+    out_values.clear();
+    for (int i = 2; i < (int)tokens.size(); i++) {
+        std::vector<std::string> parts;
+        pystring::split(tokens[i], parts, "=");
+        if ((parts.size() != 2) || !is_identifier(parts[0], true) || !is_spec_constant_value(parts[1])) {
+            inp.out_error = inp.error(line_index, fmt::format("invalid @specialize value '{}' (must be constant_id=value or name=value, with a number, true or false).", tokens[i]));
+            return false;
+        }
+        for (const auto& other: out_values) {
+            if (other.first == parts[0]) {
+                inp.out_error = inp.error(line_index, fmt::format("duplicate @specialize constant '{}'.", parts[0]));
+                return false;
+            }
+        }
+        out_values.push_back({ parts[0], parts[1] });
+    }
+    return true;
+}
+
 static bool validate_block_tag(const std::vector<std::string>& tokens, bool in_snippet, int line_index, input_t& inp) {
     if (tokens.size() != 2) {
         inp.out_error = inp.error(line_index, "@block tag must have exactly one arg (@block name).");
@@ -251,9 +431,27 @@ static bool validate_end_tag(const std::vector<std::string>& tokens, bool in_sni
     return true;
 }
 
+/* check if a string is a (optionally negative) decimal integer */
+static bool is_integer(const std::string& str) {
+    size_t start = ((str.length() > 1) && (str[0] == '-')) ? 1 : 0;
+    if ((str.length() == start) || (str.length() > (start + 9))) {
+        return false;
+    }
+    for (size_t i = start; i < str.length(); i++) {
+        if ((str[i] < '0') || (str[i] > '9')) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static bool validate_program_tag(const std::vector<std::string>& tokens, bool in_snippet, int line_index, input_t& inp) {
-    if (tokens.size() != 4) {
-        inp.out_error = inp.error(line_index, "@program tag must have exactly 3 args (@program name vs_name fs_name).");
+    if ((tokens.size() != 4) && (tokens.size() != 5)) {
+        inp.out_error = inp.error(line_index, "@program tag must have 3 or 4 args (@program name vs_name fs_name [priority]).");
+        return false;
+    }
+    if ((tokens.size() == 5) && !is_integer(tokens[4])) {
+        inp.out_error = inp.error(line_index, fmt::format("@program '{}' priority must be an integer (found '{}').", tokens[1], tokens[4]));
         return false;
     }
     if (in_snippet) {
@@ -293,6 +491,94 @@ static bool validate_options_tag(const std::vector<std::string>& tokens, const s
     return true;
 }
 
+static bool validate_optimize_tag(const std::vector<std::string>& tokens, const snippet_t& cur_snippet, bool in_snippet, int line_index, input_t& inp) {
+    if (tokens.size() != 2) {
+        inp.out_error = inp.error(line_index, "@optimize tag must have exactly one arg (@optimize [none|default|perf|size]).");
+        return false;
+    }
+    if (!in_snippet || ((cur_snippet.type != snippet_t::VS) && (cur_snippet.type != snippet_t::FS))) {
+        inp.out_error = inp.error(line_index, "@optimize must be inside a @vs or @fs block");
+        return false;
+    }
+    if (opt_level_t::from_str(tokens[1]) == opt_level_t::INVALID) {
+        inp.out_error = inp.error(line_index, fmt::format("unknown optimization level '{}' (must be 'none', 'default', 'perf' or 'size')", tokens[1]));
+        return false;
+    }
+    return true;
+}
+
+static bool validate_format_tag(const std::vector<std::string>& tokens, const snippet_t& cur_snippet, bool in_snippet, int line_index, input_t& inp) {
+    if (tokens.size() != 3) {
+        inp.out_error = inp.error(line_index, "@format tag must have exactly two args (@format [attr] [format]).");
+        return false;
+    }
+    if (!in_snippet || (cur_snippet.type != snippet_t::VS)) {
+        inp.out_error = inp.error(line_index, "@format must be inside a @vs block");
+        return false;
+    }
+    if (cur_snippet.attr_formats.count(tokens[1]) > 0) {
+        inp.out_error = inp.error(line_index, fmt::format("@format for attribute '{}' already defined", tokens[1]));
+        return false;
+    }
+    if (vertex_format_t::from_str(tokens[2]) == vertex_format_t::INVALID) {
+        inp.out_error = inp.error(line_index, fmt::format("unknown vertex format '{}' (must be float, float2, float3, float4, byte4, byte4n, ubyte4, ubyte4n, "
+            "short2, short2n, ushort2n, short4, short4n, ushort4n, uint10_n2, half2 or half4)", tokens[2]));
+        return false;
+    }
+    return true;
+}
+
+static bool validate_instance_tag(const std::vector<std::string>& tokens, const snippet_t& cur_snippet, bool in_snippet, int line_index, input_t& inp) {
+    if (tokens.size() < 2) {
+        inp.out_error = inp.error(line_index, "@instance tag must have at least one arg (@instance [attr...]).");
+        return false;
+    }
+    if (!in_snippet || (cur_snippet.type != snippet_t::VS)) {
+        inp.out_error = inp.error(line_index, "@instance must be inside a @vs block");
+        return false;
+    }
+    for (int i = 1; i < (int)tokens.size(); i++) {
+        const auto& attrs = cur_snippet.instance_attrs;
+        if ((std::find(attrs.begin(), attrs.end(), tokens[i]) != attrs.end()) || (std::find(tokens.begin() + 1, tokens.begin() + i, tokens[i]) != tokens.begin() + i)) {
+            inp.out_error = inp.error(line_index, fmt::format("attribute '{}' is already per-instance", tokens[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
+/* the shader language from a @precision tag arg, or slang_t::NUM if not a valid shader language */
+static slang_t::type_t slang_from_str(const std::string& str) {
+    for (int i = 0; i < slang_t::NUM; i++) {
+        if (str == slang_t::to_str((slang_t::type_t)i)) {
+            return (slang_t::type_t)i;
+        }
+    }
+    return slang_t::NUM;
+}
+
+static bool validate_precision_tag(const std::vector<std::string>& tokens, const snippet_t& cur_snippet, bool in_snippet, int line_index, input_t& inp) {
+    if (tokens.size() < 2) {
+        inp.out_error = inp.error(line_index, "@precision tag must have at least one arg (@precision [default|highp|mediump] [slang ...]).");
+        return false;
+    }
+    if (!in_snippet || ((cur_snippet.type != snippet_t::VS) && (cur_snippet.type != snippet_t::FS))) {
+        inp.out_error = inp.error(line_index, "@precision must be inside a @vs or @fs block");
+        return false;
+    }
+    if (precision_t::from_str(tokens[1]) == precision_t::INVALID) {
+        inp.out_error = inp.error(line_index, fmt::format("unknown precision '{}' (must be 'default', 'highp' or 'mediump')", tokens[1]));
+        return false;
+    }
+    for (int i = 2; i < (int)tokens.size(); i++) {
+        if (slang_from_str(tokens[i]) == slang_t::NUM) {
+            inp.out_error = inp.error(line_index, fmt::format("unknown shader language '{}' in @precision tag", tokens[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
 /* This parses the split input line array for custom tags (@vs, @fs, @block,
     @end and @program), and fills the respective members. If a parsing error
     happens, the inp.error object is setup accordingly.
@@ -324,6 +610,57 @@ static bool parse(input_t& inp) {
                 }
                 inp.type_map[tokens[1]] = tokens[2];
             }
+            else if ((tokens[0] == per_frame_tag) || (tokens[0] == per_material_tag) || (tokens[0] == per_draw_tag)) {
+                if (!validate_frequency_tag(tokens, in_snippet, line_index, inp)) {
+                    return false;
+                }
+                frequency_t::type_t frequency = frequency_t::PER_DRAW;
+                if (tokens[0] == per_frame_tag) {
+                    frequency = frequency_t::PER_FRAME;
+                }
+                else if (tokens[0] == per_material_tag) {
+                    frequency = frequency_t::PER_MATERIAL;
+                }
+                std::map<std::string, frequency_t::type_t>& members = inp.frequency_map[tokens[1]];
+                if (tokens.size() == 2) {
+                    members[""] = frequency;
+                }
+                if (inp.frequency_lines.count(tokens[1]) == 0) {
+                    inp.frequency_lines[tokens[1]] = line_index;
+                }
+                for (int i = 2; i < (int)tokens.size(); i++) {
+                    members[tokens[i]] = frequency;
+                    inp.frequency_lines[fmt::format("{}.{}", tokens[1], tokens[i])] = line_index;
+                }
+            }
+            else if (tokens[0] == move_to_vs_tag) {
+                if (!validate_move_to_vs_tag(tokens, in_snippet, line_index, inp)) {
+                    return false;
+                }
+                for (int i = 1; i < (int)tokens.size(); i++) {
+                    inp.programs[tokens[i]].move_to_vs = true;
+                }
+            }
+            else if (tokens[0] == specialize_tag) {
+                std::vector<std::pair<std::string, std::string>> values;
+                if (!validate_specialize_tag(tokens, in_snippet, line_index, inp, values)) {
+                    return false;
+                }
+                inp.programs[tokens[1]].spec_constants = std::move(values);
+                inp.programs[tokens[1]].spec_line_index = line_index;
+            }
+            else if (tokens[0] == variants_tag) {
+                std::vector<variant_t> variants;
+                if (!validate_variants_tag(tokens, in_snippet, line_index, inp, variants)) {
+                    return false;
+                }
+                // the original snippet is compiled with the default values
+                snippet_t& snippet = inp.snippets[inp.snippet_map.at(tokens[1])];
+                for (const variant_t& variant: variants) {
+                    snippet.defines.push_back({ variant.name, variant.values[0] });
+                }
+                snippet.variants = std::move(variants);
+            }
             else if (tokens[0] == glsl_options_tag) {
                 if (!validate_options_tag(tokens, cur_snippet, line_index, inp)) {
                     return false;
@@ -358,6 +695,47 @@ static bool parse(input_t& inp) {
                 }
                 add_line = false;
             }
+            else if (tokens[0] == optimize_tag) {
+                if (!validate_optimize_tag(tokens, cur_snippet, in_snippet, line_index, inp)) {
+                    return false;
+                }
+                cur_snippet.opt_level = opt_level_t::from_str(tokens[1]);
+                add_line = false;
+            }
+            else if (tokens[0] == precision_tag) {
+                if (!validate_precision_tag(tokens, cur_snippet, in_snippet, line_index, inp)) {
+                    return false;
+                }
+                const precision_t::type_t precision = precision_t::from_str(tokens[1]);
+                if (tokens.size() == 2) {
+                    // without explicit shader languages, only the mobile shader languages are affected
+                    for (int i = 0; i < slang_t::NUM; i++) {
+                        if (slang_t::is_mobile((slang_t::type_t)i)) {
+                            cur_snippet.precision[i] = precision;
+                        }
+                    }
+                }
+                else {
+                    for (int i = 2; i < (int)tokens.size(); i++) {
+                        cur_snippet.precision[slang_from_str(tokens[i])] = precision;
+                    }
+                }
+                add_line = false;
+            }
+            else if (tokens[0] == format_tag) {
+                if (!validate_format_tag(tokens, cur_snippet, in_snippet, line_index, inp)) {
+                    return false;
+                }
+                cur_snippet.attr_formats[tokens[1]] = vertex_format_t::from_str(tokens[2]);
+                add_line = false;
+            }
+            else if (tokens[0] == instance_tag) {
+                if (!validate_instance_tag(tokens, cur_snippet, in_snippet, line_index, inp)) {
+                    return false;
+                }
+                cur_snippet.instance_attrs.insert(cur_snippet.instance_attrs.end(), tokens.begin() + 1, tokens.end());
+                add_line = false;
+            }
             else if (tokens[0] == block_tag) {
                 if (!validate_block_tag(tokens, in_snippet, line_index, inp)) {
                     return false;
@@ -420,6 +798,9 @@ static bool parse(input_t& inp) {
                     return false;
                 }
                 inp.programs[tokens[1]] = program_t(tokens[1], tokens[2], tokens[3], line_index);
+                if (tokens.size() == 5) {
+                    inp.programs[tokens[1]].priority = atoi(tokens[4].c_str());
+                }
                 add_line = false;
             }
             else if (tokens[0][0] == '@') {
@@ -439,6 +820,180 @@ static bool parse(input_t& inp) {
     return true;
 }
 
+/* the number of bits needed to store a variant value index */
+static int variant_bits(const variant_t& variant) {
+    int bits = 0;
+    while ((1 << bits) < (int)variant.values.size()) {
+        bits++;
+    }
+    return bits;
+}
+
+/* assign the bit positions of the value indices in a variant mask */
+static int layout_variant_mask(std::vector<variant_t>& variants) {
+    int shift = 0;
+    for (variant_t& variant: variants) {
+        variant.shift = shift;
+        variant.bits = variant_bits(variant);
+        shift += variant.bits;
+    }
+    return shift;
+}
+
+/* find or create the copy of a vs or fs snippet which is compiled with the
+    variant defines selected by a program variant, returns the snippet name
+*/
+static bool variant_snippet(input_t& inp, const program_t& prog, const std::string& name, const std::vector<int>& value_indices, std::string& out_name) {
+    const int snippet_index = inp.snippet_map.at(name);
+    std::vector<variant_t> variants = inp.snippets[snippet_index].variants;
+    layout_variant_mask(variants);
+    uint32_t mask = 0;
+    std::vector<std::pair<std::string, std::string>> defines;
+    for (const variant_t& variant: variants) {
+        for (int i = 0; i < (int)prog.variants.size(); i++) {
+            if (prog.variants[i].name == variant.name) {
+                mask |= (uint32_t)value_indices[i] << variant.shift;
+                defines.push_back({ variant.name, variant.values[value_indices[i]] });
+            }
+        }
+    }
+    if (mask == 0) {
+        out_name = name;
+        return true;
+    }
+    out_name = fmt::format("{}_v{}", name, mask);
+    if (inp.snippet_map.count(out_name) > 0) {
+        if (inp.snippets[inp.snippet_map.at(out_name)].variant_index != snippet_index) {
+            inp.out_error = inp.error(prog.line_index, fmt::format("name of variant '{}' of '{}' is already used.", out_name, name));
+            return false;
+        }
+        return true;
+    }
+    snippet_t snippet = inp.snippets[snippet_index];
+    snippet.name = out_name;
+    snippet.variant_index = snippet_index;
+    snippet.variants.clear();
+    snippet.defines = defines;
+    const int new_index = (int)inp.snippets.size();
+    inp.snippet_map[out_name] = new_index;
+    if (snippet.type == snippet_t::VS) {
+        inp.vs_map[out_name] = new_index;
+    }
+    else {
+        inp.fs_map[out_name] = new_index;
+    }
+    inp.snippets.push_back(std::move(snippet));
+    return true;
+}
+
+/* create the copy of a vs or fs snippet which is specialized for a program, returns the snippet name */
+static std::string specialized_snippet(input_t& inp, const program_t& prog, const std::string& name) {
+    const int snippet_index = inp.snippet_map.at(name);
+    snippet_t snippet = inp.snippets[snippet_index];
+    std::string new_name = fmt::format("{}_{}", name, prog.name);
+    for (int i = 2; inp.snippet_map.count(new_name) > 0; i++) {
+        new_name = fmt::format("{}_{}_{}", name, prog.name, i);
+    }
+    snippet.name = new_name;
+    snippet.variant_index = snippet_index;
+    snippet.spec_constants = prog.spec_constants;
+    const int new_index = (int)inp.snippets.size();
+    inp.snippet_map[new_name] = new_index;
+    if (snippet.type == snippet_t::VS) {
+        inp.vs_map[new_name] = new_index;
+    }
+    else {
+        inp.fs_map[new_name] = new_index;
+    }
+    inp.snippets.push_back(std::move(snippet));
+    return new_name;
+}
+
+/* specialize the vertex and fragment shader of each program with a @specialize
+    tag into copies named [snippet]_[program] (the @variants of the original
+    shaders are expanded from the specialized copies)
+*/
+static void specialize_programs(input_t& inp) {
+    for (auto& item: inp.programs) {
+        program_t& prog = item.second;
+        if (!prog.spec_constants.empty()) {
+            prog.vs_name = specialized_snippet(inp, prog, prog.vs_name);
+            prog.fs_name = specialized_snippet(inp, prog, prog.fs_name);
+        }
+    }
+}
+
+/* expand the @variants of the vertex and fragment shader of each program
+    into one program per permutation of the variant defines, the permutation
+    with all default values is the original program, all other permutations
+    are copies named [program]_v[mask], with the vs and fs snippets copied
+    as [snippet]_v[mask] (where the mask only covers the snippet's own defines)
+*/
+static bool expand_variants(input_t& inp) {
+    std::vector<std::string> prog_names;
+    for (const auto& item: inp.programs) {
+        prog_names.push_back(item.first);
+    }
+    for (const std::string& prog_name: prog_names) {
+        program_t& prog = inp.programs[prog_name];
+        const snippet_t& vs = inp.snippets[inp.vs_map.at(prog.vs_name)];
+        const snippet_t& fs = inp.snippets[inp.fs_map.at(prog.fs_name)];
+        if (vs.variants.empty() && fs.variants.empty()) {
+            continue;
+        }
+        // a define which is used by both shaders must have the same values in both
+        prog.variants = vs.variants;
+        for (const variant_t& variant: fs.variants) {
+            const auto it = std::find_if(prog.variants.begin(), prog.variants.end(), [&variant](const variant_t& v) { return v.name == variant.name; });
+            if (it == prog.variants.end()) {
+                prog.variants.push_back(variant);
+            }
+            else if (it->values != variant.values) {
+                inp.out_error = inp.error(prog.line_index, fmt::format("@variants define '{}' has different values in '{}' and '{}' for @program '{}'.", variant.name, prog.vs_name, prog.fs_name, prog.name));
+                return false;
+            }
+        }
+        int num_variants = 1;
+        for (const variant_t& variant: prog.variants) {
+            num_variants *= (int)variant.values.size();
+            if (num_variants > max_variants) {
+                inp.out_error = inp.error(prog.line_index, fmt::format("@program '{}' has too many variants (max {}).", prog.name, max_variants));
+                return false;
+            }
+        }
+        layout_variant_mask(prog.variants);
+        prog.variant_map[0] = prog.name;
+        for (int variant_nr = 1; variant_nr < num_variants; variant_nr++) {
+            // the value index of each define, the first define changes fastest
+            std::vector<int> value_indices;
+            uint32_t mask = 0;
+            int rest = variant_nr;
+            for (const variant_t& variant: prog.variants) {
+                value_indices.push_back(rest % (int)variant.values.size());
+                mask |= (uint32_t)value_indices.back() << variant.shift;
+                rest /= (int)variant.values.size();
+            }
+            std::string vs_name, fs_name;
+            if (!variant_snippet(inp, prog, prog.vs_name, value_indices, vs_name) ||
+                !variant_snippet(inp, prog, prog.fs_name, value_indices, fs_name))
+            {
+                return false;
+            }
+            const std::string name = fmt::format("{}_v{}", prog.name, mask);
+            if (inp.programs.count(name) > 0) {
+                inp.out_error = inp.error(prog.line_index, fmt::format("name of variant '{}' of @program '{}' is already used.", name, prog.name));
+                return false;
+            }
+            program_t variant_prog(name, vs_name, fs_name, prog.line_index);
+            variant_prog.priority = prog.priority;
+            variant_prog.move_to_vs = prog.move_to_vs;
+            inp.programs[name] = variant_prog;
+            prog.variant_map[mask] = name;
+        }
+    }
+    return true;
+}
+
 static bool validate_include_tag(const std::vector<std::string>& tokens, int line_nr, const std::string& path, input_t& inp) {
     if (tokens.size() != 2) {
         inp.out_error = errmsg_t::error(path, line_nr, "@include tag must have exactly one arg (@include filename).");
@@ -538,8 +1093,9 @@ input_t input_t::load_and_parse(const std::string& path) {
 
     input_t inp;
     inp.base_path = path;
-    if (load_and_preprocess(path, include_dirs, inp, 0)) {
-        parse(inp);
+    if (load_and_preprocess(path, include_dirs, inp, 0) && parse(inp)) {
+        specialize_programs(inp);
+        expand_variants(inp);
     }
 
     return inp;
@@ -571,6 +1127,12 @@ void input_t::dump_debug(errmsg_t::msg_format_t err_fmt) const {
     for (const auto& item: type_map) {
         fmt::print(stderr, "    {}: {}\n", item.first, item.second);
     }
+    fmt::print(stderr, "  frequencies:\n");
+    for (const auto& block_item: frequency_map) {
+        for (const auto& member_item: block_item.second) {
+            fmt::print(stderr, "    {}{}{}: {}\n", block_item.first, member_item.first.empty() ? "" : ".", member_item.first, frequency_t::to_str(member_item.second));
+        }
+    }
     {
         int snippet_nr = 0;
         fmt::print(stderr, "  snippets:\n");
@@ -578,6 +1140,24 @@ void input_t::dump_debug(errmsg_t::msg_format_t err_fmt) const {
             fmt::print(stderr, "    snippet {}:\n", snippet_nr++);
             fmt::print(stderr, "      name: {}\n", snippet.name);
             fmt::print(stderr, "      type: {}\n", snippet_t::type_to_str(snippet.type));
+            fmt::print(stderr, "      opt_level: {}\n", opt_level_t::to_str(snippet.opt_level));
+            for (const auto& define: snippet.defines) {
+                fmt::print(stderr, "      define: {} {}\n", define.first, define.second);
+            }
+            for (const auto& spec_constant: snippet.spec_constants) {
+                fmt::print(stderr, "      spec_constant: {}={}\n", spec_constant.first, spec_constant.second);
+            }
+            for (const auto& attr_format: snippet.attr_formats) {
+                fmt::print(stderr, "      format: {} {}\n", attr_format.first, vertex_format_t::to_str(attr_format.second));
+            }
+            for (const std::string& attr: snippet.instance_attrs) {
+                fmt::print(stderr, "      instance: {}\n", attr);
+            }
+            for (int i = 0; i < slang_t::NUM; i++) {
+                if (snippet.precision[i] != precision_t::INVALID) {
+                    fmt::print(stderr, "      precision {}: {}\n", slang_t::to_str((slang_t::type_t)i), precision_t::to_str(snippet.precision[i]));
+                }
+            }
             fmt::print(stderr, "      lines:\n");
             int line_nr = 1;
             for (int line_index : snippet.lines) {
@@ -610,6 +1190,17 @@ void input_t::dump_debug(errmsg_t::msg_format_t err_fmt) const {
         fmt::print(stderr, "      vs: {}\n", prog.vs_name);
         fmt::print(stderr, "      fs: {}\n", prog.fs_name);
         fmt::print(stderr, "      line_index: {}\n", prog.line_index);
+        fmt::print(stderr, "      priority: {}\n", prog.priority);
+        fmt::print(stderr, "      move_to_vs: {}\n", prog.move_to_vs);
+        for (const auto& spec_constant: prog.spec_constants) {
+            fmt::print(stderr, "      spec_constant: {}={}\n", spec_constant.first, spec_constant.second);
+        }
+        for (const variant_t& variant: prog.variants) {
+            fmt::print(stderr, "      variant: {} {} (shift: {}, bits: {})\n", variant.name, pystring::join(",", variant.values), variant.shift, variant.bits);
+        }
+        for (const auto& variant_item: prog.variant_map) {
+            fmt::print(stderr, "      variant mask {}: {}\n", variant_item.first, variant_item.second);
+        }
     }
     fmt::print("\n");
 }
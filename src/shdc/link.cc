@@ -0,0 +1,1589 @@
+/*
+    Cross-stage link-time optimization of the vertex/fragment shader pairs
+    of each @program: varyings which are never read by the fragment shader
+    are removed from both stages (and the computations in the vertex shader
+    which only fed those varyings are removed by the optimizer), varyings
+    which are set to a compile-time constant in the vertex shader are
+    folded into the fragment shader, and the remaining varyings are
+    renumbered to contiguous locations. Optionally, float scalar, vec2 and
+    vec3 varyings are packed into as few vec4 varyings as possible, and for
+    programs tagged with @move_to_vs, fragment shader computations which are
+    linear in the varyings are moved into the vertex shader.
+
+    Vertex and fragment shaders which are shared between several programs
+    are specialized into copies if the programs need different changes.
+*/
+#include "shdc.h"
+#include "fmt/format.h"
+#include "pystring.h"
+#include <algorithm>
+#include <set>
+
+namespace shdc {
+
+/* the shape of a 32-bit scalar or vector type */
+struct link_shape_t {
+    spv::Op base = spv::OpNop;  // OpTypeFloat or OpTypeInt
+    uint32_t signedness = 0;
+    uint32_t count = 0;
+
+    bool equals(const link_shape_t& rhs) const {
+        return (base == rhs.base) && (signedness == rhs.signedness) && (count == rhs.count);
+    }
+};
+
+/* a constant value stored into a vertex shader output */
+struct link_const_t {
+    link_shape_t shape;
+    std::vector<uint32_t> words;
+
+    bool equals(const link_const_t& rhs) const {
+        return shape.equals(rhs.shape) && (words == rhs.words);
+    }
+};
+
+/* the SPIRV bytecode and GLSL100 fallback bytecode of a shader for each shader language */
+typedef std::vector<std::vector<uint32_t>> link_variant_t;
+
+static bool type_shape(const spirv_module_t& mod, uint32_t type_id, link_shape_t& out_shape) {
+    int index = mod.find_def(type_id);
+    if (index < 0) {
+        return false;
+    }
+    const spirv_inst_t* inst = &mod.insts[index];
+    out_shape.count = 1;
+    if ((inst->op == spv::OpTypeVector) && (inst->operands.size() == 3)) {
+        out_shape.count = inst->operands[2];
+        index = mod.find_def(inst->operands[1]);
+        if (index < 0) {
+            return false;
+        }
+        inst = &mod.insts[index];
+    }
+    if ((inst->op == spv::OpTypeFloat) && (inst->operands.size() == 2) && (inst->operands[1] == 32)) {
+        out_shape.base = spv::OpTypeFloat;
+        out_shape.signedness = 0;
+    }
+    else if ((inst->op == spv::OpTypeInt) && (inst->operands.size() == 3) && (inst->operands[1] == 32)) {
+        out_shape.base = spv::OpTypeInt;
+        out_shape.signedness = inst->operands[2];
+    }
+    else {
+        return false;
+    }
+    return (out_shape.count >= 1) && (out_shape.count <= 4);
+}
+
+/* return the type a variable points to, or 0 */
+static uint32_t pointee_type(const spirv_module_t& mod, uint32_t var_id) {
+    const int var_index = mod.find_def(var_id);
+    if (var_index < 0) {
+        return 0;
+    }
+    const int ptr_index = mod.find_def(mod.insts[var_index].operands[0]);
+    if ((ptr_index < 0) || (mod.insts[ptr_index].op != spv::OpTypePointer) || (mod.insts[ptr_index].operands.size() != 3)) {
+        return 0;
+    }
+    return mod.insts[ptr_index].operands[2];
+}
+
+/* a varying which is a 32-bit scalar or vector only occupies a single location */
+static bool is_single_location(const spirv_module_t& mod, uint32_t var_id) {
+    link_shape_t shape;
+    return type_shape(mod, pointee_type(mod, var_id), shape);
+}
+
+/* gather the location-decorated input or output variables, returns false for
+    overlapping locations or component packing which isn't supported
+*/
+static bool gather_varyings(const spirv_module_t& mod, spv::StorageClass storage_class, std::map<uint32_t, uint32_t>& out_vars) {
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op != spv::OpVariable) || (inst.operands.size() < 3) || (inst.operands[2] != (uint32_t)storage_class)) {
+            continue;
+        }
+        const uint32_t var_id = inst.operands[1];
+        uint32_t location = 0;
+        uint32_t component = 0;
+        if (!mod.find_decoration(var_id, spv::DecorationLocation, location)) {
+            // a builtin
+            continue;
+        }
+        if (mod.find_decoration(var_id, spv::DecorationComponent, component) || (out_vars.count(location) > 0)) {
+            return false;
+        }
+        out_vars[location] = var_id;
+    }
+    return true;
+}
+
+static bool constant_value(const spirv_module_t& mod, uint32_t const_id, link_const_t& out_const) {
+    const int index = mod.find_def(const_id);
+    if (index < 0) {
+        return false;
+    }
+    const spirv_inst_t& inst = mod.insts[index];
+    out_const.words.clear();
+    if ((inst.op == spv::OpConstant) && (inst.operands.size() == 3)) {
+        out_const.words.push_back(inst.operands[2]);
+    }
+    else if (inst.op == spv::OpConstantComposite) {
+        for (size_t i = 2; i < inst.operands.size(); i++) {
+            const int comp_index = mod.find_def(inst.operands[i]);
+            if ((comp_index < 0) || (mod.insts[comp_index].op != spv::OpConstant) || (mod.insts[comp_index].operands.size() != 3)) {
+                return false;
+            }
+            out_const.words.push_back(mod.insts[comp_index].operands[2]);
+        }
+    }
+    else {
+        return false;
+    }
+    return type_shape(mod, inst.operands[0], out_const.shape) && (out_const.words.size() == out_const.shape.count);
+}
+
+/* check if a vertex shader output is only written once with a constant */
+static bool constant_output(const spirv_module_t& mod, uint32_t var_id, link_const_t& out_const) {
+    const std::vector<int> uses = mod.find_uses(var_id);
+    if (uses.size() != 1) {
+        return false;
+    }
+    const spirv_inst_t& inst = mod.insts[uses[0]];
+    if ((inst.op != spv::OpStore) || (inst.operands.size() < 2) || (inst.operands[0] != var_id)) {
+        return false;
+    }
+    return constant_value(mod, inst.operands[1], out_const);
+}
+
+static void remove_variable(spirv_module_t& mod, uint32_t var_id) {
+    mod.remove_decorations(var_id);
+    mod.remove_names(var_id);
+    mod.remove_from_interface(var_id);
+    const int index = mod.find_def(var_id);
+    if (index >= 0) {
+        mod.insts.erase(mod.insts.begin() + index);
+    }
+}
+
+/* remove a vertex shader output and the stores into it, fails if the output is used otherwise */
+static bool remove_output(spirv_module_t& mod, uint32_t var_id) {
+    const std::vector<int> uses = mod.find_uses(var_id);
+    for (int index: uses) {
+        const spirv_inst_t& inst = mod.insts[index];
+        if ((inst.op != spv::OpStore) || (inst.operands.size() < 2) || (inst.operands[0] != var_id) || (inst.operands[1] == var_id)) {
+            return false;
+        }
+    }
+    for (auto it = uses.rbegin(); it != uses.rend(); ++it) {
+        mod.insts.erase(mod.insts.begin() + *it);
+    }
+    remove_variable(mod, var_id);
+    return true;
+}
+
+/* remove an unused fragment shader input */
+static bool remove_input(spirv_module_t& mod, uint32_t var_id) {
+    if (!mod.find_uses(var_id).empty()) {
+        return false;
+    }
+    remove_variable(mod, var_id);
+    return true;
+}
+
+/* turn a fragment shader input into a private variable initialized with a constant,
+    the optimizer passes then propagate the constant into the loads
+*/
+static bool fold_input(spirv_module_t& mod, uint32_t var_id, const link_const_t& value) {
+    for (int index: mod.find_uses(var_id)) {
+        const spirv_inst_t& inst = mod.insts[index];
+        if ((inst.op != spv::OpLoad) || (inst.operands.size() < 3) || (inst.operands[2] != var_id)) {
+            return false;
+        }
+    }
+    int var_index = mod.find_def(var_id);
+    const uint32_t type_id = pointee_type(mod, var_id);
+    link_shape_t shape;
+    if ((var_index < 0) || !type_shape(mod, type_id, shape) || !shape.equals(value.shape)) {
+        return false;
+    }
+    uint32_t comp_type_id = type_id;
+    if (shape.count > 1) {
+        comp_type_id = mod.insts[mod.find_def(type_id)].operands[1];
+    }
+    std::vector<spirv_inst_t> decls;
+    std::vector<uint32_t> comp_ids;
+    for (uint32_t word: value.words) {
+        const uint32_t comp_id = mod.alloc_id();
+        decls.push_back(spirv_inst_t(spv::OpConstant, { comp_type_id, comp_id, word }));
+        comp_ids.push_back(comp_id);
+    }
+    uint32_t const_id = comp_ids[0];
+    if (shape.count > 1) {
+        const_id = mod.alloc_id();
+        std::vector<uint32_t> operands = { type_id, const_id };
+        operands.insert(operands.end(), comp_ids.begin(), comp_ids.end());
+        decls.push_back(spirv_inst_t(spv::OpConstantComposite, operands));
+    }
+    // non-aggregate types must be unique, so reuse an existing private pointer type
+    uint32_t ptr_type_id = 0;
+    for (int i = 0; i < var_index; i++) {
+        const spirv_inst_t& inst = mod.insts[i];
+        if ((inst.op == spv::OpTypePointer) && (inst.operands[1] == (uint32_t)spv::StorageClassPrivate) && (inst.operands[2] == type_id)) {
+            ptr_type_id = inst.operands[0];
+            break;
+        }
+    }
+    if (ptr_type_id == 0) {
+        ptr_type_id = mod.alloc_id();
+        decls.push_back(spirv_inst_t(spv::OpTypePointer, { ptr_type_id, (uint32_t)spv::StorageClassPrivate, type_id }));
+    }
+    mod.insts.insert(mod.insts.begin() + var_index, decls.begin(), decls.end());
+    var_index += (int)decls.size();
+    mod.insts[var_index].operands = { ptr_type_id, var_id, (uint32_t)spv::StorageClassPrivate, const_id };
+    mod.remove_decorations(var_id);
+    mod.remove_from_interface(var_id);
+    return true;
+}
+
+/* change the location decorations of input or output variables */
+static void renumber_varyings(spirv_module_t& mod, spv::StorageClass storage_class, const std::map<uint32_t, uint32_t>& remap) {
+    std::map<uint32_t, uint32_t> vars;
+    gather_varyings(mod, storage_class, vars);
+    for (spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpDecorate) && (inst.operands.size() == 3) && (inst.operands[1] == (uint32_t)spv::DecorationLocation)) {
+            auto var_it = vars.find(inst.operands[2]);
+            auto remap_it = remap.find(inst.operands[2]);
+            if ((var_it != vars.end()) && (var_it->second == inst.operands[0]) && (remap_it != remap.end())) {
+                inst.operands[2] = remap_it->second;
+            }
+        }
+    }
+}
+
+/* a varying which is packed into a vec4 together with other varyings */
+struct link_pack_member_t {
+    uint32_t location = 0;  // original location of the varying
+    uint32_t count = 0;     // number of components
+    uint32_t offset = 0;    // first component in the packed vec4
+};
+
+/* a packed vec4 varying */
+struct link_pack_t {
+    std::vector<link_pack_member_t> members;
+    uint32_t size = 0;
+};
+
+/* check if a varying can be packed, this must be a float scalar, vec2 or vec3
+    without interpolation qualifiers, which is only accessed with whole loads and stores
+*/
+static bool is_packable(const spirv_module_t& mod, uint32_t var_id, link_shape_t& out_shape) {
+    if (!type_shape(mod, pointee_type(mod, var_id), out_shape) || (out_shape.base != spv::OpTypeFloat) || (out_shape.count > 3)) {
+        return false;
+    }
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpDecorate) && (inst.operands[0] == var_id)) {
+            if ((inst.operands[1] != (uint32_t)spv::DecorationLocation) && (inst.operands[1] != (uint32_t)spv::DecorationRelaxedPrecision)) {
+                return false;
+            }
+        }
+    }
+    for (int index: mod.find_uses(var_id)) {
+        const spirv_inst_t& inst = mod.insts[index];
+        const bool is_load = (inst.op == spv::OpLoad) && (inst.operands.size() >= 3) && (inst.operands[2] == var_id);
+        const bool is_store = (inst.op == spv::OpStore) && (inst.operands.size() >= 2) && (inst.operands[0] == var_id) && (inst.operands[1] != var_id);
+        if (!is_load && !is_store) {
+            return false;
+        }
+    }
+    // the packed varyings need a debug name which matches between stages
+    return mod.find_first(spv::OpName) >= 0;
+}
+
+/* turn an input or output variable into a private variable */
+static void make_private(spirv_module_t& mod, uint32_t var_id) {
+    const uint32_t ptr_type_id = mod.find_or_add_global(spv::OpTypePointer, { (uint32_t)spv::StorageClassPrivate, pointee_type(mod, var_id) }, 0);
+    // move the variable behind the (possibly new) pointer type
+    mod.insts.erase(mod.insts.begin() + mod.find_def(var_id));
+    mod.add_global(spirv_inst_t(spv::OpVariable, { ptr_type_id, var_id, (uint32_t)spv::StorageClassPrivate }));
+    mod.remove_decorations(var_id);
+    mod.remove_from_interface(var_id);
+}
+
+/* add a new input or output variable with a location and debug name */
+static uint32_t add_varying_var(spirv_module_t& mod, spv::StorageClass storage_class, uint32_t type_id, uint32_t location, const std::string& name) {
+    const uint32_t ptr_type_id = mod.find_or_add_global(spv::OpTypePointer, { (uint32_t)storage_class, type_id }, 0);
+    const uint32_t var_id = mod.alloc_id();
+    mod.add_global(spirv_inst_t(spv::OpVariable, { ptr_type_id, var_id, (uint32_t)storage_class }));
+    mod.insts.insert(mod.insts.begin() + mod.find_first(spv::OpDecorate), spirv_inst_t(spv::OpDecorate, { var_id, (uint32_t)spv::DecorationLocation, location }));
+    std::vector<uint32_t> name_operands = { var_id };
+    const std::vector<uint32_t> words = spirv_module_t::string_words(name);
+    name_operands.insert(name_operands.end(), words.begin(), words.end());
+    mod.insts.insert(mod.insts.begin() + mod.find_first(spv::OpName), spirv_inst_t(spv::OpName, name_operands));
+    for (spirv_inst_t& inst: mod.insts) {
+        if (inst.op == spv::OpEntryPoint) {
+            inst.operands.push_back(var_id);
+        }
+    }
+    return var_id;
+}
+
+/* pack varyings into vec4 variables, the vertex shader writes the packed
+    variables before each return, and the fragment shader unpacks them at the
+    start of the entry function, the original varyings become private variables
+    which are removed by the cleanup passes
+*/
+static bool pack_varyings(spirv_module_t& mod, bool is_vs, const std::map<uint32_t, uint32_t>& vars, const std::vector<link_pack_t>& packs) {
+    const int ep_index = mod.find_first(spv::OpEntryPoint);
+    if ((ep_index < 0) || (mod.find_first(spv::OpDecorate) < 0) || (mod.find_first(spv::OpName) < 0)) {
+        return false;
+    }
+    const uint32_t func_id = mod.insts[ep_index].operands[1];
+    const uint32_t float_type_id = mod.find_or_add_global(spv::OpTypeFloat, { 32 }, 0);
+    const uint32_t vec4_type_id = mod.find_or_add_global(spv::OpTypeVector, { float_type_id, 4 }, 0);
+    const uint32_t zero_id = mod.find_or_add_global(spv::OpConstant, { float_type_id, 0 }, 1);
+    const spv::StorageClass storage_class = is_vs ? spv::StorageClassOutput : spv::StorageClassInput;
+    std::vector<uint32_t> packed_ids;
+    for (size_t pack_index = 0; pack_index < packs.size(); pack_index++) {
+        const link_pack_t& pack = packs[pack_index];
+        packed_ids.push_back(add_varying_var(mod, storage_class, vec4_type_id, pack.members[0].location, fmt::format("packed_varying{}", pack_index)));
+        for (const link_pack_member_t& member: pack.members) {
+            make_private(mod, vars.at(member.location));
+        }
+    }
+    // generate the packing or unpacking code
+    std::vector<spirv_inst_t> code;
+    for (size_t pack_index = 0; pack_index < packs.size(); pack_index++) {
+        const link_pack_t& pack = packs[pack_index];
+        if (is_vs) {
+            std::vector<uint32_t> construct = { vec4_type_id, mod.alloc_id() };
+            for (const link_pack_member_t& member: pack.members) {
+                const uint32_t var_id = vars.at(member.location);
+                const uint32_t load_id = mod.alloc_id();
+                code.push_back(spirv_inst_t(spv::OpLoad, { pointee_type(mod, var_id), load_id, var_id }));
+                construct.push_back(load_id);
+            }
+            for (uint32_t i = pack.size; i < 4; i++) {
+                construct.push_back(zero_id);
+            }
+            code.push_back(spirv_inst_t(spv::OpCompositeConstruct, construct));
+            code.push_back(spirv_inst_t(spv::OpStore, { packed_ids[pack_index], construct[1] }));
+        }
+        else {
+            const uint32_t load_id = mod.alloc_id();
+            code.push_back(spirv_inst_t(spv::OpLoad, { vec4_type_id, load_id, packed_ids[pack_index] }));
+            for (const link_pack_member_t& member: pack.members) {
+                const uint32_t var_id = vars.at(member.location);
+                const uint32_t value_id = mod.alloc_id();
+                if (member.count == 1) {
+                    code.push_back(spirv_inst_t(spv::OpCompositeExtract, { float_type_id, value_id, load_id, member.offset }));
+                }
+                else {
+                    std::vector<uint32_t> shuffle = { pointee_type(mod, var_id), value_id, load_id, load_id };
+                    for (uint32_t i = 0; i < member.count; i++) {
+                        shuffle.push_back(member.offset + i);
+                    }
+                    code.push_back(spirv_inst_t(spv::OpVectorShuffle, shuffle));
+                }
+                code.push_back(spirv_inst_t(spv::OpStore, { var_id, value_id }));
+            }
+        }
+    }
+    int index = mod.find_def(func_id);
+    if (index < 0) {
+        return false;
+    }
+    if (is_vs) {
+        for (; (index < (int)mod.insts.size()) && (mod.insts[index].op != spv::OpFunctionEnd); index++) {
+            if (mod.insts[index].op == spv::OpReturn) {
+                mod.insts.insert(mod.insts.begin() + index, code.begin(), code.end());
+                index += (int)code.size();
+            }
+        }
+    }
+    else {
+        // function-local variables must come first in the entry block
+        while ((index < (int)mod.insts.size()) && (mod.insts[index].op != spv::OpLabel)) {
+            index++;
+        }
+        index++;
+        while ((index < (int)mod.insts.size()) && ((mod.insts[index].op == spv::OpVariable) || (mod.insts[index].op == spv::OpLine) || (mod.insts[index].op == spv::OpNoLine))) {
+            index++;
+        }
+        mod.insts.insert(mod.insts.begin() + index, code.begin(), code.end());
+    }
+    return true;
+}
+
+/* assign the packable varyings to vec4 slots (first-fit decreasing), only
+    slots with more than one varying are returned
+*/
+static std::vector<link_pack_t> plan_packing(const std::vector<link_pack_member_t>& candidates) {
+    std::vector<link_pack_member_t> sorted = candidates;
+    std::stable_sort(sorted.begin(), sorted.end(), [](const link_pack_member_t& a, const link_pack_member_t& b) { return a.count > b.count; });
+    std::vector<link_pack_t> packs;
+    for (link_pack_member_t member: sorted) {
+        auto it = std::find_if(packs.begin(), packs.end(), [&member](const link_pack_t& pack) { return (pack.size + member.count) <= 4; });
+        if (it == packs.end()) {
+            packs.push_back(link_pack_t());
+            it = packs.end() - 1;
+        }
+        member.offset = it->size;
+        it->members.push_back(member);
+        it->size += member.count;
+    }
+    packs.erase(std::remove_if(packs.begin(), packs.end(), [](const link_pack_t& pack) { return pack.members.size() < 2; }), packs.end());
+    return packs;
+}
+
+/* a fragment shader value which can be computed in the vertex shader instead,
+    either uniform (only depends on constants and on uniform blocks which are
+    also declared in the vertex shader), or linear (affine) in the varyings,
+    linear values are interpolated exactly when they are computed per vertex
+*/
+struct link_linear_t {
+    spirv_inst_t inst;                  // the defining instruction
+    bool is_linear = false;             // depends on varyings
+    bool has_math = false;              // false for loads, constants and values which only move components around
+    bool is_varying = false;            // a load of a varying
+    uint32_t location = 0;              // varying loads: the input location
+    std::string block;                  // uniform loads: the uniform block signature
+    std::vector<uint32_t> indices;      // uniform loads: the access chain index constants
+    std::vector<size_t> arg_pos;        // positions of the value operands in inst.operands
+    std::string key;                    // canonical expression, identical in the SPIRV and fallback SPIRV
+};
+
+/* the vertex shader counterparts of the fragment shader inputs and uniform blocks */
+struct link_vs_env_t {
+    std::map<uint32_t, uint32_t> outputs;       // location => output variable
+    std::map<std::string, uint32_t> blocks;     // uniform block signature => uniform variable
+};
+
+/* the guaranteed minimum number of vec4 varyings of a shader language */
+static int max_varyings(slang_t::type_t slang) {
+    switch (slang) {
+        case slang_t::GLSL100:      return 8;
+        case slang_t::GLSL330:
+        case slang_t::GLSL300ES:
+        case slang_t::WGPU:         return 15;
+        default:                    return 31;
+    }
+}
+
+/* the number of locations occupied by a varying type */
+static uint32_t location_count(const spirv_module_t& mod, uint32_t type_id) {
+    const int index = mod.find_def(type_id);
+    if (index < 0) {
+        return 1;
+    }
+    const spirv_inst_t& inst = mod.insts[index];
+    if (inst.op == spv::OpTypeMatrix) {
+        return inst.operands[2];
+    }
+    else if (inst.op == spv::OpTypeArray) {
+        const int len_index = mod.find_def(inst.operands[2]);
+        const uint32_t len = ((len_index >= 0) && (mod.insts[len_index].op == spv::OpConstant)) ? mod.insts[len_index].operands[2] : 1;
+        return len * location_count(mod, inst.operands[1]);
+    }
+    return 1;
+}
+
+/* the number of varying slots, and the first free location */
+static uint32_t varying_slots(const spirv_module_t& mod, const std::map<uint32_t, uint32_t>& vars, uint32_t& out_next_location) {
+    uint32_t num_slots = 0;
+    out_next_location = 0;
+    for (const auto& item: vars) {
+        const uint32_t count = location_count(mod, pointee_type(mod, item.second));
+        num_slots += count;
+        out_next_location = std::max(out_next_location, item.first + count);
+    }
+    return num_slots;
+}
+
+/* check if a type is a 32-bit float scalar, vector or matrix */
+static bool is_float_value_type(const spirv_module_t& mod, uint32_t type_id) {
+    link_shape_t shape;
+    const int index = mod.find_def(type_id);
+    if ((index >= 0) && (mod.insts[index].op == spv::OpTypeMatrix)) {
+        return type_shape(mod, mod.insts[index].operands[1], shape) && (shape.base == spv::OpTypeFloat);
+    }
+    return type_shape(mod, type_id, shape) && (shape.base == spv::OpTypeFloat);
+}
+
+/* a uniform block is identified by its name and member names in both stages */
+static std::string block_signature(const spirv_module_t& mod, uint32_t var_id) {
+    uint32_t dummy = 0;
+    const uint32_t type_id = pointee_type(mod, var_id);
+    if ((type_id == 0) || !mod.find_decoration(type_id, spv::DecorationBlock, dummy)) {
+        return "";
+    }
+    std::string name;
+    std::string members;
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpName) && (inst.operands[0] == type_id)) {
+            name = (const char*)&inst.operands[1];
+        }
+        else if ((inst.op == spv::OpMemberName) && (inst.operands[0] == type_id)) {
+            members += fmt::format(",{}:{}", inst.operands[1], (const char*)&inst.operands[2]);
+        }
+    }
+    return name.empty() ? "" : (name + members);
+}
+
+static uint32_t glsl_std_import(const spirv_module_t& mod) {
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpExtInstImport) && (std::string((const char*)&inst.operands[1]) == "GLSL.std.450")) {
+            return inst.operands[0];
+        }
+    }
+    return 0;
+}
+
+/* check if a value of a supported instruction is linear, given which operands are linear */
+static bool is_linear_op(const spirv_inst_t& inst, const std::vector<bool>& linear) {
+    switch (inst.op) {
+        case spv::OpFNegate:
+        case spv::OpFAdd:
+        case spv::OpFSub:
+        case spv::OpCompositeConstruct:
+        case spv::OpCompositeExtract:
+        case spv::OpVectorShuffle:
+            return true;
+        case spv::OpFMul:
+        case spv::OpVectorTimesScalar:
+        case spv::OpMatrixTimesScalar:
+        case spv::OpMatrixTimesMatrix:
+        case spv::OpDot:
+            return !(linear[0] && linear[1]);
+        case spv::OpFDiv:
+        case spv::OpVectorTimesMatrix:
+            return !linear[1];
+        case spv::OpMatrixTimesVector:
+            return !linear[0];
+        case spv::OpExtInst:
+            switch (inst.operands[3]) {
+                case 11:    // Radians
+                case 12:    // Degrees
+                    return true;
+                case 46:    // FMix
+                    return !linear[2] || (!linear[0] && !linear[1]);
+                case 50:    // Fma
+                case 68:    // Cross
+                    return !(linear[0] && linear[1]);
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+/* find the uniform and linear values of a fragment shader */
+static std::map<uint32_t, link_linear_t> gather_linear(const spirv_module_t& mod, const std::map<uint32_t, uint32_t>& inputs) {
+    // only float varyings without interpolation qualifiers
+    std::map<uint32_t, uint32_t> input_locations;
+    for (const auto& item: inputs) {
+        link_shape_t shape;
+        if (!type_shape(mod, pointee_type(mod, item.second), shape) || (shape.base != spv::OpTypeFloat)) {
+            continue;
+        }
+        bool has_qualifiers = false;
+        for (const spirv_inst_t& inst: mod.insts) {
+            if ((inst.op == spv::OpDecorate) && (inst.operands[0] == item.second)) {
+                has_qualifiers |= (inst.operands[1] != (uint32_t)spv::DecorationLocation) && (inst.operands[1] != (uint32_t)spv::DecorationRelaxedPrecision);
+            }
+        }
+        if (!has_qualifiers) {
+            input_locations[item.second] = item.first;
+        }
+    }
+    const uint32_t glsl_std_id = glsl_std_import(mod);
+    std::map<uint32_t, std::string> block_vars;
+    std::map<uint32_t, link_linear_t> chains;
+    std::map<uint32_t, link_linear_t> values;
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpVariable) && (inst.operands[2] == (uint32_t)spv::StorageClassUniform)) {
+            const std::string signature = block_signature(mod, inst.operands[1]);
+            if (!signature.empty()) {
+                block_vars[inst.operands[1]] = signature;
+            }
+            continue;
+        }
+        if (((inst.op == spv::OpAccessChain) || (inst.op == spv::OpInBoundsAccessChain)) && (block_vars.count(inst.operands[2]) > 0)) {
+            link_linear_t chain;
+            chain.block = block_vars[inst.operands[2]];
+            chain.key = chain.block;
+            bool valid = true;
+            for (size_t i = 3; i < inst.operands.size(); i++) {
+                link_const_t index;
+                valid &= constant_value(mod, inst.operands[i], index) && (index.shape.base == spv::OpTypeInt) && (index.shape.count == 1);
+                if (valid) {
+                    chain.indices.push_back(inst.operands[i]);
+                    chain.key += fmt::format("[{}]", index.words[0]);
+                }
+            }
+            if (valid) {
+                chains[inst.operands[1]] = chain;
+            }
+            continue;
+        }
+        if ((inst.operands.size() < 2) || !is_float_value_type(mod, inst.operands[0])) {
+            continue;
+        }
+        link_linear_t val;
+        val.inst = inst;
+        std::string literals;
+        switch (inst.op) {
+            case spv::OpConstant:
+            case spv::OpConstantComposite:
+                {
+                    val.key = "const";
+                    for (size_t i = 2; i < inst.operands.size(); i++) {
+                        auto it = values.find(inst.operands[i]);
+                        if (inst.op == spv::OpConstant) {
+                            val.key += fmt::format(":{:#x}", inst.operands[i]);
+                        }
+                        else if ((it != values.end()) && (it->second.inst.op == spv::OpConstant || it->second.inst.op == spv::OpConstantComposite)) {
+                            val.key += "(" + it->second.key + ")";
+                        }
+                        else {
+                            val.key.clear();
+                            break;
+                        }
+                    }
+                    if (!val.key.empty()) {
+                        values[inst.operands[1]] = val;
+                    }
+                }
+                continue;
+            case spv::OpLoad:
+                {
+                    auto chain_it = chains.find(inst.operands[2]);
+                    auto input_it = input_locations.find(inst.operands[2]);
+                    if (inst.operands.size() != 3) {
+                        continue;
+                    }
+                    if (chain_it != chains.end()) {
+                        val.block = chain_it->second.block;
+                        val.indices = chain_it->second.indices;
+                        val.key = chain_it->second.key;
+                    }
+                    else if (input_it != input_locations.end()) {
+                        val.is_linear = true;
+                        val.is_varying = true;
+                        val.location = input_it->second;
+                        val.key = fmt::format("in{}", val.location);
+                    }
+                    else {
+                        continue;
+                    }
+                    values[inst.operands[1]] = val;
+                }
+                continue;
+            case spv::OpFNegate:
+            case spv::OpFAdd:
+            case spv::OpFSub:
+            case spv::OpFMul:
+            case spv::OpFDiv:
+            case spv::OpFRem:
+            case spv::OpFMod:
+            case spv::OpVectorTimesScalar:
+            case spv::OpMatrixTimesScalar:
+            case spv::OpVectorTimesMatrix:
+            case spv::OpMatrixTimesVector:
+            case spv::OpMatrixTimesMatrix:
+            case spv::OpDot:
+                for (size_t i = 2; i < inst.operands.size(); i++) {
+                    val.arg_pos.push_back(i);
+                }
+                val.has_math = true;
+                break;
+            case spv::OpCompositeConstruct:
+                for (size_t i = 2; i < inst.operands.size(); i++) {
+                    val.arg_pos.push_back(i);
+                }
+                break;
+            case spv::OpCompositeExtract:
+                val.arg_pos.push_back(2);
+                for (size_t i = 3; i < inst.operands.size(); i++) {
+                    literals += fmt::format(",{}", inst.operands[i]);
+                }
+                break;
+            case spv::OpVectorShuffle:
+                val.arg_pos = { 2, 3 };
+                for (size_t i = 4; i < inst.operands.size(); i++) {
+                    literals += fmt::format(",{}", inst.operands[i]);
+                }
+                break;
+            case spv::OpExtInst:
+                {
+                    // no instructions with pointer operands, and no fragment-shader-only interpolation functions
+                    const uint32_t ext_op = inst.operands[3];
+                    if ((glsl_std_id == 0) || (inst.operands[2] != glsl_std_id) || (ext_op == 35) || (ext_op == 51) || (ext_op >= 76)) {
+                        continue;
+                    }
+                    for (size_t i = 4; i < inst.operands.size(); i++) {
+                        val.arg_pos.push_back(i);
+                    }
+                    literals = fmt::format(",{}", ext_op);
+                    val.has_math = true;
+                }
+                break;
+            default:
+                continue;
+        }
+        bool valid = true;
+        std::vector<bool> linear;
+        std::string args;
+        for (size_t pos: val.arg_pos) {
+            auto it = values.find(inst.operands[pos]);
+            if (it == values.end()) {
+                valid = false;
+                break;
+            }
+            linear.push_back(it->second.is_linear);
+            val.is_linear |= it->second.is_linear;
+            val.has_math |= it->second.has_math;
+            args += (args.empty() ? "" : ",") + it->second.key;
+        }
+        if (!valid || (val.is_linear && !is_linear_op(inst, linear))) {
+            continue;
+        }
+        val.key = fmt::format("{}({}{})", (int)inst.op, args, literals);
+        values[inst.operands[1]] = val;
+    }
+    return values;
+}
+
+/* Find the maximal linear values which are worth moving: linear values with
+    some math which are used by instructions that stay in the fragment shader,
+    and which fit into a varying. Values which stay in the fragment shader need
+    their operands there, so these become candidates.
+*/
+static std::map<std::string, uint32_t> find_linear_roots(const spirv_module_t& mod, const std::map<uint32_t, link_linear_t>& values) {
+    std::vector<uint32_t> work;
+    for (const spirv_inst_t& inst: mod.insts) {
+        switch (inst.op) {
+            case spv::OpName:
+            case spv::OpMemberName:
+            case spv::OpDecorate:
+            case spv::OpMemberDecorate:
+            case spv::OpEntryPoint:
+                continue;
+            default:
+                break;
+        }
+        if (inst.operands.size() >= 2) {
+            auto it = values.find(inst.operands[1]);
+            if ((it != values.end()) && (it->second.inst.op == inst.op)) {
+                continue;
+            }
+        }
+        for (uint32_t operand: inst.operands) {
+            if (values.count(operand) > 0) {
+                work.push_back(operand);
+            }
+        }
+    }
+    std::map<std::string, uint32_t> roots;
+    std::set<uint32_t> visited;
+    while (!work.empty()) {
+        const uint32_t id = work.back();
+        work.pop_back();
+        if (!visited.insert(id).second) {
+            continue;
+        }
+        const link_linear_t& val = values.at(id);
+        if (!val.is_linear) {
+            continue;
+        }
+        link_shape_t shape;
+        if (val.has_math && type_shape(mod, val.inst.operands[0], shape)) {
+            roots[val.key] = id;
+            continue;
+        }
+        for (size_t pos: val.arg_pos) {
+            work.push_back(val.inst.operands[pos]);
+        }
+    }
+    return roots;
+}
+
+static link_vs_env_t vs_env(const spirv_module_t& mod, const std::map<uint32_t, uint32_t>& outputs) {
+    link_vs_env_t env;
+    env.outputs = outputs;
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpVariable) && (inst.operands[2] == (uint32_t)spv::StorageClassUniform)) {
+            const std::string signature = block_signature(mod, inst.operands[1]);
+            if (!signature.empty()) {
+                env.blocks[signature] = inst.operands[1];
+            }
+        }
+    }
+    return env;
+}
+
+/* check if all varyings and uniform blocks of a fragment shader value exist in the vertex shader */
+static bool can_clone(const spirv_module_t& fs_mod, const std::map<uint32_t, link_linear_t>& values, uint32_t id, const spirv_module_t& vs_mod, const link_vs_env_t& env) {
+    const link_linear_t& val = values.at(id);
+    if (val.is_varying) {
+        link_shape_t fs_shape, vs_shape;
+        auto it = env.outputs.find(val.location);
+        return (it != env.outputs.end()) && type_shape(vs_mod, pointee_type(vs_mod, it->second), vs_shape) &&
+               type_shape(fs_mod, val.inst.operands[0], fs_shape) && vs_shape.equals(fs_shape);
+    }
+    if (!val.block.empty()) {
+        return env.blocks.count(val.block) > 0;
+    }
+    for (size_t pos: val.arg_pos) {
+        if (!can_clone(fs_mod, values, val.inst.operands[pos], vs_mod, env)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* gather the uniform block signatures which a fragment shader value reads */
+static void value_blocks(const std::map<uint32_t, link_linear_t>& values, uint32_t id, std::set<std::string>& out_blocks) {
+    const link_linear_t& val = values.at(id);
+    if (!val.block.empty()) {
+        out_blocks.insert(val.block);
+    }
+    for (size_t pos: val.arg_pos) {
+        value_blocks(values, val.inst.operands[pos], out_blocks);
+    }
+}
+
+/* the block name of a uniform block signature */
+static std::string block_name(const std::string& signature) {
+    return signature.substr(0, signature.find(','));
+}
+
+/* copy a scalar, vector or matrix type into another module */
+static uint32_t clone_type(const spirv_module_t& src, spirv_module_t& dst, uint32_t type_id) {
+    const spirv_inst_t& inst = src.insts[src.find_def(type_id)];
+    if ((inst.op == spv::OpTypeVector) || (inst.op == spv::OpTypeMatrix)) {
+        return dst.find_or_add_global(inst.op, { clone_type(src, dst, inst.operands[1]), inst.operands[2] }, 0);
+    }
+    return dst.find_or_add_global(inst.op, std::vector<uint32_t>(inst.operands.begin() + 1, inst.operands.end()), 0);
+}
+
+/* copy a scalar, vector or matrix constant into another module */
+static uint32_t clone_constant(const spirv_module_t& src, spirv_module_t& dst, uint32_t const_id) {
+    const spirv_inst_t& inst = src.insts[src.find_def(const_id)];
+    std::vector<uint32_t> operands = { clone_type(src, dst, inst.operands[0]) };
+    for (size_t i = 2; i < inst.operands.size(); i++) {
+        operands.push_back((inst.op == spv::OpConstant) ? inst.operands[i] : clone_constant(src, dst, inst.operands[i]));
+    }
+    return dst.find_or_add_global(inst.op, operands, 1);
+}
+
+/* copy the computation of a fragment shader value into the vertex shader, varyings
+    are read back from the vertex shader outputs, returns the new value id
+*/
+static uint32_t clone_value(const spirv_module_t& fs_mod, const std::map<uint32_t, link_linear_t>& values, uint32_t id,
+                            spirv_module_t& vs_mod, const link_vs_env_t& env, std::map<uint32_t, uint32_t>& cloned, std::vector<spirv_inst_t>& code)
+{
+    auto cloned_it = cloned.find(id);
+    if (cloned_it != cloned.end()) {
+        return cloned_it->second;
+    }
+    const link_linear_t& val = values.at(id);
+    uint32_t new_id = 0;
+    if ((val.inst.op == spv::OpConstant) || (val.inst.op == spv::OpConstantComposite)) {
+        new_id = clone_constant(fs_mod, vs_mod, id);
+    }
+    else if (val.is_varying) {
+        const uint32_t var_id = env.outputs.at(val.location);
+        new_id = vs_mod.alloc_id();
+        code.push_back(spirv_inst_t(spv::OpLoad, { pointee_type(vs_mod, var_id), new_id, var_id }));
+    }
+    else if (!val.block.empty()) {
+        const uint32_t type_id = clone_type(fs_mod, vs_mod, val.inst.operands[0]);
+        const uint32_t ptr_type_id = vs_mod.find_or_add_global(spv::OpTypePointer, { (uint32_t)spv::StorageClassUniform, type_id }, 0);
+        const uint32_t chain_id = vs_mod.alloc_id();
+        std::vector<uint32_t> chain = { ptr_type_id, chain_id, env.blocks.at(val.block) };
+        for (uint32_t index_id: val.indices) {
+            chain.push_back(clone_constant(fs_mod, vs_mod, index_id));
+        }
+        code.push_back(spirv_inst_t(spv::OpAccessChain, chain));
+        new_id = vs_mod.alloc_id();
+        code.push_back(spirv_inst_t(spv::OpLoad, { type_id, new_id, chain_id }));
+    }
+    else {
+        spirv_inst_t inst = val.inst;
+        for (size_t pos: val.arg_pos) {
+            inst.operands[pos] = clone_value(fs_mod, values, inst.operands[pos], vs_mod, env, cloned, code);
+        }
+        if (inst.op == spv::OpExtInst) {
+            inst.operands[2] = glsl_std_import(vs_mod);
+            if (inst.operands[2] == 0) {
+                inst.operands[2] = vs_mod.alloc_id();
+                std::vector<uint32_t> operands = { inst.operands[2] };
+                const std::vector<uint32_t> words = spirv_module_t::string_words("GLSL.std.450");
+                operands.insert(operands.end(), words.begin(), words.end());
+                vs_mod.insts.insert(vs_mod.insts.begin() + vs_mod.find_first(spv::OpMemoryModel), spirv_inst_t(spv::OpExtInstImport, operands));
+            }
+        }
+        inst.operands[0] = clone_type(fs_mod, vs_mod, inst.operands[0]);
+        new_id = vs_mod.alloc_id();
+        inst.operands[1] = new_id;
+        code.push_back(inst);
+    }
+    cloned[id] = new_id;
+    return new_id;
+}
+
+/* side-effect free instructions which can be removed when their result is unused */
+static bool is_removable(const spirv_inst_t& inst, uint32_t glsl_std_id) {
+    switch (inst.op) {
+        case spv::OpLoad:
+        case spv::OpAccessChain:
+        case spv::OpInBoundsAccessChain:
+        case spv::OpFNegate:
+        case spv::OpFAdd:
+        case spv::OpFSub:
+        case spv::OpFMul:
+        case spv::OpFDiv:
+        case spv::OpFRem:
+        case spv::OpFMod:
+        case spv::OpVectorTimesScalar:
+        case spv::OpMatrixTimesScalar:
+        case spv::OpVectorTimesMatrix:
+        case spv::OpMatrixTimesVector:
+        case spv::OpMatrixTimesMatrix:
+        case spv::OpDot:
+        case spv::OpCompositeConstruct:
+        case spv::OpCompositeExtract:
+        case spv::OpVectorShuffle:
+            return true;
+        case spv::OpExtInst:
+            return (glsl_std_id != 0) && (inst.operands[2] == glsl_std_id);
+        default:
+            return false;
+    }
+}
+
+/* remove unused side-effect free instructions from the function bodies, returns
+    the number of removed instructions (without access chains)
+*/
+static int remove_dead_code(spirv_module_t& mod) {
+    const uint32_t glsl_std_id = glsl_std_import(mod);
+    std::set<uint32_t> removed;
+    int num_removed = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        std::set<uint32_t> used;
+        for (const spirv_inst_t& inst: mod.insts) {
+            if ((inst.op == spv::OpName) || (inst.op == spv::OpMemberName) || (inst.op == spv::OpDecorate) || (inst.op == spv::OpMemberDecorate)) {
+                continue;
+            }
+            const bool removable = is_removable(inst, glsl_std_id);
+            for (size_t i = 0; i < inst.operands.size(); i++) {
+                if (!removable || (i != 1)) {
+                    used.insert(inst.operands[i]);
+                }
+            }
+        }
+        bool in_function = false;
+        for (auto it = mod.insts.begin(); it != mod.insts.end();) {
+            in_function = (it->op == spv::OpFunction) || (in_function && (it->op != spv::OpFunctionEnd));
+            if (in_function && is_removable(*it, glsl_std_id) && (used.count(it->operands[1]) == 0)) {
+                removed.insert(it->operands[1]);
+                if ((it->op != spv::OpAccessChain) && (it->op != spv::OpInBoundsAccessChain)) {
+                    num_removed++;
+                }
+                it = mod.insts.erase(it);
+                changed = true;
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+    for (uint32_t id: removed) {
+        mod.remove_decorations(id);
+        mod.remove_names(id);
+    }
+    return num_removed;
+}
+
+/* replace the definition of a fragment shader value with a load from a new input */
+static void replace_with_input(spirv_module_t& mod, uint32_t value_id, spv::Op op, uint32_t location, const std::string& name) {
+    for (size_t i = 0; i < mod.insts.size(); i++) {
+        if ((mod.insts[i].op == op) && (mod.insts[i].operands.size() >= 2) && (mod.insts[i].operands[1] == value_id)) {
+            const uint32_t type_id = mod.insts[i].operands[0];
+            const uint32_t var_id = add_varying_var(mod, spv::StorageClassInput, type_id, location, name);
+            // the new declarations are in front of the function
+            for (spirv_inst_t& inst: mod.insts) {
+                if ((inst.op == op) && (inst.operands.size() >= 2) && (inst.operands[1] == value_id)) {
+                    inst = spirv_inst_t(spv::OpLoad, { type_id, value_id, var_id });
+                    break;
+                }
+            }
+            return;
+        }
+    }
+}
+
+/* compute values in the vertex shader and write them to new outputs before the
+    return of the entry function, fails for entry functions with several returns
+*/
+static bool add_vs_outputs(spirv_module_t& vs_mod, const spirv_module_t& fs_mod, const std::map<uint32_t, link_linear_t>& values,
+                           const std::vector<uint32_t>& roots, uint32_t first_location, const link_vs_env_t& env)
+{
+    const int ep_index = vs_mod.find_first(spv::OpEntryPoint);
+    if ((ep_index < 0) || (vs_mod.find_first(spv::OpDecorate) < 0) || (vs_mod.find_first(spv::OpName) < 0)) {
+        return false;
+    }
+    const uint32_t func_id = vs_mod.insts[ep_index].operands[1];
+    std::vector<spirv_inst_t> code;
+    std::map<uint32_t, uint32_t> cloned;
+    for (size_t i = 0; i < roots.size(); i++) {
+        const uint32_t value_id = clone_value(fs_mod, values, roots[i], vs_mod, env, cloned, code);
+        const uint32_t type_id = clone_type(fs_mod, vs_mod, values.at(roots[i]).inst.operands[0]);
+        const uint32_t var_id = add_varying_var(vs_mod, spv::StorageClassOutput, type_id, first_location + (uint32_t)i, fmt::format("linear_varying{}", i));
+        code.push_back(spirv_inst_t(spv::OpStore, { var_id, value_id }));
+    }
+    int return_index = -1;
+    for (int index = vs_mod.find_def(func_id); (index < (int)vs_mod.insts.size()) && (vs_mod.insts[index].op != spv::OpFunctionEnd); index++) {
+        if (vs_mod.insts[index].op == spv::OpReturn) {
+            if (return_index >= 0) {
+                return false;
+            }
+            return_index = index;
+        }
+    }
+    if (return_index < 0) {
+        return false;
+    }
+    vs_mod.insts.insert(vs_mod.insts.begin() + return_index, code.begin(), code.end());
+    return true;
+}
+
+/* the number of varyings before linking, how many have been removed or constant-folded,
+    the number of varying slots before and after packing, and the number of values
+    moved from the fragment to the vertex shader
+*/
+struct link_stats_t {
+    int num_varyings = 0;
+    int num_removed = 0;
+    int num_folded = 0;
+    int num_slots_before = 0;
+    int num_slots_after = 0;
+    int num_moved = 0;
+    int num_instrs_saved = 0;           // estimated per-pixel instructions saved by moving values
+    int num_move_slots_before = 0;
+    int num_move_slots_after = 0;
+    std::set<std::string> shared_ubs;   // uniform blocks read from the vertex shader by moved values
+};
+
+typedef std::vector<std::map<uint32_t, uint32_t>> link_varyings_t;
+
+static void gather_all_varyings(const std::vector<spirv_module_t>& mods, spv::StorageClass storage_class, link_varyings_t& out_varyings) {
+    out_varyings.clear();
+    out_varyings.resize(mods.size());
+    for (size_t i = 0; i < mods.size(); i++) {
+        gather_varyings(mods[i], storage_class, out_varyings[i]);
+    }
+}
+
+/* remove unused varyings and fold constant varyings */
+static void eliminate_varyings(std::vector<spirv_module_t>& vs_mods, std::vector<spirv_module_t>& fs_mods,
+                               link_varyings_t& vs_outputs, link_varyings_t& fs_inputs, link_stats_t& stats)
+{
+    for (const auto& item: vs_outputs[0]) {
+        const uint32_t location = item.first;
+        bool is_read = false;
+        for (size_t i = 0; i < fs_mods.size(); i++) {
+            if (!fs_mods[i].find_uses(fs_inputs[i][location]).empty()) {
+                is_read = true;
+            }
+        }
+        bool is_const = false;
+        link_const_t value;
+        if (is_read) {
+            is_const = true;
+            for (size_t i = 0; i < vs_mods.size(); i++) {
+                link_const_t vs_value;
+                if (!constant_output(vs_mods[i], vs_outputs[i][location], vs_value) || ((i > 0) && !vs_value.equals(value))) {
+                    is_const = false;
+                    break;
+                }
+                value = vs_value;
+            }
+        }
+        if (is_read && !is_const) {
+            continue;
+        }
+        // apply to copies of all modules, so that a failure leaves the varying intact
+        std::vector<spirv_module_t> vs_copies = vs_mods;
+        std::vector<spirv_module_t> fs_copies = fs_mods;
+        bool ok = true;
+        for (size_t i = 0; ok && (i < vs_copies.size()); i++) {
+            ok = remove_output(vs_copies[i], vs_outputs[i][location]);
+        }
+        for (size_t i = 0; ok && (i < fs_copies.size()); i++) {
+            if (is_const) {
+                ok = fold_input(fs_copies[i], fs_inputs[i][location], value);
+            }
+            else {
+                ok = remove_input(fs_copies[i], fs_inputs[i][location]);
+            }
+        }
+        if (ok) {
+            vs_mods = std::move(vs_copies);
+            fs_mods = std::move(fs_copies);
+            stats.num_removed++;
+            if (is_const) {
+                stats.num_folded++;
+            }
+        }
+    }
+    gather_all_varyings(vs_mods, spv::StorageClassOutput, vs_outputs);
+    gather_all_varyings(fs_mods, spv::StorageClassInput, fs_inputs);
+}
+
+/* pack float scalar, vec2 and vec3 varyings into vec4 slots in both stages */
+static void pack_stages(std::vector<spirv_module_t>& vs_mods, std::vector<spirv_module_t>& fs_mods,
+                        link_varyings_t& vs_outputs, link_varyings_t& fs_inputs)
+{
+    std::vector<link_pack_member_t> candidates;
+    for (const auto& item: vs_outputs[0]) {
+        link_pack_member_t member;
+        member.location = item.first;
+        bool packable = true;
+        for (size_t i = 0; packable && (i < vs_mods.size()); i++) {
+            link_shape_t shape;
+            packable = is_packable(vs_mods[i], vs_outputs[i][member.location], shape) && ((i == 0) || (shape.count == member.count));
+            member.count = shape.count;
+        }
+        for (size_t i = 0; packable && (i < fs_mods.size()); i++) {
+            link_shape_t shape;
+            packable = is_packable(fs_mods[i], fs_inputs[i][member.location], shape) && (shape.count == member.count);
+        }
+        if (packable) {
+            candidates.push_back(member);
+        }
+    }
+    const std::vector<link_pack_t> packs = plan_packing(candidates);
+    if (packs.empty()) {
+        return;
+    }
+    std::vector<spirv_module_t> vs_copies = vs_mods;
+    std::vector<spirv_module_t> fs_copies = fs_mods;
+    bool ok = true;
+    for (size_t i = 0; ok && (i < vs_copies.size()); i++) {
+        ok = pack_varyings(vs_copies[i], true, vs_outputs[i], packs);
+    }
+    for (size_t i = 0; ok && (i < fs_copies.size()); i++) {
+        ok = pack_varyings(fs_copies[i], false, fs_inputs[i], packs);
+    }
+    if (ok) {
+        vs_mods = std::move(vs_copies);
+        fs_mods = std::move(fs_copies);
+        gather_all_varyings(vs_mods, spv::StorageClassOutput, vs_outputs);
+        gather_all_varyings(fs_mods, spv::StorageClassInput, fs_inputs);
+    }
+}
+
+/* move the linear fragment shader computations into the vertex shader, the
+    number of varying slots may only grow up to the limit of the shader language,
+    values which contain the last uses of a fragment shader uniform block are
+    not moved (the block would disappear from the fragment shader reflection,
+    while the application still applies uniforms to it)
+*/
+static void move_stages(slang_t::type_t slang, std::vector<spirv_module_t>& vs_mods, std::vector<spirv_module_t>& fs_mods,
+                        link_varyings_t& vs_outputs, link_varyings_t& fs_inputs, link_stats_t& stats)
+{
+    std::vector<std::map<uint32_t, link_linear_t>> values(fs_mods.size());
+    std::vector<std::map<std::string, uint32_t>> roots(fs_mods.size());
+    for (size_t i = 0; i < fs_mods.size(); i++) {
+        values[i] = gather_linear(fs_mods[i], fs_inputs[i]);
+        roots[i] = find_linear_roots(fs_mods[i], values[i]);
+    }
+    std::vector<link_vs_env_t> envs;
+    for (size_t i = 0; i < vs_mods.size(); i++) {
+        envs.push_back(vs_env(vs_mods[i], vs_outputs[i]));
+    }
+    // a value must be found in all fragment shaders, and must be computable in all vertex shaders
+    std::vector<std::string> keys;
+    for (const auto& item: roots[0]) {
+        bool valid = true;
+        for (size_t i = 1; i < fs_mods.size(); i++) {
+            valid &= roots[i].count(item.first) > 0;
+        }
+        for (size_t i = 0; i < vs_mods.size(); i++) {
+            valid &= can_clone(fs_mods[0], values[0], item.second, vs_mods[i], envs[i]);
+        }
+        if (valid) {
+            keys.push_back(item.first);
+        }
+    }
+    std::vector<std::map<uint32_t, std::string>> fs_blocks(fs_mods.size());
+    for (size_t i = 0; i < fs_mods.size(); i++) {
+        for (const spirv_inst_t& inst: fs_mods[i].insts) {
+            if ((inst.op == spv::OpVariable) && (inst.operands[2] == (uint32_t)spv::StorageClassUniform)) {
+                const std::string signature = block_signature(fs_mods[i], inst.operands[1]);
+                if (!signature.empty() && !fs_mods[i].find_uses(inst.operands[1]).empty()) {
+                    fs_blocks[i][inst.operands[1]] = signature;
+                }
+            }
+        }
+    }
+    uint32_t next_location = 0;
+    const uint32_t num_slots = varying_slots(fs_mods[0], fs_inputs[0], next_location);
+    stats.num_move_slots_before = (int)num_slots;
+    stats.num_move_slots_after = (int)num_slots;
+    // move fewer values until the varyings fit
+    for (size_t num = keys.size(); num > 0; num--) {
+        std::vector<spirv_module_t> vs_copies = vs_mods;
+        std::vector<spirv_module_t> fs_copies = fs_mods;
+        int num_removed = 0;
+        for (size_t i = 0; i < fs_copies.size(); i++) {
+            for (size_t k = 0; k < num; k++) {
+                const uint32_t value_id = roots[i].at(keys[k]);
+                replace_with_input(fs_copies[i], value_id, values[i].at(value_id).inst.op, next_location + (uint32_t)k, fmt::format("linear_varying{}", k));
+            }
+            const int num_removed_here = remove_dead_code(fs_copies[i]);
+            if (i == 0) {
+                num_removed = num_removed_here;
+            }
+        }
+        // don't move the values which read uniform blocks that are no longer used in the fragment shader
+        std::set<std::string> lost_blocks;
+        for (size_t i = 0; i < fs_copies.size(); i++) {
+            for (const auto& item: fs_blocks[i]) {
+                if (fs_copies[i].find_uses(item.first).empty()) {
+                    lost_blocks.insert(item.second);
+                }
+            }
+        }
+        if (!lost_blocks.empty()) {
+            keys.erase(std::remove_if(keys.begin(), keys.end(), [&](const std::string& key) {
+                std::set<std::string> blocks;
+                value_blocks(values[0], roots[0].at(key), blocks);
+                for (const std::string& block: blocks) {
+                    if (lost_blocks.count(block) > 0) {
+                        return true;
+                    }
+                }
+                return false;
+            }), keys.end());
+            num = keys.size() + 1;
+            continue;
+        }
+        // the varyings which the fragment shader doesn't read anymore become
+        // private variables in the vertex shader, which are still read there
+        for (const auto& item: fs_inputs[0]) {
+            bool freed = true;
+            for (size_t i = 0; i < fs_copies.size(); i++) {
+                const uint32_t var_id = fs_inputs[i].at(item.first);
+                freed &= !fs_mods[i].find_uses(var_id).empty() && fs_copies[i].find_uses(var_id).empty();
+            }
+            if (freed) {
+                for (size_t i = 0; i < fs_copies.size(); i++) {
+                    remove_input(fs_copies[i], fs_inputs[i].at(item.first));
+                }
+                for (size_t i = 0; i < vs_copies.size(); i++) {
+                    make_private(vs_copies[i], vs_outputs[i].at(item.first));
+                }
+            }
+        }
+        std::vector<uint32_t> vs_roots;
+        for (size_t k = 0; k < num; k++) {
+            vs_roots.push_back(roots[0].at(keys[k]));
+        }
+        for (size_t i = 0; i < vs_copies.size(); i++) {
+            if (!add_vs_outputs(vs_copies[i], fs_mods[0], values[0], vs_roots, next_location, envs[i])) {
+                return;
+            }
+        }
+        link_varyings_t new_inputs;
+        gather_all_varyings(fs_copies, spv::StorageClassInput, new_inputs);
+        uint32_t new_next_location = 0;
+        const uint32_t new_num_slots = varying_slots(fs_copies[0], new_inputs[0], new_next_location);
+        if ((new_num_slots > num_slots) && ((int)new_num_slots > max_varyings(slang))) {
+            continue;
+        }
+        vs_mods = std::move(vs_copies);
+        fs_mods = std::move(fs_copies);
+        gather_all_varyings(vs_mods, spv::StorageClassOutput, vs_outputs);
+        gather_all_varyings(fs_mods, spv::StorageClassInput, fs_inputs);
+        stats.num_moved = (int)num;
+        stats.num_instrs_saved = num_removed;
+        for (uint32_t root: vs_roots) {
+            std::set<std::string> blocks;
+            value_blocks(values[0], root, blocks);
+            for (const std::string& block: blocks) {
+                stats.shared_ubs.insert(block_name(block));
+            }
+        }
+        stats.num_move_slots_after = (int)new_num_slots;
+        return;
+    }
+}
+
+/* renumber the varyings to contiguous locations, unless a varying occupies several locations */
+static void renumber_stages(std::vector<spirv_module_t>& vs_mods, std::vector<spirv_module_t>& fs_mods,
+                            const link_varyings_t& vs_outputs, const link_varyings_t& fs_inputs)
+{
+    for (size_t i = 0; i < vs_mods.size(); i++) {
+        for (const auto& item: vs_outputs[i]) {
+            if (!is_single_location(vs_mods[i], item.second)) {
+                return;
+            }
+        }
+    }
+    for (size_t i = 0; i < fs_mods.size(); i++) {
+        for (const auto& item: fs_inputs[i]) {
+            if (!is_single_location(fs_mods[i], item.second)) {
+                return;
+            }
+        }
+    }
+    std::map<uint32_t, uint32_t> remap;
+    for (const auto& item: vs_outputs[0]) {
+        remap[item.first] = (uint32_t)remap.size();
+    }
+    for (spirv_module_t& mod: vs_mods) {
+        renumber_varyings(mod, spv::StorageClassOutput, remap);
+    }
+    for (spirv_module_t& mod: fs_mods) {
+        renumber_varyings(mod, spv::StorageClassInput, remap);
+    }
+}
+
+/* link a vertex/fragment shader pair, the SPIRV and optional GLSL100 fallback
+    SPIRV of both stages are transformed in lockstep so that the interfaces
+    match whatever SPIRV is picked during translation, returns false if nothing
+    has been changed
+*/
+static bool link_stages(slang_t::type_t slang, const spirv_blob_t& vs_blob, const spirv_blob_t& fs_blob, bool eliminate, bool move, bool pack,
+                        link_stats_t& stats, std::vector<spirv_module_t>& vs_mods, std::vector<spirv_module_t>& fs_mods)
+{
+    const spirv_blob_t* blobs[2] = { &vs_blob, &fs_blob };
+    std::vector<spirv_module_t>* mods[2] = { &vs_mods, &fs_mods };
+    for (int stage = 0; stage < 2; stage++) {
+        mods[stage]->resize(blobs[stage]->fallback_bytecode.empty() ? 1 : 2);
+        if (!spirv_module_t::parse(blobs[stage]->bytecode, (*mods[stage])[0])) {
+            return false;
+        }
+        if (!blobs[stage]->fallback_bytecode.empty() && !spirv_module_t::parse(blobs[stage]->fallback_bytecode, (*mods[stage])[1])) {
+            return false;
+        }
+    }
+    // the existing interfaces must match by location
+    link_varyings_t vs_outputs(vs_mods.size());
+    link_varyings_t fs_inputs(fs_mods.size());
+    for (size_t i = 0; i < vs_mods.size(); i++) {
+        if (!gather_varyings(vs_mods[i], spv::StorageClassOutput, vs_outputs[i])) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < fs_mods.size(); i++) {
+        if (!gather_varyings(fs_mods[i], spv::StorageClassInput, fs_inputs[i])) {
+            return false;
+        }
+    }
+    for (const auto& vars: vs_outputs) {
+        for (const auto& other: fs_inputs) {
+            if ((vars.size() != other.size()) || !std::equal(vars.begin(), vars.end(), other.begin(),
+                [](const std::pair<const uint32_t, uint32_t>& a, const std::pair<const uint32_t, uint32_t>& b) { return a.first == b.first; }))
+            {
+                return false;
+            }
+        }
+    }
+    stats.num_varyings = (int)vs_outputs[0].size();
+    if (eliminate) {
+        eliminate_varyings(vs_mods, fs_mods, vs_outputs, fs_inputs, stats);
+    }
+    if (move) {
+        move_stages(slang, vs_mods, fs_mods, vs_outputs, fs_inputs, stats);
+    }
+    stats.num_slots_before = (int)vs_outputs[0].size();
+    if (pack) {
+        pack_stages(vs_mods, fs_mods, vs_outputs, fs_inputs);
+    }
+    stats.num_slots_after = (int)vs_outputs[0].size();
+    if ((stats.num_removed == 0) && (stats.num_moved == 0) && (stats.num_slots_after == stats.num_slots_before)) {
+        return false;
+    }
+    renumber_stages(vs_mods, fs_mods, vs_outputs, fs_inputs);
+    return true;
+}
+
+static link_variant_t blob_variant(const std::array<spirv_t,slang_t::NUM>& spirv, int snippet_index) {
+    link_variant_t variant(2 * slang_t::NUM);
+    for (int i = 0; i < slang_t::NUM; i++) {
+        const int blob_index = spirv[i].find_blob_by_snippet_index(snippet_index);
+        if (blob_index >= 0) {
+            variant[2 * i] = spirv[i].blobs[blob_index].bytecode;
+            variant[2 * i + 1] = spirv[i].blobs[blob_index].fallback_bytecode;
+        }
+    }
+    return variant;
+}
+
+static void apply_variant(std::array<spirv_t,slang_t::NUM>& spirv, int snippet_index, const link_variant_t& variant) {
+    for (int i = 0; i < slang_t::NUM; i++) {
+        const int blob_index = spirv[i].find_blob_by_snippet_index(snippet_index);
+        if (blob_index >= 0) {
+            spirv[i].blobs[blob_index].bytecode = variant[2 * i];
+            spirv[i].blobs[blob_index].fallback_bytecode = variant[2 * i + 1];
+        }
+    }
+}
+
+/* create a copy of a vertex or fragment shader snippet and its SPIRV blobs, returns the new snippet index */
+static int clone_snippet(input_t& inp, std::array<spirv_t,slang_t::NUM>& spirv, int snippet_index, const std::string& prog_name) {
+    snippet_t snippet = inp.snippets[snippet_index];
+    std::string name = fmt::format("{}_{}", snippet.name, prog_name);
+    for (int i = 2; inp.snippet_map.count(name) > 0; i++) {
+        name = fmt::format("{}_{}_{}", snippet.name, prog_name, i);
+    }
+    snippet.name = name;
+    snippet.base_index = snippet_index;
+    const int new_index = (int)inp.snippets.size();
+    inp.snippets.push_back(snippet);
+    inp.snippet_map[name] = new_index;
+    if (snippet.type == snippet_t::VS) {
+        inp.vs_map[name] = new_index;
+    }
+    else {
+        inp.fs_map[name] = new_index;
+    }
+    for (int i = 0; i < slang_t::NUM; i++) {
+        const int blob_index = spirv[i].find_blob_by_snippet_index(snippet_index);
+        if (blob_index >= 0) {
+            spirv_blob_t blob = spirv[i].blobs[blob_index];
+            blob.snippet_index = new_index;
+            spirv[i].blobs.push_back(blob);
+        }
+    }
+    return new_index;
+}
+
+void link_t::link(const args_t& args, input_t& inp, std::array<spirv_t,slang_t::NUM>& spirv) {
+    // link each program from the unmodified SPIRV
+    std::map<std::string, std::array<link_variant_t, 2>> linked;
+    std::map<std::string, std::vector<std::string>> shared_ubs;
+    for (const auto& item: inp.programs) {
+        const program_t& prog = item.second;
+        const int vs_snippet_index = inp.vs_map.at(prog.vs_name);
+        const int fs_snippet_index = inp.fs_map.at(prog.fs_name);
+        std::array<link_variant_t, 2>& variants = linked[prog.name];
+        variants[0] = blob_variant(spirv, vs_snippet_index);
+        variants[1] = blob_variant(spirv, fs_snippet_index);
+        for (int i = 0; i < slang_t::NUM; i++) {
+            slang_t::type_t slang = (slang_t::type_t)i;
+            if (0 == (args.slang & slang_t::bit(slang))) {
+                continue;
+            }
+            const int vs_blob_index = spirv[i].find_blob_by_snippet_index(vs_snippet_index);
+            const int fs_blob_index = spirv[i].find_blob_by_snippet_index(fs_snippet_index);
+            assert((vs_blob_index >= 0) && (fs_blob_index >= 0));
+            link_stats_t stats;
+            std::vector<spirv_module_t> vs_mods;
+            std::vector<spirv_module_t> fs_mods;
+            if (link_stages(slang, spirv[i].blobs[vs_blob_index], spirv[i].blobs[fs_blob_index], args.link, prog.move_to_vs, args.pack_varyings, stats, vs_mods, fs_mods)) {
+                const opt_level_t::type_t vs_opt_level = spirv_t::opt_level(args, inp.snippets[vs_snippet_index]);
+                const opt_level_t::type_t fs_opt_level = spirv_t::opt_level(args, inp.snippets[fs_snippet_index]);
+                for (size_t mod_index = 0; mod_index < vs_mods.size(); mod_index++) {
+                    std::vector<uint32_t>& bytecode = variants[0][2 * i + mod_index];
+                    bytecode = vs_mods[mod_index].assemble();
+                    spirv_t::optimize_linked(slang, vs_opt_level, bytecode);
+                }
+                for (size_t mod_index = 0; mod_index < fs_mods.size(); mod_index++) {
+                    std::vector<uint32_t>& bytecode = variants[1][2 * i + mod_index];
+                    bytecode = fs_mods[mod_index].assemble();
+                    spirv_t::optimize_linked(slang, fs_opt_level, bytecode);
+                }
+            }
+            if (args.report && args.link) {
+                fmt::print("sokol-shdc: {} program '{}' linked: {} of {} varyings removed ({} constant-folded)\n",
+                    slang_t::to_str(slang), prog.name, stats.num_removed, stats.num_varyings, stats.num_folded);
+            }
+            for (const std::string& ub_name: stats.shared_ubs) {
+                if (std::find(shared_ubs[prog.name].begin(), shared_ubs[prog.name].end(), ub_name) == shared_ubs[prog.name].end()) {
+                    shared_ubs[prog.name].push_back(ub_name);
+                }
+            }
+            if (args.report && prog.move_to_vs) {
+                fmt::print("sokol-shdc: {} program '{}' moved to vertex shader: {} linear values, ~{} per-pixel instructions saved ({} => {} varying slots)\n",
+                    slang_t::to_str(slang), prog.name, stats.num_moved, stats.num_instrs_saved, stats.num_move_slots_before, stats.num_move_slots_after);
+            }
+            if (args.report && args.pack_varyings) {
+                fmt::print("sokol-shdc: {} program '{}' packed: {} => {} varying slots ({} saved)\n",
+                    slang_t::to_str(slang), prog.name, stats.num_slots_before, stats.num_slots_after, stats.num_slots_before - stats.num_slots_after);
+            }
+        }
+    }
+
+    // sokol-gfx has separate uniform blocks per shader stage, so the moved values
+    // only compute the same result if the application applies the same data to
+    // the uniform block in both stages, this can't be checked here
+    for (const auto& item: shared_ubs) {
+        if (!item.second.empty()) {
+            program_t& prog = inp.programs.at(item.first);
+            prog.shared_ubs = item.second;
+            inp.warning(prog.line_index, fmt::format("@move_to_vs: program '{}' reads the uniform blocks '{}' in the vertex shader instead of the fragment shader, apply the same uniform data to both shader stages ({}_SHARED_UNIFORMS)",
+                prog.name, pystring::join("', '", prog.shared_ubs), prog.name)).print(args.error_format);
+        }
+    }
+
+    // shaders which are shared between programs keep the original snippet for the
+    // programs which need the unmodified SPIRV (or for the first program if there
+    // are none), all other programs get a specialized copy
+    const int num_snippets = (int)inp.snippets.size();
+    for (int stage = 0; stage < 2; stage++) {
+        for (int snippet_index = 0; snippet_index < num_snippets; snippet_index++) {
+            if (inp.snippets[snippet_index].type != ((stage == 0) ? snippet_t::VS : snippet_t::FS)) {
+                continue;
+            }
+            std::vector<std::pair<link_variant_t, std::vector<std::string>>> groups;
+            for (const auto& item: inp.programs) {
+                const program_t& prog = item.second;
+                const std::string& name = (stage == 0) ? prog.vs_name : prog.fs_name;
+                if (inp.snippet_map.at(name) != snippet_index) {
+                    continue;
+                }
+                const link_variant_t& variant = linked[prog.name][stage];
+                auto it = std::find_if(groups.begin(), groups.end(), [&variant](const std::pair<link_variant_t, std::vector<std::string>>& group) { return group.first == variant; });
+                if (it == groups.end()) {
+                    groups.push_back({ variant, { prog.name } });
+                }
+                else {
+                    it->second.push_back(prog.name);
+                }
+            }
+            if (groups.empty()) {
+                continue;
+            }
+            const link_variant_t original = blob_variant(spirv, snippet_index);
+            auto keep_it = std::find_if(groups.begin(), groups.end(), [&original](const std::pair<link_variant_t, std::vector<std::string>>& group) { return group.first == original; });
+            if (keep_it == groups.end()) {
+                keep_it = groups.begin();
+                apply_variant(spirv, snippet_index, keep_it->first);
+            }
+            for (auto it = groups.begin(); it != groups.end(); ++it) {
+                if (it == keep_it) {
+                    continue;
+                }
+                const int clone_index = clone_snippet(inp, spirv, snippet_index, it->second[0]);
+                apply_variant(spirv, clone_index, it->first);
+                for (const std::string& prog_name: it->second) {
+                    program_t& prog = inp.programs.at(prog_name);
+                    if (stage == 0) {
+                        prog.vs_name = inp.snippets[clone_index].name;
+                    }
+                    else {
+                        prog.fs_name = inp.snippets[clone_index].name;
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // namespace shdc
@@ -0,0 +1,273 @@
+/*
+    In-tree LZ compressor for shader payloads, the output is a standard
+    LZ4 block (without frame header), so that it can be decoded with the
+    tiny decoder which is embedded into the generated code.
+*/
+#include "shdc.h"
+#include <string.h>
+#include <chrono>
+
+namespace shdc {
+
+static const int lz_min_match = 4;
+static const int lz_max_offset = 65535;
+static const int lz_last_literals = 5;     // the last 5 bytes are always literals
+static const int lz_match_find_limit = 12; // last match must start at least 12 bytes before end
+static const int lz_hash_bits = 16;
+static const int lz_max_chain = 256;
+
+static uint32_t read_u32(const uint8_t* ptr) {
+    return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static uint32_t lz_hash(const uint8_t* ptr) {
+    return (read_u32(ptr) * 2654435761U) >> (32 - lz_hash_bits);
+}
+
+static void put_length(std::vector<uint8_t>& dst, int len) {
+    while (len >= 255) {
+        dst.push_back(255);
+        len -= 255;
+    }
+    dst.push_back((uint8_t)len);
+}
+
+static void put_sequence(std::vector<uint8_t>& dst, const uint8_t* literals, int num_literals, int offset, int match_len) {
+    const int lit_token = (num_literals < 15) ? num_literals : 15;
+    int match_token = 0;
+    if (match_len > 0) {
+        match_token = ((match_len - lz_min_match) < 15) ? (match_len - lz_min_match) : 15;
+    }
+    dst.push_back((uint8_t)((lit_token << 4) | match_token));
+    if (num_literals >= 15) {
+        put_length(dst, num_literals - 15);
+    }
+    dst.insert(dst.end(), literals, literals + num_literals);
+    if (match_len > 0) {
+        dst.push_back((uint8_t)(offset & 0xFF));
+        dst.push_back((uint8_t)((offset >> 8) & 0xFF));
+        if ((match_len - lz_min_match) >= 15) {
+            put_length(dst, match_len - lz_min_match - 15);
+        }
+    }
+}
+
+/* compress with a hash-chain match finder, speed doesn't matter much here, but compression ratio does */
+std::vector<uint8_t> lz_t::compress(const uint8_t* src, size_t src_size) {
+    std::vector<uint8_t> dst;
+    const int num_bytes = (int)src_size;
+    std::vector<int> head(1 << lz_hash_bits, -1);
+    std::vector<int> prev(num_bytes, -1);
+    const int match_limit = num_bytes - lz_last_literals;
+    int anchor = 0;
+    int pos = 0;
+    int next_insert = 0;
+    while ((pos + lz_match_find_limit) < num_bytes) {
+        // update the hash chains up to the current position
+        for (; next_insert <= pos; next_insert++) {
+            uint32_t h = lz_hash(&src[next_insert]);
+            prev[next_insert] = head[h];
+            head[h] = next_insert;
+        }
+        // find the longest match
+        int best_len = 0;
+        int best_pos = -1;
+        int cand = prev[pos];
+        for (int chain = 0; (cand >= 0) && (chain < lz_max_chain) && ((pos - cand) <= lz_max_offset); chain++) {
+            int len = 0;
+            while (((pos + len) < match_limit) && (src[cand + len] == src[pos + len])) {
+                len++;
+            }
+            if (len > best_len) {
+                best_len = len;
+                best_pos = cand;
+            }
+            cand = prev[cand];
+        }
+        if (best_len >= lz_min_match) {
+            put_sequence(dst, &src[anchor], pos - anchor, pos - best_pos, best_len);
+            pos += best_len;
+            anchor = pos;
+        }
+        else {
+            pos++;
+        }
+    }
+    // the last sequence only has literals
+    put_sequence(dst, src + anchor, num_bytes - anchor, 0, 0);
+    return dst;
+}
+
+std::vector<uint8_t> lz_t::compress(const std::vector<uint8_t>& src) {
+    return compress(src.data(), src.size());
+}
+
+/* C++ version of the embedded decoder, used to validate the compressor output and measure decode speed */
+bool lz_t::decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size) {
+    const uint8_t* ip = src;
+    const uint8_t* const ip_end = src + src_size;
+    uint8_t* op = dst;
+    uint8_t* const op_end = dst + dst_size;
+    for (;;) {
+        if (ip >= ip_end) {
+            return false;
+        }
+        const int token = *ip++;
+        size_t len = token >> 4;
+        if (len == 15) {
+            int b;
+            do {
+                if (ip >= ip_end) {
+                    return false;
+                }
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        if ((len > (size_t)(ip_end - ip)) || (len > (size_t)(op_end - op))) {
+            return false;
+        }
+        memcpy(op, ip, len);
+        op += len;
+        ip += len;
+        if (ip == ip_end) {
+            break;
+        }
+        if ((ip_end - ip) < 2) {
+            return false;
+        }
+        const size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if ((offset == 0) || (offset > (size_t)(op - dst))) {
+            return false;
+        }
+        len = token & 15;
+        if (len == 15) {
+            int b;
+            do {
+                if (ip >= ip_end) {
+                    return false;
+                }
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        len += lz_min_match;
+        if (len > (size_t)(op_end - op)) {
+            return false;
+        }
+        // matches may overlap the output, so copy byte by byte
+        const uint8_t* match = op - offset;
+        while (len-- > 0) {
+            *op++ = *match++;
+        }
+    }
+    return op == op_end;
+}
+
+/* the decoder which is embedded into generated C code, a transliteration of lz_t::decompress() */
+const char* lz_t::c_decoder_source() {
+    return
+        "#if !defined(SOKOL_SHDC_LZ_INCLUDED)\n"
+        "#define SOKOL_SHDC_LZ_INCLUDED (1)\n"
+        "/* decode an LZ4 block, returns 0 if the input is corrupt or doesn't decode to exactly dst_size bytes */\n"
+        "static inline int _sshdc_lz_decode(const uint8_t* src, int src_size, uint8_t* dst, int dst_size) {\n"
+        "    const uint8_t* ip = src;\n"
+        "    const uint8_t* const ip_end = src + src_size;\n"
+        "    uint8_t* op = dst;\n"
+        "    uint8_t* const op_end = dst + dst_size;\n"
+        "    for (;;) {\n"
+        "        if (ip >= ip_end) {\n"
+        "            return 0;\n"
+        "        }\n"
+        "        const int token = *ip++;\n"
+        "        int len = token >> 4;\n"
+        "        if (len == 15) {\n"
+        "            int b;\n"
+        "            do {\n"
+        "                if (ip >= ip_end) {\n"
+        "                    return 0;\n"
+        "                }\n"
+        "                b = *ip++;\n"
+        "                len += b;\n"
+        "            } while (b == 255);\n"
+        "        }\n"
+        "        if ((len > (ip_end - ip)) || (len > (op_end - op))) {\n"
+        "            return 0;\n"
+        "        }\n"
+        "        while (len-- > 0) {\n"
+        "            *op++ = *ip++;\n"
+        "        }\n"
+        "        if (ip == ip_end) {\n"
+        "            break;\n"
+        "        }\n"
+        "        if ((ip_end - ip) < 2) {\n"
+        "            return 0;\n"
+        "        }\n"
+        "        const int offset = ip[0] | (ip[1] << 8);\n"
+        "        ip += 2;\n"
+        "        if ((offset == 0) || (offset > (op - dst))) {\n"
+        "            return 0;\n"
+        "        }\n"
+        "        len = token & 15;\n"
+        "        if (len == 15) {\n"
+        "            int b;\n"
+        "            do {\n"
+        "                if (ip >= ip_end) {\n"
+        "                    return 0;\n"
+        "                }\n"
+        "                b = *ip++;\n"
+        "                len += b;\n"
+        "            } while (b == 255);\n"
+        "        }\n"
+        "        len += 4;\n"
+        "        if (len > (op_end - op)) {\n"
+        "            return 0;\n"
+        "        }\n"
+        "        const uint8_t* match = op - offset;\n"
+        "        while (len-- > 0) {\n"
+        "            *op++ = *match++;\n"
+        "        }\n"
+        "    }\n"
+        "    return op == op_end;\n"
+        "}\n"
+        "/* decode a payload on first use, returns 0 if decoding has failed */\n"
+        "static inline int _sshdc_lz_decode_once(int* decoded, const uint8_t* src, int src_size, void* dst, int dst_size) {\n"
+        "    if (0 == *decoded) {\n"
+        "        *decoded = _sshdc_lz_decode(src, src_size, (uint8_t*)dst, dst_size) ? 1 : -1;\n"
+        "    }\n"
+        "    return *decoded > 0;\n"
+        "}\n"
+        "#endif /* SOKOL_SHDC_LZ_INCLUDED */\n";
+}
+
+/* compress all payloads, verify that they decode correctly and measure the decoding speed */
+errmsg_t payloads_t::compress(const input_t& inp) {
+    compressed_size = 0;
+    for (payload_t& payload: items) {
+        payload.compressed = lz_t::compress(payload.data);
+        compressed_size += payload.compressed.size();
+    }
+    std::vector<uint8_t> buf;
+    int num_rounds = 0;
+    size_t num_decoded_bytes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    do {
+        for (const payload_t& payload: items) {
+            buf.resize(payload.data.size());
+            if (!lz_t::decompress(payload.compressed.data(), payload.compressed.size(), buf.data(), buf.size()) ||
+                ((num_rounds == 0) && (buf != payload.data)))
+            {
+                return errmsg_t::error(inp.base_path, 0, fmt::format("internal error: compressed payload '{}' doesn't decode correctly", payload.c_name));
+            }
+            num_decoded_bytes += buf.size();
+        }
+        num_rounds++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while ((elapsed < 0.05) && (num_rounds < 1000));
+    decode_throughput = (elapsed > 0.0) ? ((double)num_decoded_bytes / (1024.0 * 1024.0)) / elapsed : 0.0;
+    return errmsg_t();
+}
+
+} // namespace shdc
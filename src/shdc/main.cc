@@ -34,10 +34,13 @@ int main(int argc, const char** argv) {
     for (int i = 0; i < slang_t::NUM; i++) {
         slang_t::type_t slang = (slang_t::type_t)i;
         if (args.slang & slang_t::bit(slang)) {
-            spirv[i] = spirv_t::compile_input_glsl(inp, slang);
+            spirv[i] = spirv_t::compile_input_glsl(args, inp, slang);
             if (args.debug_dump) {
                 spirv[i].dump_debug(inp, args.error_format);
             }
+            if (args.report) {
+                spirv[i].report(inp, slang);
+            }
             if (!spirv[i].errors.empty()) {
                 bool has_errors = false;
                 for (const errmsg_t& err: spirv[i].errors) {
@@ -53,8 +56,61 @@ int main(int argc, const char** argv) {
         }
     }
 
+    // collapse the @variants permutations and @specialize copies which
+    // compiled to identical shaders
+    bool has_variants = false;
+    for (const snippet_t& snippet: inp.snippets) {
+        has_variants |= (snippet.variant_index >= 0);
+    }
+    if (has_variants) {
+        variants_t::dedup(args, inp, spirv);
+    }
+
+    // split uniform blocks by the update frequency annotations, and optionally
+    // hoist uniform-only expressions to the CPU, reorder uniform block members
+    // to minimize the std140 padding and remove the uniform block members which
+    // a shader doesn't read, this happens on the SPIRV, so that the shader code,
+    // reflection info and generated C structs of all shader languages agree
+    errmsg_t split_err = uniforms_t::split(args, inp, spirv);
+    if (split_err.valid) {
+        split_err.print(args.error_format);
+        return 10;
+    }
+    if (args.hoist_uniforms) {
+        uniforms_t::hoist(args, inp, spirv);
+    }
+    if (args.reorder_uniforms) {
+        uniforms_t::reorder(args, spirv);
+    }
+    if (args.compact_uniforms) {
+        uniforms_t::compact(args, inp, spirv);
+    }
+
+    // optional link step, removes unused varyings and folds constant
+    // varyings between the vertex and fragment shader of each program,
+    // packs varyings into vec4 slots, and moves linear fragment shader
+    // computations into the vertex shader for programs tagged with @move_to_vs
+    bool move_to_vs = false;
+    for (const auto& item: inp.programs) {
+        move_to_vs |= item.second.move_to_vs;
+    }
+    if (args.link || args.pack_varyings || move_to_vs) {
+        link_t::link(args, inp, spirv);
+    }
+
+    // optionally give each uniform block and image the same bind slot in all
+    // programs (and in all modules which share a slot map file)
+    if (args.stable_slots) {
+        errmsg_t err = slots_t::allocate(args, inp, spirv);
+        if (err.valid) {
+            err.print(args.error_format);
+            return 10;
+        }
+    }
+
     // cross-translate SPIRV to shader dialects
     std::array<spirvcross_t,slang_t::NUM> spirvcross;
+    bool vertex_structs_reported = false;
     for (int i = 0; i < slang_t::NUM; i++) {
         slang_t::type_t slang = (slang_t::type_t)i;
         if (args.slang & slang_t::bit(slang)) {
@@ -62,10 +118,30 @@ int main(int argc, const char** argv) {
             if (args.debug_dump) {
                 spirvcross[i].dump_debug(stderr, args.error_format, slang);
             }
+            if (args.report) {
+                spirvcross[i].report(inp, slang);
+            }
             if (spirvcross[i].error.valid) {
                 spirvcross[i].error.print(args.error_format);
                 return 10;
             }
+            // the vertex struct sizes are the same for all shader languages
+            if (args.report && !vertex_structs_reported) {
+                spirvcross[i].report_vertex_structs(inp);
+                vertex_structs_reported = true;
+            }
+        }
+    }
+
+    // minify the shader source code, this happens before the bytecode compilation
+    // so that the minified code is validated by the bytecode compilers
+    // (WebGPU SPIR-V bytecode doesn't embed any source code)
+    if (args.minify) {
+        for (int i = 0; i < slang_t::NUM; i++) {
+            slang_t::type_t slang = (slang_t::type_t)i;
+            if ((args.slang & slang_t::bit(slang)) && (slang != slang_t::WGPU)) {
+                minify_t::minify(args, spirvcross[i], slang);
+            }
         }
     }
 
@@ -99,8 +175,28 @@ int main(int argc, const char** argv) {
         }
     }
 
+    // gather the shader source code and bytecode, and merge identical payloads
+    payloads_t payloads = payloads_t::gather(args, inp, spirvcross, bytecode);
+    if (args.compress) {
+        errmsg_t err = payloads.compress(inp);
+        if (err.valid) {
+            err.print(args.error_format);
+            return 10;
+        }
+    }
+    if (args.report) {
+        payloads.report();
+    }
+
     if (args.output_format == format_t::BARE) {
-        errmsg_t err = bare_t::gen(args, inp, spirvcross, bytecode);
+        errmsg_t err = bare_t::gen(args, inp, spirvcross, bytecode, payloads);
+        if (err.valid) {
+            err.print(args.error_format);
+            return 10;
+        }
+    }
+    else if (args.output_format == format_t::PACK) {
+        errmsg_t err = pack_t::gen(args, inp, spirvcross, payloads);
         if (err.valid) {
             err.print(args.error_format);
             return 10;
@@ -108,7 +204,16 @@ int main(int argc, const char** argv) {
     }
     else {
         // generate the output C header
-        errmsg_t err = sokol_t::gen(args, inp, spirvcross, bytecode);
+        errmsg_t err = sokol_t::gen(args, inp, spirvcross, bytecode, payloads);
+        if (err.valid) {
+            err.print(args.error_format);
+            return 10;
+        }
+    }
+
+    // optional reflection info for tools and runtime code
+    if (args.reflection_format != reflection_format_t::NONE) {
+        errmsg_t err = reflection_t::gen(args, inp, spirvcross, payloads);
         if (err.valid) {
             err.print(args.error_format);
             return 10;
@@ -0,0 +1,254 @@
+/*
+    Minify the shader source code generated by SPIRV-Cross: removes line
+    directives, comments and whitespace, and shortens the temporary
+    identifiers generated by SPIRV-Cross (_123). Names which are visible
+    to sokol_gfx.h (vertex attributes, uniform blocks, images, entry
+    points) are never renamed.
+*/
+#include "shdc.h"
+#include "fmt/format.h"
+#include "pystring.h"
+#include <set>
+
+namespace shdc {
+
+static bool is_ident_start(char c) {
+    return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || (c == '_');
+}
+
+static bool is_ident_char(char c) {
+    return is_ident_start(c) || ((c >= '0') && (c <= '9'));
+}
+
+/* check for a SPIRV-Cross generated temporary identifier (_ followed by digits) */
+static bool is_temp_ident(const std::string& ident) {
+    if ((ident.length() < 2) || (ident[0] != '_')) {
+        return false;
+    }
+    for (size_t i = 1; i < ident.length(); i++) {
+        if ((ident[i] < '0') || (ident[i] > '9')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* two adjacent tokens need a separating space if joining them would create a different token */
+static bool needs_space(char prev, char next) {
+    static const std::string op_chars = "+-*/%<>=&|^!:";
+    const bool prev_word = is_ident_char(prev) || (prev == '.');
+    const bool next_word = is_ident_char(next) || (next == '.');
+    if (prev_word && next_word) {
+        return true;
+    }
+    return (op_chars.find(prev) != std::string::npos) && (op_chars.find(next) != std::string::npos);
+}
+
+/* generate a short identifier name (_ followed by base-36 digits) */
+static std::string short_ident(int index) {
+    static const char* digits = "0123456789abcdefghijklmnopqrstuvwxyz";
+    std::string res;
+    do {
+        res.insert(res.begin(), digits[index % 36]);
+        index /= 36;
+    } while (index > 0);
+    return "_" + res;
+}
+
+/* collect all identifiers in a piece of code, ignoring comments */
+static void collect_idents(const std::string& code, std::set<std::string>& idents) {
+    size_t i = 0;
+    while (i < code.length()) {
+        if (is_ident_start(code[i])) {
+            size_t start = i;
+            while ((i < code.length()) && is_ident_char(code[i])) {
+                i++;
+            }
+            idents.insert(code.substr(start, i - start));
+        }
+        else if ((code[i] >= '0') && (code[i] <= '9')) {
+            while ((i < code.length()) && (is_ident_char(code[i]) || (code[i] == '.'))) {
+                i++;
+            }
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+/* remove comments and whitespace from a chunk of code (without preprocessor lines), and rename identifiers */
+static void minify_code(const std::string& code, const std::map<std::string, std::string>& renames, std::string& out) {
+    bool pending_space = false;
+    size_t i = 0;
+    while (i < code.length()) {
+        const char c = code[i];
+        if ((c == '/') && ((i + 1) < code.length()) && (code[i + 1] == '/')) {
+            i = code.find('\n', i);
+            if (i == std::string::npos) {
+                break;
+            }
+            continue;
+        }
+        if ((c == '/') && ((i + 1) < code.length()) && (code[i + 1] == '*')) {
+            i = code.find("*/", i + 2);
+            if (i == std::string::npos) {
+                break;
+            }
+            i += 2;
+            pending_space = true;
+            continue;
+        }
+        if ((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r')) {
+            pending_space = true;
+            i++;
+            continue;
+        }
+        std::string token;
+        if (is_ident_start(c)) {
+            size_t start = i;
+            while ((i < code.length()) && is_ident_char(code[i])) {
+                i++;
+            }
+            token = code.substr(start, i - start);
+            auto it = renames.find(token);
+            if (it != renames.end()) {
+                token = it->second;
+            }
+        }
+        else if ((c >= '0') && (c <= '9')) {
+            size_t start = i;
+            while ((i < code.length()) && (is_ident_char(code[i]) || (code[i] == '.'))) {
+                i++;
+            }
+            token = code.substr(start, i - start);
+        }
+        else {
+            token = std::string(1, c);
+            i++;
+        }
+        if (pending_space && !out.empty() && (out.back() != '\n') && needs_space(out.back(), token[0])) {
+            out += ' ';
+        }
+        pending_space = false;
+        out += token;
+    }
+}
+
+/* minify a single shader source, the names in keep are never renamed */
+static std::string minify_source(const std::string& src, const std::set<std::string>& keep) {
+    std::vector<std::string> lines;
+    pystring::splitlines(src, lines);
+
+    // split into preprocessor lines and code chunks, and drop line directives
+    std::vector<std::pair<bool, std::string>> chunks;
+    bool continued = false;
+    for (const std::string& line: lines) {
+        const std::string stripped = pystring::strip(line);
+        const bool is_pp = continued || pystring::startswith(stripped, "#");
+        continued = is_pp && pystring::endswith(stripped, "\\");
+        if (is_pp) {
+            if (!pystring::startswith(stripped, "#line")) {
+                chunks.push_back({ true, stripped });
+            }
+        }
+        else if (!chunks.empty() && !chunks.back().first) {
+            chunks.back().second += "\n" + line;
+        }
+        else {
+            chunks.push_back({ false, line });
+        }
+    }
+
+    // find the SPIRV-Cross temporaries which can be renamed, and pick short names,
+    // identifiers which are used in preprocessor lines are never renamed
+    std::set<std::string> idents;
+    std::set<std::string> pp_idents;
+    for (const auto& chunk: chunks) {
+        collect_idents(chunk.second, idents);
+        if (chunk.first) {
+            collect_idents(chunk.second, pp_idents);
+        }
+    }
+    std::map<std::string, std::string> renames;
+    int next_index = 0;
+    for (const auto& chunk: chunks) {
+        if (chunk.first) {
+            continue;
+        }
+        std::set<std::string> chunk_idents;
+        collect_idents(chunk.second, chunk_idents);
+        for (const std::string& ident: chunk_idents) {
+            if (is_temp_ident(ident) && (keep.count(ident) == 0) && (pp_idents.count(ident) == 0) && (renames.count(ident) == 0)) {
+                std::string name;
+                do {
+                    name = short_ident(next_index++);
+                } while ((idents.count(name) > 0) || (keep.count(name) > 0));
+                if (name.length() < ident.length()) {
+                    renames[ident] = name;
+                }
+            }
+        }
+    }
+    std::string out;
+    for (const auto& chunk: chunks) {
+        if (chunk.first) {
+            if (!out.empty() && (out.back() != '\n')) {
+                out += '\n';
+            }
+            out += chunk.second;
+            out += '\n';
+        }
+        else {
+            minify_code(chunk.second, renames, out);
+        }
+    }
+    if (!out.empty() && (out.back() != '\n')) {
+        out += '\n';
+    }
+    return out;
+}
+
+/* gather all names which are visible to sokol_gfx.h or which must match between shader stages */
+static void gather_keep_names(const spirvcross_t& spirvcross, std::set<std::string>& keep) {
+    for (const spirvcross_source_t& src: spirvcross.sources) {
+        keep.insert(src.refl.entry_point);
+        for (const attr_t& attr: src.refl.inputs) {
+            if (attr.slot >= 0) {
+                keep.insert(attr.name);
+            }
+        }
+        for (const attr_t& attr: src.refl.outputs) {
+            if (attr.slot >= 0) {
+                keep.insert(attr.name);
+            }
+        }
+        for (const uniform_block_t& ub: src.refl.uniform_blocks) {
+            keep.insert(ub.name);
+            for (const uniform_t& u: ub.uniforms) {
+                keep.insert(u.name);
+            }
+        }
+        for (const image_t& img: src.refl.images) {
+            keep.insert(img.name);
+        }
+    }
+}
+
+void minify_t::minify(const args_t& args, spirvcross_t& spirvcross, slang_t::type_t slang) {
+    std::set<std::string> keep;
+    gather_keep_names(spirvcross, keep);
+    size_t size_before = 0;
+    size_t size_after = 0;
+    for (spirvcross_source_t& src: spirvcross.sources) {
+        size_before += src.source_code.length();
+        src.source_code = minify_source(src.source_code, keep);
+        size_after += src.source_code.length();
+    }
+    if (args.report) {
+        fmt::print("sokol-shdc: {} minified: {} => {} bytes ({:.1f}%)\n",
+            slang_t::to_str(slang), size_before, size_after, (100.0 * size_after) / (size_before > 0 ? size_before : 1));
+    }
+}
+
+} // namespace shdc
@@ -30,4 +30,205 @@ errmsg_t output_t::check_errors(const input_t& inp,
     return errmsg_t();
 }
 
+/* 64-bit FNV-1a hash */
+uint64_t hash64(const void* ptr, size_t num_bytes) {
+    const uint8_t* bytes = (const uint8_t*) ptr;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < num_bytes; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* gather the source code or bytecode of all shaders, and merge identical payloads */
+payloads_t payloads_t::gather(const args_t& args,
+                              const input_t& inp,
+                              const std::array<spirvcross_t,slang_t::NUM>& spirvcross,
+                              const std::array<bytecode_t,slang_t::NUM>& bytecode)
+{
+    payloads_t payloads;
+    std::multimap<uint64_t, int> hash_map;
+    for (int i = 0; i < slang_t::NUM; i++) {
+        slang_t::type_t slang = (slang_t::type_t) i;
+        if (0 == (args.slang & slang_t::bit(slang))) {
+            continue;
+        }
+        for (int snippet_index = 0; snippet_index < (int)inp.snippets.size(); snippet_index++) {
+            const snippet_t& snippet = inp.snippets[snippet_index];
+            if ((snippet.type != snippet_t::VS) && (snippet.type != snippet_t::FS)) {
+                continue;
+            }
+            int src_index = spirvcross[i].find_source_by_snippet_index(snippet_index);
+            if (src_index < 0) {
+                continue;
+            }
+            const spirvcross_source_t& src = spirvcross[i].sources[src_index];
+            int blob_index = bytecode[i].find_blob_by_snippet_index(snippet_index);
+            payload_t payload;
+            if (blob_index != -1) {
+                payload.is_bytecode = true;
+                payload.data = bytecode[i].blobs[blob_index].data;
+                payload.c_name = fmt::format("{}{}_bytecode_{}", mod_prefix(inp), snippet.name, slang_t::to_str(slang));
+            }
+            else {
+                const char* str = src.source_code.c_str();
+                payload.data.assign((const uint8_t*)str, (const uint8_t*)str + src.source_code.length() + 1);
+                payload.c_name = fmt::format("{}{}_source_{}", mod_prefix(inp), snippet.name, slang_t::to_str(slang));
+            }
+            payload.hash = hash64(payload.data.data(), payload.data.size());
+            payloads.total_size += payload.data.size();
+
+            // look for an existing payload with identical content
+            int payload_index = -1;
+            auto range = hash_map.equal_range(payload.hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                const payload_t& other = payloads.items[it->second];
+                if ((other.is_bytecode == payload.is_bytecode) && (other.data == payload.data)) {
+                    payload_index = it->second;
+                    break;
+                }
+            }
+            if (payload_index < 0) {
+                payload.slang = slang;
+                payload.snippet_index = snippet_index;
+                payload_index = (int) payloads.items.size();
+                payloads.unique_size += payload.data.size();
+                hash_map.insert(std::make_pair(payload.hash, payload_index));
+                payloads.items.push_back(std::move(payload));
+            }
+            payloads.items[payload_index].slang_mask |= slang_t::bit(slang);
+            payloads.items[payload_index].num_refs++;
+            payloads.snippet_payloads[i][snippet_index] = payload_index;
+        }
+    }
+    return payloads;
+}
+
+int payloads_t::find_payload_index(slang_t::type_t slang, int snippet_index) const {
+    const auto& map = snippet_payloads[(int)slang];
+    auto it = map.find(snippet_index);
+    if (it != map.end()) {
+        return it->second;
+    }
+    return -1;
+}
+
+const payload_t& payloads_t::find_payload(slang_t::type_t slang, int snippet_index) const {
+    int payload_index = find_payload_index(slang, snippet_index);
+    assert(payload_index >= 0);
+    return items[payload_index];
+}
+
+/* the content hash of a program in a shader language, combined from the vertex- and fragment-shader payload hashes */
+uint64_t payloads_t::program_hash(const input_t& inp, const program_t& prog, slang_t::type_t slang) const {
+    const uint64_t vs_hash = find_payload(slang, inp.snippet_map.at(prog.vs_name)).hash;
+    const uint64_t fs_hash = find_payload(slang, inp.snippet_map.at(prog.fs_name)).hash;
+    uint8_t bytes[16];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (uint8_t)(vs_hash >> (i * 8));
+        bytes[8 + i] = (uint8_t)(fs_hash >> (i * 8));
+    }
+    return hash64(bytes, sizeof(bytes));
+}
+
+/* the content hash of all programs in all shader languages */
+uint64_t payloads_t::module_hash(const args_t& args, const input_t& inp) const {
+    std::vector<uint8_t> bytes;
+    for (const auto& item: inp.programs) {
+        for (int i = 0; i < slang_t::NUM; i++) {
+            slang_t::type_t slang = (slang_t::type_t) i;
+            if (args.slang & slang_t::bit(slang)) {
+                const uint64_t hash = program_hash(inp, item.second, slang);
+                for (int b = 0; b < 8; b++) {
+                    bytes.push_back((uint8_t)(hash >> (b * 8)));
+                }
+            }
+        }
+    }
+    return hash64(bytes.data(), bytes.size());
+}
+
+void payloads_t::report() const {
+    int num_refs = 0;
+    for (const payload_t& payload: items) {
+        num_refs += payload.num_refs;
+    }
+    fmt::print("sokol-shdc: shader payloads: {} unique of {} ({} => {} bytes, {} bytes saved)\n",
+        items.size(), num_refs, total_size, unique_size, total_size - unique_size);
+    if (compressed_size > 0) {
+        fmt::print("sokol-shdc: compressed payloads: {} => {} bytes ({:.1f}%), decoding at {:.1f} MB/sec\n",
+            unique_size, compressed_size, (100.0 * compressed_size) / (unique_size > 0 ? unique_size : 1), decode_throughput);
+    }
+}
+
+int roundup(int val, int round_to) {
+    return (val + (round_to - 1)) & ~(round_to - 1);
+}
+
+const char* img_type_to_sokol_type_str(image_t::type_t type) {
+    switch (type) {
+        case image_t::IMAGE_TYPE_2D:    return "SG_IMAGETYPE_2D";
+        case image_t::IMAGE_TYPE_CUBE:  return "SG_IMAGETYPE_CUBE";
+        case image_t::IMAGE_TYPE_3D:    return "SG_IMAGETYPE_3D";
+        case image_t::IMAGE_TYPE_ARRAY: return "SG_IMAGETYPE_ARRAY";
+        default: return "INVALID";
+    }
+}
+
+const char* img_basetype_to_sokol_samplertype_str(image_t::basetype_t basetype) {
+    switch (basetype) {
+        case image_t::IMAGE_BASETYPE_FLOAT: return "SG_SAMPLERTYPE_FLOAT";
+        case image_t::IMAGE_BASETYPE_SINT:  return "SG_SAMPLERTYPE_SINT";
+        case image_t::IMAGE_BASETYPE_UINT:  return "SG_SAMPLERTYPE_UINT";
+        default: return "INVALID";
+    }
+}
+
+const uniform_block_t* find_uniform_block(const spirvcross_refl_t& refl, int slot) {
+    for (const uniform_block_t& ub: refl.uniform_blocks) {
+        if (ub.slot == slot) {
+            return &ub;
+        }
+    }
+    return nullptr;
+}
+
+const image_t* find_image(const spirvcross_refl_t& refl, int slot) {
+    for (const image_t& img: refl.images) {
+        if (img.slot == slot) {
+            return &img;
+        }
+    }
+    return nullptr;
+}
+
+const char* sokol_define(slang_t::type_t slang) {
+    switch (slang) {
+        case slang_t::GLSL330:      return "SOKOL_GLCORE33";
+        case slang_t::GLSL100:      return "SOKOL_GLES2";
+        case slang_t::GLSL300ES:    return "SOKOL_GLES3";
+        case slang_t::HLSL5:        return "SOKOL_D3D11";
+        case slang_t::METAL_MACOS:  return "SOKOL_METAL";
+        case slang_t::METAL_IOS:    return "SOKOL_METAL";
+        case slang_t::METAL_SIM:    return "SOKOL_METAL";
+        case slang_t::WGPU:         return "SOKOL_WGPU";
+        default: return "<INVALID>";
+    }
+}
+
+const char* sokol_backend(slang_t::type_t slang) {
+    switch (slang) {
+        case slang_t::GLSL330:      return "SG_BACKEND_GLCORE33";
+        case slang_t::GLSL100:      return "SG_BACKEND_GLES2";
+        case slang_t::GLSL300ES:    return "SG_BACKEND_GLES3";
+        case slang_t::HLSL5:        return "SG_BACKEND_D3D11";
+        case slang_t::METAL_MACOS:  return "SG_BACKEND_METAL_MACOS";
+        case slang_t::METAL_IOS:    return "SG_BACKEND_METAL_IOS";
+        case slang_t::METAL_SIM:    return "SG_BACKEND_METAL_SIMULATOR";
+        case slang_t::WGPU:         return "SG_BACKEND_WGPU";
+        default: return "<INVALID>";
+    }
+}
+
 }
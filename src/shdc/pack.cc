@@ -0,0 +1,781 @@
+/*
+    Generate a single-file binary shader pack which can be used in place
+    after mmap(), and a small C header with the loader code which
+    builds sg_shader_desc structs pointing directly into the pack data.
+
+    All values are stored as little-endian 32- or 64-bit integers (64-bit values
+    are 8-byte aligned). The pack layout is:
+
+    - header (64 bytes), with the module content hash
+    - entries: one per (program, slang) pair, sorted by program name and slang,
+      with the program content hash
+    - stages: fixed-layout binary reflection info and content hash for each
+      vertex- and fragment-shader, shared by all entries using the same shader
+    - strings: zero-terminated strings, referenced by byte-offset
+    - payloads: shader source code (zero-terminated) or bytecode, 16-byte aligned,
+      identical payloads are only stored once and shared by all stages using them
+
+    With --compress, the header flag SSHDC_PACK_FLAG_LZ is set and each payload
+    is stored as a 32-bit uncompressed size followed by an LZ4 block.
+
+    The binary reflection output (--reflection binary) uses the same layout,
+    but has the header flag SSHDC_PACK_FLAG_REFLECTION set and contains no
+    payloads (the stage payload offsets are zero, the payload sizes are the
+    uncompressed sizes).
+*/
+#include "shdc.h"
+#include "fmt/format.h"
+#include "pystring.h"
+#include <stdio.h>
+#include <algorithm>
+
+namespace shdc {
+
+static const uint32_t pack_magic = 0x50444853;     // 'SHDP'
+static const uint32_t pack_version = 4;
+static const int pack_header_size = 64;
+static const int pack_entry_size = 24;
+static const int pack_attr_size = 16;
+static const int pack_uniform_size = 20;
+static const int pack_uniform_block_size = 16 + uniform_t::NUM * pack_uniform_size;
+static const int pack_image_size = 16;
+static const int pack_stage_size = 48 +
+    2 * attr_t::NUM * pack_attr_size +
+    uniform_block_t::NUM * pack_uniform_block_size +
+    image_t::NUM * pack_image_size;
+static const int pack_payload_align = 16;
+static const uint32_t pack_flag_lz = (1<<0);
+static const uint32_t pack_flag_reflection = (1<<1);
+// fragment shader features which prevent early depth/stencil testing
+static const uint32_t pack_stage_flag_discard = (1<<0);
+static const uint32_t pack_stage_flag_writes_depth = (1<<1);
+static const uint32_t pack_stage_flag_sample_shading = (1<<2);
+static const uint32_t pack_stage_flag_side_effects = (1<<3);
+static const uint32_t pack_stage_flag_early_fragment_tests = (1<<4);
+static const uint32_t pack_stage_flag_early_z = (1<<5);
+
+static std::string file_content;
+static std::vector<uint8_t> pack_data;
+static std::string pack_strings;
+static std::map<std::string, uint32_t> pack_string_offsets;
+static std::vector<std::vector<uint8_t>> pack_payloads;
+static bool pack_reflection_only = false;
+
+#if defined(_MSC_VER)
+#define L(str, ...) file_content.append(fmt::format(str, __VA_ARGS__))
+#else
+#define L(str, ...) file_content.append(fmt::format(str, ##__VA_ARGS__))
+#endif
+
+/* a vertex- or fragment-shader in a specific shader language */
+struct pack_stage_t {
+    slang_t::type_t slang = slang_t::NUM;
+    const spirvcross_source_t* src = nullptr;
+    int payload_index = -1;     // index into payloads_t.items
+};
+
+/* a (program, slang) pair */
+struct pack_entry_t {
+    std::string name;
+    slang_t::type_t slang = slang_t::NUM;
+    int vs_stage = -1;
+    int fs_stage = -1;
+    uint64_t hash = 0;      // program content hash
+};
+
+static void put_u32(uint32_t val) {
+    pack_data.push_back((uint8_t)(val & 0xFF));
+    pack_data.push_back((uint8_t)((val >> 8) & 0xFF));
+    pack_data.push_back((uint8_t)((val >> 16) & 0xFF));
+    pack_data.push_back((uint8_t)((val >> 24) & 0xFF));
+}
+
+static void put_i32(int val) {
+    put_u32((uint32_t)val);
+}
+
+static void put_u64(uint64_t val) {
+    put_u32((uint32_t)(val & 0xFFFFFFFF));
+    put_u32((uint32_t)(val >> 32));
+}
+
+static void put_bytes(const void* ptr, size_t num_bytes) {
+    const uint8_t* bytes = (const uint8_t*) ptr;
+    pack_data.insert(pack_data.end(), bytes, bytes + num_bytes);
+}
+
+static void put_padding(size_t offset) {
+    assert(pack_data.size() <= offset);
+    pack_data.resize(offset, 0);
+}
+
+/* add a string to the string table, return its byte offset (offset 0 is the empty string) */
+static uint32_t add_string(const std::string& str) {
+    if (pack_string_offsets.count(str) > 0) {
+        return pack_string_offsets.at(str);
+    }
+    uint32_t offset = (uint32_t) pack_strings.size();
+    pack_strings.append(str);
+    pack_strings.push_back(0);
+    pack_string_offsets[str] = offset;
+    return offset;
+}
+
+static int find_or_add_stage(std::vector<pack_stage_t>& stages, slang_t::type_t slang, const spirvcross_source_t* src, int payload_index) {
+    for (int i = 0; i < (int)stages.size(); i++) {
+        if ((stages[i].slang == slang) && (stages[i].src == src)) {
+            return i;
+        }
+    }
+    pack_stage_t stage;
+    stage.slang = slang;
+    stage.src = src;
+    stage.payload_index = payload_index;
+    stages.push_back(stage);
+    return (int)stages.size() - 1;
+}
+
+static void put_attr(const attr_t& attr) {
+    put_i32(attr.slot);
+    put_u32(add_string(attr.name));
+    put_u32(add_string(attr.sem_name));
+    put_i32(attr.sem_index);
+}
+
+static void put_stage(const pack_stage_t& stage, const input_t& inp, const payloads_t& payloads, const std::vector<uint32_t>& payload_offsets) {
+    const spirvcross_refl_t& refl = stage.src->refl;
+    const payload_t& payload = payloads.items[stage.payload_index];
+    put_u32((uint32_t)refl.stage);
+    put_u32(add_string(refl.entry_point));
+    put_u32(add_string(inp.snippets[stage.src->snippet_index].name));
+    if (pack_reflection_only) {
+        put_u32(0);
+        put_u32((uint32_t)payload.data.size());
+    }
+    else {
+        put_u32(payload_offsets[stage.payload_index]);
+        put_u32((uint32_t)pack_payloads[stage.payload_index].size());
+    }
+    put_u32(payload.is_bytecode ? 1 : 0);
+    put_u32((uint32_t)refl.uniform_blocks.size());
+    put_u32((uint32_t)refl.images.size());
+    uint32_t flags = 0;
+    if (refl.stage == stage_t::FS) {
+        flags |= refl.uses_discard ? pack_stage_flag_discard : 0;
+        flags |= refl.writes_depth ? pack_stage_flag_writes_depth : 0;
+        flags |= refl.sample_shading ? pack_stage_flag_sample_shading : 0;
+        flags |= refl.has_side_effects ? pack_stage_flag_side_effects : 0;
+        flags |= refl.early_fragment_tests ? pack_stage_flag_early_fragment_tests : 0;
+        flags |= refl.early_z() ? pack_stage_flag_early_z : 0;
+    }
+    put_u32(flags);
+    put_u32(0);
+    put_u64(payload.hash);
+    for (const attr_t& attr: refl.inputs) {
+        put_attr(attr);
+    }
+    for (const attr_t& attr: refl.outputs) {
+        put_attr(attr);
+    }
+    // uniform blocks and images are stored by bind slot
+    for (int ub_index = 0; ub_index < uniform_block_t::NUM; ub_index++) {
+        const uniform_block_t* ub = find_uniform_block(refl, ub_index);
+        if (ub) {
+            put_i32(ub->slot);
+            put_u32((uint32_t)ub->size);
+            put_u32(add_string(ub->name));
+            put_u32((uint32_t)ub->uniforms.size());
+        }
+        else {
+            put_i32(-1);
+            put_u32(0);
+            put_u32(0);
+            put_u32(0);
+        }
+        for (int u_index = 0; u_index < uniform_t::NUM; u_index++) {
+            if (ub && (u_index < (int)ub->uniforms.size())) {
+                const uniform_t& u = ub->uniforms[u_index];
+                put_u32(add_string(u.name));
+                put_u32((uint32_t)u.type);
+                put_i32(u.array_count);
+                put_u32((uint32_t)u.offset);
+                put_u32((uint32_t)u.size);
+            }
+            else {
+                put_u32(0);
+                put_u32(0);
+                put_i32(0);
+                put_u32(0);
+                put_u32(0);
+            }
+        }
+    }
+    for (int img_index = 0; img_index < image_t::NUM; img_index++) {
+        const image_t* img = find_image(refl, img_index);
+        if (img) {
+            put_i32(img->slot);
+            put_u32(add_string(img->name));
+            put_u32((uint32_t)img->type);
+            put_u32((uint32_t)img->base_type);
+        }
+        else {
+            put_i32(-1);
+            put_u32(0);
+            put_u32(0);
+            put_u32(0);
+        }
+    }
+}
+
+static errmsg_t write_pack(const args_t& args,
+                           const input_t& inp,
+                           const std::array<spirvcross_t,slang_t::NUM>& spirvcross,
+                           const payloads_t& payloads,
+                           const std::string& path)
+{
+    // gather entries and unique shader stages
+    std::vector<pack_entry_t> entries;
+    std::vector<pack_stage_t> stages;
+    for (int i = 0; i < slang_t::NUM; i++) {
+        slang_t::type_t slang = (slang_t::type_t) i;
+        if (0 == (args.slang & slang_t::bit(slang))) {
+            continue;
+        }
+        for (const auto& item: inp.programs) {
+            const program_t& prog = item.second;
+            int vs_snippet_index = inp.snippet_map.at(prog.vs_name);
+            int fs_snippet_index = inp.snippet_map.at(prog.fs_name);
+            int vs_src_index = spirvcross[i].find_source_by_snippet_index(vs_snippet_index);
+            int fs_src_index = spirvcross[i].find_source_by_snippet_index(fs_snippet_index);
+            assert((vs_src_index >= 0) && (fs_src_index >= 0));
+            pack_entry_t entry;
+            entry.name = prog.name;
+            entry.slang = slang;
+            entry.hash = payloads.program_hash(inp, prog, slang);
+            entry.vs_stage = find_or_add_stage(stages, slang,
+                &spirvcross[i].sources[vs_src_index],
+                payloads.find_payload_index(slang, vs_snippet_index));
+            entry.fs_stage = find_or_add_stage(stages, slang,
+                &spirvcross[i].sources[fs_src_index],
+                payloads.find_payload_index(slang, fs_snippet_index));
+            entries.push_back(entry);
+        }
+    }
+    // sort the entries so that the loader can do a binary search
+    std::sort(entries.begin(), entries.end(), [](const pack_entry_t& a, const pack_entry_t& b) {
+        if (a.name != b.name) {
+            return a.name < b.name;
+        }
+        return a.slang < b.slang;
+    });
+
+    // build the string table up front, so that the final layout is known
+    pack_strings.clear();
+    pack_string_offsets.clear();
+    add_string("");
+    add_string(inp.module);
+    for (const pack_entry_t& entry: entries) {
+        add_string(entry.name);
+    }
+    // the payload data as stored in the pack
+    pack_payloads.clear();
+    for (const payload_t& payload: payloads.items) {
+        if (pack_reflection_only) {
+            pack_payloads.push_back(std::vector<uint8_t>());
+        }
+        else if (args.compress) {
+            const uint32_t raw_size = (uint32_t) payload.data.size();
+            std::vector<uint8_t> data = { (uint8_t)raw_size, (uint8_t)(raw_size >> 8), (uint8_t)(raw_size >> 16), (uint8_t)(raw_size >> 24) };
+            data.insert(data.end(), payload.compressed.begin(), payload.compressed.end());
+            pack_payloads.push_back(data);
+        }
+        else {
+            pack_payloads.push_back(payload.data);
+        }
+    }
+    std::vector<uint32_t> payload_offsets(payloads.items.size(), 0);
+    pack_data.clear();
+    for (const pack_stage_t& stage: stages) {
+        put_stage(stage, inp, payloads, payload_offsets);
+    }
+
+    // compute the layout
+    const uint32_t entries_offset = pack_header_size;
+    const uint32_t stages_offset = roundup(entries_offset + (int)entries.size() * pack_entry_size, pack_payload_align);
+    const uint32_t strings_offset = stages_offset + (uint32_t)stages.size() * pack_stage_size;
+    const uint32_t payloads_offset = roundup(strings_offset + (int)pack_strings.size(), pack_payload_align);
+    uint32_t cur_offset = payloads_offset;
+    for (int i = 0; i < (int)payloads.items.size(); i++) {
+        payload_offsets[i] = cur_offset;
+        cur_offset = roundup(cur_offset + (int)pack_payloads[i].size(), pack_payload_align);
+    }
+    const uint32_t total_size = cur_offset;
+
+    // write the pack (now with the final payload offsets in the stage records)
+    pack_data.clear();
+    put_u32(pack_magic);
+    put_u32(pack_version);
+    put_u32(total_size);
+    put_u32(add_string(inp.module));
+    put_u32((uint32_t)entries.size());
+    put_u32(entries_offset);
+    put_u32((uint32_t)stages.size());
+    put_u32(stages_offset);
+    put_u32(strings_offset);
+    put_u32((uint32_t)pack_strings.size());
+    put_u32(payloads_offset);
+    put_u32(total_size - payloads_offset);
+    if (pack_reflection_only) {
+        put_u32(pack_flag_reflection);
+    }
+    else {
+        put_u32(args.compress ? pack_flag_lz : 0);
+    }
+    put_u32(0);
+    put_u64(payloads.module_hash(args, inp));
+    put_padding(pack_header_size);
+    for (const pack_entry_t& entry: entries) {
+        put_u32(add_string(entry.name));
+        put_u32((uint32_t)entry.slang);
+        put_u32(stages_offset + entry.vs_stage * pack_stage_size);
+        put_u32(stages_offset + entry.fs_stage * pack_stage_size);
+        put_u64(entry.hash);
+    }
+    put_padding(stages_offset);
+    for (const pack_stage_t& stage: stages) {
+        put_stage(stage, inp, payloads, payload_offsets);
+    }
+    assert(pack_data.size() == strings_offset);
+    put_bytes(pack_strings.data(), pack_strings.size());
+    for (int i = 0; i < (int)payloads.items.size(); i++) {
+        put_padding(payload_offsets[i]);
+        put_bytes(pack_payloads[i].data(), pack_payloads[i].size());
+    }
+    put_padding(total_size);
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        return errmsg_t::error(inp.base_path, 0, fmt::format("failed to open output file '{}'", path));
+    }
+    size_t written = fwrite(pack_data.data(), 1, pack_data.size(), f);
+    fclose(f);
+    if (written != pack_data.size()) {
+        return errmsg_t::error(inp.base_path, 0, fmt::format("failed to write output file '{}'", path));
+    }
+    return errmsg_t();
+}
+
+static errmsg_t write_loader(const args_t& args, const input_t& inp, const std::string& loader_path) {
+    file_content.clear();
+    L("#pragma once\n");
+    L("/*\n");
+    L("    #version:{}# (machine generated, don't edit!)\n\n", args.gen_version);
+    L("    Generated by sokol-shdc (https://github.com/floooh/sokol-tools)\n\n");
+    L("    Loader for the shader pack '{}'.\n\n", pystring::os::path::basename(args.output));
+    L("    The pack is used in place (e.g. after mmap()), no data is parsed or copied,\n");
+    L("    the returned sg_shader_desc points directly into the pack data, which must\n");
+    L("    remain valid until sg_make_shader() has been called. The pack data must be\n");
+    L("    at least 8-byte aligned and is expected to run on a little-endian host.\n\n");
+    L("    Programs:\n\n");
+    for (const auto& item: inp.programs) {
+        L("        {}\n", item.second.name);
+    }
+    L("\n");
+    L("    Usage:\n\n");
+    L("        if (sshdc_pack_validate(pack_ptr, pack_size)) {{\n");
+    L("            sg_shader_desc desc;\n");
+    L("            if (sshdc_pack_shader_desc(pack_ptr, \"[program name]\", sg_query_backend(), &desc)) {{\n");
+    L("                sg_shader shd = sg_make_shader(&desc);\n");
+    L("            }}\n");
+    L("        }}\n\n");
+    L("    For compressed packs (sokol-shdc --compress), use sshdc_pack_shader_desc_decode()\n");
+    L("    with a buffer of at least sshdc_pack_decode_size() bytes instead.\n");
+    L("*/\n");
+    L("#if !defined(SOKOL_GFX_INCLUDED)\n");
+    L("  #error \"Please include sokol_gfx.h before {}\"\n", pystring::os::path::basename(loader_path));
+    L("#endif\n");
+    L("#if !defined(SOKOL_SHDC_PACK_INCLUDED)\n");
+    L("#define SOKOL_SHDC_PACK_INCLUDED (1)\n");
+    L("#include <stdint.h>\n");
+    L("#include <stdbool.h>\n");
+    L("#include <string.h>\n");
+    L("#include <assert.h>\n");
+    L("#define SSHDC_PACK_MAGIC ({:#010x})\n", pack_magic);
+    L("#define SSHDC_PACK_VERSION ({})\n", pack_version);
+    L("#define SSHDC_PACK_FLAG_LZ ({})\n", pack_flag_lz);
+    L("#define SSHDC_PACK_FLAG_REFLECTION ({})\n", pack_flag_reflection);
+    L("#define SSHDC_PACK_STAGE_FLAG_DISCARD ({})\n", pack_stage_flag_discard);
+    L("#define SSHDC_PACK_STAGE_FLAG_WRITES_DEPTH ({})\n", pack_stage_flag_writes_depth);
+    L("#define SSHDC_PACK_STAGE_FLAG_SAMPLE_SHADING ({})\n", pack_stage_flag_sample_shading);
+    L("#define SSHDC_PACK_STAGE_FLAG_SIDE_EFFECTS ({})\n", pack_stage_flag_side_effects);
+    L("#define SSHDC_PACK_STAGE_FLAG_EARLY_FRAGMENT_TESTS ({})\n", pack_stage_flag_early_fragment_tests);
+    L("#define SSHDC_PACK_STAGE_FLAG_EARLY_Z ({})\n", pack_stage_flag_early_z);
+    L("typedef struct sshdc_pack_header_t {{\n");
+    L("    uint32_t magic;\n");
+    L("    uint32_t version;\n");
+    L("    uint32_t size;\n");
+    L("    uint32_t module;\n");
+    L("    uint32_t num_entries;\n");
+    L("    uint32_t entries;\n");
+    L("    uint32_t num_stages;\n");
+    L("    uint32_t stages;\n");
+    L("    uint32_t strings;\n");
+    L("    uint32_t strings_size;\n");
+    L("    uint32_t payloads;\n");
+    L("    uint32_t payloads_size;\n");
+    L("    uint32_t flags;\n");
+    L("    uint32_t _reserved;\n");
+    L("    uint64_t module_hash;\n");
+    L("}} sshdc_pack_header_t;\n");
+    L("typedef struct sshdc_pack_entry_t {{\n");
+    L("    uint32_t name;\n");
+    L("    uint32_t slang;\n");
+    L("    uint32_t vs;\n");
+    L("    uint32_t fs;\n");
+    L("    uint64_t hash;\n");
+    L("}} sshdc_pack_entry_t;\n");
+    L("typedef struct sshdc_pack_attr_t {{\n");
+    L("    int32_t slot;\n");
+    L("    uint32_t name;\n");
+    L("    uint32_t sem_name;\n");
+    L("    int32_t sem_index;\n");
+    L("}} sshdc_pack_attr_t;\n");
+    L("typedef struct sshdc_pack_uniform_t {{\n");
+    L("    uint32_t name;\n");
+    L("    uint32_t type;\n");
+    L("    int32_t array_count;\n");
+    L("    uint32_t offset;\n");
+    L("    uint32_t size;\n");
+    L("}} sshdc_pack_uniform_t;\n");
+    L("typedef struct sshdc_pack_uniform_block_t {{\n");
+    L("    int32_t slot;\n");
+    L("    uint32_t size;\n");
+    L("    uint32_t name;\n");
+    L("    uint32_t num_uniforms;\n");
+    L("    sshdc_pack_uniform_t uniforms[{}];\n", uniform_t::NUM);
+    L("}} sshdc_pack_uniform_block_t;\n");
+    L("typedef struct sshdc_pack_image_t {{\n");
+    L("    int32_t slot;\n");
+    L("    uint32_t name;\n");
+    L("    uint32_t type;\n");
+    L("    uint32_t base_type;\n");
+    L("}} sshdc_pack_image_t;\n");
+    L("typedef struct sshdc_pack_stage_t {{\n");
+    L("    uint32_t stage;\n");
+    L("    uint32_t entry;\n");
+    L("    uint32_t snippet;\n");
+    L("    uint32_t payload;\n");
+    L("    uint32_t payload_size;\n");
+    L("    uint32_t bytecode;\n");
+    L("    uint32_t num_uniform_blocks;\n");
+    L("    uint32_t num_images;\n");
+    L("    uint32_t flags;\n");
+    L("    uint32_t _reserved;\n");
+    L("    uint64_t hash;\n");
+    L("    sshdc_pack_attr_t inputs[{}];\n", attr_t::NUM);
+    L("    sshdc_pack_attr_t outputs[{}];\n", attr_t::NUM);
+    L("    sshdc_pack_uniform_block_t uniform_blocks[{}];\n", uniform_block_t::NUM);
+    L("    sshdc_pack_image_t images[{}];\n", image_t::NUM);
+    L("}} sshdc_pack_stage_t;\n");
+    L("static inline const char* sshdc_pack_str(const void* pack, uint32_t str) {{\n");
+    L("    return (const char*)pack + ((const sshdc_pack_header_t*)pack)->strings + str;\n");
+    L("}}\n");
+    L("static inline bool _sshdc_pack_valid_str(const sshdc_pack_header_t* hdr, uint32_t str) {{\n");
+    L("    return str < hdr->strings_size;\n");
+    L("}}\n");
+    L("static inline bool _sshdc_pack_valid_range(const sshdc_pack_header_t* hdr, uint32_t offset, uint64_t size) {{\n");
+    L("    return ((uint64_t)offset + size) <= (uint64_t)hdr->size;\n");
+    L("}}\n");
+    L("/* check that a stage offset points to one of the stage records */\n");
+    L("static inline bool _sshdc_pack_valid_stage_offset(const sshdc_pack_header_t* hdr, uint32_t offset) {{\n");
+    L("    return (offset >= hdr->stages) &&\n");
+    L("        (((offset - hdr->stages) % sizeof(sshdc_pack_stage_t)) == 0) &&\n");
+    L("        (((offset - hdr->stages) / sizeof(sshdc_pack_stage_t)) < hdr->num_stages);\n");
+    L("}}\n");
+    L("static inline bool _sshdc_pack_valid_stage(const sshdc_pack_header_t* hdr, const sshdc_pack_stage_t* stage) {{\n");
+    L("    if (!_sshdc_pack_valid_str(hdr, stage->entry) || !_sshdc_pack_valid_str(hdr, stage->snippet)) {{\n");
+    L("        return false;\n");
+    L("    }}\n");
+    L("    if (0 == (hdr->flags & SSHDC_PACK_FLAG_REFLECTION)) {{\n");
+    L("        // payloads must be inside the payload section, compressed payloads start with the 32-bit uncompressed size\n");
+    L("        if ((stage->payload < hdr->payloads) || !_sshdc_pack_valid_range(hdr, stage->payload, stage->payload_size)) {{\n");
+    L("            return false;\n");
+    L("        }}\n");
+    L("        if ((hdr->flags & SSHDC_PACK_FLAG_LZ) && (stage->payload_size < 4)) {{\n");
+    L("            return false;\n");
+    L("        }}\n");
+    L("    }}\n");
+    L("    for (int i = 0; i < {}; i++) {{\n", attr_t::NUM);
+    L("        const sshdc_pack_attr_t* attrs[2] = {{ &stage->inputs[i], &stage->outputs[i] }};\n");
+    L("        for (int j = 0; j < 2; j++) {{\n");
+    L("            if ((attrs[j]->slot >= 0) && (!_sshdc_pack_valid_str(hdr, attrs[j]->name) || !_sshdc_pack_valid_str(hdr, attrs[j]->sem_name))) {{\n");
+    L("                return false;\n");
+    L("            }}\n");
+    L("        }}\n");
+    L("    }}\n");
+    L("    for (int i = 0; i < {}; i++) {{\n", uniform_block_t::NUM);
+    L("        const sshdc_pack_uniform_block_t* ub = &stage->uniform_blocks[i];\n");
+    L("        if (ub->slot < 0) {{\n");
+    L("            continue;\n");
+    L("        }}\n");
+    L("        if (!_sshdc_pack_valid_str(hdr, ub->name) || (ub->num_uniforms > {})) {{\n", uniform_t::NUM);
+    L("            return false;\n");
+    L("        }}\n");
+    L("        for (uint32_t u = 0; u < ub->num_uniforms; u++) {{\n");
+    L("            if (!_sshdc_pack_valid_str(hdr, ub->uniforms[u].name)) {{\n");
+    L("                return false;\n");
+    L("            }}\n");
+    L("        }}\n");
+    L("    }}\n");
+    L("    for (int i = 0; i < {}; i++) {{\n", image_t::NUM);
+    L("        const sshdc_pack_image_t* img = &stage->images[i];\n");
+    L("        if ((img->slot >= 0) && (!_sshdc_pack_valid_str(hdr, img->name) || (img->type > {}) || (img->base_type > {}))) {{\n",
+        (int)image_t::IMAGE_TYPE_ARRAY, (int)image_t::IMAGE_BASETYPE_UINT);
+    L("            return false;\n");
+    L("        }}\n");
+    L("    }}\n");
+    L("    return true;\n");
+    L("}}\n");
+    L("/* check the pack header, and that all offsets and sizes in the pack are inside the pack data */\n");
+    L("static inline bool sshdc_pack_validate(const void* pack, size_t size) {{\n");
+    L("    const sshdc_pack_header_t* hdr = (const sshdc_pack_header_t*) pack;\n");
+    L("    if (!pack || (size < sizeof(sshdc_pack_header_t)) ||\n");
+    L("        (hdr->magic != SSHDC_PACK_MAGIC) ||\n");
+    L("        (hdr->version != SSHDC_PACK_VERSION) ||\n");
+    L("        (hdr->size > size))\n");
+    L("    {{\n");
+    L("        return false;\n");
+    L("    }}\n");
+    L("    // sections, entries and stages contain 64-bit values and must be 8-byte aligned,\n");
+    L("    // the string section must end with a terminating zero\n");
+    L("    if (((hdr->entries & 7) != 0) || ((hdr->stages & 7) != 0) ||\n");
+    L("        !_sshdc_pack_valid_range(hdr, hdr->entries, (uint64_t)hdr->num_entries * sizeof(sshdc_pack_entry_t)) ||\n");
+    L("        !_sshdc_pack_valid_range(hdr, hdr->stages, (uint64_t)hdr->num_stages * sizeof(sshdc_pack_stage_t)) ||\n");
+    L("        !_sshdc_pack_valid_range(hdr, hdr->strings, hdr->strings_size) ||\n");
+    L("        !_sshdc_pack_valid_range(hdr, hdr->payloads, hdr->payloads_size) ||\n");
+    L("        (hdr->strings_size == 0) ||\n");
+    L("        (((const char*)pack)[hdr->strings + hdr->strings_size - 1] != 0) ||\n");
+    L("        !_sshdc_pack_valid_str(hdr, hdr->module))\n");
+    L("    {{\n");
+    L("        return false;\n");
+    L("    }}\n");
+    L("    const sshdc_pack_entry_t* entries = (const sshdc_pack_entry_t*) ((const uint8_t*)pack + hdr->entries);\n");
+    L("    for (uint32_t i = 0; i < hdr->num_entries; i++) {{\n");
+    L("        if (!_sshdc_pack_valid_str(hdr, entries[i].name) ||\n");
+    L("            !_sshdc_pack_valid_stage_offset(hdr, entries[i].vs) ||\n");
+    L("            !_sshdc_pack_valid_stage_offset(hdr, entries[i].fs))\n");
+    L("        {{\n");
+    L("            return false;\n");
+    L("        }}\n");
+    L("    }}\n");
+    L("    const sshdc_pack_stage_t* stages = (const sshdc_pack_stage_t*) ((const uint8_t*)pack + hdr->stages);\n");
+    L("    for (uint32_t i = 0; i < hdr->num_stages; i++) {{\n");
+    L("        if (!_sshdc_pack_valid_stage(hdr, &stages[i])) {{\n");
+    L("            return false;\n");
+    L("        }}\n");
+    L("    }}\n");
+    L("    return true;\n");
+    L("}}\n");
+    L("static inline int _sshdc_pack_slang(sg_backend backend) {{\n");
+    L("    switch (backend) {{\n");
+    for (int i = 0; i < slang_t::NUM; i++) {
+        L("        case {}: return {}; /* {} */\n", sokol_backend((slang_t::type_t)i), i, slang_t::to_str((slang_t::type_t)i));
+    }
+    L("        default: return -1;\n");
+    L("    }}\n");
+    L("}}\n");
+    L("/* binary search for a (program, backend) entry, returns 0 if not found */\n");
+    L("static inline const sshdc_pack_entry_t* sshdc_pack_find(const void* pack, const char* prog_name, sg_backend backend) {{\n");
+    L("    assert(pack && prog_name);\n");
+    L("    const int slang = _sshdc_pack_slang(backend);\n");
+    L("    if (slang < 0) {{\n");
+    L("        return 0;\n");
+    L("    }}\n");
+    L("    const sshdc_pack_header_t* hdr = (const sshdc_pack_header_t*) pack;\n");
+    L("    const sshdc_pack_entry_t* entries = (const sshdc_pack_entry_t*) ((const uint8_t*)pack + hdr->entries);\n");
+    L("    int lo = 0;\n");
+    L("    int hi = (int)hdr->num_entries - 1;\n");
+    L("    while (lo <= hi) {{\n");
+    L("        const int mid = (lo + hi) / 2;\n");
+    L("        int cmp = strcmp(prog_name, sshdc_pack_str(pack, entries[mid].name));\n");
+    L("        if (0 == cmp) {{\n");
+    L("            cmp = slang - (int)entries[mid].slang;\n");
+    L("        }}\n");
+    L("        if (0 == cmp) {{\n");
+    L("            return &entries[mid];\n");
+    L("        }}\n");
+    L("        else if (cmp < 0) {{\n");
+    L("            hi = mid - 1;\n");
+    L("        }}\n");
+    L("        else {{\n");
+    L("            lo = mid + 1;\n");
+    L("        }}\n");
+    L("    }}\n");
+    L("    return 0;\n");
+    L("}}\n");
+    L("static inline void _sshdc_pack_stage_desc(const void* pack, uint32_t stage_offset, sg_shader_stage_desc* out) {{\n");
+    L("    static const sg_image_type img_types[] = {{ ");
+    for (int i = 0; i <= (int)image_t::IMAGE_TYPE_ARRAY; i++) {
+        const char* str = img_type_to_sokol_type_str((image_t::type_t)i);
+        L("{}, ", (i == image_t::IMAGE_TYPE_INVALID) ? "_SG_IMAGETYPE_DEFAULT" : str);
+    }
+    L("}};\n");
+    L("    static const sg_sampler_type sampler_types[] = {{ ");
+    for (int i = 0; i <= (int)image_t::IMAGE_BASETYPE_UINT; i++) {
+        const char* str = img_basetype_to_sokol_samplertype_str((image_t::basetype_t)i);
+        L("{}, ", (i == image_t::IMAGE_BASETYPE_INVALID) ? "_SG_SAMPLERTYPE_DEFAULT" : str);
+    }
+    L("}};\n");
+    L("    const sshdc_pack_stage_t* stage = (const sshdc_pack_stage_t*) ((const uint8_t*)pack + stage_offset);\n");
+    L("    const uint8_t* payload = (const uint8_t*)pack + stage->payload;\n");
+    L("    if (stage->bytecode) {{\n");
+    L("        out->bytecode = payload;\n");
+    L("        out->bytecode_size = (int) stage->payload_size;\n");
+    L("    }}\n");
+    L("    else {{\n");
+    L("        out->source = (const char*) payload;\n");
+    L("    }}\n");
+    L("    out->entry = sshdc_pack_str(pack, stage->entry);\n");
+    L("    for (int i = 0; i < {}; i++) {{\n", uniform_block_t::NUM);
+    L("        const sshdc_pack_uniform_block_t* ub = &stage->uniform_blocks[i];\n");
+    L("        if (ub->slot >= 0) {{\n");
+    L("            // sokol-gfx expects the uniform block size rounded up to 16 bytes\n");
+    L("            out->uniform_blocks[i].size = (int) ((ub->size + 15) & ~15u);\n");
+    L("            out->uniform_blocks[i].uniforms[0].name = sshdc_pack_str(pack, ub->name);\n");
+    L("            out->uniform_blocks[i].uniforms[0].type = SG_UNIFORMTYPE_FLOAT4;\n");
+    L("            out->uniform_blocks[i].uniforms[0].array_count = out->uniform_blocks[i].size / 16;\n");
+    L("        }}\n");
+    L("    }}\n");
+    L("    for (int i = 0; i < {}; i++) {{\n", image_t::NUM);
+    L("        const sshdc_pack_image_t* img = &stage->images[i];\n");
+    L("        if (img->slot >= 0) {{\n");
+    L("            out->images[i].name = sshdc_pack_str(pack, img->name);\n");
+    L("            out->images[i].type = img_types[img->type];\n");
+    L("            out->images[i].sampler_type = sampler_types[img->base_type];\n");
+    L("        }}\n");
+    L("    }}\n");
+    L("}}\n");
+    L("static inline void _sshdc_pack_entry_desc(const void* pack, const sshdc_pack_entry_t* entry, sg_shader_desc* out_desc) {{\n");
+    L("    memset(out_desc, 0, sizeof(sg_shader_desc));\n");
+    L("    const sshdc_pack_stage_t* vs = (const sshdc_pack_stage_t*) ((const uint8_t*)pack + entry->vs);\n");
+    L("    for (int i = 0; i < {}; i++) {{\n", attr_t::NUM);
+    L("        const sshdc_pack_attr_t* attr = &vs->inputs[i];\n");
+    L("        if (attr->slot >= 0) {{\n");
+    L("            out_desc->attrs[i].name = sshdc_pack_str(pack, attr->name);\n");
+    L("            out_desc->attrs[i].sem_name = sshdc_pack_str(pack, attr->sem_name);\n");
+    L("            out_desc->attrs[i].sem_index = attr->sem_index;\n");
+    L("        }}\n");
+    L("    }}\n");
+    L("    _sshdc_pack_stage_desc(pack, entry->vs, &out_desc->vs);\n");
+    L("    _sshdc_pack_stage_desc(pack, entry->fs, &out_desc->fs);\n");
+    L("    out_desc->label = sshdc_pack_str(pack, entry->name);\n");
+    L("}}\n");
+    L("/* fill an sg_shader_desc for a program and backend, returns false if not found, if the pack is compressed or reflection-only */\n");
+    L("static inline bool sshdc_pack_shader_desc(const void* pack, const char* prog_name, sg_backend backend, sg_shader_desc* out_desc) {{\n");
+    L("    const sshdc_pack_entry_t* entry = sshdc_pack_find(pack, prog_name, backend);\n");
+    L("    if ((0 == entry) || (((const sshdc_pack_header_t*)pack)->flags & (SSHDC_PACK_FLAG_LZ|SSHDC_PACK_FLAG_REFLECTION))) {{\n");
+    L("        return false;\n");
+    L("    }}\n");
+    L("    _sshdc_pack_entry_desc(pack, entry, out_desc);\n");
+    L("    return true;\n");
+    L("}}\n");
+    L("{}", lz_t::c_decoder_source());
+    L("static inline int _sshdc_pack_raw_size(const void* pack, uint32_t stage_offset) {{\n");
+    L("    const sshdc_pack_stage_t* stage = (const sshdc_pack_stage_t*) ((const uint8_t*)pack + stage_offset);\n");
+    L("    const uint8_t* payload = (const uint8_t*)pack + stage->payload;\n");
+    L("    return (int) (payload[0] | (payload[1] << 8) | (payload[2] << 16) | ((uint32_t)payload[3] << 24));\n");
+    L("}}\n");
+    L("static inline bool _sshdc_pack_decode_stage(const void* pack, uint32_t stage_offset, uint8_t* dst, sg_shader_stage_desc* out) {{\n");
+    L("    const sshdc_pack_stage_t* stage = (const sshdc_pack_stage_t*) ((const uint8_t*)pack + stage_offset);\n");
+    L("    const uint8_t* payload = (const uint8_t*)pack + stage->payload;\n");
+    L("    const int raw_size = _sshdc_pack_raw_size(pack, stage_offset);\n");
+    L("    if (!_sshdc_lz_decode(payload + 4, (int)stage->payload_size - 4, dst, raw_size)) {{\n");
+    L("        return false;\n");
+    L("    }}\n");
+    L("    if (stage->bytecode) {{\n");
+    L("        out->bytecode = dst;\n");
+    L("        out->bytecode_size = raw_size;\n");
+    L("    }}\n");
+    L("    else {{\n");
+    L("        out->source = (const char*) dst;\n");
+    L("    }}\n");
+    L("    return true;\n");
+    L("}}\n");
+    L("/* number of buffer bytes needed by sshdc_pack_shader_desc_decode(), 0 if the pack isn't compressed or the program isn't found */\n");
+    L("static inline size_t sshdc_pack_decode_size(const void* pack, const char* prog_name, sg_backend backend) {{\n");
+    L("    const sshdc_pack_entry_t* entry = sshdc_pack_find(pack, prog_name, backend);\n");
+    L("    if ((0 == entry) || (0 == (((const sshdc_pack_header_t*)pack)->flags & SSHDC_PACK_FLAG_LZ))) {{\n");
+    L("        return 0;\n");
+    L("    }}\n");
+    L("    return (size_t) (((_sshdc_pack_raw_size(pack, entry->vs) + 15) & ~15) + _sshdc_pack_raw_size(pack, entry->fs));\n");
+    L("}}\n");
+    L("/* like sshdc_pack_shader_desc(), but also works for compressed packs, the shader code is decompressed\n");
+    L("   into buf, which must be at least sshdc_pack_decode_size() bytes and remain valid until sg_make_shader() has been called */\n");
+    L("static inline bool sshdc_pack_shader_desc_decode(const void* pack, const char* prog_name, sg_backend backend, void* buf, size_t buf_size, sg_shader_desc* out_desc) {{\n");
+    L("    const sshdc_pack_entry_t* entry = sshdc_pack_find(pack, prog_name, backend);\n");
+    L("    if ((0 == entry) || (((const sshdc_pack_header_t*)pack)->flags & SSHDC_PACK_FLAG_REFLECTION)) {{\n");
+    L("        return false;\n");
+    L("    }}\n");
+    L("    _sshdc_pack_entry_desc(pack, entry, out_desc);\n");
+    L("    if (((const sshdc_pack_header_t*)pack)->flags & SSHDC_PACK_FLAG_LZ) {{\n");
+    L("        if (buf_size < sshdc_pack_decode_size(pack, prog_name, backend)) {{\n");
+    L("            return false;\n");
+    L("        }}\n");
+    L("        uint8_t* vs_buf = (uint8_t*) buf;\n");
+    L("        uint8_t* fs_buf = vs_buf + ((_sshdc_pack_raw_size(pack, entry->vs) + 15) & ~15);\n");
+    L("        if (!_sshdc_pack_decode_stage(pack, entry->vs, vs_buf, &out_desc->vs) ||\n");
+    L("            !_sshdc_pack_decode_stage(pack, entry->fs, fs_buf, &out_desc->fs))\n");
+    L("        {{\n");
+    L("            return false;\n");
+    L("        }}\n");
+    L("    }}\n");
+    L("    return true;\n");
+    L("}}\n");
+    L("#endif /* SOKOL_SHDC_PACK_INCLUDED */\n");
+
+    FILE* f = fopen(loader_path.c_str(), "w");
+    if (!f) {
+        return errmsg_t::error(inp.base_path, 0, fmt::format("failed to open output file '{}'", loader_path));
+    }
+    fwrite(file_content.c_str(), file_content.length(), 1, f);
+    fclose(f);
+    return errmsg_t();
+}
+
+errmsg_t pack_t::gen(const args_t& args, const input_t& inp,
+                     const std::array<spirvcross_t,slang_t::NUM>& spirvcross,
+                     const payloads_t& payloads)
+{
+    for (int i = 0; i < slang_t::NUM; i++) {
+        slang_t::type_t slang = (slang_t::type_t) i;
+        if (args.slang & slang_t::bit(slang)) {
+            errmsg_t err = output_t::check_errors(inp, spirvcross[i], slang);
+            if (err.valid) {
+                return err;
+            }
+        }
+    }
+    pack_reflection_only = false;
+    errmsg_t err = write_pack(args, inp, spirvcross, payloads, args.output);
+    if (err.valid) {
+        return err;
+    }
+    // the C loader header is written next to the pack file
+    return write_loader(args, inp, fmt::format("{}.h", args.output));
+}
+
+errmsg_t pack_t::gen_reflection(const args_t& args, const input_t& inp,
+                                const std::array<spirvcross_t,slang_t::NUM>& spirvcross,
+                                const payloads_t& payloads,
+                                const std::string& path)
+{
+    pack_reflection_only = true;
+    errmsg_t err = write_pack(args, inp, spirvcross, payloads, path);
+    pack_reflection_only = false;
+    if (err.valid) {
+        return err;
+    }
+    return write_loader(args, inp, fmt::format("{}.h", path));
+}
+
+} // namespace shdc
@@ -0,0 +1,188 @@
+/*
+    Generate structured reflection info for all programs and shader
+    languages, either as JSON (for tools), or as a fixed-layout binary
+    file (for runtime code, see pack.cc for the layout).
+*/
+#include "shdc.h"
+#include "fmt/format.h"
+#include "pystring.h"
+#include <stdio.h>
+
+namespace shdc {
+
+static std::string file_content;
+
+#if defined(_MSC_VER)
+#define L(str, ...) file_content.append(fmt::format(str, __VA_ARGS__))
+#else
+#define L(str, ...) file_content.append(fmt::format(str, ##__VA_ARGS__))
+#endif
+
+/* return a quoted and escaped JSON string */
+static std::string json_str(const std::string& str) {
+    std::string res = "\"";
+    for (char c: str) {
+        switch (c) {
+            case '"':   res += "\\\""; break;
+            case '\\':  res += "\\\\"; break;
+            case '\n':  res += "\\n"; break;
+            case '\r':  res += "\\r"; break;
+            case '\t':  res += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    res += fmt::format("\\u{:04x}", (int)c);
+                }
+                else {
+                    res += c;
+                }
+                break;
+        }
+    }
+    res += "\"";
+    return res;
+}
+
+static void write_attrs(const char* name, const std::array<attr_t, attr_t::NUM>& attrs, bool vertex_inputs, const std::string& indent) {
+    L("{}{}: [", indent, json_str(name));
+    bool sep = false;
+    for (const attr_t& attr: attrs) {
+        if (attr.slot >= 0) {
+            // vertex shader inputs also have the vertex format (from @format, or unpacked floats) and step rate (from @instance)
+            const std::string format = vertex_inputs ? fmt::format(", \"format\": {}, \"per_instance\": {}", json_str(vertex_format_t::to_str(attr.vertex_format())), attr.per_instance) : "";
+            L("{}\n{}  {{ \"slot\": {}, \"name\": {}, \"sem_name\": {}, \"sem_index\": {}{} }}",
+                sep ? "," : "", indent, attr.slot, json_str(attr.name), json_str(attr.sem_name), attr.sem_index, format);
+            sep = true;
+        }
+    }
+    L("{}]", sep ? fmt::format("\n{}", indent) : "");
+}
+
+static void write_stage(const input_t& inp, const spirvcross_source_t& src, const payload_t& payload, const std::string& indent) {
+    const spirvcross_refl_t& refl = src.refl;
+    L("{{\n");
+    L("{}  \"snippet\": {},\n", indent, json_str(inp.snippets[src.snippet_index].name));
+    L("{}  \"entry_point\": {},\n", indent, json_str(refl.entry_point));
+    L("{}  \"bytecode\": {},\n", indent, payload.is_bytecode ? "true" : "false");
+    L("{}  \"payload_size\": {},\n", indent, payload.data.size());
+    L("{}  \"hash\": \"{:#018x}\",\n", indent, payload.hash);
+    write_attrs("inputs", refl.inputs, refl.stage == stage_t::VS, indent + "  ");
+    L(",\n");
+    write_attrs("outputs", refl.outputs, false, indent + "  ");
+    L(",\n");
+    L("{}  \"uniform_blocks\": [", indent);
+    for (int ub_index = 0; ub_index < (int)refl.uniform_blocks.size(); ub_index++) {
+        const uniform_block_t& ub = refl.uniform_blocks[ub_index];
+        L("{}\n{}    {{\n", (ub_index > 0) ? "," : "", indent);
+        L("{}      \"slot\": {},\n", indent, ub.slot);
+        L("{}      \"name\": {},\n", indent, json_str(ub.name));
+        L("{}      \"size\": {},\n", indent, ub.size);
+        if (!ub.base_name.empty()) {
+            L("{}      \"compacted_from\": {},\n", indent, json_str(ub.base_name));
+        }
+        L("{}      \"members\": [", indent);
+        for (int u_index = 0; u_index < (int)ub.uniforms.size(); u_index++) {
+            const uniform_t& u = ub.uniforms[u_index];
+            L("{}\n{}        {{ \"name\": {}, \"type\": {}, \"array_count\": {}, \"offset\": {}, \"size\": {} }}",
+                (u_index > 0) ? "," : "", indent, json_str(u.name), json_str(uniform_t::type_to_str(u.type)), u.array_count, u.offset, u.size);
+        }
+        L("{}]\n", ub.uniforms.empty() ? "" : fmt::format("\n{}      ", indent));
+        L("{}    }}", indent);
+    }
+    L("{}],\n", refl.uniform_blocks.empty() ? "" : fmt::format("\n{}  ", indent));
+    L("{}  \"images\": [", indent);
+    for (int img_index = 0; img_index < (int)refl.images.size(); img_index++) {
+        const image_t& img = refl.images[img_index];
+        L("{}\n{}    {{ \"slot\": {}, \"name\": {}, \"type\": {}, \"base_type\": {} }}",
+            (img_index > 0) ? "," : "", indent, img.slot, json_str(img.name), json_str(image_t::type_to_str(img.type)), json_str(image_t::basetype_to_str(img.base_type)));
+    }
+    L("{}]", refl.images.empty() ? "" : fmt::format("\n{}  ", indent));
+    if (refl.stage == stage_t::FS) {
+        L(",\n{}  \"early_z\": {{ \"enabled\": {}, \"uses_discard\": {}, \"writes_depth\": {}, \"sample_shading\": {}, \"side_effects\": {}, \"early_fragment_tests\": {} }}",
+            indent, refl.early_z(), refl.uses_discard, refl.writes_depth, refl.sample_shading, refl.has_side_effects, refl.early_fragment_tests);
+    }
+    L("\n{}}}", indent);
+}
+
+static errmsg_t write_json(const args_t& args,
+                           const input_t& inp,
+                           const std::array<spirvcross_t,slang_t::NUM>& spirvcross,
+                           const payloads_t& payloads,
+                           const std::string& path)
+{
+    file_content.clear();
+    L("{{\n");
+    L("  \"version\": {},\n", args.gen_version);
+    L("  \"module\": {},\n", json_str(inp.module));
+    L("  \"module_hash\": \"{:#018x}\",\n", payloads.module_hash(args, inp));
+    L("  \"programs\": [");
+    bool prog_sep = false;
+    for (const auto& item: inp.programs) {
+        const program_t& prog = item.second;
+        const int vs_snippet_index = inp.snippet_map.at(prog.vs_name);
+        const int fs_snippet_index = inp.snippet_map.at(prog.fs_name);
+        L("{}\n    {{\n", prog_sep ? "," : "");
+        prog_sep = true;
+        L("      \"name\": {},\n", json_str(prog.name));
+        L("      \"vs\": {},\n", json_str(prog.vs_name));
+        L("      \"fs\": {},\n", json_str(prog.fs_name));
+        L("      \"priority\": {},\n", prog.priority);
+        std::vector<std::string> shared_ubs;
+        for (const std::string& ub_name: prog.shared_ubs) {
+            shared_ubs.push_back(json_str(ub_name));
+        }
+        L("      \"shared_uniform_blocks\": [{}],\n", pystring::join(", ", shared_ubs));
+        L("      \"slangs\": {{");
+        bool slang_sep = false;
+        for (int i = 0; i < slang_t::NUM; i++) {
+            slang_t::type_t slang = (slang_t::type_t) i;
+            if (0 == (args.slang & slang_t::bit(slang))) {
+                continue;
+            }
+            int vs_src_index = spirvcross[i].find_source_by_snippet_index(vs_snippet_index);
+            int fs_src_index = spirvcross[i].find_source_by_snippet_index(fs_snippet_index);
+            assert((vs_src_index >= 0) && (fs_src_index >= 0));
+            L("{}\n        {}: {{\n", slang_sep ? "," : "", json_str(slang_t::to_str(slang)));
+            slang_sep = true;
+            L("          \"hash\": \"{:#018x}\",\n", payloads.program_hash(inp, prog, slang));
+            L("          \"vs\": ");
+            write_stage(inp, spirvcross[i].sources[vs_src_index], payloads.find_payload(slang, vs_snippet_index), "          ");
+            L(",\n");
+            L("          \"fs\": ");
+            write_stage(inp, spirvcross[i].sources[fs_src_index], payloads.find_payload(slang, fs_snippet_index), "          ");
+            L("\n");
+            L("        }}");
+        }
+        L("\n      }}\n");
+        L("    }}");
+    }
+    L("\n  ]\n");
+    L("}}\n");
+
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        return errmsg_t::error(inp.base_path, 0, fmt::format("failed to open output file '{}'", path));
+    }
+    fwrite(file_content.c_str(), file_content.length(), 1, f);
+    fclose(f);
+    return errmsg_t();
+}
+
+errmsg_t reflection_t::gen(const args_t& args, const input_t& inp,
+                           const std::array<spirvcross_t,slang_t::NUM>& spirvcross,
+                           const payloads_t& payloads)
+{
+    // with the bare output format, the output path is a prefix which may be a directory
+    std::string base_path = args.output;
+    if (pystring::endswith(base_path, "/") || pystring::endswith(base_path, "\\")) {
+        base_path += "reflection";
+    }
+    if (args.reflection_format == reflection_format_t::JSON) {
+        return write_json(args, inp, spirvcross, payloads, fmt::format("{}.json", base_path));
+    }
+    else if (args.reflection_format == reflection_format_t::BINARY) {
+        return pack_t::gen_reflection(args, inp, spirvcross, payloads, fmt::format("{}.refl", base_path));
+    }
+    return errmsg_t();
+}
+
+} // namespace shdc
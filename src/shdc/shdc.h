@@ -55,6 +55,10 @@ struct slang_t {
         }
         return res;
     }
+    // the mobile shader languages, where fp16 math matters
+    static bool is_mobile(type_t c) {
+        return (c == GLSL100) || (c == GLSL300ES) || (c == METAL_IOS);
+    }
 };
 
 /* the output format */
@@ -64,6 +68,7 @@ struct format_t	{
         SOKOL_DECL,
         SOKOL_IMPL,
         BARE,
+        PACK,
         NUM,
         INVALID,
     };
@@ -74,6 +79,7 @@ struct format_t	{
             case SOKOL_DECL:    return "sokol_decl";
             case SOKOL_IMPL:    return "sokol_impl";
             case BARE:          return "bare";
+            case PACK:          return "pack";
             default:            return "<invalid>";
         }
     }
@@ -90,6 +96,252 @@ struct format_t	{
         else if (str == "bare") {
             return BARE;
         }
+        else if (str == "pack") {
+            return PACK;
+        }
+        else {
+            return INVALID;
+        }
+    }
+};
+
+/* the reflection output format */
+struct reflection_format_t {
+    enum type_t {
+        NONE = 0,
+        JSON,
+        BINARY,
+        INVALID,
+    };
+
+    static const char* to_str(type_t f) {
+        switch (f) {
+            case NONE:      return "none";
+            case JSON:      return "json";
+            case BINARY:    return "binary";
+            default:        return "<invalid>";
+        }
+    }
+    static type_t from_str(const std::string& str) {
+        if (str == "json") {
+            return JSON;
+        }
+        else if (str == "binary") {
+            return BINARY;
+        }
+        else {
+            return INVALID;
+        }
+    }
+};
+
+/* SPIR-V optimizer pass pipelines (--opt and @optimize) */
+struct opt_level_t {
+    enum type_t {
+        NONE = 0,
+        DEFAULT,
+        PERF,
+        SIZE,
+        INVALID,
+    };
+
+    static const char* to_str(type_t t) {
+        switch (t) {
+            case NONE:      return "none";
+            case DEFAULT:   return "default";
+            case PERF:      return "perf";
+            case SIZE:      return "size";
+            default:        return "<invalid>";
+        }
+    }
+    static type_t from_str(const std::string& str) {
+        if (str == "none") {
+            return NONE;
+        }
+        else if (str == "default") {
+            return DEFAULT;
+        }
+        else if (str == "perf") {
+            return PERF;
+        }
+        else if (str == "size") {
+            return SIZE;
+        }
+        else {
+            return INVALID;
+        }
+    }
+};
+
+/* default float precision (--precision and @precision) */
+struct precision_t {
+    enum type_t {
+        DEFAULT = 0,    // keep the precision from the GLSL compiler
+        HIGHP,          // remove all relaxed-precision decorations
+        MEDIUMP,        // relax all float operations
+        INVALID,
+    };
+
+    static const char* to_str(type_t t) {
+        switch (t) {
+            case DEFAULT:   return "default";
+            case HIGHP:     return "highp";
+            case MEDIUMP:   return "mediump";
+            default:        return "<invalid>";
+        }
+    }
+    static type_t from_str(const std::string& str) {
+        if (str == "default") {
+            return DEFAULT;
+        }
+        else if (str == "highp") {
+            return HIGHP;
+        }
+        else if (str == "mediump") {
+            return MEDIUMP;
+        }
+        else {
+            return INVALID;
+        }
+    }
+};
+
+/* vertex attribute formats for @format (identical with sg_vertex_format) */
+struct vertex_format_t {
+    enum type_t {
+        FLOAT = 0,
+        FLOAT2,
+        FLOAT3,
+        FLOAT4,
+        BYTE4,
+        BYTE4N,
+        UBYTE4,
+        UBYTE4N,
+        SHORT2,
+        SHORT2N,
+        USHORT2N,
+        SHORT4,
+        SHORT4N,
+        USHORT4N,
+        UINT10_N2,
+        HALF2,
+        HALF4,
+        NUM,
+        INVALID,
+    };
+
+    static const char* to_str(type_t t) {
+        switch (t) {
+            case FLOAT:     return "float";
+            case FLOAT2:    return "float2";
+            case FLOAT3:    return "float3";
+            case FLOAT4:    return "float4";
+            case BYTE4:     return "byte4";
+            case BYTE4N:    return "byte4n";
+            case UBYTE4:    return "ubyte4";
+            case UBYTE4N:   return "ubyte4n";
+            case SHORT2:    return "short2";
+            case SHORT2N:   return "short2n";
+            case USHORT2N:  return "ushort2n";
+            case SHORT4:    return "short4";
+            case SHORT4N:   return "short4n";
+            case USHORT4N:  return "ushort4n";
+            case UINT10_N2: return "uint10_n2";
+            case HALF2:     return "half2";
+            case HALF4:     return "half4";
+            default:        return "<invalid>";
+        }
+    }
+    static type_t from_str(const std::string& str) {
+        for (int i = 0; i < NUM; i++) {
+            if (str == to_str((type_t)i)) {
+                return (type_t)i;
+            }
+        }
+        return INVALID;
+    }
+    /* the unpacked float format for a number of components */
+    static type_t float_format(int num_components) {
+        switch (num_components) {
+            case 1:  return FLOAT;
+            case 2:  return FLOAT2;
+            case 3:  return FLOAT3;
+            default: return FLOAT4;
+        }
+    }
+    static int num_components(type_t t) {
+        switch (t) {
+            case FLOAT:     return 1;
+            case FLOAT2:
+            case SHORT2:
+            case SHORT2N:
+            case USHORT2N:
+            case HALF2:     return 2;
+            case FLOAT3:    return 3;
+            case UINT10_N2: return 1;   // packed into a single 32-bit value
+            default:        return 4;
+        }
+    }
+    static int byte_size(type_t t) {
+        switch (t) {
+            case FLOAT2:    return 8;
+            case FLOAT3:    return 12;
+            case FLOAT4:    return 16;
+            case SHORT4:
+            case SHORT4N:
+            case USHORT4N:
+            case HALF4:     return 8;
+            default:        return 4;
+        }
+    }
+    /* the C type of a single component */
+    static const char* c_type(type_t t) {
+        switch (t) {
+            case BYTE4:
+            case BYTE4N:    return "int8_t";
+            case UBYTE4:
+            case UBYTE4N:   return "uint8_t";
+            case SHORT2:
+            case SHORT2N:
+            case SHORT4:
+            case SHORT4N:   return "int16_t";
+            case USHORT2N:
+            case USHORT4N:
+            case HALF2:
+            case HALF4:     return "uint16_t";
+            case UINT10_N2: return "uint32_t";
+            default:        return "float";
+        }
+    }
+};
+
+/* release mode for SPIR-V bytecode output (--spirv) */
+struct spirv_strip_t {
+    enum type_t {
+        NONE = 0,
+        STRIP,
+        REMAP,
+        INVALID,
+    };
+
+    static const char* to_str(type_t t) {
+        switch (t) {
+            case NONE:      return "none";
+            case STRIP:     return "strip";
+            case REMAP:     return "remap";
+            default:        return "<invalid>";
+        }
+    }
+    static type_t from_str(const std::string& str) {
+        if (str == "none") {
+            return NONE;
+        }
+        else if (str == "strip") {
+            return STRIP;
+        }
+        else if (str == "remap") {
+            return REMAP;
+        }
         else {
             return INVALID;
         }
@@ -154,6 +406,26 @@ struct errmsg_t {
     }
 };
 
+/* uniform update frequencies (@per_frame, @per_material and @per_draw) */
+struct frequency_t {
+    enum type_t {
+        PER_FRAME = 0,
+        PER_MATERIAL,
+        PER_DRAW,
+        NUM,
+        INVALID,
+    };
+
+    static const char* to_str(type_t t) {
+        switch (t) {
+            case PER_FRAME:     return "per_frame";
+            case PER_MATERIAL:  return "per_material";
+            case PER_DRAW:      return "per_draw";
+            default:            return "<invalid>";
+        }
+    }
+};
+
 /* result of command-line-args parsing */
 struct args_t {
     bool valid = false;
@@ -164,8 +436,22 @@ struct args_t {
     uint32_t slang = 0;                 // combined slang_t bits
     bool byte_code = false;             // output byte code (for HLSL and MetalSL)
     format_t::type_t output_format = format_t::SOKOL; // output format
+    reflection_format_t::type_t reflection_format = reflection_format_t::NONE;  // optional reflection output format
     bool debug_dump = false;            // print debug-dump info
     bool no_ifdef = false;              // don't emit platform #ifdefs (SOKOL_D3D11 etc...)
+    bool report = false;                // print statistics about the generated output
+    bool compress = false;              // compress shader source code and bytecode
+    bool minify = false;                // minify generated shader source code
+    bool link = false;                  // cross-stage link-time optimization of @program stages
+    bool pack_varyings = false;         // pack float varyings into vec4 slots
+    bool reorder_uniforms = false;      // reorder uniform block members to minimize padding
+    bool compact_uniforms = false;      // remove unused uniform block members per shader
+    bool hoist_uniforms = false;        // compute uniform-only expressions on the CPU
+    bool stable_slots = false;          // same bind slot for each uniform block and image in all programs
+    std::string slot_map;               // optional bind slot map file shared by several modules
+    spirv_strip_t::type_t spirv_strip = spirv_strip_t::NONE;   // release mode for SPIR-V bytecode
+    opt_level_t::type_t opt_level = opt_level_t::DEFAULT;   // SPIR-V optimization level
+    precision_t::type_t precision = precision_t::DEFAULT;   // default float precision for mobile shader languages
     int gen_version = 1;                // generator-version stamp
     errmsg_t::msg_format_t error_format = errmsg_t::GCC;  // format for error messages
 
@@ -196,6 +482,14 @@ struct option_t {
     }
 };
 
+/* a compile-time variant define from @variants, the first value is the default */
+struct variant_t {
+    std::string name;
+    std::vector<std::string> values;
+    int shift = 0;          // bit position of the value index in a variant mask
+    int bits = 0;           // number of bits of the value index in a variant mask
+};
+
 /* a named code-snippet (@block, @vs or @fs) in the input source file */
 struct snippet_t {
     enum type_t {
@@ -206,11 +500,20 @@ struct snippet_t {
     };
     type_t type = INVALID;
     std::array<uint32_t, slang_t::NUM> options = { };
+    opt_level_t::type_t opt_level = opt_level_t::INVALID;  // from @optimize, INVALID if not set
+    std::array<precision_t::type_t, slang_t::NUM> precision;    // from @precision, INVALID if not set
+    int base_index = -1;    // for copies specialized by the link step: index of the original snippet
+    int variant_index = -1; // for copies created by @variants and @specialize: index of the original snippet
+    std::vector<variant_t> variants;    // from @variants: the variant defines of a vs or fs snippet
+    std::vector<std::pair<std::string, std::string>> defines;   // the variant defines this snippet is compiled with
+    std::vector<std::pair<std::string, std::string>> spec_constants;    // from @specialize: constant_id or name => value
+    std::map<std::string, vertex_format_t::type_t> attr_formats;        // from @format: vertex shader input name => vertex format
+    std::vector<std::string> instance_attrs;    // from @instance: the per-instance vertex shader inputs
     std::string name;
     std::vector<int> lines; // resolved zero-based line-indices (including @include_block)
 
-    snippet_t() { };
-    snippet_t(type_t t, const std::string& n): type(t), name(n) { };
+    snippet_t() { precision.fill(precision_t::INVALID); };
+    snippet_t(type_t t, const std::string& n): type(t), name(n) { precision.fill(precision_t::INVALID); };
 
     static const char* type_to_str(type_t t) {
         switch (t) {
@@ -228,6 +531,13 @@ struct program_t {
     std::string vs_name;    // name of vertex shader snippet
     std::string fs_name;    // name of fragment shader snippet
     int line_index = -1;    // line index in input source (zero-based)
+    int priority = 0;       // optional @program priority, higher priority programs are prewarmed first
+    bool move_to_vs = false;    // from @move_to_vs: move linear fragment shader computations into the vertex shader
+    std::vector<std::string> shared_ubs;    // @move_to_vs: uniform blocks which moved computations read in the vertex shader
+    std::vector<variant_t> variants;    // the variant defines of the vs and fs snippet (mask bit layout)
+    std::map<uint32_t, std::string> variant_map;    // variant mask => program name (mask 0 is the program itself)
+    std::vector<std::pair<std::string, std::string>> spec_constants;    // from @specialize: constant_id or name => value
+    int spec_line_index = -1;   // line index of the @specialize tag
 
     program_t() { };
     program_t(const std::string& n, const std::string& vs, const std::string& fs, int l): name(n), vs_name(vs), fs_name(fs), line_index(l) { };
@@ -243,6 +553,15 @@ struct line_t {
     line_t(const std::string& ln, int fn, int ix): line(ln), filename(fn), index(ix) { };
 };
 
+/* a uniform-only expression hoisted into a new uniform block member, computed
+    on the CPU by the C statements in 'code' (see uniforms_t::hoist)
+*/
+struct hoisted_t {
+    std::string block;      // uniform block name
+    std::string name;       // new uniform block member name
+    std::vector<std::string> code;  // C statements which read 'in' and write 'out->name'
+};
+
 /* pre-parsed GLSL source file, with content split into snippets */
 struct input_t {
     errmsg_t out_error;
@@ -252,11 +571,16 @@ struct input_t {
     std::vector<line_t> lines;          // input source files split into lines
     std::vector<snippet_t> snippets;    // @block, @vs and @fs snippets
     std::map<std::string, std::string> type_map;    // @type uniform type definitions
+    std::map<std::string, std::map<std::string, frequency_t::type_t>> frequency_map;  // @per_frame/@per_material/@per_draw: uniform block => member => frequency ("" for the whole block)
+    std::map<std::string, int> frequency_lines;     // line index of the @per_frame/@per_material/@per_draw tag by block name and 'block.member'
     std::map<std::string, int> snippet_map; // name-index mapping for all code snippets
     std::map<std::string, int> block_map;   // name-index mapping for @block snippets
     std::map<std::string, int> vs_map;      // name-index mapping for @vs snippets
     std::map<std::string, int> fs_map;      // name-index mapping for @fs snippets
     std::map<std::string, program_t> programs;    // all @program definitions
+    std::vector<hoisted_t> hoisted;     // from --hoist-uniforms: hoisted expressions of all uniform blocks
+    std::map<std::string, int> ub_slots;    // from --stable-slots: uniform block name => bind slot
+    std::map<std::string, int> img_slots;   // from --stable-slots: image name => bind slot
 
     input_t() { };
     static input_t load_and_parse(const std::string& path);
@@ -286,10 +610,51 @@ struct input_t {
 struct spirv_blob_t {
     int snippet_index = -1;         // index into input_t.snippets
     std::vector<uint32_t> bytecode; // the SPIRV blob
+    opt_level_t::type_t opt_level = opt_level_t::NONE;  // the optimizer pipeline that was actually run
+    int num_instrs_before = 0;      // number of SPIRV instructions before optimization
+    int num_instrs_after = 0;       // number of SPIRV instructions after optimization
+    std::vector<uint32_t> fallback_bytecode;    // GLSL100 only: conservatively optimized SPIRV
+    precision_t::type_t precision = precision_t::DEFAULT;   // the effective default float precision
+    int num_relaxed = 0;                        // number of values with relaxed precision after optimization
+    std::vector<std::string> demoted;           // values demoted to relaxed precision by propagation
+    std::map<std::string, std::string> compacted_uniform_blocks;    // compacted uniform block name => full uniform block name
+    std::vector<uint32_t> uncompacted_bytecode; // the SPIRV before uniform block compaction (for the full uniform block layouts)
+    std::vector<std::string> spec_matched;      // the @specialize keys which matched a specialization constant
 
     spirv_blob_t(int snippet_index): snippet_index(snippet_index) { };
 };
 
+/* a single SPIRV instruction */
+struct spirv_inst_t {
+    spv::Op op = spv::OpNop;
+    std::vector<uint32_t> operands;
+
+    spirv_inst_t() { };
+    spirv_inst_t(spv::Op op, const std::vector<uint32_t>& operands): op(op), operands(operands) { };
+};
+
+/* a SPIRV module split into instructions for simple transformations */
+struct spirv_module_t {
+    std::array<uint32_t, 5> header = { };
+    std::vector<spirv_inst_t> insts;
+
+    static bool parse(const std::vector<uint32_t>& spirv, spirv_module_t& out_module);
+    static std::vector<uint32_t> string_words(const std::string& str);
+    std::vector<uint32_t> assemble() const;
+    uint32_t alloc_id();
+    int find_def(uint32_t id) const;
+    int find_first(spv::Op op) const;
+    bool find_decoration(uint32_t id, spv::Decoration decoration, uint32_t& out_value) const;
+    void add_decoration(uint32_t id, spv::Decoration decoration);
+    void add_global(const spirv_inst_t& inst);
+    uint32_t find_or_add_global(spv::Op op, const std::vector<uint32_t>& operands, int result_pos);
+    std::vector<int> find_uses(uint32_t id) const;
+    void remove_decorations(uint32_t id);
+    void set_name(uint32_t id, const std::string& name);
+    void remove_names(uint32_t id);
+    void remove_from_interface(uint32_t id);
+};
+
 /* glsl-to-spirv compiler wrapper */
 struct spirvcross_t;
 struct spirv_t {
@@ -298,11 +663,42 @@ struct spirv_t {
 
     static void initialize_spirv_tools();
     static void finalize_spirv_tools();
-    static spirv_t compile_input_glsl(const input_t& inp, slang_t::type_t slang);
-    static spirv_t compile_spirvcross_glsl(const input_t& inp, slang_t::type_t slang, const spirvcross_t* spirvcross);
+    static spirv_t compile_input_glsl(const args_t& args, const input_t& inp, slang_t::type_t slang);
+    static spirv_t compile_spirvcross_glsl(const args_t& args, const input_t& inp, slang_t::type_t slang, const spirvcross_t* spirvcross);
+    static opt_level_t::type_t opt_level(const args_t& args, const snippet_t& snippet);
+    static precision_t::type_t precision(const args_t& args, const snippet_t& snippet, slang_t::type_t slang);
+    static void optimize_linked(slang_t::type_t slang, opt_level_t::type_t opt_level, std::vector<uint32_t>& spirv);
+    int find_blob_by_snippet_index(int snippet_index) const;
+    void report(const input_t& inp, slang_t::type_t slang) const;
     void dump_debug(const input_t& inp, errmsg_t::msg_format_t err_fmt) const;
 };
 
+/* cross-stage link-time optimization of the SPIRV blobs of each @program */
+struct link_t {
+    static void link(const args_t& args, input_t& inp, std::array<spirv_t,slang_t::NUM>& spirv);
+};
+
+/* collapse shader variants which compiled to identical SPIRV */
+struct variants_t {
+    static void dedup(const args_t& args, input_t& inp, std::array<spirv_t,slang_t::NUM>& spirv);
+};
+
+/* stable bind slots for uniform blocks and images across programs (and modules) */
+struct slots_t {
+    static errmsg_t allocate(const args_t& args, input_t& inp, const std::array<spirv_t,slang_t::NUM>& spirv);
+};
+
+/* uniform block layout optimizations: split uniform blocks by update frequency,
+    hoist uniform-only expressions to the CPU, reorder members to minimize the
+    std140 padding, and compact uniform blocks to the members each shader reads
+*/
+struct uniforms_t {
+    static errmsg_t split(const args_t& args, const input_t& inp, std::array<spirv_t,slang_t::NUM>& spirv);
+    static void reorder(const args_t& args, std::array<spirv_t,slang_t::NUM>& spirv);
+    static void compact(const args_t& args, const input_t& inp, std::array<spirv_t,slang_t::NUM>& spirv);
+    static void hoist(const args_t& args, input_t& inp, std::array<spirv_t,slang_t::NUM>& spirv);
+};
+
 /* reflection info */
 struct attr_t {
     static const int NUM = 16;      // must be identical with NUM_VERTEX_ATTRS
@@ -310,7 +706,14 @@ struct attr_t {
     std::string name;
     std::string sem_name;
     int sem_index = 0;
+    int num_components = 4;     // of the GLSL input/output type
+    vertex_format_t::type_t format = vertex_format_t::INVALID;  // vertex shader inputs: from @format, INVALID if not set
+    bool per_instance = false;  // vertex shader inputs: from @instance
 
+    /* the vertex format of a vertex shader input, unannotated inputs are unpacked floats */
+    vertex_format_t::type_t vertex_format() const {
+        return (format != vertex_format_t::INVALID) ? format : vertex_format_t::float_format(num_components);
+    }
     bool equals(const attr_t& rhs) const {
         return (slot == rhs.slot) &&
                (name == rhs.name) &&
@@ -333,6 +736,7 @@ struct uniform_t {
     type_t type = INVALID;
     int array_count = 1;
     int offset = 0;
+    int size = 0;           // size in bytes, including array elements
 
     static const char* type_to_str(type_t t) {
         switch (t) {
@@ -349,7 +753,8 @@ struct uniform_t {
         return (name == other.name) &&
                (type == other.type) &&
                (array_count == other.array_count) &&
-               (offset == other.offset);
+               (offset == other.offset) &&
+               (size == other.size);
     }
 };
 
@@ -360,6 +765,7 @@ struct uniform_block_t {
     std::string name;
     std::vector<uniform_t> uniforms;
     int unique_index = -1;      // index into spirvcross_t.unique_uniform_blocks
+    std::string base_name;      // for compacted uniform blocks: the name of the full uniform block
 
     bool equals(const uniform_block_t& other) const {
         if ((slot != other.slot) ||
@@ -444,14 +850,36 @@ struct spirvcross_refl_t {
     std::array<attr_t, attr_t::NUM> outputs;
     std::vector<uniform_block_t> uniform_blocks;
     std::vector<image_t> images;
+    // fragment shader features which prevent early depth/stencil testing
+    bool uses_discard = false;          // discard, demote or terminate invocation
+    bool writes_depth = false;          // writes gl_FragDepth
+    bool sample_shading = false;        // runs per sample (gl_SampleID, gl_SamplePosition or 'sample' inputs)
+    bool has_side_effects = false;      // image or storage buffer stores, or atomics
+    bool early_fragment_tests = false;  // layout(early_fragment_tests) forces early tests anyway
+
+    bool early_z() const {
+        return early_fragment_tests || !(uses_discard || writes_depth || has_side_effects);
+    }
+    // bytes per vertex or instance with the vertex formats, and with unpacked float attributes
+    int vertex_struct_size(bool per_instance, bool packed) const {
+        int size = 0;
+        for (const attr_t& attr: inputs) {
+            if ((attr.slot >= 0) && (attr.per_instance == per_instance)) {
+                size += packed ? vertex_format_t::byte_size(attr.vertex_format()) : (4 * attr.num_components);
+            }
+        }
+        return size;
+    }
 };
 
 /* result of a spirv-cross compilation */
 struct spirvcross_source_t {
     bool valid = false;
+    bool loop_fallback = false;     // GLSL100: translated from the conservatively optimized SPIRV
     int snippet_index = -1;
     std::string source_code;
     spirvcross_refl_t refl;
+    std::vector<uniform_block_t> uncompacted_uniform_blocks;    // the full layouts of compacted uniform blocks
 };
 
 /* spirv-cross wrapper */
@@ -464,6 +892,8 @@ struct spirvcross_t {
     static spirvcross_t translate(const input_t& inp, const spirv_t& spirv, slang_t::type_t slang);
     int find_source_by_snippet_index(int snippet_index) const;
     void write_reflection_info(FILE* stream, const spirvcross_source_t& source, const std::string& indent) const;
+    void report(const input_t& inp, slang_t::type_t slang) const;
+    void report_vertex_structs(const input_t& inp) const;
     void dump_debug(FILE* stream, errmsg_t::msg_format_t err_fmt, slang_t::type_t slang) const;
 };
 
@@ -483,14 +913,69 @@ struct bytecode_t {
     void dump_debug() const;
 };
 
+/* a unique shader payload (source code or bytecode), shared by all shaders with identical content */
+struct payload_t {
+    bool is_bytecode = false;
+    uint64_t hash = 0;              // 64-bit FNV-1a hash over data
+    std::vector<uint8_t> data;      // bytecode, or source code including the terminating zero
+    std::string c_name;             // name of the data array in generated code
+    slang_t::type_t slang = slang_t::NUM;   // shader language of first use
+    int snippet_index = -1;         // snippet of first use
+    uint32_t slang_mask = 0;        // all shader languages using this payload
+    int num_refs = 0;
+    std::vector<uint8_t> compressed;    // LZ4-block compressed data (only with --compress)
+};
+
+/* deduplicated payloads of all shaders in all shader languages */
+struct payloads_t {
+    std::vector<payload_t> items;
+    std::array<std::map<int,int>, slang_t::NUM> snippet_payloads;   // per slang: snippet index => payload index
+    size_t total_size = 0;          // accumulated payload size before deduplication
+    size_t unique_size = 0;         // accumulated payload size after deduplication
+    size_t compressed_size = 0;     // accumulated payload size after compression
+    double decode_throughput = 0.0; // decompression speed in MBytes/sec
+
+    static payloads_t gather(const args_t& args, const input_t& inp, const std::array<spirvcross_t,slang_t::NUM>& spirvcross, const std::array<bytecode_t,slang_t::NUM>& bytecode);
+    int find_payload_index(slang_t::type_t slang, int snippet_index) const;
+    const payload_t& find_payload(slang_t::type_t slang, int snippet_index) const;
+    uint64_t program_hash(const input_t& inp, const program_t& prog, slang_t::type_t slang) const;
+    uint64_t module_hash(const args_t& args, const input_t& inp) const;
+    errmsg_t compress(const input_t& inp);
+    void report() const;
+};
+
+/* shader source code minifier (--minify) */
+struct minify_t {
+    static void minify(const args_t& args, spirvcross_t& spirvcross, slang_t::type_t slang);
+};
+
+/* in-tree LZ4-block compressor and decompressor for shader payloads */
+struct lz_t {
+    static std::vector<uint8_t> compress(const uint8_t* src, size_t src_size);
+    static std::vector<uint8_t> compress(const std::vector<uint8_t>& src);
+    static bool decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size);
+    static const char* c_decoder_source();
+};
+
 /* C header-generator for sokol_gfx.h */
 struct sokol_t {
-    static errmsg_t gen(const args_t& args, const input_t& inp, const std::array<spirvcross_t,slang_t::NUM>& spirvcross, const std::array<bytecode_t,slang_t::NUM>& bytecode);
+    static errmsg_t gen(const args_t& args, const input_t& inp, const std::array<spirvcross_t,slang_t::NUM>& spirvcross, const std::array<bytecode_t,slang_t::NUM>& bytecode, const payloads_t& payloads);
 };
 
 /* bare format generator */
 struct bare_t {
-    static errmsg_t gen(const args_t& args, const input_t& inp, const std::array<spirvcross_t,slang_t::NUM>& spirvcross, const std::array<bytecode_t,slang_t::NUM>& bytecode);
+    static errmsg_t gen(const args_t& args, const input_t& inp, const std::array<spirvcross_t,slang_t::NUM>& spirvcross, const std::array<bytecode_t,slang_t::NUM>& bytecode, const payloads_t& payloads);
+};
+
+/* binary shader pack generator (single mmap-able file plus C loader header) */
+struct pack_t {
+    static errmsg_t gen(const args_t& args, const input_t& inp, const std::array<spirvcross_t,slang_t::NUM>& spirvcross, const payloads_t& payloads);
+    static errmsg_t gen_reflection(const args_t& args, const input_t& inp, const std::array<spirvcross_t,slang_t::NUM>& spirvcross, const payloads_t& payloads, const std::string& path);
+};
+
+/* reflection info generator (JSON or binary) */
+struct reflection_t {
+    static errmsg_t gen(const args_t& args, const input_t& inp, const std::array<spirvcross_t,slang_t::NUM>& spirvcross, const payloads_t& payloads);
 };
 
 /* utility functions for generators */
@@ -507,4 +992,13 @@ struct output_t {
     static errmsg_t check_errors(const input_t& inp, const spirvcross_t& spirvcross, slang_t::type_t slang);
 };
 
+uint64_t hash64(const void* ptr, size_t num_bytes);
+int roundup(int val, int round_to);
+const char* img_type_to_sokol_type_str(image_t::type_t type);
+const char* img_basetype_to_sokol_samplertype_str(image_t::basetype_t basetype);
+const uniform_block_t* find_uniform_block(const spirvcross_refl_t& refl, int slot);
+const image_t* find_image(const spirvcross_refl_t& refl, int slot);
+const char* sokol_define(slang_t::type_t slang);
+const char* sokol_backend(slang_t::type_t slang);
+
 } // namespace shdc
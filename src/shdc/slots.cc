@@ -0,0 +1,322 @@
+/*
+    Stable bind slots (--stable-slots and --slot-map): by default, the
+    uniform blocks and images of each shader get their bind slots in
+    declaration order, so the same uniform block or image may end up at
+    different slots in different programs. With stable slots, each uniform
+    block and image name gets one bind slot which is used by all shaders.
+
+    Slots are allocated greedily in order of first use: a name gets the lowest
+    slot which isn't taken by another name in any shader which uses both
+    names (so names which never meet in a shader stage may share a slot).
+    Because sokol-gfx requires continuous bind slots in each shader stage,
+    a name must get a slot below the number of names of its shader (shaders
+    with fewer names are allocated first), and an error is reported if that
+    isn't possible.
+    With --slot-map, the existing assignments are loaded from a text file
+    and the new assignments are merged back into the file under a lock, so
+    that several modules share the same slots, even when they are compiled
+    in parallel:
+
+        # uniform blocks and images with their bind slot
+        ub vs_params 0
+        img tex 1
+*/
+#include "shdc.h"
+#include "fmt/format.h"
+#include "pystring.h"
+#include <stdio.h>
+#include <set>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+namespace shdc {
+
+using namespace spirv_cross;
+
+enum slots_kind_t {
+    SLOTS_UB = 0,
+    SLOTS_IMG = 1,
+};
+
+/* the uniform block and image names used by a vertex or fragment shader */
+struct slots_shader_t {
+    int snippet_index = -1;
+    std::set<std::string> names[2];     // indexed by slots_kind_t
+};
+
+// wait up to 10 seconds for the slot map lock
+static const int slot_map_lock_retries = 1000;
+static const int slot_map_lock_delay_ms = 10;
+
+static const char* slots_kind_str(int kind) {
+    return (kind == SLOTS_UB) ? "uniform block" : "image";
+}
+
+static void gather_names(const std::vector<uint32_t>& bytecode, slots_shader_t& shader) {
+    if (bytecode.empty()) {
+        return;
+    }
+    Compiler compiler(bytecode);
+    ShaderResources res = compiler.get_shader_resources();
+    for (const Resource& ub_res: res.uniform_buffers) {
+        shader.names[SLOTS_UB].insert(ub_res.name);
+    }
+    for (const Resource& img_res: res.sampled_images) {
+        shader.names[SLOTS_IMG].insert(img_res.name);
+    }
+}
+
+static errmsg_t load_slot_map(const std::string& path, std::map<std::string, int>* slots) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) {
+        // a missing slot map file is created
+        return errmsg_t();
+    }
+    std::string content;
+    char buf[4096];
+    size_t num_bytes;
+    while ((num_bytes = fread(buf, 1, sizeof(buf), f)) > 0) {
+        content.append(buf, num_bytes);
+    }
+    fclose(f);
+    std::vector<std::string> lines;
+    pystring::splitlines(content, lines);
+    std::vector<std::string> tokens;
+    for (int line_index = 0; line_index < (int)lines.size(); line_index++) {
+        pystring::split(lines[line_index], tokens);
+        if (tokens.empty() || (tokens[0][0] == '#')) {
+            continue;
+        }
+        int kind = -1;
+        if (tokens[0] == "ub") {
+            kind = SLOTS_UB;
+        }
+        else if (tokens[0] == "img") {
+            kind = SLOTS_IMG;
+        }
+        if ((tokens.size() != 3) || (kind < 0) || !pystring::isdigit(tokens[2])) {
+            return errmsg_t::error(path, line_index, "invalid slot map line (must be 'ub [name] [slot]' or 'img [name] [slot]')");
+        }
+        if (slots[kind].count(tokens[1]) > 0) {
+            return errmsg_t::error(path, line_index, fmt::format("{} '{}' is already in the slot map", slots_kind_str(kind), tokens[1]));
+        }
+        slots[kind][tokens[1]] = atoi(tokens[2].c_str());
+    }
+    return errmsg_t();
+}
+
+/* the slot map file is locked by creating a lock file next to it, so that
+    modules which are compiled in parallel with the same slot map don't
+    overwrite each other's new assignments
+*/
+static errmsg_t lock_slot_map(const std::string& path, const std::string& lock_path) {
+    for (int i = 0; i < slot_map_lock_retries; i++) {
+        // 'x' fails if the file exists (C11)
+        FILE* f = fopen(lock_path.c_str(), "wx");
+        if (f) {
+            fclose(f);
+            return errmsg_t();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(slot_map_lock_delay_ms));
+    }
+    return errmsg_t::error(path, 0, fmt::format("failed to lock slot map file '{}' (delete '{}' if no other sokol-shdc is running)", path, lock_path));
+}
+
+static void unlock_slot_map(const std::string& lock_path) {
+    remove(lock_path.c_str());
+}
+
+static bool replace_file(const std::string& src_path, const std::string& dst_path) {
+    #if defined(_WIN32)
+    return MoveFileExA(src_path.c_str(), dst_path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+    #else
+    return rename(src_path.c_str(), dst_path.c_str()) == 0;
+    #endif
+}
+
+static errmsg_t write_slot_map(const std::string& path, const std::map<std::string, int>* slots) {
+    // write into a temporary file which replaces the slot map, so that
+    // a failed write never leaves a truncated slot map behind
+    const std::string tmp_path = path + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "w");
+    if (!f) {
+        return errmsg_t::error(path, 0, fmt::format("failed to write slot map file '{}'", tmp_path));
+    }
+    fmt::print(f, "# sokol-shdc bind slot map: uniform blocks and images with their bind slot\n");
+    for (const auto& item: slots[SLOTS_UB]) {
+        fmt::print(f, "ub {} {}\n", item.first, item.second);
+    }
+    for (const auto& item: slots[SLOTS_IMG]) {
+        fmt::print(f, "img {} {}\n", item.first, item.second);
+    }
+    const bool write_failed = ferror(f) != 0;
+    if ((fclose(f) != 0) || write_failed || !replace_file(tmp_path, path)) {
+        remove(tmp_path.c_str());
+        return errmsg_t::error(path, 0, fmt::format("failed to write slot map file '{}'", path));
+    }
+    return errmsg_t();
+}
+
+/* merge the new assignments into the current content of the slot map
+    (which may have been updated by another module since it was loaded),
+    and write the result back
+*/
+static errmsg_t save_slot_map(const std::string& path, const std::map<std::string, int>* slots) {
+    const std::string lock_path = path + ".lock";
+    errmsg_t err = lock_slot_map(path, lock_path);
+    if (err.valid) {
+        return err;
+    }
+    std::map<std::string, int> merged[2];
+    err = load_slot_map(path, merged);
+    for (int kind = 0; (kind < 2) && !err.valid; kind++) {
+        for (const auto& item: slots[kind]) {
+            const auto it = merged[kind].find(item.first);
+            if (it == merged[kind].end()) {
+                merged[kind][item.first] = item.second;
+            }
+            else if (it->second != item.second) {
+                err = errmsg_t::error(path, 0, fmt::format("{} '{}' got bind slot {} in the slot map by another module while this module was compiled, compile this module again",
+                    slots_kind_str(kind), item.first, it->second));
+            }
+        }
+    }
+    if (!err.valid) {
+        err = write_slot_map(path, merged);
+    }
+    unlock_slot_map(lock_path);
+    return err;
+}
+
+/* the slots of all names of another shader which share a name with a shader
+    (these can't be used for the shader's new names), the slots of the shader's
+    own names are included
+*/
+static std::set<int> slots_taken(const std::vector<slots_shader_t>& shaders, const std::string& name, int kind, const std::map<std::string, int>& slots) {
+    std::set<int> taken;
+    for (const slots_shader_t& other: shaders) {
+        if (other.names[kind].count(name) > 0) {
+            for (const std::string& other_name: other.names[kind]) {
+                if (slots.count(other_name) > 0) {
+                    taken.insert(slots.at(other_name));
+                }
+            }
+        }
+    }
+    return taken;
+}
+
+/* assign a slot to each name which doesn't have one yet, sokol-gfx requires
+    the uniform blocks and images of a shader stage in continuous slots
+    starting at 0, so the new names of a shader fill the slots below the
+    number of names in the shader which are not yet taken, finally check
+    that the names of each shader have different and continuous slots
+*/
+static errmsg_t assign_slots(const args_t& args, const input_t& inp, const std::vector<slots_shader_t>& shaders, int kind, int max_slots, std::map<std::string, int>& slots, int& out_num_new) {
+    // shaders with fewer names first, so that names which are used alone get the low slots
+    std::vector<slots_shader_t> sorted_shaders = shaders;
+    std::stable_sort(sorted_shaders.begin(), sorted_shaders.end(), [kind](const slots_shader_t& a, const slots_shader_t& b) {
+        return a.names[kind].size() < b.names[kind].size();
+    });
+    for (const slots_shader_t& shader: sorted_shaders) {
+        const int num_names = (int)shader.names[kind].size();
+        for (const std::string& name: shader.names[kind]) {
+            if (slots.count(name) > 0) {
+                continue;
+            }
+            const std::set<int> taken = slots_taken(shaders, name, kind, slots);
+            int slot = 0;
+            while ((slot < num_names) && (taken.count(slot) > 0)) {
+                slot++;
+            }
+            if (slot >= std::min(num_names, max_slots)) {
+                const snippet_t& snippet = inp.snippets[shader.snippet_index];
+                return inp.error(snippet.lines[0], fmt::format("no free {} bind slot for '{}' in '{}' which keeps the bind slots continuous in all shader stages (max {} per shader stage)",
+                    slots_kind_str(kind), name, snippet.name, max_slots));
+            }
+            slots[name] = slot;
+            out_num_new++;
+        }
+    }
+    for (const slots_shader_t& shader: shaders) {
+        const snippet_t& snippet = inp.snippets[shader.snippet_index];
+        std::map<int, std::string> names_by_slot;
+        for (const std::string& name: shader.names[kind]) {
+            const int slot = slots.at(name);
+            if (slot >= max_slots) {
+                return inp.error(snippet.lines[0], fmt::format("{} '{}' in '{}' has bind slot {} in slot map '{}' (max {} per shader stage)",
+                    slots_kind_str(kind), name, snippet.name, slot, args.slot_map, max_slots));
+            }
+            if (names_by_slot.count(slot) > 0) {
+                return inp.error(snippet.lines[0], fmt::format("{}s '{}' and '{}' in '{}' both have bind slot {} in slot map '{}'",
+                    slots_kind_str(kind), names_by_slot.at(slot), name, snippet.name, slot, args.slot_map));
+            }
+            names_by_slot[slot] = name;
+        }
+        // the slots are continuous if the highest slot is the number of names - 1
+        if (!names_by_slot.empty() && (names_by_slot.rbegin()->first != ((int)names_by_slot.size() - 1))) {
+            return inp.error(snippet.lines[0], fmt::format("{} bind slots of '{}' are not continuous ('{}' has bind slot {}, but there are only {} {}s), use different {} names in this shader or remove them from the slot map",
+                slots_kind_str(kind), snippet.name, names_by_slot.rbegin()->second, names_by_slot.rbegin()->first, names_by_slot.size(), slots_kind_str(kind), slots_kind_str(kind)));
+        }
+    }
+    return errmsg_t();
+}
+
+errmsg_t slots_t::allocate(const args_t& args, input_t& inp, const std::array<spirv_t,slang_t::NUM>& spirv) {
+    std::map<std::string, int> slots[2];
+    if (!args.slot_map.empty()) {
+        errmsg_t err = load_slot_map(args.slot_map, slots);
+        if (err.valid) {
+            return err;
+        }
+    }
+
+    // the uniform block and image names of each shader in all shader languages,
+    // the full uniform blocks of compacted uniform blocks are reflected at the same slot
+    std::vector<slots_shader_t> shaders;
+    for (int snippet_index = 0; snippet_index < (int)inp.snippets.size(); snippet_index++) {
+        slots_shader_t shader;
+        shader.snippet_index = snippet_index;
+        for (const spirv_t& slang_spirv: spirv) {
+            const int blob_index = slang_spirv.find_blob_by_snippet_index(snippet_index);
+            if (blob_index >= 0) {
+                gather_names(slang_spirv.blobs[blob_index].bytecode, shader);
+                gather_names(slang_spirv.blobs[blob_index].uncompacted_bytecode, shader);
+            }
+        }
+        if (!shader.names[SLOTS_UB].empty() || !shader.names[SLOTS_IMG].empty()) {
+            shaders.push_back(shader);
+        }
+    }
+
+    int num_new_ubs = 0;
+    int num_new_imgs = 0;
+    errmsg_t err = assign_slots(args, inp, shaders, SLOTS_UB, uniform_block_t::NUM, slots[SLOTS_UB], num_new_ubs);
+    if (err.valid) {
+        return err;
+    }
+    err = assign_slots(args, inp, shaders, SLOTS_IMG, image_t::NUM, slots[SLOTS_IMG], num_new_imgs);
+    if (err.valid) {
+        return err;
+    }
+    inp.ub_slots = slots[SLOTS_UB];
+    inp.img_slots = slots[SLOTS_IMG];
+
+    if (!args.slot_map.empty() && ((num_new_ubs > 0) || (num_new_imgs > 0))) {
+        err = save_slot_map(args.slot_map, slots);
+        if (err.valid) {
+            return err;
+        }
+        if (args.report) {
+            fmt::print("sokol-shdc: slot map '{}' updated: {} new uniform blocks, {} new images\n", args.slot_map, num_new_ubs, num_new_imgs);
+        }
+    }
+    return errmsg_t();
+}
+
+} // namespace shdc
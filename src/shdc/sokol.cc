@@ -5,6 +5,9 @@
 #include "fmt/format.h"
 #include "pystring.h"
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <set>
 
 namespace shdc {
 
@@ -38,73 +41,33 @@ static int uniform_type_size(uniform_t::type_t type) {
     }
 }
 
-static int roundup(int val, int round_to) {
-    return (val + (round_to - 1)) & ~(round_to - 1);
+/* the vertex shaders with @format or @instance annotations, which get packed vertex- and instance-structs */
+static bool has_vertex_struct(const input_t& inp, const spirvcross_source_t& src) {
+    const snippet_t& snippet = inp.snippets[src.snippet_index];
+    return (src.refl.stage == stage_t::VS) && (snippet.base_index < 0) && (!snippet.attr_formats.empty() || !snippet.instance_attrs.empty());
 }
 
-static const char* img_type_to_sokol_type_str(image_t::type_t type) {
-    switch (type) {
-        case image_t::IMAGE_TYPE_2D:    return "SG_IMAGETYPE_2D";
-        case image_t::IMAGE_TYPE_CUBE:  return "SG_IMAGETYPE_CUBE";
-        case image_t::IMAGE_TYPE_3D:    return "SG_IMAGETYPE_3D";
-        case image_t::IMAGE_TYPE_ARRAY: return "SG_IMAGETYPE_ARRAY";
-        default: return "INVALID";
-    }
-}
-
-static const char* img_basetype_to_sokol_samplertype_str(image_t::basetype_t basetype) {
-    switch (basetype) {
-        case image_t::IMAGE_BASETYPE_FLOAT: return "SG_SAMPLERTYPE_FLOAT";
-        case image_t::IMAGE_BASETYPE_SINT:  return "SG_SAMPLERTYPE_SINT";
-        case image_t::IMAGE_BASETYPE_UINT:  return "SG_SAMPLERTYPE_UINT";
-        default: return "INVALID";
-    }
-}
-
-static const uniform_block_t* find_uniform_block(const spirvcross_refl_t& refl, int slot) {
-    for (const uniform_block_t& ub: refl.uniform_blocks) {
-        if (ub.slot == slot) {
-            return &ub;
-        }
-    }
-    return nullptr;
-}
-
-static const image_t* find_image(const spirvcross_refl_t& refl, int slot) {
-    for (const image_t& img: refl.images) {
-        if (img.slot == slot) {
-            return &img;
+static bool has_vertex_structs(const input_t& inp, const spirvcross_t& spirvcross) {
+    for (const spirvcross_source_t& src: spirvcross.sources) {
+        if (has_vertex_struct(inp, src)) {
+            return true;
         }
     }
-    return nullptr;
+    return false;
 }
 
-static const char* sokol_define(slang_t::type_t slang) {
-    switch (slang) {
-        case slang_t::GLSL330:      return "SOKOL_GLCORE33";
-        case slang_t::GLSL100:      return "SOKOL_GLES2";
-        case slang_t::GLSL300ES:    return "SOKOL_GLES3";
-        case slang_t::HLSL5:        return "SOKOL_D3D11";
-        case slang_t::METAL_MACOS:  return "SOKOL_METAL";
-        case slang_t::METAL_IOS:    return "SOKOL_METAL";
-        case slang_t::METAL_SIM:    return "SOKOL_METAL";
-        case slang_t::WGPU:         return "SOKOL_WGPU";
-        default: return "<INVALID>";
+/* the vertex buffer slot of the per-vertex or per-instance attributes, or -1 if there are none,
+    the per-vertex attributes come first
+*/
+static int vertex_buffer_slot(const spirvcross_refl_t& refl, bool per_instance) {
+    const bool has_vertex_attrs = refl.vertex_struct_size(false, true) > 0;
+    if (!per_instance) {
+        return has_vertex_attrs ? 0 : -1;
     }
-}
-
-static const char* sokol_backend(slang_t::type_t slang) {
-    switch (slang) {
-        case slang_t::GLSL330:      return "SG_BACKEND_GLCORE33";
-        case slang_t::GLSL100:      return "SG_BACKEND_GLES2";
-        case slang_t::GLSL300ES:    return "SG_BACKEND_GLES3";
-        case slang_t::HLSL5:        return "SG_BACKEND_D3D11";
-        case slang_t::METAL_MACOS:  return "SG_BACKEND_METAL_MACOS";
-        case slang_t::METAL_IOS:    return "SG_BACKEND_METAL_IOS";
-        case slang_t::METAL_SIM:    return "SG_BACKEND_METAL_SIMULATOR";
-        case slang_t::WGPU:         return "SG_BACKEND_WGPU";
-        default: return "<INVALID>";
+    else if (refl.vertex_struct_size(true, true) > 0) {
+        return has_vertex_attrs ? 1 : 0;
     }
+    return -1;
 }
 
 static void write_header(const args_t& args, const input_t& inp, const spirvcross_t& spirvcross) {
@@ -124,14 +87,44 @@ static void write_header(const args_t& args, const input_t& inp, const spirvcros
         const spirvcross_source_t& fs_src = spirvcross.sources[fs_src_index];
         L("        Shader program '{}':\n", prog.name);
         L("            Get shader desc: {}{}_shader_desc()\n", mod_prefix(inp), prog.name);
+        L("            Get shader desc by name: {}shader_desc_by_name(\"{}\")\n", mod_prefix(inp), prog.name);
+        L("            Get shader desc by hash: {}shader_desc_by_hash(PROG_HASH_{}{})\n", mod_prefix(inp), mod_prefix(inp), prog.name);
+        L("            Get content hash: {}{}_shader_hash()\n", mod_prefix(inp), prog.name);
+        if (!prog.variant_map.empty()) {
+            std::vector<std::string> masks;
+            for (const variant_t& variant: prog.variants) {
+                masks.push_back(fmt::format("VARIANT_{}{}_{}_{}", mod_prefix(inp), prog.name, variant.name, variant.values.back()));
+            }
+            std::set<std::string> unique;
+            for (const auto& variant_item: prog.variant_map) {
+                unique.insert(variant_item.second);
+            }
+            L("            Get shader desc of a variant: {}{}_shader_desc_variant({})\n", mod_prefix(inp), prog.name, pystring::join(" | ", masks));
+            L("            Variants: {} permutations, {} unique programs\n", prog.variant_map.size(), unique.size());
+        }
         L("            Vertex shader: {}\n", prog.vs_name);
         L("                Attribute slots:\n");
-        const snippet_t& vs_snippet = inp.snippets[vs_src.snippet_index];
+        // vertex shader copies specialized by the link step share the attribute slots of the original
+        const int vs_base_index = inp.snippets[vs_src.snippet_index].base_index;
+        const snippet_t& vs_snippet = inp.snippets[(vs_base_index >= 0) ? vs_base_index : vs_src.snippet_index];
         for (const attr_t& attr: vs_src.refl.inputs) {
             if (attr.slot >= 0) {
                 L("                    ATTR_{}{}_{} = {}\n", mod_prefix(inp), vs_snippet.name, attr.name, attr.slot);
             }
         }
+        if (!vs_snippet.attr_formats.empty() || !vs_snippet.instance_attrs.empty()) {
+            if (vertex_buffer_slot(vs_src.refl, false) >= 0) {
+                L("                Vertex struct: {}{}_vertex_t ({} bytes per vertex, {} bytes unpacked) in buffer slot VERTEX_BUFFER_{}{} = {}\n",
+                    mod_prefix(inp), vs_snippet.name, vs_src.refl.vertex_struct_size(false, true), vs_src.refl.vertex_struct_size(false, false),
+                    mod_prefix(inp), vs_snippet.name, vertex_buffer_slot(vs_src.refl, false));
+            }
+            if (vertex_buffer_slot(vs_src.refl, true) >= 0) {
+                L("                Instance struct: {}{}_instance_t ({} bytes per instance, {} bytes unpacked) in buffer slot INSTANCE_BUFFER_{}{} = {}\n",
+                    mod_prefix(inp), vs_snippet.name, vs_src.refl.vertex_struct_size(true, true), vs_src.refl.vertex_struct_size(true, false),
+                    mod_prefix(inp), vs_snippet.name, vertex_buffer_slot(vs_src.refl, true));
+            }
+            L("                Vertex layout: {}{}_vertex_layout()\n", mod_prefix(inp), vs_snippet.name);
+        }
         for (const uniform_block_t& ub: vs_src.refl.uniform_blocks) {
             L("                Uniform block '{}':\n", ub.name);
             L("                    C struct: {}{}_t\n", mod_prefix(inp), ub.name);
@@ -155,6 +148,28 @@ static void write_header(const args_t& args, const input_t& inp, const spirvcros
             L("                    Component Type: {}\n", img_basetype_to_sokol_samplertype_str(img.base_type));
             L("                    Bind slot: SLOT_{}{} = {}\n", mod_prefix(inp), img.name, img.slot);
         }
+        if (fs_src.refl.early_z()) {
+            L("                Early-Z: yes ({}{}_FS_EARLY_Z)\n", mod_prefix(inp), prog.name);
+        }
+        else {
+            std::vector<std::string> blockers;
+            if (fs_src.refl.uses_discard) {
+                blockers.push_back("discard");
+            }
+            if (fs_src.refl.writes_depth) {
+                blockers.push_back("depth write");
+            }
+            if (fs_src.refl.has_side_effects) {
+                blockers.push_back("side effects");
+            }
+            L("                Early-Z: no, {} ({}{}_FS_EARLY_Z)\n", pystring::join(", ", blockers), mod_prefix(inp), prog.name);
+        }
+        if (fs_src.refl.sample_shading) {
+            L("                Sample rate shading ({}{}_FS_SAMPLE_SHADING)\n", mod_prefix(inp), prog.name);
+        }
+        if (!prog.shared_ubs.empty()) {
+            L("            Apply the same data in both stages to: {} ({}{}_SHARED_UNIFORMS)\n", pystring::join(", ", prog.shared_ubs), mod_prefix(inp), prog.name);
+        }
         L("\n");
     }
     L("\n");
@@ -164,9 +179,35 @@ static void write_header(const args_t& args, const input_t& inp, const spirvcros
         L("        sg_shader {} = sg_make_shader({}{}_shader_desc());\n", prog.name, mod_prefix(inp), prog.name);
     }
     L("\n");
+    L("    Create all shaders up front (e.g. during a loading screen), ordered\n");
+    L("    by @program priority, either all at once or in batches:\n\n");
+    L("        sg_shader* shaders = calloc({}prewarm_count(), sizeof(sg_shader));\n", mod_prefix(inp));
+    L("        int num = {}prewarm_shaders(shaders, first, max_count);\n\n", mod_prefix(inp));
+    L("    The shader for a program is then found at shaders[PREWARM_[program]].\n");
+    L("\n");
     for (const spirvcross_source_t& src: spirvcross.sources) {
-        if (src.refl.stage == stage_t::VS) {
+        if ((src.refl.stage == stage_t::VS) && (inp.snippets[src.snippet_index].base_index < 0)) {
             const snippet_t& vs_snippet = inp.snippets[src.snippet_index];
+            if (has_vertex_struct(inp, src)) {
+                L("    Packed vertex structs and vertex layout for vertex shader '{}':\n\n", vs_snippet.name);
+                if (vertex_buffer_slot(src.refl, false) >= 0) {
+                    L("        {}{}_vertex_t vertices[] = {{ ... }};\n", mod_prefix(inp), vs_snippet.name);
+                }
+                if (vertex_buffer_slot(src.refl, true) >= 0) {
+                    L("        {}{}_instance_t instances[] = {{ ... }};\n", mod_prefix(inp), vs_snippet.name);
+                }
+                L("        sg_pipeline pip = sg_make_pipeline(&(sg_pipeline_desc){{\n");
+                L("            .layout = {}{}_vertex_layout(),\n", mod_prefix(inp), vs_snippet.name);
+                L("            ...}});\n");
+                if (vertex_buffer_slot(src.refl, false) >= 0) {
+                    L("        bindings.vertex_buffers[VERTEX_BUFFER_{}{}] = vertex_buffer;\n", mod_prefix(inp), vs_snippet.name);
+                }
+                if (vertex_buffer_slot(src.refl, true) >= 0) {
+                    L("        bindings.vertex_buffers[INSTANCE_BUFFER_{}{}] = instance_buffer;\n", mod_prefix(inp), vs_snippet.name);
+                }
+                L("\n");
+                continue;
+            }
             L("    Vertex attribute locations for vertex shader '{}':\n\n", vs_snippet.name);
             L("        sg_pipeline pip = sg_make_pipeline(&(sg_pipeline_desc){{\n");
             L("            .layout = {{\n");
@@ -189,23 +230,50 @@ static void write_header(const args_t& args, const input_t& inp, const spirvcros
     L("\n");
     for (const uniform_block_t& ub: spirvcross.unique_uniform_blocks) {
         L("    Bind slot and C-struct for uniform block '{}':\n\n", ub.name);
-        L("        {}{}_t {} = {{\n", mod_prefix(inp), ub.name, ub.name);
-        for (const uniform_t& uniform: ub.uniforms) {
-            L("            .{} = ...;\n", uniform.name);
-        };
-        L("        }};\n");
+        const bool has_hoisted = std::find_if(inp.hoisted.begin(), inp.hoisted.end(), [&ub](const hoisted_t& h) { return h.block == ub.name; }) != inp.hoisted.end();
+        if (has_hoisted) {
+            L("        {}{}_in_t {}_in = {{\n", mod_prefix(inp), ub.name, ub.name);
+            for (const uniform_t& uniform: ub.uniforms) {
+                if (std::find_if(inp.hoisted.begin(), inp.hoisted.end(), [&ub, &uniform](const hoisted_t& h) { return (h.block == ub.name) && (h.name == uniform.name); }) == inp.hoisted.end()) {
+                    L("            .{} = ...;\n", uniform.name);
+                }
+            }
+            L("        }};\n");
+            L("        {}{}_t {};\n", mod_prefix(inp), ub.name, ub.name);
+            L("        {}{}_prepare(&{}_in, &{});   // computes the uniform-only expressions hoisted out of the shaders\n", mod_prefix(inp), ub.name, ub.name, ub.name);
+        }
+        else if (ub.base_name.empty()) {
+            L("        {}{}_t {} = {{\n", mod_prefix(inp), ub.name, ub.name);
+            for (const uniform_t& uniform: ub.uniforms) {
+                L("            .{} = ...;\n", uniform.name);
+            };
+            L("        }};\n");
+        }
+        else {
+            L("        {}{}_t {};\n", mod_prefix(inp), ub.name, ub.name);
+            L("        {}{}_pack(&{}, &{});   // only the members of '{}' which are used by the shader\n", mod_prefix(inp), ub.name, ub.name, ub.base_name, ub.base_name);
+        }
         L("        sg_apply_uniforms(SG_SHADERSTAGE_[VS|FS], SLOT_{}{}, &{}, sizeof({}));\n", mod_prefix(inp), ub.name, ub.name, ub.name);
         L("\n");
     }
     L("*/\n");
     L("#include <stdint.h>\n");
     L("#include <stdbool.h>\n");
+    if (has_vertex_structs(inp, spirvcross)) {
+        L("#include <stddef.h>\n");
+    }
+    if (args.compact_uniforms || args.hoist_uniforms || has_vertex_structs(inp, spirvcross)) {
+        L("#include <string.h>\n");
+    }
+    if (args.hoist_uniforms) {
+        L("#include <math.h>\n");
+    }
 }
 
 static void write_vertex_attrs(const input_t& inp, const spirvcross_t& spirvcross) {
     // vertex attributes
     for (const spirvcross_source_t& src: spirvcross.sources) {
-        if (src.refl.stage == stage_t::VS) {
+        if ((src.refl.stage == stage_t::VS) && (inp.snippets[src.snippet_index].base_index < 0)) {
             const snippet_t& vs_snippet = inp.snippets[src.snippet_index];
             for (const attr_t& attr: src.refl.inputs) {
                 if (attr.slot >= 0) {
@@ -216,12 +284,157 @@ static void write_vertex_attrs(const input_t& inp, const spirvcross_t& spirvcros
     }
 }
 
+/* a tightly packed struct with the per-vertex or per-instance attributes,
+    all vertex formats are multiples of 4 bytes, so no padding is needed
+*/
+static void write_vertex_struct(const input_t& inp, const snippet_t& vs_snippet, const spirvcross_refl_t& refl, bool per_instance) {
+    const char* kind = per_instance ? "instance" : "vertex";
+    L("typedef struct {}{}_{}_t {{\n", mod_prefix(inp), vs_snippet.name, kind);
+    for (const attr_t& attr: refl.inputs) {
+        if ((attr.slot >= 0) && (attr.per_instance == per_instance)) {
+            const vertex_format_t::type_t fmt = attr.vertex_format();
+            if (vertex_format_t::num_components(fmt) == 1) {
+                L("    {} {};\n", vertex_format_t::c_type(fmt), attr.name);
+            }
+            else {
+                L("    {} {}[{}];\n", vertex_format_t::c_type(fmt), attr.name, vertex_format_t::num_components(fmt));
+            }
+        }
+    }
+    L("}} {}{}_{}_t;\n", mod_prefix(inp), vs_snippet.name, kind);
+    L("#define {}_BUFFER_{}{} ({})\n", pystring::upper(kind), mod_prefix(inp), vs_snippet.name, vertex_buffer_slot(refl, per_instance));
+}
+
+/* packed vertex- and instance-structs for vertex shaders with @format or @instance annotations */
+static void write_vertex_structs(const input_t& inp, const spirvcross_t& spirvcross) {
+    for (const spirvcross_source_t& src: spirvcross.sources) {
+        if (!has_vertex_struct(inp, src)) {
+            continue;
+        }
+        const snippet_t& vs_snippet = inp.snippets[src.snippet_index];
+        if (vertex_buffer_slot(src.refl, false) >= 0) {
+            write_vertex_struct(inp, vs_snippet, src.refl, false);
+        }
+        if (vertex_buffer_slot(src.refl, true) >= 0) {
+            write_vertex_struct(inp, vs_snippet, src.refl, true);
+        }
+        for (const attr_t& attr: src.refl.inputs) {
+            if (attr.slot >= 0) {
+                L("#define ATTR_FORMAT_{}{}_{} (SG_VERTEXFORMAT_{})\n", mod_prefix(inp), vs_snippet.name, attr.name,
+                    pystring::upper(vertex_format_t::to_str(attr.vertex_format())));
+            }
+        }
+    }
+}
+
+/* write the [vs]_vertex_layout() functions which return the sg_layout_desc for the packed vertex- and instance-structs */
+static void write_vertex_layout_funcs(const input_t& inp, const spirvcross_t& spirvcross, const std::string& func_prefix) {
+    for (const spirvcross_source_t& src: spirvcross.sources) {
+        if (!has_vertex_struct(inp, src)) {
+            continue;
+        }
+        const snippet_t& vs_snippet = inp.snippets[src.snippet_index];
+        L("{}sg_layout_desc {}{}_vertex_layout(void) {{\n", func_prefix, mod_prefix(inp), vs_snippet.name);
+        L("    sg_layout_desc layout;\n");
+        L("    memset(&layout, 0, sizeof(layout));\n");
+        if (vertex_buffer_slot(src.refl, false) >= 0) {
+            L("    layout.buffers[VERTEX_BUFFER_{}{}].stride = sizeof({}{}_vertex_t);\n", mod_prefix(inp), vs_snippet.name, mod_prefix(inp), vs_snippet.name);
+        }
+        if (vertex_buffer_slot(src.refl, true) >= 0) {
+            L("    layout.buffers[INSTANCE_BUFFER_{}{}].stride = sizeof({}{}_instance_t);\n", mod_prefix(inp), vs_snippet.name, mod_prefix(inp), vs_snippet.name);
+            L("    layout.buffers[INSTANCE_BUFFER_{}{}].step_func = SG_VERTEXSTEP_PER_INSTANCE;\n", mod_prefix(inp), vs_snippet.name);
+        }
+        for (const attr_t& attr: src.refl.inputs) {
+            if (attr.slot >= 0) {
+                const char* kind = attr.per_instance ? "instance" : "vertex";
+                L("    layout.attrs[ATTR_{}{}_{}].buffer_index = {}_BUFFER_{}{};\n",
+                    mod_prefix(inp), vs_snippet.name, attr.name, pystring::upper(kind), mod_prefix(inp), vs_snippet.name);
+                L("    layout.attrs[ATTR_{}{}_{}].offset = offsetof({}{}_{}_t, {});\n",
+                    mod_prefix(inp), vs_snippet.name, attr.name, mod_prefix(inp), vs_snippet.name, kind, attr.name);
+                L("    layout.attrs[ATTR_{}{}_{}].format = ATTR_FORMAT_{}{}_{};\n",
+                    mod_prefix(inp), vs_snippet.name, attr.name, mod_prefix(inp), vs_snippet.name, attr.name);
+            }
+        }
+        L("    return layout;\n");
+        L("}}\n");
+    }
+}
+
+/* per program, the fragment shader features which prevent early depth/stencil testing */
+static void write_early_z_flags(const input_t& inp, const spirvcross_t& spirvcross) {
+    for (const auto& item: inp.programs) {
+        const program_t& prog = item.second;
+        const int fs_src_index = spirvcross.find_source_by_snippet_index(inp.snippet_map.at(prog.fs_name));
+        assert(fs_src_index >= 0);
+        const spirvcross_refl_t& refl = spirvcross.sources[fs_src_index].refl;
+        L("#define {}{}_FS_USES_DISCARD ({})\n", mod_prefix(inp), prog.name, refl.uses_discard ? 1 : 0);
+        L("#define {}{}_FS_WRITES_DEPTH ({})\n", mod_prefix(inp), prog.name, refl.writes_depth ? 1 : 0);
+        L("#define {}{}_FS_SAMPLE_SHADING ({})\n", mod_prefix(inp), prog.name, refl.sample_shading ? 1 : 0);
+        L("#define {}{}_FS_SIDE_EFFECTS ({})\n", mod_prefix(inp), prog.name, refl.has_side_effects ? 1 : 0);
+        L("#define {}{}_FS_EARLY_Z ({})\n", mod_prefix(inp), prog.name, refl.early_z() ? 1 : 0);
+    }
+}
+
+/* per program, if @move_to_vs computations read uniform blocks in the vertex shader
+    which the application must fill with the same data in both shader stages
+*/
+static void write_shared_uniforms_flags(const input_t& inp) {
+    for (const auto& item: inp.programs) {
+        const program_t& prog = item.second;
+        L("#define {}{}_SHARED_UNIFORMS ({})\n", mod_prefix(inp), prog.name, prog.shared_ubs.empty() ? 0 : 1);
+    }
+}
+
 static void write_images_bind_slots(const input_t& inp, const spirvcross_t& spirvcross) {
     for (const image_t& img: spirvcross.unique_images) {
         L("#define SLOT_{}{} ({})\n", mod_prefix(inp), img.name, img.slot);
     }
 }
 
+static void write_uniform_member(const input_t& inp, const uniform_t& uniform) {
+    if (inp.type_map.count(uniform_type_str(uniform.type)) > 0) {
+        // user-provided type names
+        if (uniform.array_count == 1) {
+            L("    {} {};\n", inp.type_map.at(uniform_type_str(uniform.type)), uniform.name);
+        }
+        else {
+            L("    {} {}[{}];\n", inp.type_map.at(uniform_type_str(uniform.type)), uniform.name, uniform.array_count);
+        }
+    }
+    else {
+        // default type names (float)
+        if (uniform.array_count == 1) {
+            switch (uniform.type) {
+                case uniform_t::FLOAT:   L("    float {};\n", uniform.name); break;
+                case uniform_t::FLOAT2:  L("    float {}[2];\n", uniform.name); break;
+                case uniform_t::FLOAT3:  L("    float {}[3];\n", uniform.name); break;
+                case uniform_t::FLOAT4:  L("    float {}[4];\n", uniform.name); break;
+                case uniform_t::MAT4:    L("    float {}[16];\n", uniform.name); break;
+                default:                 L("    INVALID_UNIFORM_TYPE;\n"); break;
+            }
+        }
+        else {
+            switch (uniform.type) {
+                case uniform_t::FLOAT:   L("    float {}[{}];\n", uniform.name, uniform.array_count); break;
+                case uniform_t::FLOAT2:  L("    float {}[{}][2];\n", uniform.name, uniform.array_count); break;
+                case uniform_t::FLOAT3:  L("    float {}[{}][3];\n", uniform.name, uniform.array_count); break;
+                case uniform_t::FLOAT4:  L("    float {}[{}][4];\n", uniform.name, uniform.array_count); break;
+                case uniform_t::MAT4:    L("    float {}[{}][16];\n", uniform.name, uniform.array_count); break;
+                default:                 L("    INVALID_UNIFORM_TYPE;\n"); break;
+            }
+        }
+    }
+}
+
+static bool is_hoisted(const std::vector<const hoisted_t*>& hoisted, const uniform_t& uniform) {
+    for (const hoisted_t* h: hoisted) {
+        if (h->name == uniform.name) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static void write_uniform_blocks(const input_t& inp, const spirvcross_t& spirvcross, slang_t::type_t slang) {
     for (const uniform_block_t& ub: spirvcross.unique_uniform_blocks) {
         L("#define SLOT_{}{} ({})\n", mod_prefix(inp), ub.name, ub.slot);
@@ -234,38 +447,7 @@ static void write_uniform_blocks(const input_t& inp, const spirvcross_t& spirvcr
                 L("    uint8_t _pad_{}[{}];\n", cur_offset, next_offset - cur_offset);
                 cur_offset = next_offset;
             }
-            if (inp.type_map.count(uniform_type_str(uniform.type)) > 0) {
-                // user-provided type names
-                if (uniform.array_count == 1) {
-                    L("    {} {};\n", inp.type_map.at(uniform_type_str(uniform.type)), uniform.name);
-                }
-                else {
-                    L("    {} {}[{}];\n", inp.type_map.at(uniform_type_str(uniform.type)), uniform.name, uniform.array_count);
-                }
-            }
-            else {
-                // default type names (float)
-                if (uniform.array_count == 1) {
-                    switch (uniform.type) {
-                        case uniform_t::FLOAT:   L("    float {};\n", uniform.name); break;
-                        case uniform_t::FLOAT2:  L("    float {}[2];\n", uniform.name); break;
-                        case uniform_t::FLOAT3:  L("    float {}[3];\n", uniform.name); break;
-                        case uniform_t::FLOAT4:  L("    float {}[4];\n", uniform.name); break;
-                        case uniform_t::MAT4:    L("    float {}[16];\n", uniform.name); break;
-                        default:                 L("    INVALID_UNIFORM_TYPE;\n"); break;
-                    }
-                }
-                else {
-                    switch (uniform.type) {
-                        case uniform_t::FLOAT:   L("    float {}[{}];\n", uniform.name, uniform.array_count); break;
-                        case uniform_t::FLOAT2:  L("    float {}[{}][2];\n", uniform.name, uniform.array_count); break;
-                        case uniform_t::FLOAT3:  L("    float {}[{}][3];\n", uniform.name, uniform.array_count); break;
-                        case uniform_t::FLOAT4:  L("    float {}[{}][4];\n", uniform.name, uniform.array_count); break;
-                        case uniform_t::MAT4:    L("    float {}[{}][16];\n", uniform.name, uniform.array_count); break;
-                        default:                 L("    INVALID_UNIFORM_TYPE;\n"); break;
-                    }
-                }
-            }
+            write_uniform_member(inp, uniform);
             cur_offset += uniform_type_size(uniform.type) * uniform.array_count;
         }
         /* pad to multiple of 16-bytes struct size */
@@ -276,84 +458,172 @@ static void write_uniform_blocks(const input_t& inp, const spirvcross_t& spirvcr
         L("}} {}{}_t;\n", mod_prefix(inp), ub.name);
         L("#pragma pack(pop)\n");
     }
+    // packing functions from the full C struct into the C struct of compacted uniform blocks
+    for (const uniform_block_t& ub: spirvcross.unique_uniform_blocks) {
+        if (ub.base_name.empty()) {
+            continue;
+        }
+        L("static inline void {}{}_pack({}{}_t* dst, const {}{}_t* src) {{\n", mod_prefix(inp), ub.name, mod_prefix(inp), ub.name, mod_prefix(inp), ub.base_name);
+        for (const uniform_t& uniform: ub.uniforms) {
+            L("    memcpy(&dst->{}, &src->{}, sizeof(dst->{}));\n", uniform.name, uniform.name, uniform.name);
+        }
+        L("}}\n");
+    }
+    // input structs and prepare functions which compute the hoisted uniform-only expressions
+    for (const uniform_block_t& ub: spirvcross.unique_uniform_blocks) {
+        std::vector<const hoisted_t*> hoisted;
+        for (const hoisted_t& h: inp.hoisted) {
+            if (h.block == ub.name) {
+                hoisted.push_back(&h);
+            }
+        }
+        if (hoisted.empty()) {
+            continue;
+        }
+        L("typedef struct {}{}_in_t {{\n", mod_prefix(inp), ub.name);
+        for (const uniform_t& uniform: ub.uniforms) {
+            if (!is_hoisted(hoisted, uniform)) {
+                write_uniform_member(inp, uniform);
+            }
+        }
+        L("}} {}{}_in_t;\n", mod_prefix(inp), ub.name);
+        L("static inline void {}{}_prepare(const {}{}_in_t* in, {}{}_t* out) {{\n", mod_prefix(inp), ub.name, mod_prefix(inp), ub.name, mod_prefix(inp), ub.name);
+        for (const uniform_t& uniform: ub.uniforms) {
+            if (!is_hoisted(hoisted, uniform)) {
+                L("    memcpy(&out->{}, &in->{}, sizeof(out->{}));\n", uniform.name, uniform.name, uniform.name);
+            }
+        }
+        for (const hoisted_t* h: hoisted) {
+            L("    {{\n");
+            for (const std::string& line: h->code) {
+                L("        {}\n", line);
+            }
+            L("    }}\n");
+        }
+        L("}}\n");
+    }
+}
+
+static void write_bytes(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if ((i & 15) == 0) {
+            L("    ");
+        }
+        L("{:#04x},", data[i]);
+        if ((i & 15) == 15) {
+            L("\n");
+        }
+    }
+    L("\n}};\n");
 }
 
-static void write_shader_sources_and_blobs(const input_t& inp,
-                                           const spirvcross_t& spirvcross,
-                                           const bytecode_t& bytecode,
+static void write_payload(const args_t& args,
+                          const input_t& inp,
+                          const std::array<spirvcross_t,slang_t::NUM>& spirvcross,
+                          const payload_t& payload)
+{
+    const spirvcross_t& payload_spirvcross = spirvcross[payload.slang];
+    int src_index = payload_spirvcross.find_source_by_snippet_index(payload.snippet_index);
+    assert(src_index >= 0);
+    const spirvcross_source_t& src = payload_spirvcross.sources[src_index];
+    std::vector<std::string> lines;
+    pystring::splitlines(src.source_code, lines);
+    /* first write the source code in a comment block */
+    L("/*\n");
+    for (const std::string& line: lines) {
+        L("    {}\n", line);
+    }
+    L("*/\n");
+    if (args.compress) {
+        /* compressed data, and a zero-initialized buffer which is decompressed into on first use */
+        L("static const uint8_t {}_lz[{}] = {{\n", payload.c_name, payload.compressed.size());
+        write_bytes(payload.compressed.data(), payload.compressed.size());
+        L("static {} {}[{}];\n", payload.is_bytecode ? "uint8_t" : "char", payload.c_name, payload.data.size());
+        L("static int {}_decoded;\n", payload.c_name);
+    }
+    else {
+        /* source code is written as a byte array with a trailing 0 */
+        L("static const {} {}[{}] = {{\n", payload.is_bytecode ? "uint8_t" : "char", payload.c_name, payload.data.size());
+        write_bytes(payload.data.data(), payload.data.size());
+    }
+}
+
+/* with --compress, decompress a payload on first use in the shader desc accessor function */
+static void write_payload_decode(const payload_t& payload) {
+    L("        if (!_sshdc_lz_decode_once(&{}_decoded, {}_lz, {}, {}, {})) {{\n",
+        payload.c_name, payload.c_name, payload.compressed.size(), payload.c_name, payload.data.size());
+    L("            return 0;\n");
+    L("        }}\n");
+}
+
+/* return the '#if defined(...)' condition for a payload, or an empty string if all users share the same define */
+static std::string payload_condition(const payload_t& payload) {
+    std::vector<std::string> defines;
+    for (int i = 0; i < slang_t::NUM; i++) {
+        slang_t::type_t slang = (slang_t::type_t) i;
+        if (payload.slang_mask & slang_t::bit(slang)) {
+            std::string def = fmt::format("defined({})", sokol_define(slang));
+            if (std::find(defines.begin(), defines.end(), def) == defines.end()) {
+                defines.push_back(def);
+            }
+        }
+    }
+    if (defines.size() < 2) {
+        return std::string();
+    }
+    return pystring::join(" || ", defines);
+}
+
+/* write payloads which are shared between different sokol backend defines */
+static void write_shared_payloads(const args_t& args,
+                                  const input_t& inp,
+                                  const std::array<spirvcross_t,slang_t::NUM>& spirvcross,
+                                  const payloads_t& payloads)
+{
+    if (args.no_ifdef) {
+        return;
+    }
+    for (const payload_t& payload: payloads.items) {
+        std::string cond = payload_condition(payload);
+        if (!cond.empty()) {
+            L("#if {}\n", cond);
+            write_payload(args, inp, spirvcross, payload);
+            L("#endif\n");
+        }
+    }
+}
+
+/* write the payloads which are first used in a shader language and not shared with other backend defines */
+static void write_shader_sources_and_blobs(const args_t& args,
+                                           const input_t& inp,
+                                           const std::array<spirvcross_t,slang_t::NUM>& spirvcross,
+                                           const payloads_t& payloads,
                                            slang_t::type_t slang)
 {
-    for (int snippet_index = 0; snippet_index < (int)inp.snippets.size(); snippet_index++) {
-        const snippet_t& snippet = inp.snippets[snippet_index];
-        if ((snippet.type != snippet_t::VS) && (snippet.type != snippet_t::FS)) {
+    for (const payload_t& payload: payloads.items) {
+        if (payload.slang != slang) {
             continue;
         }
-        int src_index = spirvcross.find_source_by_snippet_index(snippet_index);
-        assert(src_index >= 0);
-        const spirvcross_source_t& src = spirvcross.sources[src_index];
-        int blob_index = bytecode.find_blob_by_snippet_index(snippet_index);
-        const bytecode_blob_t* blob = 0;
-        if (blob_index != -1) {
-            blob = &bytecode.blobs[blob_index];
-        }
-        std::vector<std::string> lines;
-        pystring::splitlines(src.source_code, lines);
-        /* first write the source code in a comment block */
-        L("/*\n");
-        for (const std::string& line: lines) {
-            L("    {}\n", line);
-        }
-        L("*/\n");
-        if (blob) {
-            std::string c_name = fmt::format("{}{}_bytecode_{}", mod_prefix(inp), snippet.name, slang_t::to_str(slang));
-            L("static const uint8_t {}[{}] = {{\n", c_name.c_str(), blob->data.size());
-            const size_t len = blob->data.size();
-            for (size_t i = 0; i < len; i++) {
-                if ((i & 15) == 0) {
-                    L("    ");
-                }
-                L("{:#04x},", blob->data[i]);
-                if ((i & 15) == 15) {
-                    L("\n");
-                }
-            }
-            L("\n}};\n");
-        }
-        else {
-            /* if no bytecode exists, write the source code, but also a a byte array with a trailing 0 */
-            std::string c_name = fmt::format("{}{}_source_{}", mod_prefix(inp), snippet.name, slang_t::to_str(slang));
-            const size_t len = src.source_code.length() + 1;
-            L("static const char {}[{}] = {{\n", c_name.c_str(), len);
-            for (size_t i = 0; i < len; i++) {
-                if ((i & 15) == 0) {
-                    L("    ");
-                }
-                L("{:#04x},", src.source_code[i]);
-                if ((i & 15) == 15) {
-                    L("\n");
-                }
-            }
-            L("\n}};\n");
+        if (!args.no_ifdef && !payload_condition(payload).empty()) {
+            // already written by write_shared_payloads()
+            continue;
         }
+        write_payload(args, inp, spirvcross, payload);
     }
 }
 
 static void write_stage(const char* stage_name,
-                        const program_t& prog,
                         const spirvcross_source_t& src,
-                        const std::string& src_name,
-                        const bytecode_blob_t* blob,
-                        const std::string& blob_name,
-                        slang_t::type_t slang)
+                        const payload_t& payload)
 {
     L("  {{ /* {} */\n", stage_name);
-    if (blob) {
+    if (payload.is_bytecode) {
         L("    0, /* source */\n");
-        L("    {}, /* bytecode */\n", blob_name.c_str());
-        L("    {}, /* bytecode_size */\n", blob->data.size());
+        L("    {}, /* bytecode */\n", payload.c_name);
+        L("    {}, /* bytecode_size */\n", payload.data.size());
     }
     else {
-        L("    {}, /* source */\n", src_name);
+        L("    {}, /* source */\n", payload.c_name);
         L("    0,  /* bytecode */\n");
         L("    0,  /* bytecode_size */\n");
     }
@@ -400,7 +670,7 @@ static void write_stage(const char* stage_name,
     L("  }},\n");
 }
 
-static void write_shader_descs(const input_t& inp, const spirvcross_t& spirvcross, const bytecode_t& bytecode, slang_t::type_t slang) {
+static void write_shader_descs(const input_t& inp, const spirvcross_t& spirvcross, const payloads_t& payloads, slang_t::type_t slang) {
     for (const auto& item: inp.programs) {
         const program_t& prog = item.second;
         int vs_snippet_index = inp.snippet_map.at(prog.vs_name);
@@ -410,30 +680,8 @@ static void write_shader_descs(const input_t& inp, const spirvcross_t& spirvcros
         assert((vs_src_index >= 0) && (fs_src_index >= 0));
         const spirvcross_source_t& vs_src = spirvcross.sources[vs_src_index];
         const spirvcross_source_t& fs_src = spirvcross.sources[fs_src_index];
-        int vs_blob_index = bytecode.find_blob_by_snippet_index(vs_snippet_index);
-        int fs_blob_index = bytecode.find_blob_by_snippet_index(fs_snippet_index);
-        const bytecode_blob_t* vs_blob = 0;
-        const bytecode_blob_t* fs_blob = 0;
-        if (vs_blob_index != -1) {
-            vs_blob = &bytecode.blobs[vs_blob_index];
-        }
-        if (fs_blob_index != -1) {
-            fs_blob = &bytecode.blobs[fs_blob_index];
-        }
-        std::string vs_src_name, fs_src_name;
-        std::string vs_blob_name, fs_blob_name;
-        if (vs_blob_index != -1) {
-            vs_blob_name = fmt::format("{}{}_bytecode_{}", mod_prefix(inp), prog.vs_name, slang_t::to_str(slang));
-        }
-        else {
-            vs_src_name = fmt::format("{}{}_source_{}", mod_prefix(inp), prog.vs_name, slang_t::to_str(slang));
-        }
-        if (fs_blob_index != -1) {
-            fs_blob_name = fmt::format("{}{}_bytecode_{}", mod_prefix(inp), prog.fs_name, slang_t::to_str(slang));
-        }
-        else {
-            fs_src_name = fmt::format("{}{}_source_{}", mod_prefix(inp), prog.fs_name, slang_t::to_str(slang));
-        }
+        const payload_t& vs_payload = payloads.find_payload(slang, vs_snippet_index);
+        const payload_t& fs_payload = payloads.find_payload(slang, fs_snippet_index);
 
         /* write shader desc */
         L("static const sg_shader_desc {}{}_shader_desc_{} = {{\n", mod_prefix(inp), prog.name, slang_t::to_str(slang));
@@ -449,17 +697,389 @@ static void write_shader_descs(const input_t& inp, const spirvcross_t& spirvcros
             }
         }
         L(" }},\n");
-        write_stage("vs", prog, vs_src, vs_src_name, vs_blob, vs_blob_name, slang);
-        write_stage("fs", prog, fs_src, fs_src_name, fs_blob, fs_blob_name, slang);
+        write_stage("vs", vs_src, vs_payload);
+        write_stage("fs", fs_src, fs_payload);
         L("  \"{}{}_shader\", /* label */\n", mod_prefix(inp), prog.name);
         L("  0, /* _end_canary */\n");
         L("}};\n");
     }
 }
 
+/* all sg_backend enum values, in the order of declaration */
+static const char* sokol_backends[] = {
+    "SG_BACKEND_GLCORE33",
+    "SG_BACKEND_GLES2",
+    "SG_BACKEND_GLES3",
+    "SG_BACKEND_D3D11",
+    "SG_BACKEND_METAL_IOS",
+    "SG_BACKEND_METAL_MACOS",
+    "SG_BACKEND_METAL_SIMULATOR",
+    "SG_BACKEND_WGPU",
+    "SG_BACKEND_DUMMY",
+};
+static const int num_sokol_backends = sizeof(sokol_backends) / sizeof(sokol_backends[0]);
+
+/* the generated tables are indexed by sg_backend, check at compile time that the
+    sg_backend enum values match the order of sokol_backends[] (C arrays
+    can't use designated initializers in C++)
+*/
+static void write_backend_order_check() {
+    std::string cond;
+    for (int backend_index = 0; backend_index < num_sokol_backends; backend_index++) {
+        cond += fmt::format("{}({} == {})", (backend_index > 0) ? " && " : "", sokol_backends[backend_index], backend_index);
+    }
+    const char* msg = "\"sg_backend enum values don't match the generated shader tables, sokol-shdc and sokol_gfx.h versions differ?\"";
+    L("#if defined(__cplusplus)\n");
+    L("static_assert({}, {});\n", cond, msg);
+    L("#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)\n");
+    L("_Static_assert({}, {});\n", cond, msg);
+    L("#endif\n");
+}
+
+/* write a table of sg_shader_desc pointers for a program, indexed by sg_backend */
+static void write_shader_desc_table(const args_t& args, const input_t& inp, const program_t& prog) {
+    L("static const sg_shader_desc* {}{}_shader_desc_table[SG_BACKEND_DUMMY+1] = {{\n", mod_prefix(inp), prog.name);
+    for (int backend_index = 0; backend_index < num_sokol_backends; backend_index++) {
+        bool found = false;
+        for (int i = 0; i < slang_t::NUM; i++) {
+            slang_t::type_t slang = (slang_t::type_t) i;
+            if ((args.slang & slang_t::bit(slang)) && (0 == strcmp(sokol_backend(slang), sokol_backends[backend_index]))) {
+                if (!args.no_ifdef) {
+                    L("    #if defined({})\n", sokol_define(slang));
+                }
+                L("    &{}{}_shader_desc_{}, /* {} */\n", mod_prefix(inp), prog.name, slang_t::to_str(slang), sokol_backends[backend_index]);
+                if (!args.no_ifdef) {
+                    L("    #else\n");
+                    L("    0,\n");
+                    L("    #endif\n");
+                }
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            L("    0, /* {} */\n", sokol_backends[backend_index]);
+        }
+    }
+    L("}};\n");
+}
+
+/* the program name lookup uses a two-level 'hash and displace' perfect hash
+    table (CHD): the name hash selects a bucket of about 4 names, and each
+    bucket has a displacement pair (d0, d1) which moves all of its names into
+    free slots of a table with one slot per program, the table functions
+    must match the generated C code
+*/
+struct name_hash_keys_t {
+    uint32_t bucket;
+    uint32_t f1;
+    uint32_t f2;
+};
+
+static name_hash_keys_t name_hash_keys(uint64_t hash, uint64_t seed, uint32_t num_buckets, uint32_t table_size) {
+    const uint64_t x = hash ^ seed;
+    const uint64_t h1 = x * 0x9E3779B97F4A7C15ULL;
+    const uint64_t h2 = x * 0xC2B2AE3D27D4EB4FULL;
+    name_hash_keys_t keys;
+    keys.bucket = (uint32_t)(h1 >> 32) % num_buckets;
+    keys.f1 = (uint32_t)(h2 >> 32) % table_size;
+    keys.f2 = (uint32_t)((h1 ^ h2) >> 16) % table_size;
+    return keys;
+}
+
+static uint32_t name_hash_slot(const name_hash_keys_t& keys, uint32_t d0, uint32_t d1, uint32_t table_size) {
+    return (uint32_t)((keys.f1 + (uint64_t)d0 * keys.f2 + d1) % table_size);
+}
+
+struct name_hash_table_t {
+    uint64_t seed = 0;
+    uint32_t num_buckets = 1;
+    uint32_t table_size = 1;
+    std::vector<std::array<uint32_t,2>> disp;   // d0, d1 per bucket
+    std::vector<int> slots;                     // index into hashes per slot, or -1
+};
+
+/* try to place all hashes with the given seed and table size, buckets with the most
+    hashes are placed first, while most slots are still free
+*/
+static bool place_name_hashes(const std::vector<uint64_t>& hashes, name_hash_table_t& t) {
+    std::vector<std::vector<int>> buckets(t.num_buckets);
+    std::vector<name_hash_keys_t> keys;
+    for (int i = 0; i < (int)hashes.size(); i++) {
+        keys.push_back(name_hash_keys(hashes[i], t.seed, t.num_buckets, t.table_size));
+        buckets[keys.back().bucket].push_back(i);
+    }
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < t.num_buckets; i++) {
+        order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+    t.disp.assign(t.num_buckets, { 0, 0 });
+    t.slots.assign(t.table_size, -1);
+    for (uint32_t bucket_index: order) {
+        const std::vector<int>& bucket = buckets[bucket_index];
+        if (bucket.empty()) {
+            break;
+        }
+        bool placed = false;
+        for (uint32_t d0 = 0; (d0 < t.table_size) && !placed; d0++) {
+            for (uint32_t d1 = 0; (d1 < t.table_size) && !placed; d1++) {
+                std::vector<uint32_t> bucket_slots;
+                bool collision = false;
+                for (int i: bucket) {
+                    const uint32_t slot = name_hash_slot(keys[i], d0, d1, t.table_size);
+                    if ((t.slots[slot] >= 0) || (std::find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end())) {
+                        collision = true;
+                        break;
+                    }
+                    bucket_slots.push_back(slot);
+                }
+                if (!collision) {
+                    for (int i = 0; i < (int)bucket.size(); i++) {
+                        t.slots[bucket_slots[i]] = bucket[i];
+                    }
+                    t.disp[bucket_index] = { d0, d1 };
+                    placed = true;
+                }
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* build the perfect hash table for a set of different hashes, a bucket only fails
+    to place when two of its hashes have the same f1 and f2, which is resolved by
+    another seed (or, very unlikely, a bigger table)
+*/
+static name_hash_table_t build_name_hash_table(const std::vector<uint64_t>& hashes) {
+    name_hash_table_t t;
+    t.table_size = std::max((uint32_t)hashes.size(), 1u);
+    t.num_buckets = (t.table_size + 3) / 4;
+    for (int attempt = 1; !place_name_hashes(hashes, t); attempt++) {
+        t.seed++;
+        if ((attempt % 64) == 0) {
+            t.table_size++;
+        }
+    }
+    return t;
+}
+
+/* write the program lookup functions by name and name hash, using a perfect hash table */
+static errmsg_t write_shader_desc_by_hash(const input_t& inp, const std::string& func_prefix) {
+    std::vector<uint64_t> hashes;
+    std::vector<const program_t*> progs;
+    std::map<uint64_t, const program_t*> progs_by_hash;
+    for (const auto& item: inp.programs) {
+        const uint64_t hash = hash64(item.first.c_str(), item.first.length());
+        if (progs_by_hash.count(hash) > 0) {
+            const program_t* other = progs_by_hash[hash];
+            return inp.error(item.second.line_index, fmt::format("programs '{}' and '{}' have the same 64-bit name hash, rename one of them",
+                other->name, item.second.name));
+        }
+        progs_by_hash[hash] = &item.second;
+        hashes.push_back(hash);
+        progs.push_back(&item.second);
+    }
+    const name_hash_table_t t = build_name_hash_table(hashes);
+    L("#if !defined(SOKOL_SHDC_HASH_INCLUDED)\n");
+    L("#define SOKOL_SHDC_HASH_INCLUDED (1)\n");
+    L("/* 64-bit FNV-1a hash of a program name */\n");
+    L("static inline uint64_t _sshdc_hash64(const char* str) {{\n");
+    L("    uint64_t hash = 0xcbf29ce484222325ULL;\n");
+    L("    while (*str) {{\n");
+    L("        hash ^= (uint8_t)*str++;\n");
+    L("        hash *= 0x100000001b3ULL;\n");
+    L("    }}\n");
+    L("    return hash;\n");
+    L("}}\n");
+    L("#endif /* SOKOL_SHDC_HASH_INCLUDED */\n");
+    L("{}const sg_shader_desc* {}shader_desc_by_hash(uint64_t hash) {{\n", func_prefix, mod_prefix(inp));
+    L("    static const uint32_t disp[{}][2] = {{\n", t.num_buckets);
+    for (const auto& d: t.disp) {
+        L("        {{ {}, {} }},\n", d[0], d[1]);
+    }
+    L("    }};\n");
+    L("    static const struct {{ uint64_t hash; const sg_shader_desc* (*func)(void); }} table[{}] = {{\n", t.table_size);
+    for (int prog_index: t.slots) {
+        if (prog_index >= 0) {
+            L("        {{ PROG_HASH_{}{}, {}{}_shader_desc }},\n", mod_prefix(inp), progs[prog_index]->name, mod_prefix(inp), progs[prog_index]->name);
+        }
+        else {
+            L("        {{ 0, 0 }},\n");
+        }
+    }
+    L("    }};\n");
+    L("    const uint64_t x = hash ^ {:#x}ULL;\n", t.seed);
+    L("    const uint64_t h1 = x * 0x9E3779B97F4A7C15ULL;\n");
+    L("    const uint64_t h2 = x * 0xC2B2AE3D27D4EB4FULL;\n");
+    L("    const uint32_t* d = disp[(uint32_t)(h1 >> 32) % {}];\n", t.num_buckets);
+    L("    const uint32_t f1 = (uint32_t)(h2 >> 32) % {};\n", t.table_size);
+    L("    const uint32_t f2 = (uint32_t)((h1 ^ h2) >> 16) % {};\n", t.table_size);
+    L("    const uint32_t slot = (uint32_t)((f1 + (uint64_t)d[0] * f2 + d[1]) % {});\n", t.table_size);
+    L("    if ((table[slot].hash == hash) && table[slot].func) {{\n");
+    L("        return table[slot].func();\n");
+    L("    }}\n");
+    L("    return 0;\n");
+    L("}}\n");
+    L("{}const sg_shader_desc* {}shader_desc_by_name(const char* name) {{\n", func_prefix, mod_prefix(inp));
+    L("    return {}shader_desc_by_hash(_sshdc_hash64(name));\n", mod_prefix(inp));
+    L("}}\n");
+    return errmsg_t();
+}
+
+/* write the build-time content hashes of all shaders and programs, and the combined module hash */
+static void write_content_hashes(const args_t& args, const input_t& inp, const payloads_t& payloads) {
+    for (const auto& item: inp.programs) {
+        const program_t& prog = item.second;
+        for (int i = 0; i < slang_t::NUM; i++) {
+            slang_t::type_t slang = (slang_t::type_t) i;
+            if (args.slang & slang_t::bit(slang)) {
+                const payload_t& vs_payload = payloads.find_payload(slang, inp.snippet_map.at(prog.vs_name));
+                const payload_t& fs_payload = payloads.find_payload(slang, inp.snippet_map.at(prog.fs_name));
+                L("#define VS_HASH_{}{}_{} ({:#018x}ULL)\n", mod_prefix(inp), prog.name, slang_t::to_str(slang), vs_payload.hash);
+                L("#define FS_HASH_{}{}_{} ({:#018x}ULL)\n", mod_prefix(inp), prog.name, slang_t::to_str(slang), fs_payload.hash);
+                L("#define SHADER_HASH_{}{}_{} ({:#018x}ULL)\n", mod_prefix(inp), prog.name, slang_t::to_str(slang), payloads.program_hash(inp, prog, slang));
+            }
+        }
+    }
+    L("#define MODULE_HASH{} ({:#018x}ULL)\n", inp.module.empty() ? "" : fmt::format("_{}", inp.module), payloads.module_hash(args, inp));
+}
+
+/* write a table of program content hashes indexed by sg_backend, and the function which returns the hash for the current backend */
+static void write_content_hash_func(const args_t& args, const input_t& inp, const program_t& prog, const std::string& func_prefix) {
+    L("{}uint64_t {}{}_shader_hash(void) {{\n", func_prefix, mod_prefix(inp), prog.name);
+    L("    static const uint64_t table[SG_BACKEND_DUMMY+1] = {{\n");
+    for (int backend_index = 0; backend_index < num_sokol_backends; backend_index++) {
+        bool found = false;
+        for (int i = 0; i < slang_t::NUM; i++) {
+            slang_t::type_t slang = (slang_t::type_t) i;
+            if ((args.slang & slang_t::bit(slang)) && (0 == strcmp(sokol_backend(slang), sokol_backends[backend_index]))) {
+                L("        SHADER_HASH_{}{}_{}, /* {} */\n", mod_prefix(inp), prog.name, slang_t::to_str(slang), sokol_backends[backend_index]);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            L("        0, /* {} */\n", sokol_backends[backend_index]);
+        }
+    }
+    L("    }};\n");
+    L("    return table[sg_query_backend()];\n");
+    L("}}\n");
+}
+
+/* return the programs in prewarm order, higher priority first, programs with the same priority sorted by name */
+static std::vector<const program_t*> prewarm_order(const input_t& inp) {
+    std::vector<const program_t*> progs;
+    for (const auto& item: inp.programs) {
+        progs.push_back(&item.second);
+    }
+    std::stable_sort(progs.begin(), progs.end(), [](const program_t* a, const program_t* b) {
+        return a->priority > b->priority;
+    });
+    return progs;
+}
+
+/* write the index of each program in the prewarm order */
+static void write_prewarm_indices(const input_t& inp) {
+    const std::vector<const program_t*> progs = prewarm_order(inp);
+    for (int i = 0; i < (int)progs.size(); i++) {
+        L("#define PREWARM_{}{} ({})\n", mod_prefix(inp), progs[i]->name, i);
+    }
+}
+
+/* write the body of [module]_prewarm_shader_desc(), a table of desc functions in prewarm order */
+static void write_prewarm_table(const input_t& inp, const std::vector<const program_t*>& progs) {
+    L("    static const sg_shader_desc* (*table[{}])(void) = {{\n", progs.size());
+    for (const program_t* prog: progs) {
+        L("        {}{}_shader_desc, /* priority {} */\n", mod_prefix(inp), prog->name, prog->priority);
+    }
+    L("    }};\n");
+    L("    if ((index < 0) || (index >= {})) {{\n", progs.size());
+    L("        return 0;\n");
+    L("    }}\n");
+    L("    return table[index]();\n");
+    L("}}\n");
+}
+
+/* write the functions which create all shaders up front, either at once or in caller-controlled batches */
+static void write_prewarm_funcs(const input_t& inp, const std::string& func_prefix) {
+    const std::vector<const program_t*> progs = prewarm_order(inp);
+    L("{}int {}prewarm_count(void) {{\n", func_prefix, mod_prefix(inp));
+    L("    return {};\n", progs.size());
+    L("}}\n");
+    L("{}const sg_shader_desc* {}prewarm_shader_desc(int index) {{\n", func_prefix, mod_prefix(inp));
+    if (progs.empty()) {
+        L("    (void)index;\n");
+        L("    return 0;\n");
+        L("}}\n");
+    }
+    else {
+        write_prewarm_table(inp, progs);
+    }
+    L("{}int {}prewarm_shaders(sg_shader* shaders, int first, int max_count) {{\n", func_prefix, mod_prefix(inp));
+    L("    int num = 0;\n");
+    L("    for (int index = first; (index >= 0) && (index < {}) && (num < max_count); index++, num++) {{\n", progs.size());
+    L("        // the shader desc is null if the current backend wasn't compiled in\n");
+    L("        const sg_shader_desc* desc = {}prewarm_shader_desc(index);\n", mod_prefix(inp));
+    L("        if (desc) {{\n");
+    L("            shaders[index] = sg_make_shader(desc);\n");
+    L("        }}\n");
+    L("        else {{\n");
+    L("            shaders[index].id = SG_INVALID_ID;\n");
+    L("        }}\n");
+    L("    }}\n");
+    L("    return num;\n");
+    L("}}\n");
+}
+
+/* write the variant mask bits for use with [program]_shader_desc_variant() */
+static void write_variant_masks(const input_t& inp) {
+    for (const auto& item: inp.programs) {
+        const program_t& prog = item.second;
+        for (const variant_t& variant: prog.variants) {
+            for (int i = 0; i < (int)variant.values.size(); i++) {
+                L("#define VARIANT_{}{}_{}_{} ({})\n", mod_prefix(inp), prog.name, variant.name, variant.values[i], (uint32_t)i << variant.shift);
+            }
+        }
+    }
+}
+
+/* write the [program]_shader_desc_variant() functions which map a variant mask to a shader desc */
+static void write_variant_funcs(const input_t& inp, const std::string& func_prefix) {
+    for (const auto& item: inp.programs) {
+        const program_t& prog = item.second;
+        if (prog.variant_map.empty()) {
+            continue;
+        }
+        L("{}const sg_shader_desc* {}{}_shader_desc_variant(uint32_t mask) {{\n", func_prefix, mod_prefix(inp), prog.name);
+        L("    switch (mask) {{\n");
+        for (const auto& variant_item: prog.variant_map) {
+            L("        case {}: return {}{}_shader_desc();\n", variant_item.first, mod_prefix(inp), variant_item.second);
+        }
+        L("        default: return 0;\n");
+        L("    }}\n");
+        L("}}\n");
+    }
+}
+
+/* write the program name hashes for use with [module]_shader_desc_by_hash() */
+static void write_program_hashes(const input_t& inp) {
+    for (const auto& item: inp.programs) {
+        const program_t& prog = item.second;
+        L("#define PROG_HASH_{}{} ({:#018x}ULL)\n", mod_prefix(inp), prog.name, hash64(prog.name.c_str(), prog.name.length()));
+    }
+}
+
 errmsg_t sokol_t::gen(const args_t& args, const input_t& inp,
                      const std::array<spirvcross_t,slang_t::NUM>& spirvcross,
-                     const std::array<bytecode_t,slang_t::NUM>& bytecode)
+                     const std::array<bytecode_t,slang_t::NUM>& bytecode,
+                     const payloads_t& payloads)
 {
     // first write everything into a string, and only when no errors occur,
     // dump this into a file (so we don't have half-written files lying around)
@@ -470,6 +1090,7 @@ errmsg_t sokol_t::gen(const args_t& args, const input_t& inp,
     bool comment_header_written = false;
     bool common_decls_written = false;
     bool guard_written = false;
+    int first_slang = 0;    // the common declarations are written from the first shader language
     for (int i = 0; i < slang_t::NUM; i++) {
         slang_t::type_t slang = (slang_t::type_t) i;
         if (args.slang & slang_t::bit(slang)) {
@@ -483,6 +1104,7 @@ errmsg_t sokol_t::gen(const args_t& args, const input_t& inp,
             }
             if (!common_decls_written) {
                 common_decls_written = true;
+                first_slang = i;
                 if (args.output_format == format_t::SOKOL_IMPL) {
                     L("#if !defined(SOKOL_GFX_INCLUDED)\n");
                     L("  #error \"Please include sokol_gfx.h before {}\"\n", pystring::os::path::basename(args.output));
@@ -499,9 +1121,30 @@ errmsg_t sokol_t::gen(const args_t& args, const input_t& inp,
                     for (const auto& item: inp.programs) {
                         const program_t& prog = item.second;
                         L("const sg_shader_desc* {}{}_shader_desc(void);\n", mod_prefix(inp), prog.name);
+                        L("uint64_t {}{}_shader_hash(void);\n", mod_prefix(inp), prog.name);
+                        if (!prog.variant_map.empty()) {
+                            L("const sg_shader_desc* {}{}_shader_desc_variant(uint32_t mask);\n", mod_prefix(inp), prog.name);
+                        }
+                    }
+                    L("const sg_shader_desc* {}shader_desc_by_hash(uint64_t hash);\n", mod_prefix(inp));
+                    L("const sg_shader_desc* {}shader_desc_by_name(const char* name);\n", mod_prefix(inp));
+                    L("int {}prewarm_count(void);\n", mod_prefix(inp));
+                    L("const sg_shader_desc* {}prewarm_shader_desc(int index);\n", mod_prefix(inp));
+                    L("int {}prewarm_shaders(sg_shader* shaders, int first, int max_count);\n", mod_prefix(inp));
+                    for (const spirvcross_source_t& src: spirvcross[i].sources) {
+                        if (has_vertex_struct(inp, src)) {
+                            L("sg_layout_desc {}{}_vertex_layout(void);\n", mod_prefix(inp), inp.snippets[src.snippet_index].name);
+                        }
                     }
                 }
+                write_program_hashes(inp);
+                write_variant_masks(inp);
+                write_prewarm_indices(inp);
+                write_content_hashes(args, inp, payloads);
                 write_vertex_attrs(inp, spirvcross[i]);
+                write_vertex_structs(inp, spirvcross[i]);
+                write_early_z_flags(inp, spirvcross[i]);
+                write_shared_uniforms_flags(inp);
                 write_images_bind_slots(inp, spirvcross[i]);
                 write_uniform_blocks(inp, spirvcross[i], slang);
             }
@@ -513,12 +1156,16 @@ errmsg_t sokol_t::gen(const args_t& args, const input_t& inp,
                 else if (args.output_format == format_t::SOKOL_IMPL) {
                     L("#if defined(SOKOL_SHDC_IMPL)\n");
                 }
+                if (args.compress) {
+                    L("{}", lz_t::c_decoder_source());
+                }
+                write_shared_payloads(args, inp, spirvcross, payloads);
             }
             if (!args.no_ifdef) {
                 L("#if defined({})\n", sokol_define(slang));
             }
-            write_shader_sources_and_blobs(inp, spirvcross[i], bytecode[i], slang);
-            write_shader_descs(inp, spirvcross[i], bytecode[i], slang);
+            write_shader_sources_and_blobs(args, inp, spirvcross, payloads, slang);
+            write_shader_descs(inp, spirvcross[i], payloads, slang);
             if (!args.no_ifdef) {
                 L("#endif /* {} */\n", sokol_define(slang));
             }
@@ -535,26 +1182,43 @@ errmsg_t sokol_t::gen(const args_t& args, const input_t& inp,
     if (args.output_format != format_t::SOKOL_IMPL) {
         func_prefix = "static inline ";
     }
+    write_backend_order_check();
     for (const auto& item: inp.programs) {
         const program_t& prog = item.second;
+        write_shader_desc_table(args, inp, prog);
         L("{}const sg_shader_desc* {}{}_shader_desc(void) {{\n", func_prefix, mod_prefix(inp), prog.name);
-        for (int i = 0; i < slang_t::NUM; i++) {
-            slang_t::type_t slang = (slang_t::type_t) i;
-            if (args.slang & slang_t::bit(slang)) {
-                if (!args.no_ifdef) {
-                    L("    #if defined({})\n", sokol_define(slang));
-                }
-                L("    if (sg_query_backend() == {}) {{\n", sokol_backend(slang));
-                L("        return &{}{}_shader_desc_{};\n", mod_prefix(inp), prog.name, slang_t::to_str(slang));
-                L("    }}\n");
-                if (!args.no_ifdef) {
-                    L("    #endif /* {} */\n", sokol_define(slang));
+        if (args.compress) {
+            L("    const sg_backend backend = sg_query_backend();\n");
+            for (int i = 0; i < slang_t::NUM; i++) {
+                slang_t::type_t slang = (slang_t::type_t) i;
+                if (args.slang & slang_t::bit(slang)) {
+                    if (!args.no_ifdef) {
+                        L("    #if defined({})\n", sokol_define(slang));
+                    }
+                    L("    if (backend == {}) {{\n", sokol_backend(slang));
+                    write_payload_decode(payloads.find_payload(slang, inp.snippet_map.at(prog.vs_name)));
+                    write_payload_decode(payloads.find_payload(slang, inp.snippet_map.at(prog.fs_name)));
+                    L("    }}\n");
+                    if (!args.no_ifdef) {
+                        L("    #endif /* {} */\n", sokol_define(slang));
+                    }
                 }
             }
+            L("    return {}{}_shader_desc_table[backend];\n", mod_prefix(inp), prog.name);
+        }
+        else {
+            L("    return {}{}_shader_desc_table[sg_query_backend()];\n", mod_prefix(inp), prog.name);
         }
-        L("    return 0; /* can't happen */\n");
         L("}}\n");
+        write_content_hash_func(args, inp, prog, func_prefix);
+    }
+    write_variant_funcs(inp, func_prefix);
+    err = write_shader_desc_by_hash(inp, func_prefix);
+    if (err.valid) {
+        return err;
     }
+    write_prewarm_funcs(inp, func_prefix);
+    write_vertex_layout_funcs(inp, spirvcross[first_slang], func_prefix);
 
     if (guard_written) {
         if (args.output_format == format_t::SOKOL_DECL) {
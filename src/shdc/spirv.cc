@@ -10,6 +10,13 @@
 #include "GlslangToSpv.h"
 #include "spirv-tools/libspirv.hpp"
 #include "spirv-tools/optimizer.hpp"
+#include "SPVRemapper.h"
+#include <set>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <algorithm>
 
 namespace shdc {
 
@@ -53,6 +60,13 @@ static std::string merge_source(const input_t& inp, const snippet_t& snippet, sl
     src += fmt::format("#define SOKOL_HLSL ({})\n", is_hlsl ? 1 : 0);
     src += fmt::format("#define SOKOL_MSL ({})\n", is_msl ? 1 : 0);
     src += fmt::format("#define SOKOL_WGPU ({})\n", is_wgpu ? 1 : 0);
+    if (!snippet.defines.empty()) {
+        // @variants defines, the #line directive keeps the error line numbers intact
+        for (const auto& define: snippet.defines) {
+            src += fmt::format("#define {} {}\n", define.first, define.second);
+        }
+        src += "#line 6\n";
+    }
     for (int line_index : snippet.lines) {
         src += fmt::format("{}\n", inp.lines[line_index].line);
     }
@@ -121,26 +135,265 @@ static void infolog_to_errors(const std::string& log, const input_t& inp, int sn
     }
 }
 
-/* this is a clone of SpvTools.cpp/SpirvToolsLegalize with better control over
-    what optimization passes are run (some passes may generate shader code
-    which translates to valid GLSL, but invalid WebGL GLSL - e.g. simple
-    bounded for-loops are converted to what looks like an unbounded loop
-    ("for (;;) { }") to WebGL
+/* the effective optimization level of a snippet, the @optimize tag overrides the --opt command line arg */
+opt_level_t::type_t spirv_t::opt_level(const args_t& args, const snippet_t& snippet) {
+    return (snippet.opt_level != opt_level_t::INVALID) ? snippet.opt_level : args.opt_level;
+}
+
+/* count the instructions in a SPIRV blob (the high half-word of the first word of an instruction is the word count) */
+static int num_instructions(const std::vector<uint32_t>& spirv) {
+    const size_t header_size = 5;
+    int num = 0;
+    size_t pos = header_size;
+    while (pos < spirv.size()) {
+        const uint32_t word_count = spirv[pos] >> 16;
+        if (word_count == 0) {
+            break;
+        }
+        pos += word_count;
+        num++;
+    }
+    return num;
+}
+
+/* the effective default float precision of a snippet, the @precision tag overrides
+    the --precision command line arg, which only applies to mobile shader languages
 */
-static void spirv_optimize(slang_t::type_t slang, std::vector<uint32_t>& spirv) {
-    spv_target_env target_env;
-    if (slang == slang_t::WGPU) {
-        target_env = SPV_ENV_WEBGPU_0;
+precision_t::type_t spirv_t::precision(const args_t& args, const snippet_t& snippet, slang_t::type_t slang) {
+    if (snippet.precision[slang] != precision_t::INVALID) {
+        return snippet.precision[slang];
     }
-    else {
-        target_env = SPV_ENV_UNIVERSAL_1_2;
+    return slang_t::is_mobile(slang) ? args.precision : precision_t::DEFAULT;
+}
+
+/* remove all RelaxedPrecision decorations (@precision highp) */
+static void strip_relaxed_precision(std::vector<uint32_t>& spirv) {
+    spirv_module_t mod;
+    if (!spirv_module_t::parse(spirv, mod)) {
+        return;
     }
-    spvtools::Optimizer optimizer(target_env);
-    optimizer.SetMessageConsumer(
-        [](spv_message_level_t level, const char *source, const spv_position_t &position, const char *message) {
-            // FIXME
-        });
+    for (auto it = mod.insts.begin(); it != mod.insts.end();) {
+        const bool is_relaxed = ((it->op == spv::OpDecorate) && (it->operands.size() == 2) && (it->operands[1] == (uint32_t)spv::DecorationRelaxedPrecision)) ||
+                                ((it->op == spv::OpMemberDecorate) && (it->operands.size() == 3) && (it->operands[2] == (uint32_t)spv::DecorationRelaxedPrecision));
+        if (is_relaxed) {
+            it = mod.insts.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    spirv = mod.assemble();
+}
+
+/* return the value operands of the operations which the precision propagation may demote */
+static bool relaxable_operands(const spirv_inst_t& inst, std::vector<uint32_t>& out_ids) {
+    out_ids.clear();
+    size_t first = 2;
+    size_t last = inst.operands.size();
+    size_t step = 1;
+    switch (inst.op) {
+        case spv::OpFNegate:
+        case spv::OpFAdd:
+        case spv::OpFSub:
+        case spv::OpFMul:
+        case spv::OpFDiv:
+        case spv::OpFRem:
+        case spv::OpFMod:
+        case spv::OpVectorTimesScalar:
+        case spv::OpMatrixTimesScalar:
+        case spv::OpVectorTimesMatrix:
+        case spv::OpMatrixTimesVector:
+        case spv::OpMatrixTimesMatrix:
+        case spv::OpDot:
+        case spv::OpCompositeConstruct:
+            break;
+        case spv::OpVectorShuffle:
+        case spv::OpCompositeInsert:
+            last = 4;
+            break;
+        case spv::OpCompositeExtract:
+            last = 3;
+            break;
+        case spv::OpSelect:
+            first = 3;
+            last = 5;
+            break;
+        case spv::OpPhi:
+            // value and parent block pairs
+            step = 2;
+            break;
+        case spv::OpExtInst:
+            // extended instruction set and instruction number
+            first = 4;
+            break;
+        default:
+            return false;
+    }
+    if (inst.operands.size() < last) {
+        return false;
+    }
+    for (size_t i = first; i < last; i += step) {
+        out_ids.push_back(inst.operands[i]);
+    }
+    return true;
+}
+
+static const char* relaxable_op_name(spv::Op op) {
+    switch (op) {
+        case spv::OpLoad:               return "OpLoad";
+        case spv::OpFNegate:            return "OpFNegate";
+        case spv::OpFAdd:               return "OpFAdd";
+        case spv::OpFSub:               return "OpFSub";
+        case spv::OpFMul:               return "OpFMul";
+        case spv::OpFDiv:               return "OpFDiv";
+        case spv::OpFRem:               return "OpFRem";
+        case spv::OpFMod:               return "OpFMod";
+        case spv::OpVectorTimesScalar:  return "OpVectorTimesScalar";
+        case spv::OpMatrixTimesScalar:  return "OpMatrixTimesScalar";
+        case spv::OpVectorTimesMatrix:  return "OpVectorTimesMatrix";
+        case spv::OpMatrixTimesVector:  return "OpMatrixTimesVector";
+        case spv::OpMatrixTimesMatrix:  return "OpMatrixTimesMatrix";
+        case spv::OpDot:                return "OpDot";
+        case spv::OpCompositeConstruct: return "OpCompositeConstruct";
+        case spv::OpVectorShuffle:      return "OpVectorShuffle";
+        case spv::OpCompositeInsert:    return "OpCompositeInsert";
+        case spv::OpCompositeExtract:   return "OpCompositeExtract";
+        case spv::OpSelect:             return "OpSelect";
+        case spv::OpPhi:                return "OpPhi";
+        case spv::OpExtInst:            return "OpExtInst";
+        default:                        return "<unknown>";
+    }
+}
+
+/* check for a 32-bit float scalar, vector or matrix type */
+static bool is_float_type(const spirv_module_t& mod, uint32_t type_id) {
+    const int index = mod.find_def(type_id);
+    if (index < 0) {
+        return false;
+    }
+    const spirv_inst_t& inst = mod.insts[index];
+    if ((inst.op == spv::OpTypeVector) || (inst.op == spv::OpTypeMatrix)) {
+        return is_float_type(mod, inst.operands[1]);
+    }
+    return (inst.op == spv::OpTypeFloat) && (inst.operands[1] == 32);
+}
+
+/* check for a float constant which fits into the 16-bit float range */
+static bool is_relaxable_constant(const spirv_module_t& mod, uint32_t id) {
+    const int index = mod.find_def(id);
+    if (index < 0) {
+        return false;
+    }
+    const spirv_inst_t& inst = mod.insts[index];
+    if (inst.op == spv::OpConstantComposite) {
+        for (size_t i = 2; i < inst.operands.size(); i++) {
+            if (!is_relaxable_constant(mod, inst.operands[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if ((inst.op == spv::OpConstant) && (inst.operands.size() == 3) && is_float_type(mod, inst.operands[0])) {
+        float val;
+        memcpy(&val, &inst.operands[2], sizeof(val));
+        return (val >= -65504.0f) && (val <= 65504.0f);
+    }
+    return false;
+}
+
+/* Demote values to relaxed precision where this is safe: an operation whose
+    float operands all have relaxed precision (or are constants in the fp16
+    range) computes a relaxed-precision result, just like the GLSL ES
+    precision rules. Loads from relaxed-precision variables are relaxed too.
+    Optimizer passes don't always keep the decorations on values they create,
+    this restores them. The demoted values are returned for the report.
+*/
+static void propagate_relaxed_precision(std::vector<uint32_t>& spirv, int& out_num_relaxed, std::vector<std::string>& out_demoted) {
+    spirv_module_t mod;
+    if (!spirv_module_t::parse(spirv, mod)) {
+        return;
+    }
+    std::set<uint32_t> relaxed;
+    std::map<uint32_t, std::string> names;
+    std::map<uint32_t, const spirv_inst_t*> values;
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpDecorate) && (inst.operands.size() == 2) && (inst.operands[1] == (uint32_t)spv::DecorationRelaxedPrecision)) {
+            relaxed.insert(inst.operands[0]);
+        }
+        else if ((inst.op == spv::OpName) && (inst.operands.size() >= 2)) {
+            names[inst.operands[0]] = std::string((const char*)&inst.operands[1], strnlen((const char*)&inst.operands[1], (inst.operands.size() - 1) * sizeof(uint32_t)));
+        }
+    }
+    std::vector<uint32_t> ids;
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpLoad) || (inst.op == spv::OpAccessChain) || (inst.op == spv::OpInBoundsAccessChain) || relaxable_operands(inst, ids)) {
+            values[inst.operands[1]] = &inst;
+        }
+    }
+    std::vector<uint32_t> demoted;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const spirv_inst_t& inst: mod.insts) {
+            if ((inst.operands.size() < 3) || (relaxed.count(inst.operands[1]) > 0) || !is_float_type(mod, inst.operands[0])) {
+                continue;
+            }
+            bool demote = false;
+            if (inst.op == spv::OpLoad) {
+                // a load from a relaxed variable, or from an access chain into one
+                uint32_t ptr_id = inst.operands[2];
+                auto it = values.find(ptr_id);
+                if ((it != values.end()) && ((it->second->op == spv::OpAccessChain) || (it->second->op == spv::OpInBoundsAccessChain))) {
+                    ptr_id = it->second->operands[2];
+                }
+                demote = relaxed.count(ptr_id) > 0;
+            }
+            else if (relaxable_operands(inst, ids)) {
+                bool any_relaxed = false;
+                bool all_relaxed = true;
+                for (uint32_t id: ids) {
+                    if (relaxed.count(id) > 0) {
+                        any_relaxed = true;
+                    }
+                    else if (!is_relaxable_constant(mod, id)) {
+                        // non-float operands (e.g. ints or bools) don't affect the precision
+                        auto it = values.find(id);
+                        const bool is_non_float = (it != values.end()) && !is_float_type(mod, it->second->operands[0]);
+                        if (!is_non_float) {
+                            all_relaxed = false;
+                            break;
+                        }
+                    }
+                }
+                demote = any_relaxed && all_relaxed;
+            }
+            if (demote) {
+                relaxed.insert(inst.operands[1]);
+                demoted.push_back(inst.operands[1]);
+                out_demoted.push_back(fmt::format("%{} = {}{}", inst.operands[1], relaxable_op_name(inst.op),
+                    (names.count(inst.operands[1]) > 0) ? fmt::format(" ({})", names[inst.operands[1]]) : ""));
+                changed = true;
+            }
+        }
+    }
+    out_num_relaxed = (int)relaxed.size();
+    if (!demoted.empty()) {
+        for (uint32_t id: demoted) {
+            mod.add_decoration(id, spv::DecorationRelaxedPrecision);
+        }
+        spirv = mod.assemble();
+    }
+}
 
+/* this is a clone of SpvTools.cpp/SpirvToolsLegalize with better control over
+    what optimization passes are run (some passes may generate shader code
+    which translates to valid GLSL, but invalid GLSL ES 1.00 - e.g. simple
+    bounded for-loops are converted to what looks like an unbounded loop
+    ("for (;;) { }") to WebGL. The conservative variant skips those passes,
+    it is used as fallback for GLSL100 when the optimized code contains
+    loops which don't conform to Appendix A of the GLSL ES 1.00 spec.
+*/
+static void register_default_passes(spvtools::Optimizer& optimizer, bool conservative) {
     optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
 /*
     optimizer.RegisterPass(spvtools::CreateMergeReturnPass());
@@ -157,11 +410,13 @@ static void spirv_optimize(slang_t::type_t slang, std::vector<uint32_t>& spirv)
     optimizer.RegisterPass(spvtools::CreateDeadInsertElimPass());
     optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
     optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
-// NOTE: it's the BlockMergePass which moves the init statement of a for-loop
-//       out of the for-statement, which makes it invalid for WebGL
-//    optimizer.RegisterPass(spvtools::CreateBlockMergePass());
-// NOTE: this is the pass which may create invalid WebGL code
-//    optimizer.RegisterPass(spvtools::CreateLocalMultiStoreElimPass());
+    if (!conservative) {
+        // NOTE: it's the BlockMergePass which moves the init statement of a for-loop
+        //       out of the for-statement, which makes it invalid for WebGL
+        optimizer.RegisterPass(spvtools::CreateBlockMergePass());
+        // NOTE: this is the pass which may create invalid WebGL code
+        optimizer.RegisterPass(spvtools::CreateLocalMultiStoreElimPass());
+    }
     optimizer.RegisterPass(spvtools::CreateIfConversionPass());
     optimizer.RegisterPass(spvtools::CreateSimplificationPass());
     optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
@@ -170,17 +425,265 @@ static void spirv_optimize(slang_t::type_t slang, std::vector<uint32_t>& spirv)
     optimizer.RegisterPass(spvtools::CreateRedundancyEliminationPass());
     optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
     optimizer.RegisterPass(spvtools::CreateCFGCleanupPass());
+}
 
+/* full inlining, SSA-conversion, constant propagation and loop unrolling */
+static void register_perf_passes(spvtools::Optimizer& optimizer) {
+    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+    optimizer.RegisterPass(spvtools::CreateMergeReturnPass());
+    optimizer.RegisterPass(spvtools::CreateInlineExhaustivePass());
+    optimizer.RegisterPass(spvtools::CreateEliminateDeadFunctionsPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer.RegisterPass(spvtools::CreatePrivateToLocalPass());
+    optimizer.RegisterPass(spvtools::CreateLocalSingleBlockLoadStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateLocalSingleStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer.RegisterPass(spvtools::CreateScalarReplacementPass());
+    optimizer.RegisterPass(spvtools::CreateLocalAccessChainConvertPass());
+    optimizer.RegisterPass(spvtools::CreateLocalSingleBlockLoadStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateLocalSingleStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer.RegisterPass(spvtools::CreateLocalMultiStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer.RegisterPass(spvtools::CreateCCPPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer.RegisterPass(spvtools::CreateLoopUnrollPass(true));
+    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+    optimizer.RegisterPass(spvtools::CreateRedundancyEliminationPass());
+    optimizer.RegisterPass(spvtools::CreateCombineAccessChainsPass());
+    optimizer.RegisterPass(spvtools::CreateSimplificationPass());
+    optimizer.RegisterPass(spvtools::CreateScalarReplacementPass());
+    optimizer.RegisterPass(spvtools::CreateLocalAccessChainConvertPass());
+    optimizer.RegisterPass(spvtools::CreateLocalSingleBlockLoadStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateLocalSingleStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer.RegisterPass(spvtools::CreateLocalMultiStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer.RegisterPass(spvtools::CreateVectorDCEPass());
+    optimizer.RegisterPass(spvtools::CreateDeadInsertElimPass());
+    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+    optimizer.RegisterPass(spvtools::CreateSimplificationPass());
+    optimizer.RegisterPass(spvtools::CreateIfConversionPass());
+    optimizer.RegisterPass(spvtools::CreateCopyPropagateArraysPass());
+    optimizer.RegisterPass(spvtools::CreateReduceLoadSizePass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer.RegisterPass(spvtools::CreateBlockMergePass());
+    optimizer.RegisterPass(spvtools::CreateRedundancyEliminationPass());
+    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+    optimizer.RegisterPass(spvtools::CreateBlockMergePass());
+    optimizer.RegisterPass(spvtools::CreateSimplificationPass());
+    optimizer.RegisterPass(spvtools::CreateCFGCleanupPass());
+}
+
+/* size-oriented pipeline, without inlining and loop unrolling */
+static void register_size_passes(spvtools::Optimizer& optimizer) {
+    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+    optimizer.RegisterPass(spvtools::CreateEliminateDeadFunctionsPass());
+    optimizer.RegisterPass(spvtools::CreatePrivateToLocalPass());
+    optimizer.RegisterPass(spvtools::CreateScalarReplacementPass());
+    optimizer.RegisterPass(spvtools::CreateLocalAccessChainConvertPass());
+    optimizer.RegisterPass(spvtools::CreateLocalSingleBlockLoadStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateLocalSingleStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateLocalMultiStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateCCPPass());
+    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+    optimizer.RegisterPass(spvtools::CreateSimplificationPass());
+    optimizer.RegisterPass(spvtools::CreateIfConversionPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+    optimizer.RegisterPass(spvtools::CreateBlockMergePass());
+    optimizer.RegisterPass(spvtools::CreateCopyPropagateArraysPass());
+    optimizer.RegisterPass(spvtools::CreateVectorDCEPass());
+    optimizer.RegisterPass(spvtools::CreateDeadInsertElimPass());
+    optimizer.RegisterPass(spvtools::CreateRedundancyEliminationPass());
+    optimizer.RegisterPass(spvtools::CreateCombineAccessChainsPass());
+    optimizer.RegisterPass(spvtools::CreateSimplificationPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer.RegisterPass(spvtools::CreateEliminateDeadConstantPass());
+    optimizer.RegisterPass(spvtools::CreateCFGCleanupPass());
+}
+
+static void spirv_optimize(slang_t::type_t slang, opt_level_t::type_t opt_level, bool conservative, bool relax, std::vector<uint32_t>& spirv) {
+    if ((opt_level == opt_level_t::NONE) && !relax) {
+        return;
+    }
+    spv_target_env target_env;
+    if (slang == slang_t::WGPU) {
+        target_env = SPV_ENV_WEBGPU_0;
+    }
+    else {
+        target_env = SPV_ENV_UNIVERSAL_1_2;
+    }
+    spvtools::Optimizer optimizer(target_env);
+    optimizer.SetMessageConsumer(
+        [](spv_message_level_t level, const char *source, const spv_position_t &position, const char *message) {
+            // FIXME
+        });
+    if (relax) {
+        // @precision mediump: decorate all float operations with RelaxedPrecision
+        optimizer.RegisterPass(spvtools::CreateRelaxFloatOpsPass());
+    }
+    switch (opt_level) {
+        case opt_level_t::NONE:
+            break;
+        case opt_level_t::PERF:
+            register_perf_passes(optimizer);
+            break;
+        case opt_level_t::SIZE:
+            register_size_passes(optimizer);
+            break;
+        default:
+            register_default_passes(optimizer, conservative);
+            break;
+    }
     spvtools::OptimizerOptions spvOptOptions;
     spvOptOptions.set_run_validator(false); // The validator may run as a seperate step later on
     optimizer.Run(spirv.data(), spirv.size(), &spirv, spvOptOptions);
 }
 
-/* compile a vertex or fragment shader to SPIRV */
-static bool compile(EShLanguage stage, slang_t::type_t slang, const std::string& src, const input_t& inp, int snippet_index, bool auto_map, spirv_t& out_spirv) {
+/* cleanup passes after the link step has removed stage inputs and outputs,
+    this removes the computations which fed the removed vertex shader outputs,
+    and propagates the constants of folded fragment shader inputs, no passes
+    which restructure loops are run, so this is also safe for the GLSL100
+    fallback SPIRV
+*/
+void spirv_t::optimize_linked(slang_t::type_t slang, opt_level_t::type_t opt_level, std::vector<uint32_t>& spirv) {
+    if (opt_level == opt_level_t::NONE) {
+        return;
+    }
+    const spv_target_env target_env = (slang == slang_t::WGPU) ? SPV_ENV_WEBGPU_0 : SPV_ENV_UNIVERSAL_1_2;
+    spvtools::Optimizer optimizer(target_env);
+    optimizer.RegisterPass(spvtools::CreatePrivateToLocalPass());
+    optimizer.RegisterPass(spvtools::CreateLocalSingleBlockLoadStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateLocalSingleStoreElimPass());
+    optimizer.RegisterPass(spvtools::CreateCCPPass());
+    optimizer.RegisterPass(spvtools::CreateSimplificationPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer.RegisterPass(spvtools::CreateCFGCleanupPass());
+    spvtools::OptimizerOptions opt_options;
+    opt_options.set_run_validator(false);
+    optimizer.Run(spirv.data(), spirv.size(), &spirv, opt_options);
+}
+
+/* error message from the SPIR-V remapper's global error handler */
+static std::string remap_error;
+
+/* strip all debug instructions (the embedded SPIR-V doesn't need any names,
+    the reflection info is created from the unstripped SPIR-V), and optionally
+    remap IDs into a canonical, more compressible form (like spirv-remap),
+    the result is validated, and an error is returned if validation fails
+*/
+static bool spirv_strip(slang_t::type_t slang, spirv_strip_t::type_t mode, std::vector<uint32_t>& spirv, std::string& out_error) {
+    const spv_target_env target_env = (slang == slang_t::WGPU) ? SPV_ENV_WEBGPU_0 : SPV_ENV_UNIVERSAL_1_2;
+    spvtools::Optimizer optimizer(target_env);
+    optimizer.RegisterPass(spvtools::CreateStripDebugInfoPass());
+    spvtools::OptimizerOptions opt_options;
+    opt_options.set_run_validator(false);
+    if (!optimizer.Run(spirv.data(), spirv.size(), &spirv, opt_options)) {
+        out_error = "failed to strip debug info from SPIR-V";
+        return false;
+    }
+    if (mode == spirv_strip_t::REMAP) {
+        // the remapper reports errors through a global error handler, on error, keep the stripped SPIR-V
+        std::vector<uint32_t> remapped = spirv;
+        remap_error.clear();
+        spv::spirvbin_t::registerErrorHandler([](const std::string& msg) { remap_error = msg; });
+        spv::spirvbin_t remapper;
+        remapper.remap(remapped, spv::spirvbin_t::MAP_ALL);
+        if (remap_error.empty()) {
+            spirv = std::move(remapped);
+        }
+    }
+    spvtools::SpirvTools tools(target_env);
+    std::string validation_error;
+    tools.SetMessageConsumer(
+        [&validation_error](spv_message_level_t level, const char* source, const spv_position_t& position, const char* message) {
+            if (validation_error.empty() && message) {
+                validation_error = message;
+            }
+        });
+    if (!tools.Validate(spirv)) {
+        out_error = fmt::format("stripped SPIR-V failed validation: {}", validation_error);
+        return false;
+    }
+    return true;
+}
+
+/* decode a nul-terminated literal string operand */
+static std::string literal_string(const std::vector<uint32_t>& operands, size_t start) {
+    std::string str;
+    for (size_t i = start; i < operands.size(); i++) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            const char c = (char)((operands[i] >> shift) & 0xFF);
+            if (c == 0) {
+                return str;
+            }
+            str += c;
+        }
+    }
+    return str;
+}
+
+/* set the values of specialization constants (by constant_id or name) from
+    @specialize, and freeze all specialization constants into regular constants,
+    the constants which don't exist in a shader are ignored (but must exist
+    in the other shader of the program), the following optimizer passes
+    then remove the branches which depend on the constants
+*/
+static bool spirv_specialize(slang_t::type_t slang, const std::vector<std::pair<std::string, std::string>>& spec_constants, std::vector<uint32_t>& spirv, std::vector<std::string>& out_matched) {
+    spirv_module_t mod;
+    if (!spirv_module_t::parse(spirv, mod)) {
+        return false;
+    }
+    std::map<uint32_t, std::string> names;
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpName) && (inst.operands.size() >= 2)) {
+            names[inst.operands[0]] = literal_string(inst.operands, 1);
+        }
+    }
+    std::unordered_map<uint32_t, std::string> values;
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op != spv::OpDecorate) || (inst.operands.size() < 3) || (inst.operands[1] != (uint32_t)spv::DecorationSpecId)) {
+            continue;
+        }
+        const uint32_t spec_id = inst.operands[2];
+        const std::string name = (names.count(inst.operands[0]) > 0) ? names.at(inst.operands[0]) : "";
+        for (const auto& spec_constant: spec_constants) {
+            if ((spec_constant.first == name) || (spec_constant.first == std::to_string(spec_id))) {
+                values[spec_id] = spec_constant.second;
+                out_matched.push_back(spec_constant.first);
+            }
+        }
+    }
+    const spv_target_env target_env = (slang == slang_t::WGPU) ? SPV_ENV_WEBGPU_0 : SPV_ENV_UNIVERSAL_1_2;
+    spvtools::Optimizer optimizer(target_env);
+    optimizer.RegisterPass(spvtools::CreateSetSpecConstantDefaultValuePass(values));
+    optimizer.RegisterPass(spvtools::CreateFreezeSpecConstantValuePass());
+    optimizer.RegisterPass(spvtools::CreateFoldSpecConstantOpAndCompositePass());
+    optimizer.RegisterPass(spvtools::CreateUnifyConstantPass());
+    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    spvtools::OptimizerOptions opt_options;
+    opt_options.set_run_validator(false);
+    return optimizer.Run(spirv.data(), spirv.size(), &spirv, opt_options);
+}
+
+/* glslang's thread-safety isn't documented (it has global state like the
+    symbol tables and the pool allocators), so the glslang front-end only runs
+    on one thread at a time, the SPIRV-Tools optimizer passes run in parallel
+*/
+static std::mutex glslang_mutex;
+
+/* compile a vertex or fragment shader to SPIRV, the glslang SPIRV
+    builder messages are returned in out_log
+*/
+static bool compile(EShLanguage stage, slang_t::type_t slang, opt_level_t::type_t opt_level, precision_t::type_t precision, const std::string& src, const input_t& inp, int snippet_index, bool auto_map, spirv_t& out_spirv, std::string& out_log) {
     const char* sources[1] = { src.c_str() };
 
     // compile GLSL vertex- or fragment-shader
+    std::unique_lock<std::mutex> glslang_lock(glslang_mutex);
     glslang::TShader shader(stage);
     // FIXME: add custom defines here: compiler.addProcess(...)
     shader.setStrings(sources, 1);
@@ -234,73 +737,215 @@ static bool compile(EShLanguage stage, slang_t::type_t slang, const std::string&
     spv_options.optimizeSize = false;
     out_spirv.blobs.push_back(spirv_blob_t(snippet_index));
     glslang::GlslangToSpv(*im, out_spirv.blobs.back().bytecode, &spv_logger, &spv_options);
-    std::string spirv_log = spv_logger.getAllMessages();
-    if (!spirv_log.empty()) {
-        // FIXME: need to parse string for errors and translate to errmsg_t objects?
-        // haven't seen a case yet where this generates log messages
-        fmt::print(spirv_log);
-    }
+    // FIXME: need to parse string for errors and translate to errmsg_t objects?
+    // haven't seen a case yet where this generates log messages
+    out_log = spv_logger.getAllMessages();
+    glslang_lock.unlock();
     // run optimizer passes
-    spirv_optimize(slang, out_spirv.blobs.back().bytecode);
+    spirv_blob_t& blob = out_spirv.blobs.back();
+    const snippet_t& snippet = inp.snippets[snippet_index];
+    if (auto_map && !snippet.spec_constants.empty()) {
+        if (!spirv_specialize(slang, snippet.spec_constants, blob.bytecode, blob.spec_matched)) {
+            out_spirv.errors.push_back(inp.error(snippet.lines.empty() ? 0 : snippet.lines[0],
+                fmt::format("failed to specialize '{}' (@specialize value doesn't match the constant's type?)", snippet.name)));
+            return false;
+        }
+    }
+    blob.opt_level = opt_level;
+    blob.precision = precision;
+    if (precision == precision_t::HIGHP) {
+        strip_relaxed_precision(blob.bytecode);
+    }
+    const bool relax = (precision == precision_t::MEDIUMP);
+    blob.num_instrs_before = num_instructions(blob.bytecode);
+    if ((slang == slang_t::GLSL100) && (opt_level != opt_level_t::NONE)) {
+        // keep a conservatively optimized version around in case the
+        // optimized code contains loops which are not valid in GLSL ES 1.00
+        blob.fallback_bytecode = blob.bytecode;
+        spirv_optimize(slang, opt_level_t::DEFAULT, true, relax, blob.fallback_bytecode);
+    }
+    spirv_optimize(slang, opt_level, false, relax, blob.bytecode);
+    blob.num_instrs_after = num_instructions(blob.bytecode);
+    if ((precision != precision_t::HIGHP) && (relax || slang_t::is_mobile(slang))) {
+        propagate_relaxed_precision(blob.bytecode, blob.num_relaxed, blob.demoted);
+        if (!blob.fallback_bytecode.empty()) {
+            int fallback_num_relaxed = 0;
+            std::vector<std::string> fallback_demoted;
+            propagate_relaxed_precision(blob.fallback_bytecode, fallback_num_relaxed, fallback_demoted);
+        }
+    }
     return true;
 }
 
-/* compile all shader-snippets into SPIRV bytecode */
-spirv_t spirv_t::compile_input_glsl(const input_t& inp, slang_t::type_t slang) {
-    spirv_t out_spirv;
+/* a vertex or fragment shader compile job, compiled on a worker thread */
+struct compile_job_t {
+    EShLanguage stage = EShLangVertex;
+    opt_level_t::type_t opt_level = opt_level_t::DEFAULT;
+    precision_t::type_t precision = precision_t::DEFAULT;
+    std::string src;
+    int snippet_index = -1;
+    spirv_t result;
+    std::string log;
+    bool success = false;
+};
 
-    // compile shader-snippets
-    int snippet_index = 0;
-    const bool auto_map = true;
-    for (const snippet_t& snippet: inp.snippets) {
-        if (snippet.type == snippet_t::VS) {
-            // vertex shader
-            std::string src = merge_source(inp, snippet, slang);
-            if (!compile(EShLangVertex, slang, src, inp, snippet_index, auto_map, out_spirv)) {
-                // spirv.errors contains error list
-                return out_spirv;
+/* run compile jobs on all CPU cores (the snippets are independent, the glslang
+    front-end is serialized by glslang_mutex and the SPIRV-Tools optimizer runs
+    in parallel), the results and logs are merged in job order, up to and
+    including the first failed job
+*/
+static void compile_jobs(slang_t::type_t slang, const input_t& inp, bool auto_map, std::vector<compile_job_t>& jobs, spirv_t& out_spirv) {
+    std::atomic<int> next_job(0);
+    auto worker = [&]() {
+        for (int i = next_job++; i < (int)jobs.size(); i = next_job++) {
+            compile_job_t& job = jobs[i];
+            job.success = compile(job.stage, slang, job.opt_level, job.precision, job.src, inp, job.snippet_index, auto_map, job.result, job.log);
+        }
+    };
+    const int num_threads = std::min((int)jobs.size(), std::max(1, (int)std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+    for (compile_job_t& job: jobs) {
+        if (!job.log.empty()) {
+            fmt::print(job.log);
+        }
+        out_spirv.errors.insert(out_spirv.errors.end(), job.result.errors.begin(), job.result.errors.end());
+        if (!job.success) {
+            // spirv.errors contains error list
+            return;
+        }
+        for (spirv_blob_t& blob: job.result.blobs) {
+            out_spirv.blobs.push_back(std::move(blob));
+        }
+    }
+}
+
+/* check that each @specialize key matches a specialization constant
+    in the vertex or fragment shader of its program
+*/
+static void validate_spec_constants(const input_t& inp, spirv_t& spirv) {
+    for (const auto& item: inp.programs) {
+        const program_t& prog = item.second;
+        if (prog.spec_constants.empty()) {
+            continue;
+        }
+        std::vector<std::string> matched;
+        for (const std::string& name: { prog.vs_name, prog.fs_name }) {
+            const int blob_index = spirv.find_blob_by_snippet_index(inp.snippet_map.at(name));
+            if (blob_index >= 0) {
+                const std::vector<std::string>& blob_matched = spirv.blobs[blob_index].spec_matched;
+                matched.insert(matched.end(), blob_matched.begin(), blob_matched.end());
             }
         }
-        else if (snippet.type == snippet_t::FS) {
-            // fragment shader
-            std::string src = merge_source(inp, snippet, slang);
-            if (!compile(EShLangFragment, slang, src, inp, snippet_index, auto_map, out_spirv)) {
-                // spirv.errors contains error list
-                return out_spirv;
+        for (const auto& spec_constant: prog.spec_constants) {
+            if (std::find(matched.begin(), matched.end(), spec_constant.first) == matched.end()) {
+                spirv.errors.push_back(inp.error(prog.spec_line_index,
+                    fmt::format("@specialize constant '{}' not found in the vertex or fragment shader of program '{}'.", spec_constant.first, prog.name)));
+                return;
             }
         }
-        snippet_index++;
     }
-    // when arriving here, no compile errors occured
-    // spirv.bytecodes array contains the SPIRV-bytecode
-    // for each shader snippet
+}
+
+/* compile all shader-snippets into SPIRV bytecode */
+spirv_t spirv_t::compile_input_glsl(const args_t& args, const input_t& inp, slang_t::type_t slang) {
+    spirv_t out_spirv;
+
+    // compile shader-snippets
+    std::vector<compile_job_t> jobs;
+    for (int snippet_index = 0; snippet_index < (int)inp.snippets.size(); snippet_index++) {
+        const snippet_t& snippet = inp.snippets[snippet_index];
+        if ((snippet.type == snippet_t::VS) || (snippet.type == snippet_t::FS)) {
+            compile_job_t job;
+            job.stage = (snippet.type == snippet_t::VS) ? EShLangVertex : EShLangFragment;
+            job.opt_level = opt_level(args, snippet);
+            job.precision = precision(args, snippet, slang);
+            job.src = merge_source(inp, snippet, slang);
+            job.snippet_index = snippet_index;
+            jobs.push_back(std::move(job));
+        }
+    }
+    const bool auto_map = true;
+    compile_jobs(slang, inp, auto_map, jobs, out_spirv);
+    if (out_spirv.errors.empty()) {
+        validate_spec_constants(inp, out_spirv);
+    }
+    // when arriving here without errors, the spirv.bytecodes
+    // array contains the SPIRV-bytecode for each shader snippet
     return out_spirv;
 }
 
 /* compile the GLSL output of spirvcross back to SPIRV */
-spirv_t spirv_t::compile_spirvcross_glsl(const input_t& inp, slang_t::type_t slang, const spirvcross_t* spirvcross) {
+spirv_t spirv_t::compile_spirvcross_glsl(const args_t& args, const input_t& inp, slang_t::type_t slang, const spirvcross_t* spirvcross) {
     assert(spirvcross);
     spirv_t out_spirv;
     const bool auto_map = false;
     for (const spirvcross_source_t& src : spirvcross->sources) {
         const snippet_t& snippet = inp.snippets[src.snippet_index];
         assert((snippet.type == snippet_t::VS) || (snippet.type == snippet_t::FS));
-        if (snippet.type == snippet_t::VS) {
-            if (!compile(EShLangVertex, slang, src.source_code, inp, src.snippet_index, auto_map, out_spirv)) {
-                // spirv.errors contains error list
-                break;
-            }
+        const EShLanguage stage = (snippet.type == snippet_t::VS) ? EShLangVertex : EShLangFragment;
+        std::string log;
+        const bool success = compile(stage, slang, opt_level(args, snippet), precision(args, snippet, slang), src.source_code, inp, src.snippet_index, auto_map, out_spirv, log);
+        if (!log.empty()) {
+            fmt::print(log);
+        }
+        if (!success) {
+            // spirv.errors contains error list
+            break;
         }
-        else if (snippet.type == snippet_t::FS) {
-            if (!compile(EShLangFragment, slang, src.source_code, inp, src.snippet_index, auto_map, out_spirv)) {
-                // spirv.errors contains error list
-                break;
+    }
+    if (out_spirv.errors.empty() && (args.spirv_strip != spirv_strip_t::NONE)) {
+        size_t size_before = 0;
+        size_t size_after = 0;
+        for (spirv_blob_t& blob: out_spirv.blobs) {
+            size_before += blob.bytecode.size() * sizeof(uint32_t);
+            std::string err_msg;
+            if (!spirv_strip(slang, args.spirv_strip, blob.bytecode, err_msg)) {
+                out_spirv.errors.push_back(inp.error(inp.snippets[blob.snippet_index].lines[0], err_msg));
+                return out_spirv;
             }
+            size_after += blob.bytecode.size() * sizeof(uint32_t);
+        }
+        if (args.report) {
+            fmt::print("sokol-shdc: {} SPIR-V bytecode ({}): {} => {} bytes\n",
+                slang_t::to_str(slang), spirv_strip_t::to_str(args.spirv_strip), size_before, size_after);
         }
     }
     return out_spirv;
 }
 
+int spirv_t::find_blob_by_snippet_index(int snippet_index) const {
+    for (int i = 0; i < (int)blobs.size(); i++) {
+        if (blobs[i].snippet_index == snippet_index) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* print the SPIRV instruction counts before and after optimization */
+void spirv_t::report(const input_t& inp, slang_t::type_t slang) const {
+    for (const spirv_blob_t& blob: blobs) {
+        fmt::print("sokol-shdc: {} '{}' optimized ({}): {} => {} SPIR-V instructions\n",
+            slang_t::to_str(slang), inp.snippets[blob.snippet_index].name, opt_level_t::to_str(blob.opt_level),
+            blob.num_instrs_before, blob.num_instrs_after);
+        if ((blob.precision != precision_t::DEFAULT) || (blob.num_relaxed > 0)) {
+            fmt::print("sokol-shdc: {} '{}' precision ({}): {} relaxed values, {} demoted by propagation\n",
+                slang_t::to_str(slang), inp.snippets[blob.snippet_index].name, precision_t::to_str(blob.precision),
+                blob.num_relaxed, blob.demoted.size());
+            for (const std::string& demoted: blob.demoted) {
+                fmt::print("    {}\n", demoted);
+            }
+        }
+    }
+}
+
 void spirv_t::dump_debug(const input_t& inp, errmsg_t::msg_format_t err_fmt) const {
     fmt::print(stderr, "spirv_t:\n");
     if (errors.size() > 0) {
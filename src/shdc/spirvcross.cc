@@ -9,6 +9,8 @@
 #include "spirv_glsl.hpp"
 #include "spirv_hlsl.hpp"
 #include "spirv_msl.hpp"
+#include <algorithm>
+#include <set>
 
 /*
     for "Vulkan convention", fragment shader uniform block bindings live in the same
@@ -49,7 +51,7 @@ static void fix_ub_matrix_force_colmajor(Compiler& compiler) {
     }
 }
 
-static void fix_bind_slots(Compiler& compiler, snippet_t::type_t type, bool is_vulkan) {
+static void fix_bind_slots(const input_t& inp, Compiler& compiler, snippet_t::type_t type, bool is_vulkan) {
     /*
         This overrides all bind slots like this:
 
@@ -67,6 +69,9 @@ static void fix_bind_slots(Compiler& compiler, snippet_t::type_t type, bool is_v
         NOTE that any existing binding definitions are always overwritten,
         this differs from previous behaviour which checked if explicit
         bindings existed.
+
+        With --stable-slots, the bindings are taken from the slots allocated
+        by slots_t::allocate() instead of the declaration order.
     */
     ShaderResources res = compiler.get_shader_resources();
     uint32_t ub_slot = 0;
@@ -75,14 +80,25 @@ static void fix_bind_slots(Compiler& compiler, snippet_t::type_t type, bool is_v
     }
     for (const Resource& ub_res: res.uniform_buffers) {
         compiler.set_decoration(ub_res.id, spv::DecorationDescriptorSet, 0);
-        compiler.set_decoration(ub_res.id, spv::DecorationBinding, ub_slot++);
+        if (inp.ub_slots.count(ub_res.name) > 0) {
+            const uint32_t ub_base = (is_vulkan && (type == snippet_t::type_t::FS)) ? vk_fs_ub_binding_offset : 0;
+            compiler.set_decoration(ub_res.id, spv::DecorationBinding, ub_base + inp.ub_slots.at(ub_res.name));
+        }
+        else {
+            compiler.set_decoration(ub_res.id, spv::DecorationBinding, ub_slot++);
+        }
     }
 
     uint32_t img_slot = 0;
     uint32_t img_set = (type == snippet_t::type_t::VS) ? 1 : 2;
     for (const Resource& img_res: res.sampled_images) {
         compiler.set_decoration(img_res.id, spv::DecorationDescriptorSet, img_set);
-        compiler.set_decoration(img_res.id, spv::DecorationBinding, img_slot++);
+        if (inp.img_slots.count(img_res.name) > 0) {
+            compiler.set_decoration(img_res.id, spv::DecorationBinding, inp.img_slots.at(img_res.name));
+        }
+        else {
+            compiler.set_decoration(img_res.id, spv::DecorationBinding, img_slot++);
+        }
     }
 }
 
@@ -175,6 +191,7 @@ static spirvcross_refl_t parse_reflection(const Compiler& compiler, bool is_vulk
         refl_attr.name = res_attr.name;
         refl_attr.sem_name = "TEXCOORD";
         refl_attr.sem_index = refl_attr.slot;
+        refl_attr.num_components = (int) compiler.get_type(res_attr.type_id).vecsize;
         refl.inputs[refl_attr.slot] = refl_attr;
     }
     for (const Resource& res_attr: shd_resources.stage_outputs) {
@@ -183,6 +200,7 @@ static spirvcross_refl_t parse_reflection(const Compiler& compiler, bool is_vulk
         refl_attr.name = res_attr.name;
         refl_attr.sem_name = "TEXCOORD";
         refl_attr.sem_index = refl_attr.slot;
+        refl_attr.num_components = (int) compiler.get_type(res_attr.type_id).vecsize;
         refl.outputs[refl_attr.slot] = refl_attr;
     }
     // uniform blocks
@@ -205,6 +223,7 @@ static spirvcross_refl_t parse_reflection(const Compiler& compiler, bool is_vulk
                 refl_uniform.array_count = m_type.array[0];
             }
             refl_uniform.offset = compiler.type_struct_member_offset(ub_type, m_index);
+            refl_uniform.size = (int) compiler.get_declared_struct_member_size(ub_type, m_index);
             refl_ub.uniforms.push_back(refl_uniform);
         }
         refl.uniform_blocks.push_back(refl_ub);
@@ -222,7 +241,117 @@ static spirvcross_refl_t parse_reflection(const Compiler& compiler, bool is_vulk
     return refl;
 }
 
-static spirvcross_source_t to_glsl(const spirv_blob_t& blob, int glsl_version, bool is_gles, bool is_vulkan, uint32_t opt_mask, snippet_t::type_t type) {
+/* SPIRV opcodes and storage classes which are not in the SPIRV headers of the
+    vendored SPIRV-Tools version
+*/
+static const uint32_t spirv_op_terminate_invocation = 4416;
+static const uint32_t spirv_op_demote_to_helper_invocation = 5380;
+static const uint32_t spirv_storage_class_storage_buffer = 12;
+
+/* check if a variable is a storage buffer (StorageBuffer storage class, or
+    Uniform storage class with a BufferBlock-decorated struct type)
+*/
+static bool is_storage_buffer_var(const spirv_module_t& mod, const spirv_inst_t& var) {
+    if (var.operands.size() < 3) {
+        return false;
+    }
+    if (var.operands[2] == spirv_storage_class_storage_buffer) {
+        return true;
+    }
+    if (var.operands[2] != spv::StorageClassUniform) {
+        return false;
+    }
+    const int ptr_index = mod.find_def(var.operands[0]);
+    if ((ptr_index < 0) || (mod.insts[ptr_index].op != spv::OpTypePointer) || (mod.insts[ptr_index].operands.size() < 3)) {
+        return false;
+    }
+    uint32_t value = 0;
+    return mod.find_decoration(mod.insts[ptr_index].operands[2], spv::DecorationBufferBlock, value);
+}
+
+/* scan the fragment shader SPIRV for features which prevent early depth/stencil
+    testing, SPIRV-Cross has no reflection API for these
+*/
+static void parse_early_z(const std::vector<uint32_t>& bytecode, spirvcross_refl_t& refl) {
+    spirv_module_t mod;
+    if ((refl.stage != stage_t::FS) || !spirv_module_t::parse(bytecode, mod)) {
+        return;
+    }
+    // pointers into storage buffers, access chains are defined after their base pointer
+    std::set<uint32_t> buffer_ptrs;
+    for (const spirv_inst_t& inst: mod.insts) {
+        const uint32_t op = (uint32_t) inst.op;
+        if ((op == spirv_op_terminate_invocation) || (op == spirv_op_demote_to_helper_invocation)) {
+            refl.uses_discard = true;
+            continue;
+        }
+        switch (inst.op) {
+            case spv::OpKill:
+                refl.uses_discard = true;
+                break;
+            case spv::OpCapability:
+                if ((inst.operands.size() >= 1) && (inst.operands[0] == spv::CapabilitySampleRateShading)) {
+                    refl.sample_shading = true;
+                }
+                break;
+            case spv::OpExecutionMode:
+                if (inst.operands.size() >= 2) {
+                    if (inst.operands[1] == spv::ExecutionModeDepthReplacing) {
+                        refl.writes_depth = true;
+                    }
+                    else if (inst.operands[1] == spv::ExecutionModeEarlyFragmentTests) {
+                        refl.early_fragment_tests = true;
+                    }
+                }
+                break;
+            case spv::OpDecorate:
+                if ((inst.operands.size() >= 3) && (inst.operands[1] == spv::DecorationBuiltIn)) {
+                    if (inst.operands[2] == spv::BuiltInFragDepth) {
+                        refl.writes_depth = true;
+                    }
+                    else if ((inst.operands[2] == spv::BuiltInSampleId) || (inst.operands[2] == spv::BuiltInSamplePosition)) {
+                        refl.sample_shading = true;
+                    }
+                }
+                else if ((inst.operands.size() >= 2) && (inst.operands[1] == spv::DecorationSample)) {
+                    refl.sample_shading = true;
+                }
+                break;
+            case spv::OpVariable:
+                if (is_storage_buffer_var(mod, inst)) {
+                    buffer_ptrs.insert(inst.operands[1]);
+                }
+                break;
+            case spv::OpAccessChain:
+            case spv::OpInBoundsAccessChain:
+            case spv::OpPtrAccessChain:
+            case spv::OpInBoundsPtrAccessChain:
+            case spv::OpCopyObject:
+                if ((inst.operands.size() >= 3) && (buffer_ptrs.count(inst.operands[2]) > 0)) {
+                    buffer_ptrs.insert(inst.operands[1]);
+                }
+                break;
+            case spv::OpStore:
+            case spv::OpCopyMemory:
+                if ((inst.operands.size() >= 1) && (buffer_ptrs.count(inst.operands[0]) > 0)) {
+                    refl.has_side_effects = true;
+                }
+                break;
+            case spv::OpImageWrite:
+            case spv::OpAtomicFlagTestAndSet:
+            case spv::OpAtomicFlagClear:
+                refl.has_side_effects = true;
+                break;
+            default:
+                if ((inst.op >= spv::OpAtomicLoad) && (inst.op <= spv::OpAtomicXor)) {
+                    refl.has_side_effects = true;
+                }
+                break;
+        }
+    }
+}
+
+static spirvcross_source_t to_glsl(const input_t& inp, const spirv_blob_t& blob, int glsl_version, bool is_gles, bool is_vulkan, uint32_t opt_mask, snippet_t::type_t type) {
     CompilerGLSL compiler(blob.bytecode);
     CompilerGLSL::Options options;
     options.emit_line_directives = false;
@@ -233,7 +362,7 @@ static spirvcross_source_t to_glsl(const spirv_blob_t& blob, int glsl_version, b
     options.vertex.fixup_clipspace = (0 != (opt_mask & option_t::FIXUP_CLIPSPACE));
     options.vertex.flip_vert_y = (0 != (opt_mask & option_t::FLIP_VERT_Y));
     compiler.set_common_options(options);
-    fix_bind_slots(compiler, type, is_vulkan);
+    fix_bind_slots(inp, compiler, type, is_vulkan);
     fix_ub_matrix_force_colmajor(compiler);
     if (!is_vulkan) {
         flatten_uniform_blocks(compiler);
@@ -248,7 +377,7 @@ static spirvcross_source_t to_glsl(const spirv_blob_t& blob, int glsl_version, b
     return res;
 }
 
-static spirvcross_source_t to_hlsl5(const spirv_blob_t& blob, uint32_t opt_mask, snippet_t::type_t type) {
+static spirvcross_source_t to_hlsl5(const input_t& inp, const spirv_blob_t& blob, uint32_t opt_mask, snippet_t::type_t type) {
     CompilerHLSL compiler(blob.bytecode);
     CompilerGLSL::Options commonOptions;
     commonOptions.emit_line_directives = true;
@@ -259,7 +388,7 @@ static spirvcross_source_t to_hlsl5(const spirv_blob_t& blob, uint32_t opt_mask,
     hlslOptions.shader_model = 50;
     hlslOptions.point_size_compat = true;
     compiler.set_hlsl_options(hlslOptions);
-    fix_bind_slots(compiler, type, false);
+    fix_bind_slots(inp, compiler, type, false);
     fix_ub_matrix_force_colmajor(compiler);
     std::string src = compiler.compile();
     spirvcross_source_t res;
@@ -271,7 +400,7 @@ static spirvcross_source_t to_hlsl5(const spirv_blob_t& blob, uint32_t opt_mask,
     return res;
 }
 
-static spirvcross_source_t to_msl(const spirv_blob_t& blob, CompilerMSL::Options::Platform plat, uint32_t opt_mask, snippet_t::type_t type) {
+static spirvcross_source_t to_msl(const input_t& inp, const spirv_blob_t& blob, CompilerMSL::Options::Platform plat, uint32_t opt_mask, snippet_t::type_t type) {
     CompilerMSL compiler(blob.bytecode);
     CompilerGLSL::Options commonOptions;
     commonOptions.emit_line_directives = true;
@@ -282,7 +411,7 @@ static spirvcross_source_t to_msl(const spirv_blob_t& blob, CompilerMSL::Options
     mslOptions.platform = plat;
     mslOptions.enable_decoration_binding = true;
     compiler.set_msl_options(mslOptions);
-    fix_bind_slots(compiler, type, false);
+    fix_bind_slots(inp, compiler, type, false);
     std::string src = compiler.compile();
     spirvcross_source_t res;
     if (!src.empty()) {
@@ -295,6 +424,115 @@ static spirvcross_source_t to_msl(const spirv_blob_t& blob, CompilerMSL::Options
     return res;
 }
 
+/* uniform blocks which have been compacted to the members a shader reads get
+    the name of their full uniform block, and the full uniform blocks are
+    reflected from the uncompacted SPIRV (for the generated C structs)
+*/
+static void add_uncompacted_uniform_blocks(const input_t& inp, const spirv_blob_t& blob, snippet_t::type_t type, bool is_vulkan, spirvcross_source_t& src) {
+    for (uniform_block_t& ub: src.refl.uniform_blocks) {
+        auto it = blob.compacted_uniform_blocks.find(ub.name);
+        if (it != blob.compacted_uniform_blocks.end()) {
+            ub.base_name = it->second;
+        }
+    }
+    CompilerGLSL compiler(blob.uncompacted_bytecode);
+    fix_bind_slots(inp, compiler, type, is_vulkan);
+    const spirvcross_refl_t refl = parse_reflection(compiler, is_vulkan);
+    for (const uniform_block_t& ub: refl.uniform_blocks) {
+        for (const auto& item: blob.compacted_uniform_blocks) {
+            if (item.second == ub.name) {
+                src.uncompacted_uniform_blocks.push_back(ub);
+                break;
+            }
+        }
+    }
+}
+
+static bool is_ident_char(char c) {
+    return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9')) || (c == '_');
+}
+
+/* find the next occurrence of a keyword which isn't part of a longer identifier */
+static size_t find_keyword(const std::string& src, const std::string& keyword, size_t pos) {
+    while ((pos = src.find(keyword, pos)) != std::string::npos) {
+        const size_t end = pos + keyword.length();
+        if (((pos == 0) || !is_ident_char(src[pos - 1])) && ((end == src.length()) || !is_ident_char(src[end]))) {
+            return pos;
+        }
+        pos = end;
+    }
+    return std::string::npos;
+}
+
+/* check a for-loop header against GLSL ES 1.00 Appendix A: the init statement
+    declares and initializes the loop index, the condition compares the loop
+    index with an expression, and the loop expression increments or decrements
+    the loop index
+*/
+static bool is_conformant_for_header(const std::string& header) {
+    std::vector<std::string> parts;
+    pystring::split(header, parts, ";");
+    if (parts.size() != 3) {
+        return false;
+    }
+    std::vector<std::string> init;
+    pystring::split(parts[0], init);
+    if (!init.empty() && ((init[0] == "highp") || (init[0] == "mediump") || (init[0] == "lowp"))) {
+        init.erase(init.begin());
+    }
+    if ((init.size() < 4) || ((init[0] != "int") && (init[0] != "float")) || (init[2] != "=")) {
+        return false;
+    }
+    const std::string& index = init[1];
+    std::vector<std::string> cond;
+    pystring::split(parts[1], cond);
+    static const std::vector<std::string> rel_ops = { "<", "<=", ">", ">=", "==", "!=" };
+    if ((cond.size() < 3) || (cond[0] != index) || (std::find(rel_ops.begin(), rel_ops.end(), cond[1]) == rel_ops.end())) {
+        return false;
+    }
+    std::vector<std::string> expr;
+    pystring::split(parts[2], expr);
+    if (expr.size() == 1) {
+        return (expr[0] == index + "++") || (expr[0] == index + "--") || (expr[0] == "++" + index) || (expr[0] == "--" + index);
+    }
+    else if (expr.size() == 3) {
+        return (expr[0] == index) && ((expr[1] == "+=") || (expr[1] == "-="));
+    }
+    return false;
+}
+
+/* check that all loops in GLSL ES 1.00 source code conform to Appendix A (no while- and do-while loops) */
+static bool is_glsl100_loop_conformant(const std::string& src) {
+    if (find_keyword(src, "while", 0) != std::string::npos) {
+        return false;
+    }
+    size_t pos = 0;
+    while ((pos = find_keyword(src, "for", pos)) != std::string::npos) {
+        size_t start = src.find_first_not_of(" \t", pos + 3);
+        if ((start == std::string::npos) || (src[start] != '(')) {
+            return false;
+        }
+        int depth = 0;
+        size_t end = start;
+        for (; end < src.length(); end++) {
+            if (src[end] == '(') {
+                depth++;
+            }
+            else if ((src[end] == ')') && (--depth == 0)) {
+                break;
+            }
+        }
+        if (end == src.length()) {
+            return false;
+        }
+        if (!is_conformant_for_header(src.substr(start + 1, end - start - 1))) {
+            return false;
+        }
+        pos = end;
+    }
+    return true;
+}
+
 static int find_unique_uniform_block_by_name(const spirvcross_t& spv_cross, const std::string& name) {
     for (int i = 0; i < (int)spv_cross.unique_uniform_blocks.size(); i++) {
         if (spv_cross.unique_uniform_blocks[i].name == name) {
@@ -316,7 +554,15 @@ static int find_unique_image_by_name(const spirvcross_t& spv_cross, const std::s
 // find all identical uniform blocks across all shaders, and check for collisions
 static bool gather_unique_uniform_blocks(const input_t& inp, spirvcross_t& spv_cross) {
     for (spirvcross_source_t& src: spv_cross.sources) {
+        std::vector<uniform_block_t*> ubs;
         for (uniform_block_t& ub: src.refl.uniform_blocks) {
+            ubs.push_back(&ub);
+        }
+        for (uniform_block_t& ub: src.uncompacted_uniform_blocks) {
+            ubs.push_back(&ub);
+        }
+        for (uniform_block_t* ub_ptr: ubs) {
+            uniform_block_t& ub = *ub_ptr;
             int other_ub_index = find_unique_uniform_block_by_name(spv_cross, ub.name);
             if (other_ub_index >= 0) {
                 if (ub.equals(spv_cross.unique_uniform_blocks[other_ub_index])) {
@@ -390,6 +636,35 @@ static errmsg_t validate_linking(const input_t& inp, const spirvcross_t& spv_cro
     return errmsg_t();
 }
 
+static attr_t* find_input_attr(spirvcross_refl_t& refl, const std::string& name) {
+    for (attr_t& attr: refl.inputs) {
+        if ((attr.slot >= 0) && (attr.name == name)) {
+            return &attr;
+        }
+    }
+    return nullptr;
+}
+
+/* apply the @format vertex formats and @instance step rates to the vertex shader inputs */
+static errmsg_t apply_attr_annotations(const input_t& inp, spirvcross_source_t& src) {
+    const snippet_t& snippet = inp.snippets[src.snippet_index];
+    for (const auto& item: snippet.attr_formats) {
+        attr_t* attr = find_input_attr(src.refl, item.first);
+        if (!attr) {
+            return inp.error(snippet.lines[0], fmt::format("@format attribute '{}' is not an input of vertex shader '{}'", item.first, snippet.name));
+        }
+        attr->format = item.second;
+    }
+    for (const std::string& name: snippet.instance_attrs) {
+        attr_t* attr = find_input_attr(src.refl, name);
+        if (!attr) {
+            return inp.error(snippet.lines[0], fmt::format("@instance attribute '{}' is not an input of vertex shader '{}'", name, snippet.name));
+        }
+        attr->per_instance = true;
+    }
+    return errmsg_t();
+}
+
 spirvcross_t spirvcross_t::translate(const input_t& inp, const spirv_t& spirv, slang_t::type_t slang) {
     spirvcross_t spv_cross;
     for (const auto& blob: spirv.blobs) {
@@ -399,34 +674,57 @@ spirvcross_t spirvcross_t::translate(const input_t& inp, const spirv_t& spirv, s
         assert((type == snippet_t::VS) || (type == snippet_t::FS));
         switch (slang) {
             case slang_t::GLSL330:
-                src = to_glsl(blob, 330, false, false, opt_mask, type);
+                src = to_glsl(inp, blob, 330, false, false, opt_mask, type);
                 break;
             case slang_t::GLSL100:
-                src = to_glsl(blob, 100, true, false, opt_mask, type);
+                src = to_glsl(inp, blob, 100, true, false, opt_mask, type);
+                if (src.valid && !blob.fallback_bytecode.empty() && !is_glsl100_loop_conformant(src.source_code)) {
+                    // optimized code has loops which are not allowed in GLSL ES 1.00,
+                    // use the conservatively optimized SPIRV instead
+                    spirv_blob_t fallback_blob(blob.snippet_index);
+                    fallback_blob.bytecode = blob.fallback_bytecode;
+                    src = to_glsl(inp, fallback_blob, 100, true, false, opt_mask, type);
+                    src.loop_fallback = true;
+                    if (src.valid && !is_glsl100_loop_conformant(src.source_code)) {
+                        const snippet_t& snippet = inp.snippets[blob.snippet_index];
+                        spv_cross.error = inp.error(snippet.lines[0],
+                            fmt::format("shader '{}' has loops which are not allowed in GLSL ES 1.00 (see Appendix A of the GLSL ES 1.00 spec)", snippet.name));
+                        return spv_cross;
+                    }
+                }
                 break;
             case slang_t::GLSL300ES:
-                src = to_glsl(blob, 300, true, false, opt_mask, type);
+                src = to_glsl(inp, blob, 300, true, false, opt_mask, type);
                 break;
             case slang_t::HLSL5:
-                src = to_hlsl5(blob, opt_mask, type);
+                src = to_hlsl5(inp, blob, opt_mask, type);
                 break;
             case slang_t::METAL_MACOS:
-                src = to_msl(blob, CompilerMSL::Options::macOS, opt_mask, type);
+                src = to_msl(inp, blob, CompilerMSL::Options::macOS, opt_mask, type);
                 break;
             case slang_t::METAL_IOS:
             case slang_t::METAL_SIM:
-                src = to_msl(blob, CompilerMSL::Options::iOS, opt_mask, type);
+                src = to_msl(inp, blob, CompilerMSL::Options::iOS, opt_mask, type);
                 break;
             case slang_t::WGPU:
                 // hackety hack, just compile to GLSL even for SPIRV output
                 // so that we can use the same SPIRV-Cross's reflection API
                 // calls as for the other output types
-                src = to_glsl(blob, 450, false, true, opt_mask, type);
+                src = to_glsl(inp, blob, 450, false, true, opt_mask, type);
                 break;
             default: break;
         }
         if (src.valid) {
+            parse_early_z(blob.bytecode, src.refl);
+            if (!blob.compacted_uniform_blocks.empty()) {
+                add_uncompacted_uniform_blocks(inp, blob, type, slang == slang_t::WGPU, src);
+            }
             src.snippet_index = blob.snippet_index;
+            errmsg_t err = apply_attr_annotations(inp, src);
+            if (err.valid) {
+                spv_cross.error = err;
+                return spv_cross;
+            }
             spv_cross.sources.push_back(std::move(src));
         }
         else {
@@ -459,7 +757,8 @@ void spirvcross_t::write_reflection_info(FILE* stream, const spirvcross_source_t
     fmt::print(stream, "{}inputs:\n", indent);
     for (const attr_t& attr: source.refl.inputs) {
         if (attr.slot >= 0) {
-            fmt::print(stream, "{}  {}: slot={}, sem_name={}, sem_index={}\n", indent, attr.name, attr.slot, attr.sem_name, attr.sem_index);
+            fmt::print(stream, "{}  {}: slot={}, sem_name={}, sem_index={}, format={}, per_instance={}\n",
+                indent, attr.name, attr.slot, attr.sem_name, attr.sem_index, vertex_format_t::to_str(attr.vertex_format()), attr.per_instance);
         }
     }
     fmt::print(stream, "{}outputs:\n", indent);
@@ -483,9 +782,41 @@ void spirvcross_t::write_reflection_info(FILE* stream, const spirvcross_source_t
         fmt::print(stream, "{}image: {}, slot: {}, type: {}, basetype: {}\n",
             indent, img.name, img.slot, image_t::type_to_str(img.type), image_t::basetype_to_str(img.base_type));
     }
+    if (source.refl.stage == stage_t::FS) {
+        fmt::print(stream, "{}early z: {}, discard: {}, writes depth: {}, sample shading: {}, side effects: {}, early fragment tests: {}\n",
+            indent, source.refl.early_z(), source.refl.uses_discard, source.refl.writes_depth,
+            source.refl.sample_shading, source.refl.has_side_effects, source.refl.early_fragment_tests);
+    }
     fmt::print(stream, "\n");
 }
 
+/* print which shaders had to fall back to the conservatively optimized SPIRV */
+void spirvcross_t::report(const input_t& inp, slang_t::type_t slang) const {
+    for (const spirvcross_source_t& src: sources) {
+        if (src.loop_fallback) {
+            fmt::print("sokol-shdc: {} '{}' has loops which are not valid in GLSL ES 1.00, using conservative optimization\n",
+                slang_t::to_str(slang), inp.snippets[src.snippet_index].name);
+        }
+    }
+}
+
+/* print the packed and unpacked vertex- and instance-struct sizes of vertex shaders with @format or @instance */
+void spirvcross_t::report_vertex_structs(const input_t& inp) const {
+    for (const spirvcross_source_t& src: sources) {
+        const snippet_t& snippet = inp.snippets[src.snippet_index];
+        if ((src.refl.stage != stage_t::VS) || (snippet.base_index >= 0) || (snippet.attr_formats.empty() && snippet.instance_attrs.empty())) {
+            continue;
+        }
+        for (bool per_instance: { false, true }) {
+            const int size = src.refl.vertex_struct_size(per_instance, true);
+            if (size > 0) {
+                fmt::print("sokol-shdc: vertex shader '{}': {} bytes per {} (unpacked: {} bytes)\n",
+                    snippet.name, size, per_instance ? "instance" : "vertex", src.refl.vertex_struct_size(per_instance, false));
+            }
+        }
+    }
+}
+
 void spirvcross_t::dump_debug(FILE* stream, errmsg_t::msg_format_t err_fmt, slang_t::type_t slang) const {
     fmt::print(stream, "spirvcross_t ({}):\n", slang_t::to_str(slang));
     if (error.valid) {
@@ -0,0 +1,243 @@
+/*
+    A minimal SPIRV module representation for instruction-level edits
+    which are not covered by the SPIRV-Tools optimizer passes (used by
+    the cross-stage link step).
+*/
+#include "shdc.h"
+
+namespace shdc {
+
+static const uint32_t spirv_magic = 0x07230203;
+static const size_t spirv_header_size = 5;
+
+bool spirv_module_t::parse(const std::vector<uint32_t>& spirv, spirv_module_t& out_module) {
+    if ((spirv.size() < spirv_header_size) || (spirv[0] != spirv_magic)) {
+        return false;
+    }
+    out_module.insts.clear();
+    for (size_t i = 0; i < spirv_header_size; i++) {
+        out_module.header[i] = spirv[i];
+    }
+    size_t pos = spirv_header_size;
+    while (pos < spirv.size()) {
+        // the high half-word of the first word of an instruction is the word count
+        const uint32_t word_count = spirv[pos] >> 16;
+        if ((word_count == 0) || ((pos + word_count) > spirv.size())) {
+            return false;
+        }
+        spirv_inst_t inst;
+        inst.op = (spv::Op) (spirv[pos] & 0xFFFF);
+        inst.operands.assign(spirv.begin() + pos + 1, spirv.begin() + pos + word_count);
+        out_module.insts.push_back(std::move(inst));
+        pos += word_count;
+    }
+    return true;
+}
+
+std::vector<uint32_t> spirv_module_t::assemble() const {
+    std::vector<uint32_t> spirv(header.begin(), header.end());
+    for (const spirv_inst_t& inst: insts) {
+        spirv.push_back((uint32_t)((inst.operands.size() + 1) << 16) | (uint32_t)inst.op);
+        spirv.insert(spirv.end(), inst.operands.begin(), inst.operands.end());
+    }
+    return spirv;
+}
+
+/* allocate a new result id (header word 3 is the id bound) */
+uint32_t spirv_module_t::alloc_id() {
+    return header[3]++;
+}
+
+/* return the result id of type, constant and variable declarations, or 0 */
+static uint32_t decl_result_id(const spirv_inst_t& inst) {
+    if ((inst.op >= spv::OpTypeVoid) && (inst.op <= spv::OpTypeFunction)) {
+        return inst.operands.empty() ? 0 : inst.operands[0];
+    }
+    switch (inst.op) {
+        case spv::OpConstantTrue:
+        case spv::OpConstantFalse:
+        case spv::OpConstant:
+        case spv::OpConstantComposite:
+        case spv::OpConstantSampler:
+        case spv::OpConstantNull:
+        case spv::OpSpecConstantTrue:
+        case spv::OpSpecConstantFalse:
+        case spv::OpSpecConstant:
+        case spv::OpSpecConstantComposite:
+        case spv::OpSpecConstantOp:
+        case spv::OpVariable:
+        case spv::OpFunction:
+            return (inst.operands.size() < 2) ? 0 : inst.operands[1];
+        default:
+            return 0;
+    }
+}
+
+/* find the instruction index of a type, constant, variable or function declaration, or -1 */
+int spirv_module_t::find_def(uint32_t id) const {
+    for (int i = 0; i < (int)insts.size(); i++) {
+        if (decl_result_id(insts[i]) == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int spirv_module_t::find_first(spv::Op op) const {
+    for (int i = 0; i < (int)insts.size(); i++) {
+        if (insts[i].op == op) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool spirv_module_t::find_decoration(uint32_t id, spv::Decoration decoration, uint32_t& out_value) const {
+    for (const spirv_inst_t& inst: insts) {
+        if ((inst.op == spv::OpDecorate) && (inst.operands.size() >= 2) && (inst.operands[0] == id) && (inst.operands[1] == (uint32_t)decoration)) {
+            out_value = (inst.operands.size() >= 3) ? inst.operands[2] : 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* add a decoration without value, the annotations section is before all type declarations */
+void spirv_module_t::add_decoration(uint32_t id, spv::Decoration decoration) {
+    int index = find_first(spv::OpDecorate);
+    if (index < 0) {
+        for (index = 0; index < (int)insts.size(); index++) {
+            if ((insts[index].op == spv::OpMemberDecorate) || (insts[index].op == spv::OpDecorationGroup) || (decl_result_id(insts[index]) != 0)) {
+                break;
+            }
+        }
+    }
+    insts.insert(insts.begin() + index, spirv_inst_t(spv::OpDecorate, { id, (uint32_t)decoration }));
+}
+
+/* insert a global declaration at the end of the types, constants and variables */
+void spirv_module_t::add_global(const spirv_inst_t& inst) {
+    const int index = find_first(spv::OpFunction);
+    insts.insert((index >= 0) ? (insts.begin() + index) : insts.end(), inst);
+}
+
+/* find a type or constant declaration by its operands (without the result id), or add a new one */
+uint32_t spirv_module_t::find_or_add_global(spv::Op op, const std::vector<uint32_t>& operands, int result_pos) {
+    for (const spirv_inst_t& inst: insts) {
+        if ((inst.op == op) && (inst.operands.size() == (operands.size() + 1))) {
+            std::vector<uint32_t> other = inst.operands;
+            other.erase(other.begin() + result_pos);
+            if (other == operands) {
+                return inst.operands[result_pos];
+            }
+        }
+    }
+    const uint32_t id = alloc_id();
+    spirv_inst_t inst(op, operands);
+    inst.operands.insert(inst.operands.begin() + result_pos, id);
+    add_global(inst);
+    return id;
+}
+
+/* encode a nul-terminated literal string */
+std::vector<uint32_t> spirv_module_t::string_words(const std::string& str) {
+    std::vector<uint32_t> words((str.length() / 4) + 1, 0);
+    for (size_t i = 0; i < str.length(); i++) {
+        words[i / 4] |= ((uint32_t)(uint8_t)str[i]) << (8 * (i % 4));
+    }
+    return words;
+}
+
+/* replace the debug name of an id */
+void spirv_module_t::set_name(uint32_t id, const std::string& name) {
+    for (spirv_inst_t& inst: insts) {
+        if ((inst.op == spv::OpName) && !inst.operands.empty() && (inst.operands[0] == id)) {
+            const std::vector<uint32_t> words = string_words(name);
+            inst.operands.resize(1);
+            inst.operands.insert(inst.operands.end(), words.begin(), words.end());
+        }
+    }
+}
+
+/* find all instructions which reference an id, except debug names, decorations,
+    entry point interfaces and the declaration itself, this is a conservative
+    scan which also treats literal operands with the same value as references
+*/
+std::vector<int> spirv_module_t::find_uses(uint32_t id) const {
+    std::vector<int> uses;
+    for (int i = 0; i < (int)insts.size(); i++) {
+        const spirv_inst_t& inst = insts[i];
+        switch (inst.op) {
+            case spv::OpName:
+            case spv::OpMemberName:
+            case spv::OpDecorate:
+            case spv::OpMemberDecorate:
+            case spv::OpEntryPoint:
+                continue;
+            default:
+                break;
+        }
+        if (decl_result_id(inst) == id) {
+            continue;
+        }
+        for (uint32_t operand: inst.operands) {
+            if (operand == id) {
+                uses.push_back(i);
+                break;
+            }
+        }
+    }
+    return uses;
+}
+
+/* remove all decorations of an id */
+void spirv_module_t::remove_decorations(uint32_t id) {
+    for (auto it = insts.begin(); it != insts.end();) {
+        if (((it->op == spv::OpDecorate) || (it->op == spv::OpMemberDecorate)) && !it->operands.empty() && (it->operands[0] == id)) {
+            it = insts.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+/* remove the debug names of an id */
+void spirv_module_t::remove_names(uint32_t id) {
+    for (auto it = insts.begin(); it != insts.end();) {
+        if (((it->op == spv::OpName) || (it->op == spv::OpMemberName)) && !it->operands.empty() && (it->operands[0] == id)) {
+            it = insts.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+/* remove a variable from the interface list of all entry points */
+void spirv_module_t::remove_from_interface(uint32_t id) {
+    for (spirv_inst_t& inst: insts) {
+        if (inst.op != spv::OpEntryPoint) {
+            continue;
+        }
+        // operands are: execution model, function, literal name, interface ids,
+        // the name is nul-terminated, so it ends at the first word with a zero byte
+        size_t pos = 2;
+        while (pos < inst.operands.size()) {
+            const uint32_t w = inst.operands[pos++];
+            if (((w & 0xFF) == 0) || ((w & 0xFF00) == 0) || ((w & 0xFF0000) == 0) || ((w & 0xFF000000) == 0)) {
+                break;
+            }
+        }
+        for (size_t i = pos; i < inst.operands.size();) {
+            if (inst.operands[i] == id) {
+                inst.operands.erase(inst.operands.begin() + i);
+            }
+            else {
+                i++;
+            }
+        }
+    }
+}
+
+} // namespace shdc
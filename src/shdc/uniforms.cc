@@ -0,0 +1,1413 @@
+/*
+    Uniform block layout optimizations on the SPIRV:
+
+    - reorder the members of uniform blocks to minimize the std140 padding
+    - compact uniform blocks by removing the members a shader doesn't read
+    - hoist uniform-only expressions into new members computed on the CPU
+
+    The members are changed in the SPIRV struct declaration of each uniform
+    block (together with the member names, member decorations and the struct
+    indices of all access chains), so that the generated shader code for all
+    shader languages, the reflection info and the generated C structs all
+    see the same new layout. The new layout only depends on the member types
+    (and for compaction on the members read by the shader), so identical
+    uniform blocks in different shaders get the same layout.
+*/
+#include "shdc.h"
+#include "fmt/format.h"
+#include "pystring.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <set>
+
+namespace shdc {
+
+/* the std140 size and alignment of a uniform block member */
+struct ub_member_t {
+    uint32_t size = 0;
+    uint32_t align = 0;
+};
+
+/* a uniform block struct type in a SPIRV module */
+struct ub_block_t {
+    uint32_t type_id = 0;
+    std::string name;
+    std::vector<ub_member_t> members;
+    std::vector<std::string> member_names;
+    std::set<uint32_t> var_ids;
+};
+
+static uint32_t constant_u32(const spirv_module_t& mod, uint32_t const_id, bool& out_valid) {
+    const int index = mod.find_def(const_id);
+    if ((index < 0) || (mod.insts[index].op != spv::OpConstant) || (mod.insts[index].operands.size() != 3)) {
+        out_valid = false;
+        return 0;
+    }
+    return mod.insts[index].operands[2];
+}
+
+/* get the std140 size and alignment of a 32-bit scalar, vector, matrix or array type */
+static bool std140_member(const spirv_module_t& mod, uint32_t type_id, ub_member_t& out_member) {
+    const int index = mod.find_def(type_id);
+    if (index < 0) {
+        return false;
+    }
+    const spirv_inst_t& inst = mod.insts[index];
+    switch (inst.op) {
+        case spv::OpTypeFloat:
+        case spv::OpTypeInt:
+            out_member.size = 4;
+            out_member.align = 4;
+            return inst.operands[1] == 32;
+        case spv::OpTypeVector:
+            {
+                ub_member_t comp;
+                if (!std140_member(mod, inst.operands[1], comp) || (comp.size != 4)) {
+                    return false;
+                }
+                const uint32_t num = inst.operands[2];
+                out_member.size = 4 * num;
+                out_member.align = (num == 3) ? 16 : (4 * num);
+            }
+            return true;
+        case spv::OpTypeMatrix:
+            // column-major with a column stride of 16 bytes
+            out_member.size = 16 * inst.operands[2];
+            out_member.align = 16;
+            return true;
+        case spv::OpTypeArray:
+            {
+                uint32_t stride = 0;
+                bool valid = mod.find_decoration(type_id, spv::DecorationArrayStride, stride);
+                const uint32_t len = constant_u32(mod, inst.operands[2], valid);
+                out_member.size = stride * len;
+                out_member.align = 16;
+                return valid && (stride > 0) && ((stride % 16) == 0);
+            }
+        default:
+            return false;
+    }
+}
+
+/* the std140 member offsets for a member order, returns the end of the last member */
+static uint32_t std140_offsets(const std::vector<ub_member_t>& members, const std::vector<int>& order, std::vector<uint32_t>& out_offsets) {
+    out_offsets.assign(members.size(), 0);
+    uint32_t offset = 0;
+    for (int member_index: order) {
+        const ub_member_t& member = members[member_index];
+        offset = (uint32_t)roundup((int)offset, (int)member.align);
+        out_offsets[member_index] = offset;
+        offset += member.size;
+    }
+    return offset;
+}
+
+/* Plan the new member order: members which fill whole 16-byte rows go first
+    (in their original order), then each vec3 followed by a scalar which fills
+    the gap behind it, then the vec2s and the remaining scalars. When there
+    are more vec3s than scalars, each unpaired vec3 still leaves 4 bytes of
+    padding behind it (which is unavoidable since vec3s are 16-byte aligned),
+    all other padding is at the end of the struct.
+*/
+static std::vector<int> plan_layout(const std::vector<ub_member_t>& members) {
+    std::vector<int> rows, vec3s, vec2s, scalars;
+    for (int i = 0; i < (int)members.size(); i++) {
+        const ub_member_t& member = members[i];
+        if ((member.align == 16) && ((member.size % 16) == 0)) {
+            rows.push_back(i);
+        }
+        else if (member.size == 12) {
+            vec3s.push_back(i);
+        }
+        else if (member.size == 8) {
+            vec2s.push_back(i);
+        }
+        else {
+            scalars.push_back(i);
+        }
+    }
+    std::vector<int> order = rows;
+    size_t scalar_index = 0;
+    for (int vec3_index: vec3s) {
+        order.push_back(vec3_index);
+        if (scalar_index < scalars.size()) {
+            order.push_back(scalars[scalar_index++]);
+        }
+    }
+    order.insert(order.end(), vec2s.begin(), vec2s.end());
+    order.insert(order.end(), scalars.begin() + scalar_index, scalars.end());
+    return order;
+}
+
+/* find the uniform block struct types and their variables */
+static std::vector<ub_block_t> gather_blocks(const spirv_module_t& mod) {
+    std::vector<ub_block_t> blocks;
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op != spv::OpVariable) || (inst.operands[2] != (uint32_t)spv::StorageClassUniform)) {
+            continue;
+        }
+        const int ptr_index = mod.find_def(inst.operands[0]);
+        if ((ptr_index < 0) || (mod.insts[ptr_index].op != spv::OpTypePointer)) {
+            continue;
+        }
+        const uint32_t type_id = mod.insts[ptr_index].operands[2];
+        uint32_t dummy = 0;
+        if (!mod.find_decoration(type_id, spv::DecorationBlock, dummy)) {
+            continue;
+        }
+        auto it = std::find_if(blocks.begin(), blocks.end(), [type_id](const ub_block_t& block) { return block.type_id == type_id; });
+        if (it == blocks.end()) {
+            ub_block_t block;
+            block.type_id = type_id;
+            blocks.push_back(block);
+            it = blocks.end() - 1;
+        }
+        it->var_ids.insert(inst.operands[1]);
+    }
+    for (ub_block_t& block: blocks) {
+        const spirv_inst_t& type_inst = mod.insts[mod.find_def(block.type_id)];
+        for (size_t i = 1; i < type_inst.operands.size(); i++) {
+            ub_member_t member;
+            if (!std140_member(mod, type_inst.operands[i], member)) {
+                member.size = 0;
+            }
+            block.members.push_back(member);
+        }
+        block.member_names.resize(block.members.size());
+        for (const spirv_inst_t& inst: mod.insts) {
+            if ((inst.op == spv::OpName) && (inst.operands[0] == block.type_id)) {
+                block.name = (const char*)&inst.operands[1];
+            }
+            else if ((inst.op == spv::OpMemberName) && (inst.operands[0] == block.type_id) && (inst.operands[1] < block.members.size())) {
+                block.member_names[inst.operands[1]] = (const char*)&inst.operands[2];
+            }
+        }
+    }
+    return blocks;
+}
+
+/* check if a uniform block and all references to it can be rewritten: only
+    supported member types, access chains with a constant struct index, and
+    loads of the whole block which are only used by composite extracts
+*/
+static bool is_rewritable(const spirv_module_t& mod, const ub_block_t& block) {
+    if (block.name.empty()) {
+        return false;
+    }
+    for (const ub_member_t& member: block.members) {
+        if (member.size == 0) {
+            return false;
+        }
+    }
+    for (uint32_t var_id: block.var_ids) {
+        for (int use_index: mod.find_uses(var_id)) {
+            const spirv_inst_t& use = mod.insts[use_index];
+            if ((use.op == spv::OpAccessChain) || (use.op == spv::OpInBoundsAccessChain)) {
+                bool valid = (use.operands.size() >= 4) && (use.operands[2] == var_id);
+                if (valid) {
+                    constant_u32(mod, use.operands[3], valid);
+                }
+                if (!valid) {
+                    return false;
+                }
+            }
+            else if ((use.op == spv::OpLoad) && (use.operands[2] == var_id)) {
+                for (int load_use_index: mod.find_uses(use.operands[1])) {
+                    const spirv_inst_t& load_use = mod.insts[load_use_index];
+                    if ((load_use.op != spv::OpCompositeExtract) || (load_use.operands[2] != use.operands[1])) {
+                        return false;
+                    }
+                }
+            }
+            else {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* the struct size before and after reordering, rounded up to 16 bytes */
+static void block_sizes(const spirv_module_t& mod, const ub_block_t& block, const std::vector<int>& order, uint32_t& out_size_before, uint32_t& out_size_after) {
+    out_size_before = 0;
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpMemberDecorate) && (inst.operands[0] == block.type_id) && (inst.operands[2] == (uint32_t)spv::DecorationOffset)) {
+            out_size_before = std::max(out_size_before, inst.operands[3] + block.members[inst.operands[1]].size);
+        }
+    }
+    std::vector<uint32_t> offsets;
+    out_size_before = (uint32_t)roundup((int)out_size_before, 16);
+    out_size_after = (uint32_t)roundup((int)std140_offsets(block.members, order, offsets), 16);
+}
+
+/* rewrite a uniform block struct and all its references to a new member order,
+    members which are not in the new order are removed
+*/
+static void apply_layout(spirv_module_t& mod, const ub_block_t& block, const std::vector<int>& order) {
+    std::vector<uint32_t> offsets;
+    std140_offsets(block.members, order, offsets);
+    const uint32_t removed = 0xFFFFFFFF;
+    std::vector<uint32_t> new_index(block.members.size(), removed);
+    for (size_t i = 0; i < order.size(); i++) {
+        new_index[order[i]] = (uint32_t)i;
+    }
+    // first create the new struct index constants, the old index constants
+    // may be shared with other code, so they can't be modified
+    std::map<uint32_t, uint32_t> index_consts;
+    std::set<uint32_t> loads;
+    for (size_t inst_index = 0; inst_index < mod.insts.size(); inst_index++) {
+        const spirv_inst_t& inst = mod.insts[inst_index];
+        if (((inst.op == spv::OpAccessChain) || (inst.op == spv::OpInBoundsAccessChain)) && (block.var_ids.count(inst.operands[2]) > 0)) {
+            const uint32_t old_const_id = inst.operands[3];
+            if (index_consts.count(old_const_id) == 0) {
+                const spirv_inst_t old_const = mod.insts[mod.find_def(old_const_id)];
+                index_consts[old_const_id] = mod.find_or_add_global(spv::OpConstant, { old_const.operands[0], new_index[old_const.operands[2]] }, 1);
+            }
+        }
+        else if ((inst.op == spv::OpLoad) && (block.var_ids.count(inst.operands[2]) > 0)) {
+            loads.insert(inst.operands[1]);
+        }
+    }
+    const std::vector<uint32_t> old_members = mod.insts[mod.find_def(block.type_id)].operands;
+    for (auto it = mod.insts.begin(); it != mod.insts.end();) {
+        spirv_inst_t& inst = *it;
+        if ((inst.op == spv::OpTypeStruct) && (inst.operands[0] == block.type_id)) {
+            inst.operands.resize(order.size() + 1);
+            for (size_t i = 0; i < order.size(); i++) {
+                inst.operands[i + 1] = old_members[order[i] + 1];
+            }
+        }
+        else if (((inst.op == spv::OpMemberName) || (inst.op == spv::OpMemberDecorate)) && (inst.operands[0] == block.type_id)) {
+            const uint32_t old_index = inst.operands[1];
+            if (new_index[old_index] == removed) {
+                it = mod.insts.erase(it);
+                continue;
+            }
+            inst.operands[1] = new_index[old_index];
+            if ((inst.op == spv::OpMemberDecorate) && (inst.operands[2] == (uint32_t)spv::DecorationOffset)) {
+                inst.operands[3] = offsets[old_index];
+            }
+        }
+        else if (((inst.op == spv::OpAccessChain) || (inst.op == spv::OpInBoundsAccessChain)) && (block.var_ids.count(inst.operands[2]) > 0)) {
+            inst.operands[3] = index_consts[inst.operands[3]];
+        }
+        else if ((inst.op == spv::OpCompositeExtract) && (loads.count(inst.operands[2]) > 0)) {
+            inst.operands[3] = new_index[inst.operands[3]];
+        }
+        ++it;
+    }
+}
+
+/* the SPIRV bytecode or GLSL100 fallback bytecode of a blob */
+struct ub_bytecode_t {
+    std::vector<uint32_t>* bytecode = nullptr;
+    spirv_blob_t* blob = nullptr;
+    slang_t::type_t slang = slang_t::GLSL330;
+};
+
+/* gather the SPIRV bytecode and GLSL100 fallback bytecode of all shader languages */
+static std::vector<ub_bytecode_t> gather_bytecodes(const args_t& args, std::array<spirv_t,slang_t::NUM>& spirv) {
+    std::vector<ub_bytecode_t> bytecodes;
+    for (int i = 0; i < slang_t::NUM; i++) {
+        if (args.slang & slang_t::bit((slang_t::type_t)i)) {
+            for (spirv_blob_t& blob: spirv[i].blobs) {
+                bytecodes.push_back({ &blob.bytecode, &blob, (slang_t::type_t)i });
+                if (!blob.fallback_bytecode.empty()) {
+                    bytecodes.push_back({ &blob.fallback_bytecode, &blob, (slang_t::type_t)i });
+                }
+            }
+        }
+    }
+    return bytecodes;
+}
+
+/* Reorder the uniform blocks in the SPIRV blobs of all shader languages, the
+    generated C structs are shared between all shader languages, so a uniform
+    block is only reordered if this is possible in all blobs
+*/
+void uniforms_t::reorder(const args_t& args, std::array<spirv_t,slang_t::NUM>& spirv) {
+    std::vector<ub_bytecode_t> bytecodes = gather_bytecodes(args, spirv);
+    std::vector<spirv_module_t> mods(bytecodes.size());
+    std::vector<std::vector<ub_block_t>> blocks(bytecodes.size());
+    std::set<std::string> skipped;
+    for (size_t i = 0; i < bytecodes.size(); i++) {
+        if (!spirv_module_t::parse(*bytecodes[i].bytecode, mods[i])) {
+            continue;
+        }
+        blocks[i] = gather_blocks(mods[i]);
+        for (const ub_block_t& block: blocks[i]) {
+            if (!is_rewritable(mods[i], block)) {
+                skipped.insert(block.name);
+            }
+        }
+    }
+    std::set<std::string> reported;
+    for (size_t i = 0; i < bytecodes.size(); i++) {
+        bool changed = false;
+        for (const ub_block_t& block: blocks[i]) {
+            if (skipped.count(block.name) > 0) {
+                continue;
+            }
+            const std::vector<int> order = plan_layout(block.members);
+            uint32_t size_before, size_after;
+            block_sizes(mods[i], block, order, size_before, size_after);
+            if (size_after < size_before) {
+                apply_layout(mods[i], block, order);
+                changed = true;
+            }
+            else {
+                size_after = size_before;
+            }
+            if (args.report && (reported.count(block.name) == 0)) {
+                reported.insert(block.name);
+                fmt::print("sokol-shdc: uniform block '{}' reordered: {} => {} bytes ({} saved)\n",
+                    block.name, size_before, size_after, size_before - size_after);
+            }
+        }
+        if (changed) {
+            *bytecodes[i].bytecode = mods[i].assemble();
+        }
+    }
+    for (const std::string& name: skipped) {
+        if (args.report && !name.empty()) {
+            fmt::print("sokol-shdc: uniform block '{}' not reordered (unsupported member types or accesses)\n", name);
+        }
+    }
+}
+
+/* the members of a uniform block which a shader reads in any shader language */
+struct ub_usage_t {
+    bool valid = true;
+    std::set<int> used;
+};
+
+/* gather the members of a uniform block which are read through access chains or loads */
+static void gather_used_members(const spirv_module_t& mod, const ub_block_t& block, std::set<int>& out_used) {
+    std::set<uint32_t> loads;
+    for (const spirv_inst_t& inst: mod.insts) {
+        if (((inst.op == spv::OpAccessChain) || (inst.op == spv::OpInBoundsAccessChain)) && (block.var_ids.count(inst.operands[2]) > 0)) {
+            bool valid = true;
+            out_used.insert((int)constant_u32(mod, inst.operands[3], valid));
+        }
+        else if ((inst.op == spv::OpLoad) && (block.var_ids.count(inst.operands[2]) > 0)) {
+            loads.insert(inst.operands[1]);
+        }
+        else if ((inst.op == spv::OpCompositeExtract) && (loads.count(inst.operands[2]) > 0)) {
+            out_used.insert((int)inst.operands[3]);
+        }
+    }
+}
+
+/* Compact the uniform blocks of each shader to the members the shader reads.
+    The used members are gathered over all shader languages (and the GLSL100
+    fallback SPIRV), so that a compacted uniform block has the same layout
+    everywhere. A compacted uniform block is renamed to [block]_[shader],
+    the blob keeps the uncompacted SPIRV for the reflection info of the
+    full uniform block.
+*/
+void uniforms_t::compact(const args_t& args, const input_t& inp, std::array<spirv_t,slang_t::NUM>& spirv) {
+    std::vector<ub_bytecode_t> bytecodes = gather_bytecodes(args, spirv);
+    std::vector<spirv_module_t> mods(bytecodes.size());
+    std::vector<std::vector<ub_block_t>> blocks(bytecodes.size());
+    std::map<std::pair<int, std::string>, ub_usage_t> usage;
+    for (size_t i = 0; i < bytecodes.size(); i++) {
+        if (!spirv_module_t::parse(*bytecodes[i].bytecode, mods[i])) {
+            continue;
+        }
+        blocks[i] = gather_blocks(mods[i]);
+        for (const ub_block_t& block: blocks[i]) {
+            ub_usage_t& ub_usage = usage[{ bytecodes[i].blob->snippet_index, block.name }];
+            if (is_rewritable(mods[i], block)) {
+                gather_used_members(mods[i], block, ub_usage.used);
+            }
+            else {
+                ub_usage.valid = false;
+            }
+        }
+    }
+    std::set<std::pair<int, std::string>> reported;
+    for (size_t i = 0; i < bytecodes.size(); i++) {
+        spirv_blob_t& blob = *bytecodes[i].blob;
+        const snippet_t& snippet = inp.snippets[blob.snippet_index];
+        bool changed = false;
+        for (const ub_block_t& block: blocks[i]) {
+            const std::pair<int, std::string> key = { blob.snippet_index, block.name };
+            const ub_usage_t& ub_usage = usage[key];
+            if (!ub_usage.valid || (ub_usage.used.size() == block.members.size())) {
+                continue;
+            }
+            // keep the used members in their current order, an empty block
+            // isn't valid in all shader languages, so keep at least one member
+            std::vector<int> order(ub_usage.used.begin(), ub_usage.used.end());
+            if (order.empty()) {
+                order.push_back(0);
+            }
+            uint32_t size_before, size_after;
+            block_sizes(mods[i], block, order, size_before, size_after);
+            const std::string compacted_name = fmt::format("{}_{}", block.name, snippet.name);
+            apply_layout(mods[i], block, order);
+            mods[i].set_name(block.type_id, compacted_name);
+            if (blob.uncompacted_bytecode.empty()) {
+                blob.uncompacted_bytecode = blob.bytecode;
+            }
+            blob.compacted_uniform_blocks[compacted_name] = block.name;
+            changed = true;
+            if (args.report && (reported.count(key) == 0)) {
+                reported.insert(key);
+                fmt::print("sokol-shdc: uniform block '{}' compacted for shader '{}': {} of {} members used, {} => {} bytes ({} saved)\n",
+                    block.name, snippet.name, order.size(), block.members.size(), size_before, size_after, size_before - size_after);
+            }
+        }
+        if (changed) {
+            *bytecodes[i].bytecode = mods[i].assemble();
+        }
+    }
+}
+
+/* the update frequency of a uniform block member, members without annotation
+    get the frequency of the whole uniform block, or are updated per draw
+*/
+static frequency_t::type_t member_frequency(const std::map<std::string, frequency_t::type_t>& frequencies, const std::string& member_name) {
+    auto it = frequencies.find(member_name);
+    if (it == frequencies.end()) {
+        it = frequencies.find("");
+    }
+    return (it != frequencies.end()) ? it->second : frequency_t::PER_DRAW;
+}
+
+/* a uniform block is only split if it isn't loaded as a whole */
+static bool has_block_loads(const spirv_module_t& mod, const ub_block_t& block) {
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpLoad) && (block.var_ids.count(inst.operands[2]) > 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* insert an instruction behind the last instruction with one of the given opcodes,
+    this keeps new debug names and decorations in their module sections
+*/
+static void insert_behind_last(spirv_module_t& mod, spv::Op op0, spv::Op op1, const spirv_inst_t& inst) {
+    int index = -1;
+    for (int i = 0; i < (int)mod.insts.size(); i++) {
+        if ((mod.insts[i].op == op0) || (mod.insts[i].op == op1)) {
+            index = i;
+        }
+    }
+    if (index < 0) {
+        mod.add_global(inst);
+    }
+    else {
+        mod.insts.insert(mod.insts.begin() + index + 1, inst);
+    }
+}
+
+/* move a group of uniform block members into a new uniform block, the member
+    names and decorations are copied, and the access chains are redirected
+*/
+static void split_members(spirv_module_t& mod, const ub_block_t& block, const std::vector<int>& members, const std::string& name) {
+    std::vector<uint32_t> offsets;
+    std140_offsets(block.members, members, offsets);
+    const std::vector<uint32_t> old_members = mod.insts[mod.find_def(block.type_id)].operands;
+    std::vector<uint32_t> struct_operands;
+    for (int member_index: members) {
+        struct_operands.push_back(old_members[member_index + 1]);
+    }
+    // a new struct type, never reuse an existing struct with the same members
+    const uint32_t type_id = mod.alloc_id();
+    struct_operands.insert(struct_operands.begin(), type_id);
+    mod.add_global(spirv_inst_t(spv::OpTypeStruct, struct_operands));
+    const uint32_t ptr_type_id = mod.find_or_add_global(spv::OpTypePointer, { (uint32_t)spv::StorageClassUniform, type_id }, 0);
+    const uint32_t var_id = mod.alloc_id();
+    mod.add_global(spirv_inst_t(spv::OpVariable, { ptr_type_id, var_id, (uint32_t)spv::StorageClassUniform }));
+    mod.add_decoration(type_id, spv::DecorationBlock);
+
+    // copy the member names and decorations, and the variable decorations (bind slots are assigned later)
+    std::vector<spirv_inst_t> new_insts;
+    const uint32_t old_var_id = *block.var_ids.begin();
+    for (const spirv_inst_t& inst: mod.insts) {
+        if (((inst.op == spv::OpMemberName) || (inst.op == spv::OpMemberDecorate)) && (inst.operands[0] == block.type_id)) {
+            auto it = std::find(members.begin(), members.end(), (int)inst.operands[1]);
+            if (it != members.end()) {
+                spirv_inst_t new_inst = inst;
+                new_inst.operands[0] = type_id;
+                new_inst.operands[1] = (uint32_t)(it - members.begin());
+                if ((inst.op == spv::OpMemberDecorate) && (inst.operands[2] == (uint32_t)spv::DecorationOffset)) {
+                    new_inst.operands[3] = offsets[inst.operands[1]];
+                }
+                new_insts.push_back(new_inst);
+            }
+        }
+        else if ((inst.op == spv::OpDecorate) && (inst.operands[0] == old_var_id)) {
+            spirv_inst_t new_inst = inst;
+            new_inst.operands[0] = var_id;
+            new_insts.push_back(new_inst);
+        }
+    }
+    std::vector<uint32_t> name_operands = { type_id };
+    const std::vector<uint32_t> words = spirv_module_t::string_words(name);
+    name_operands.insert(name_operands.end(), words.begin(), words.end());
+    new_insts.push_back(spirv_inst_t(spv::OpName, name_operands));
+    for (const spirv_inst_t& inst: new_insts) {
+        if ((inst.op == spv::OpName) || (inst.op == spv::OpMemberName)) {
+            insert_behind_last(mod, spv::OpName, spv::OpMemberName, inst);
+        }
+        else {
+            insert_behind_last(mod, spv::OpDecorate, spv::OpMemberDecorate, inst);
+        }
+    }
+
+    // redirect the access chains of the moved members to the new variable
+    std::map<uint32_t, uint32_t> index_consts;
+    for (size_t inst_index = 0; inst_index < mod.insts.size(); inst_index++) {
+        const spirv_inst_t& inst = mod.insts[inst_index];
+        if (((inst.op == spv::OpAccessChain) || (inst.op == spv::OpInBoundsAccessChain)) && (block.var_ids.count(inst.operands[2]) > 0)) {
+            const uint32_t old_const_id = inst.operands[3];
+            const spirv_inst_t old_const = mod.insts[mod.find_def(old_const_id)];
+            auto it = std::find(members.begin(), members.end(), (int)old_const.operands[2]);
+            if ((it != members.end()) && (index_consts.count(old_const_id) == 0)) {
+                index_consts[old_const_id] = mod.find_or_add_global(spv::OpConstant, { old_const.operands[0], (uint32_t)(it - members.begin()) }, 1);
+            }
+        }
+    }
+    for (spirv_inst_t& inst: mod.insts) {
+        if (((inst.op == spv::OpAccessChain) || (inst.op == spv::OpInBoundsAccessChain)) && (block.var_ids.count(inst.operands[2]) > 0)) {
+            bool valid = true;
+            const uint32_t member_index = constant_u32(mod, inst.operands[3], valid);
+            if (std::find(members.begin(), members.end(), (int)member_index) != members.end()) {
+                inst.operands[2] = var_id;
+                inst.operands[3] = index_consts[inst.operands[3]];
+            }
+        }
+    }
+}
+
+/* Split uniform blocks by the update frequency of their members (@per_frame,
+    @per_material and @per_draw) into uniform blocks named [block]_[frequency],
+    so that per-frame and per-material data doesn't need to be uploaded for
+    each draw call. The frequencies are taken from the member names, so all
+    shaders and shader languages split a uniform block the same way.
+*/
+errmsg_t uniforms_t::split(const args_t& args, const input_t& inp, std::array<spirv_t,slang_t::NUM>& spirv) {
+    if (inp.frequency_map.empty()) {
+        return errmsg_t();
+    }
+    std::vector<ub_bytecode_t> bytecodes = gather_bytecodes(args, spirv);
+    std::vector<spirv_module_t> mods(bytecodes.size());
+    std::vector<std::vector<ub_block_t>> blocks(bytecodes.size());
+    std::set<std::string> skipped;
+    for (size_t i = 0; i < bytecodes.size(); i++) {
+        if (!spirv_module_t::parse(*bytecodes[i].bytecode, mods[i])) {
+            continue;
+        }
+        blocks[i] = gather_blocks(mods[i]);
+        for (const ub_block_t& block: blocks[i]) {
+            if ((inp.frequency_map.count(block.name) > 0) && (!is_rewritable(mods[i], block) || has_block_loads(mods[i], block))) {
+                skipped.insert(block.name);
+            }
+        }
+    }
+
+    // check that the tagged uniform blocks and members exist in at least one shader,
+    // otherwise a typo would silently disable the split
+    for (const auto& item: inp.frequency_map) {
+        bool block_found = false;
+        std::set<std::string> member_names;
+        for (const std::vector<ub_block_t>& mod_blocks: blocks) {
+            for (const ub_block_t& block: mod_blocks) {
+                if (block.name == item.first) {
+                    block_found = true;
+                    member_names.insert(block.member_names.begin(), block.member_names.end());
+                }
+            }
+        }
+        if (!block_found) {
+            return inp.error(inp.frequency_lines.at(item.first), fmt::format("uniform block '{}' not found in any shader", item.first));
+        }
+        for (const auto& member: item.second) {
+            if (!member.first.empty() && (member_names.count(member.first) == 0)) {
+                return inp.error(inp.frequency_lines.at(fmt::format("{}.{}", item.first, member.first)),
+                    fmt::format("uniform '{}' not found in uniform block '{}'", member.first, item.first));
+            }
+        }
+    }
+
+    std::set<std::string> reported;
+    for (size_t i = 0; i < bytecodes.size(); i++) {
+        bool changed = false;
+        // each split adds uniform blocks to the shader stage, check the per-stage limit first
+        int num_blocks = (int)blocks[i].size();
+        for (const ub_block_t& block: blocks[i]) {
+            if ((inp.frequency_map.count(block.name) == 0) || (skipped.count(block.name) > 0)) {
+                continue;
+            }
+            std::array<bool, frequency_t::NUM> used = { };
+            for (const std::string& member_name: block.member_names) {
+                used[member_frequency(inp.frequency_map.at(block.name), member_name)] = true;
+            }
+            num_blocks += (int)std::count(used.begin(), used.end(), true) - 1;
+        }
+        if (num_blocks > uniform_block_t::NUM) {
+            const snippet_t& snippet = inp.snippets[bytecodes[i].blob->snippet_index];
+            return inp.error(snippet.lines[0], fmt::format("splitting uniform blocks by update frequency results in {} uniform blocks in {} '{}' (max {} per shader stage)",
+                num_blocks, snippet_t::type_to_str(snippet.type), snippet.name, uniform_block_t::NUM));
+        }
+        for (const ub_block_t& block: blocks[i]) {
+            if ((inp.frequency_map.count(block.name) == 0) || (skipped.count(block.name) > 0)) {
+                continue;
+            }
+            // group the members by update frequency, in their original order
+            std::array<std::vector<int>, frequency_t::NUM> groups;
+            for (int member_index = 0; member_index < (int)block.members.size(); member_index++) {
+                groups[member_frequency(inp.frequency_map.at(block.name), block.member_names[member_index])].push_back(member_index);
+            }
+            int num_groups = 0;
+            int first_group = -1;
+            std::array<uint32_t, frequency_t::NUM> sizes = { };
+            for (int freq = 0; freq < frequency_t::NUM; freq++) {
+                if (!groups[freq].empty()) {
+                    std::vector<uint32_t> offsets;
+                    sizes[freq] = (uint32_t)roundup((int)std140_offsets(block.members, groups[freq], offsets), 16);
+                    num_groups++;
+                    if (first_group < 0) {
+                        first_group = freq;
+                    }
+                }
+            }
+            if (num_groups < 2) {
+                continue;
+            }
+            // the first group stays in the original uniform block, the other groups
+            // are moved into new uniform blocks, in the order of their update frequency
+            uint32_t size_before, size_after;
+            block_sizes(mods[i], block, groups[first_group], size_before, size_after);
+            for (int freq = first_group + 1; freq < frequency_t::NUM; freq++) {
+                if (!groups[freq].empty()) {
+                    split_members(mods[i], block, groups[freq], fmt::format("{}_{}", block.name, frequency_t::to_str((frequency_t::type_t)freq)));
+                }
+            }
+            apply_layout(mods[i], block, groups[first_group]);
+            mods[i].set_name(block.type_id, fmt::format("{}_{}", block.name, frequency_t::to_str((frequency_t::type_t)first_group)));
+            changed = true;
+            if (args.report && (reported.count(block.name) == 0)) {
+                reported.insert(block.name);
+                fmt::print("sokol-shdc: uniform block '{}' split by update frequency: {} => {} bytes per draw (per_frame: {} bytes, per_material: {} bytes)\n",
+                    block.name, size_before, sizes[frequency_t::PER_DRAW], sizes[frequency_t::PER_FRAME], sizes[frequency_t::PER_MATERIAL]);
+            }
+        }
+        if (changed) {
+            *bytecodes[i].bytecode = mods[i].assemble();
+        }
+    }
+    if (args.report) {
+        for (const std::string& name: skipped) {
+            fmt::print("sokol-shdc: uniform block '{}' not split by update frequency (unsupported member types or accesses)\n", name);
+        }
+    }
+    return errmsg_t();
+}
+
+/* GLSL.std.450 extended instructions which can be computed on the CPU */
+enum ub_glsl_std_t {
+    UB_GLSL_ROUND = 1,
+    UB_GLSL_TRUNC = 3,
+    UB_GLSL_FABS = 4,
+    UB_GLSL_FLOOR = 8,
+    UB_GLSL_CEIL = 9,
+    UB_GLSL_FRACT = 10,
+    UB_GLSL_RADIANS = 11,
+    UB_GLSL_DEGREES = 12,
+    UB_GLSL_SIN = 13,
+    UB_GLSL_COS = 14,
+    UB_GLSL_TAN = 15,
+    UB_GLSL_ASIN = 16,
+    UB_GLSL_ACOS = 17,
+    UB_GLSL_ATAN = 18,
+    UB_GLSL_ATAN2 = 25,
+    UB_GLSL_POW = 26,
+    UB_GLSL_EXP = 27,
+    UB_GLSL_LOG = 28,
+    UB_GLSL_EXP2 = 29,
+    UB_GLSL_LOG2 = 30,
+    UB_GLSL_SQRT = 31,
+    UB_GLSL_INVERSE_SQRT = 32,
+    UB_GLSL_MATRIX_INVERSE = 34,
+    UB_GLSL_FMIN = 37,
+    UB_GLSL_FMAX = 40,
+    UB_GLSL_FCLAMP = 43,
+    UB_GLSL_FMIX = 46,
+    UB_GLSL_STEP = 48,
+    UB_GLSL_FMA = 50,
+    UB_GLSL_LENGTH = 66,
+    UB_GLSL_DISTANCE = 67,
+    UB_GLSL_CROSS = 68,
+    UB_GLSL_NORMALIZE = 69,
+};
+
+/* the C expression of a componentwise GLSL.std.450 instruction, or an empty string */
+static std::string glsl_std_expr(uint32_t ext_op, const std::string& a, const std::string& b, const std::string& c) {
+    switch (ext_op) {
+        case UB_GLSL_ROUND:         return fmt::format("roundf({})", a);
+        case UB_GLSL_TRUNC:         return fmt::format("truncf({})", a);
+        case UB_GLSL_FABS:          return fmt::format("fabsf({})", a);
+        case UB_GLSL_FLOOR:         return fmt::format("floorf({})", a);
+        case UB_GLSL_CEIL:          return fmt::format("ceilf({})", a);
+        case UB_GLSL_FRACT:         return fmt::format("({} - floorf({}))", a, a);
+        case UB_GLSL_RADIANS:       return fmt::format("({} * 0.0174532925f)", a);
+        case UB_GLSL_DEGREES:       return fmt::format("({} * 57.2957795f)", a);
+        case UB_GLSL_SIN:           return fmt::format("sinf({})", a);
+        case UB_GLSL_COS:           return fmt::format("cosf({})", a);
+        case UB_GLSL_TAN:           return fmt::format("tanf({})", a);
+        case UB_GLSL_ASIN:          return fmt::format("asinf({})", a);
+        case UB_GLSL_ACOS:          return fmt::format("acosf({})", a);
+        case UB_GLSL_ATAN:          return fmt::format("atanf({})", a);
+        case UB_GLSL_EXP:           return fmt::format("expf({})", a);
+        case UB_GLSL_LOG:           return fmt::format("logf({})", a);
+        case UB_GLSL_EXP2:          return fmt::format("exp2f({})", a);
+        case UB_GLSL_LOG2:          return fmt::format("log2f({})", a);
+        case UB_GLSL_SQRT:          return fmt::format("sqrtf({})", a);
+        case UB_GLSL_INVERSE_SQRT:  return fmt::format("(1.0f / sqrtf({}))", a);
+        case UB_GLSL_ATAN2:         return fmt::format("atan2f({}, {})", a, b);
+        case UB_GLSL_POW:           return fmt::format("powf({}, {})", a, b);
+        case UB_GLSL_FMIN:          return fmt::format("fminf({}, {})", a, b);
+        case UB_GLSL_FMAX:          return fmt::format("fmaxf({}, {})", a, b);
+        case UB_GLSL_STEP:          return fmt::format("(({} < {}) ? 0.0f : 1.0f)", b, a);
+        case UB_GLSL_FCLAMP:        return fmt::format("fminf(fmaxf({}, {}), {})", a, b, c);
+        case UB_GLSL_FMIX:          return fmt::format("({} + ({} - {}) * {})", a, b, a, c);
+        case UB_GLSL_FMA:           return fmt::format("({} * {} + {})", a, b, c);
+        default:                    return "";
+    }
+}
+
+/* a uniform-only value, or a float constant, which can be computed on the CPU */
+struct ub_expr_t {
+    spv::Op op = spv::OpNop;            // the defining instruction
+    uint32_t var_id = 0;                // the uniform block variable of all loads, 0 for constants
+    bool has_math = false;              // false for loads, constants, and values which only move components around
+    uint32_t cols = 1;                  // the float scalar, vector or matrix shape
+    uint32_t rows = 1;
+    std::string key;                    // canonical expression, identical for identical expressions in all shaders
+    std::string ptr;                    // loads: C expression of the float pointer into the 'in' struct
+    std::vector<uint32_t> args;         // value operands
+    std::vector<uint32_t> literals;     // literal operands (composite indices, shuffle components, extended instruction)
+    std::vector<float> values;          // constants: the float values
+
+    uint32_t num() const {
+        return cols * rows;
+    }
+};
+
+/* a hoisted uniform-only expression */
+struct ub_hoist_t {
+    std::string key;
+    uint32_t cols = 1;
+    uint32_t rows = 1;
+    std::vector<std::string> code;
+};
+
+/* the shape of a 32-bit float scalar, vector or matrix type */
+static bool float_shape(const spirv_module_t& mod, uint32_t type_id, uint32_t& out_cols, uint32_t& out_rows) {
+    const int index = mod.find_def(type_id);
+    if (index < 0) {
+        return false;
+    }
+    const spirv_inst_t& inst = mod.insts[index];
+    if (inst.op == spv::OpTypeFloat) {
+        out_cols = 1;
+        out_rows = 1;
+        return inst.operands[1] == 32;
+    }
+    else if (inst.op == spv::OpTypeVector) {
+        uint32_t cols, rows;
+        out_cols = 1;
+        out_rows = inst.operands[2];
+        return float_shape(mod, inst.operands[1], cols, rows) && (rows == 1);
+    }
+    else if (inst.op == spv::OpTypeMatrix) {
+        uint32_t cols;
+        out_cols = inst.operands[2];
+        return float_shape(mod, inst.operands[1], cols, out_rows) && (cols == 1) && (out_rows > 1);
+    }
+    return false;
+}
+
+/* check if a value can be stored in a uniform block member (float, vec2..4 or mat4) */
+static bool is_uniform_shape(const ub_expr_t& expr) {
+    return (expr.cols == 1) || ((expr.cols == 4) && (expr.rows == 4));
+}
+
+/* the C pointer expression and canonical key of an access chain into a uniform block,
+    a chain must end at a float scalar, vector or matrix, the 'in' struct stores
+    these as float arrays (matrices in column-major order)
+*/
+static bool access_chain_ptr(const spirv_module_t& mod, const ub_block_t& block, const spirv_inst_t& chain, std::string& out_ptr, std::string& out_key) {
+    std::vector<uint32_t> indices;
+    for (size_t i = 3; i < chain.operands.size(); i++) {
+        bool valid = true;
+        indices.push_back(constant_u32(mod, chain.operands[i], valid));
+        if (!valid) {
+            return false;
+        }
+    }
+    if (indices.empty() || (indices[0] >= block.members.size()) || block.member_names[indices[0]].empty()) {
+        return false;
+    }
+    const std::string& name = block.member_names[indices[0]];
+    std::string base = fmt::format("in->{}", name);
+    uint32_t type_id = mod.insts[mod.find_def(block.type_id)].operands[indices[0] + 1];
+    size_t pos = 1;
+    if (mod.insts[mod.find_def(type_id)].op == spv::OpTypeArray) {
+        if (indices.size() < 2) {
+            return false;
+        }
+        base += fmt::format("[{}]", indices[1]);
+        type_id = mod.insts[mod.find_def(type_id)].operands[1];
+        pos = 2;
+    }
+    uint32_t offset = 0;
+    for (; pos < indices.size(); pos++) {
+        const spirv_inst_t& type_inst = mod.insts[mod.find_def(type_id)];
+        uint32_t cols, rows;
+        if (type_inst.op == spv::OpTypeMatrix) {
+            float_shape(mod, type_inst.operands[1], cols, rows);
+            offset += indices[pos] * rows;
+        }
+        else if (type_inst.op == spv::OpTypeVector) {
+            offset += indices[pos];
+        }
+        else {
+            return false;
+        }
+        type_id = type_inst.operands[1];
+    }
+    out_ptr = fmt::format("((const float*)&{}) + {}", base, offset);
+    out_key = fmt::format("{}@{}", base, offset);
+    return true;
+}
+
+/* find the float constants and the uniform-only values of a uniform block, in
+    instruction order (values are always defined before they are used)
+*/
+static std::map<uint32_t, ub_expr_t> gather_exprs(const spirv_module_t& mod, const ub_block_t& block) {
+    std::map<uint32_t, ub_expr_t> exprs;
+    std::map<uint32_t, std::pair<std::string, std::string>> ptrs;
+    uint32_t glsl_std_id = 0;
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpExtInstImport) && (std::string((const char*)&inst.operands[1]) == "GLSL.std.450")) {
+            glsl_std_id = inst.operands[0];
+            continue;
+        }
+        if (((inst.op == spv::OpAccessChain) || (inst.op == spv::OpInBoundsAccessChain)) && (block.var_ids.count(inst.operands[2]) > 0)) {
+            std::string ptr, key;
+            if (access_chain_ptr(mod, block, inst, ptr, key)) {
+                ptrs[inst.operands[1]] = { ptr, key };
+            }
+            continue;
+        }
+        ub_expr_t expr;
+        expr.op = inst.op;
+        if ((inst.operands.size() < 2) || !float_shape(mod, inst.operands[0], expr.cols, expr.rows)) {
+            continue;
+        }
+        bool is_math = true;
+        switch (inst.op) {
+            case spv::OpConstant:
+                {
+                    float val;
+                    memcpy(&val, &inst.operands[2], sizeof(val));
+                    if (!std::isfinite(val)) {
+                        continue;
+                    }
+                    expr.values.push_back(val);
+                    expr.key = fmt::format("{:#x}", inst.operands[2]);
+                    exprs[inst.operands[1]] = expr;
+                }
+                continue;
+            case spv::OpConstantComposite:
+                {
+                    bool valid = true;
+                    for (size_t i = 2; i < inst.operands.size(); i++) {
+                        auto it = exprs.find(inst.operands[i]);
+                        if ((it == exprs.end()) || (it->second.op != spv::OpConstant && it->second.op != spv::OpConstantComposite)) {
+                            valid = false;
+                            break;
+                        }
+                        expr.values.insert(expr.values.end(), it->second.values.begin(), it->second.values.end());
+                        expr.key += ((i > 2) ? "," : "") + it->second.key;
+                    }
+                    if (valid) {
+                        expr.key = "{" + expr.key + "}";
+                        exprs[inst.operands[1]] = expr;
+                    }
+                }
+                continue;
+            case spv::OpLoad:
+                {
+                    auto it = ptrs.find(inst.operands[2]);
+                    if ((it == ptrs.end()) || (inst.operands.size() != 3)) {
+                        continue;
+                    }
+                    expr.ptr = it->second.first;
+                    expr.key = it->second.second;
+                    expr.var_id = *block.var_ids.begin();
+                    exprs[inst.operands[1]] = expr;
+                }
+                continue;
+            case spv::OpFNegate:
+            case spv::OpFAdd:
+            case spv::OpFSub:
+            case spv::OpFMul:
+            case spv::OpFDiv:
+            case spv::OpFRem:
+            case spv::OpFMod:
+            case spv::OpVectorTimesScalar:
+            case spv::OpMatrixTimesScalar:
+            case spv::OpVectorTimesMatrix:
+            case spv::OpMatrixTimesVector:
+            case spv::OpMatrixTimesMatrix:
+            case spv::OpDot:
+                expr.args.assign(inst.operands.begin() + 2, inst.operands.end());
+                break;
+            case spv::OpCompositeConstruct:
+                expr.args.assign(inst.operands.begin() + 2, inst.operands.end());
+                is_math = false;
+                break;
+            case spv::OpCompositeExtract:
+                expr.args.push_back(inst.operands[2]);
+                expr.literals.assign(inst.operands.begin() + 3, inst.operands.end());
+                is_math = false;
+                break;
+            case spv::OpVectorShuffle:
+                expr.args.assign(inst.operands.begin() + 2, inst.operands.begin() + 4);
+                expr.literals.assign(inst.operands.begin() + 4, inst.operands.end());
+                is_math = false;
+                break;
+            case spv::OpExtInst:
+                {
+                    const uint32_t ext_op = inst.operands[3];
+                    const bool is_special = (ext_op == UB_GLSL_LENGTH) || (ext_op == UB_GLSL_DISTANCE) || (ext_op == UB_GLSL_CROSS) || (ext_op == UB_GLSL_NORMALIZE) ||
+                                            ((ext_op == UB_GLSL_MATRIX_INVERSE) && (expr.cols == 4) && (expr.rows == 4));
+                    if ((glsl_std_id == 0) || (inst.operands[2] != glsl_std_id) || (!is_special && glsl_std_expr(ext_op, "a", "b", "c").empty())) {
+                        continue;
+                    }
+                    expr.args.assign(inst.operands.begin() + 4, inst.operands.end());
+                    expr.literals.push_back(ext_op);
+                }
+                break;
+            default:
+                continue;
+        }
+        // all operands must be uniform-only values of the same uniform block, or constants
+        bool valid = true;
+        std::string args_key;
+        for (uint32_t arg: expr.args) {
+            auto it = exprs.find(arg);
+            if ((it == exprs.end()) || ((it->second.var_id != 0) && (expr.var_id != 0) && (it->second.var_id != expr.var_id))) {
+                valid = false;
+                break;
+            }
+            if (it->second.var_id != 0) {
+                expr.var_id = it->second.var_id;
+            }
+            expr.has_math |= it->second.has_math;
+            args_key += (args_key.empty() ? "" : ",") + it->second.key;
+        }
+        if (!valid || (expr.var_id == 0)) {
+            continue;
+        }
+        expr.has_math |= is_math;
+        std::string literals_key;
+        for (uint32_t literal: expr.literals) {
+            literals_key += fmt::format(",{}", literal);
+        }
+        expr.key = fmt::format("{}:{}x{}({}{})", (int)inst.op, expr.cols, expr.rows, args_key, literals_key);
+        exprs[inst.operands[1]] = expr;
+    }
+    return exprs;
+}
+
+/* Find the maximal uniform-only expressions: the uniform-only values which are
+    used by instructions that stay in the shader. Values which can't be stored
+    in a uniform block member stay in the shader too, so their operands become
+    candidates. Loads and component moves alone aren't worth hoisting.
+*/
+static std::set<uint32_t> find_hoist_roots(const spirv_module_t& mod, const std::map<uint32_t, ub_expr_t>& exprs) {
+    std::vector<uint32_t> work;
+    for (const spirv_inst_t& inst: mod.insts) {
+        switch (inst.op) {
+            case spv::OpName:
+            case spv::OpMemberName:
+            case spv::OpDecorate:
+            case spv::OpMemberDecorate:
+            case spv::OpEntryPoint:
+                continue;
+            default:
+                break;
+        }
+        if (inst.operands.size() >= 2) {
+            auto it = exprs.find(inst.operands[1]);
+            if ((it != exprs.end()) && (it->second.op == inst.op)) {
+                continue;
+            }
+        }
+        for (uint32_t operand: inst.operands) {
+            if (exprs.count(operand) > 0) {
+                work.push_back(operand);
+            }
+        }
+    }
+    std::set<uint32_t> roots;
+    std::set<uint32_t> visited;
+    while (!work.empty()) {
+        const uint32_t id = work.back();
+        work.pop_back();
+        if (!visited.insert(id).second) {
+            continue;
+        }
+        const ub_expr_t& expr = exprs.at(id);
+        if (expr.var_id == 0) {
+            continue;
+        }
+        if (expr.has_math && is_uniform_shape(expr)) {
+            roots.insert(id);
+            continue;
+        }
+        // the value stays in the shader, and needs its operands there
+        work.insert(work.end(), expr.args.begin(), expr.args.end());
+    }
+    return roots;
+}
+
+/* the C statements of a 4x4 matrix inverse (cofactor expansion) */
+static void inverse4_code(const std::string& m, const std::string& r, std::vector<std::string>& code) {
+    static const char* cofactors[16] = {
+        "+{m}[5]*{m}[10]*{m}[15] - {m}[5]*{m}[11]*{m}[14] - {m}[9]*{m}[6]*{m}[15] + {m}[9]*{m}[7]*{m}[14] + {m}[13]*{m}[6]*{m}[11] - {m}[13]*{m}[7]*{m}[10]",
+        "-{m}[1]*{m}[10]*{m}[15] + {m}[1]*{m}[11]*{m}[14] + {m}[9]*{m}[2]*{m}[15] - {m}[9]*{m}[3]*{m}[14] - {m}[13]*{m}[2]*{m}[11] + {m}[13]*{m}[3]*{m}[10]",
+        "+{m}[1]*{m}[6]*{m}[15] - {m}[1]*{m}[7]*{m}[14] - {m}[5]*{m}[2]*{m}[15] + {m}[5]*{m}[3]*{m}[14] + {m}[13]*{m}[2]*{m}[7] - {m}[13]*{m}[3]*{m}[6]",
+        "-{m}[1]*{m}[6]*{m}[11] + {m}[1]*{m}[7]*{m}[10] + {m}[5]*{m}[2]*{m}[11] - {m}[5]*{m}[3]*{m}[10] - {m}[9]*{m}[2]*{m}[7] + {m}[9]*{m}[3]*{m}[6]",
+        "-{m}[4]*{m}[10]*{m}[15] + {m}[4]*{m}[11]*{m}[14] + {m}[8]*{m}[6]*{m}[15] - {m}[8]*{m}[7]*{m}[14] - {m}[12]*{m}[6]*{m}[11] + {m}[12]*{m}[7]*{m}[10]",
+        "+{m}[0]*{m}[10]*{m}[15] - {m}[0]*{m}[11]*{m}[14] - {m}[8]*{m}[2]*{m}[15] + {m}[8]*{m}[3]*{m}[14] + {m}[12]*{m}[2]*{m}[11] - {m}[12]*{m}[3]*{m}[10]",
+        "-{m}[0]*{m}[6]*{m}[15] + {m}[0]*{m}[7]*{m}[14] + {m}[4]*{m}[2]*{m}[15] - {m}[4]*{m}[3]*{m}[14] - {m}[12]*{m}[2]*{m}[7] + {m}[12]*{m}[3]*{m}[6]",
+        "+{m}[0]*{m}[6]*{m}[11] - {m}[0]*{m}[7]*{m}[10] - {m}[4]*{m}[2]*{m}[11] + {m}[4]*{m}[3]*{m}[10] + {m}[8]*{m}[2]*{m}[7] - {m}[8]*{m}[3]*{m}[6]",
+        "+{m}[4]*{m}[9]*{m}[15] - {m}[4]*{m}[11]*{m}[13] - {m}[8]*{m}[5]*{m}[15] + {m}[8]*{m}[7]*{m}[13] + {m}[12]*{m}[5]*{m}[11] - {m}[12]*{m}[7]*{m}[9]",
+        "-{m}[0]*{m}[9]*{m}[15] + {m}[0]*{m}[11]*{m}[13] + {m}[8]*{m}[1]*{m}[15] - {m}[8]*{m}[3]*{m}[13] - {m}[12]*{m}[1]*{m}[11] + {m}[12]*{m}[3]*{m}[9]",
+        "+{m}[0]*{m}[5]*{m}[15] - {m}[0]*{m}[7]*{m}[13] - {m}[4]*{m}[1]*{m}[15] + {m}[4]*{m}[3]*{m}[13] + {m}[12]*{m}[1]*{m}[7] - {m}[12]*{m}[3]*{m}[5]",
+        "-{m}[0]*{m}[5]*{m}[11] + {m}[0]*{m}[7]*{m}[9] + {m}[4]*{m}[1]*{m}[11] - {m}[4]*{m}[3]*{m}[9] - {m}[8]*{m}[1]*{m}[7] + {m}[8]*{m}[3]*{m}[5]",
+        "-{m}[4]*{m}[9]*{m}[14] + {m}[4]*{m}[10]*{m}[13] + {m}[8]*{m}[5]*{m}[14] - {m}[8]*{m}[6]*{m}[13] - {m}[12]*{m}[5]*{m}[10] + {m}[12]*{m}[6]*{m}[9]",
+        "+{m}[0]*{m}[9]*{m}[14] - {m}[0]*{m}[10]*{m}[13] - {m}[8]*{m}[1]*{m}[14] + {m}[8]*{m}[2]*{m}[13] + {m}[12]*{m}[1]*{m}[10] - {m}[12]*{m}[2]*{m}[9]",
+        "-{m}[0]*{m}[5]*{m}[14] + {m}[0]*{m}[6]*{m}[13] + {m}[4]*{m}[1]*{m}[14] - {m}[4]*{m}[2]*{m}[13] - {m}[12]*{m}[1]*{m}[6] + {m}[12]*{m}[2]*{m}[5]",
+        "+{m}[0]*{m}[5]*{m}[10] - {m}[0]*{m}[6]*{m}[9] - {m}[4]*{m}[1]*{m}[10] + {m}[4]*{m}[2]*{m}[9] + {m}[8]*{m}[1]*{m}[6] - {m}[8]*{m}[2]*{m}[5]",
+    };
+    for (int i = 0; i < 16; i++) {
+        code.push_back(fmt::format("{}[{}] = {};", r, i, pystring::replace(cofactors[i], "{m}", m)));
+    }
+    code.push_back(fmt::format("{{ const float det = {m}[0]*{r}[0] + {m}[1]*{r}[4] + {m}[2]*{r}[8] + {m}[3]*{r}[12]; for (int i = 0; i < 16; i++) {{ {r}[i] /= det; }} }}", fmt::arg("m", m), fmt::arg("r", r)));
+}
+
+/* generate the C statements which compute a uniform-only value into a float array t[id] */
+static void expr_code(const std::map<uint32_t, ub_expr_t>& exprs, uint32_t id, std::set<uint32_t>& emitted, std::vector<std::string>& code) {
+    if (!emitted.insert(id).second) {
+        return;
+    }
+    const ub_expr_t& expr = exprs.at(id);
+    for (uint32_t arg: expr.args) {
+        expr_code(exprs, arg, emitted, code);
+    }
+    const std::string t = fmt::format("t{}", id);
+    const std::string a = expr.args.empty() ? "" : fmt::format("t{}", expr.args[0]);
+    const std::string b = (expr.args.size() < 2) ? "" : fmt::format("t{}", expr.args[1]);
+    const std::string c = (expr.args.size() < 3) ? "" : fmt::format("t{}", expr.args[2]);
+    const uint32_t n = expr.num();
+    const ub_expr_t* a_expr = expr.args.empty() ? nullptr : &exprs.at(expr.args[0]);
+    const ub_expr_t* b_expr = (expr.args.size() < 2) ? nullptr : &exprs.at(expr.args[1]);
+    if ((expr.op == spv::OpConstant) || (expr.op == spv::OpConstantComposite)) {
+        std::string values;
+        for (float val: expr.values) {
+            values += fmt::format("{}{:.9e}f", values.empty() ? "" : ", ", val);
+        }
+        code.push_back(fmt::format("const float {}[{}] = {{ {} }};", t, n, values));
+        return;
+    }
+    code.push_back(fmt::format("float {}[{}];", t, n));
+    switch (expr.op) {
+        case spv::OpLoad:
+            code.push_back(fmt::format("memcpy({}, {}, sizeof({}));", t, expr.ptr, t));
+            break;
+        case spv::OpFNegate:
+            code.push_back(fmt::format("for (int i = 0; i < {}; i++) {{ {}[i] = -{}[i]; }}", n, t, a));
+            break;
+        case spv::OpFAdd:
+        case spv::OpFSub:
+        case spv::OpFMul:
+        case spv::OpFDiv:
+            {
+                const char* op_str = (expr.op == spv::OpFAdd) ? "+" : (expr.op == spv::OpFSub) ? "-" : (expr.op == spv::OpFMul) ? "*" : "/";
+                code.push_back(fmt::format("for (int i = 0; i < {}; i++) {{ {}[i] = {}[i] {} {}[i]; }}", n, t, a, op_str, b));
+            }
+            break;
+        case spv::OpFRem:
+            code.push_back(fmt::format("for (int i = 0; i < {}; i++) {{ {}[i] = fmodf({}[i], {}[i]); }}", n, t, a, b));
+            break;
+        case spv::OpFMod:
+            code.push_back(fmt::format("for (int i = 0; i < {}; i++) {{ {}[i] = {}[i] - {}[i] * floorf({}[i] / {}[i]); }}", n, t, a, b, a, b));
+            break;
+        case spv::OpVectorTimesScalar:
+        case spv::OpMatrixTimesScalar:
+            code.push_back(fmt::format("for (int i = 0; i < {}; i++) {{ {}[i] = {}[i] * {}[0]; }}", n, t, a, b));
+            break;
+        case spv::OpMatrixTimesVector:
+            code.push_back(fmt::format("for (int r = 0; r < {}; r++) {{ {}[r] = 0.0f; for (int c = 0; c < {}; c++) {{ {}[r] += {}[c * {} + r] * {}[c]; }} }}",
+                a_expr->rows, t, a_expr->cols, t, a, a_expr->rows, b));
+            break;
+        case spv::OpVectorTimesMatrix:
+            code.push_back(fmt::format("for (int c = 0; c < {}; c++) {{ {}[c] = 0.0f; for (int r = 0; r < {}; r++) {{ {}[c] += {}[r] * {}[c * {} + r]; }} }}",
+                b_expr->cols, t, b_expr->rows, t, a, b, b_expr->rows));
+            break;
+        case spv::OpMatrixTimesMatrix:
+            code.push_back(fmt::format("for (int c = 0; c < {}; c++) {{ for (int r = 0; r < {}; r++) {{ {}[c * {} + r] = 0.0f; for (int k = 0; k < {}; k++) {{ {}[c * {} + r] += {}[k * {} + r] * {}[c * {} + k]; }} }} }}",
+                b_expr->cols, a_expr->rows, t, a_expr->rows, a_expr->cols, t, a_expr->rows, a, a_expr->rows, b, b_expr->rows));
+            break;
+        case spv::OpDot:
+            code.push_back(fmt::format("{}[0] = 0.0f; for (int i = 0; i < {}; i++) {{ {}[0] += {}[i] * {}[i]; }}", t, a_expr->num(), t, a, b));
+            break;
+        case spv::OpCompositeConstruct:
+            {
+                uint32_t dst = 0;
+                for (uint32_t arg: expr.args) {
+                    for (uint32_t src = 0; src < exprs.at(arg).num(); src++) {
+                        code.push_back(fmt::format("{}[{}] = t{}[{}];", t, dst++, arg, src));
+                    }
+                }
+            }
+            break;
+        case spv::OpCompositeExtract:
+            {
+                uint32_t offset = expr.literals[0];
+                if (a_expr->cols > 1) {
+                    // first index selects a matrix column
+                    offset = expr.literals[0] * a_expr->rows + ((expr.literals.size() > 1) ? expr.literals[1] : 0);
+                }
+                code.push_back(fmt::format("memcpy({}, {} + {}, sizeof({}));", t, a, offset, t));
+            }
+            break;
+        case spv::OpVectorShuffle:
+            for (uint32_t i = 0; i < (uint32_t)expr.literals.size(); i++) {
+                const uint32_t comp = expr.literals[i];
+                if (comp == 0xFFFFFFFF) {
+                    code.push_back(fmt::format("{}[{}] = 0.0f;", t, i));
+                }
+                else if (comp < a_expr->num()) {
+                    code.push_back(fmt::format("{}[{}] = {}[{}];", t, i, a, comp));
+                }
+                else {
+                    code.push_back(fmt::format("{}[{}] = {}[{}];", t, i, b, comp - a_expr->num()));
+                }
+            }
+            break;
+        case spv::OpExtInst:
+            switch (expr.literals[0]) {
+                case UB_GLSL_LENGTH:
+                    code.push_back(fmt::format("{}[0] = 0.0f; for (int i = 0; i < {}; i++) {{ {}[0] += {}[i] * {}[i]; }} {}[0] = sqrtf({}[0]);", t, a_expr->num(), t, a, a, t, t));
+                    break;
+                case UB_GLSL_DISTANCE:
+                    code.push_back(fmt::format("{}[0] = 0.0f; for (int i = 0; i < {}; i++) {{ const float d = {}[i] - {}[i]; {}[0] += d * d; }} {}[0] = sqrtf({}[0]);", t, a_expr->num(), a, b, t, t, t));
+                    break;
+                case UB_GLSL_NORMALIZE:
+                    code.push_back(fmt::format("{{ float len = 0.0f; for (int i = 0; i < {}; i++) {{ len += {}[i] * {}[i]; }} len = sqrtf(len); for (int i = 0; i < {}; i++) {{ {}[i] = {}[i] / len; }} }}", n, a, a, n, t, a));
+                    break;
+                case UB_GLSL_CROSS:
+                    code.push_back(fmt::format("{}[0] = {}[1] * {}[2] - {}[2] * {}[1];", t, a, b, a, b));
+                    code.push_back(fmt::format("{}[1] = {}[2] * {}[0] - {}[0] * {}[2];", t, a, b, a, b));
+                    code.push_back(fmt::format("{}[2] = {}[0] * {}[1] - {}[1] * {}[0];", t, a, b, a, b));
+                    break;
+                case UB_GLSL_MATRIX_INVERSE:
+                    inverse4_code(a, t, code);
+                    break;
+                default:
+                    code.push_back(fmt::format("for (int i = 0; i < {}; i++) {{ {}[i] = {}; }}", n, t,
+                        glsl_std_expr(expr.literals[0], a + "[i]", b.empty() ? "" : (b + "[i]"), c.empty() ? "" : (c + "[i]"))));
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/* find a type declaration, or add it in front of another declaration which uses it */
+static uint32_t find_or_add_type(spirv_module_t& mod, spv::Op op, const std::vector<uint32_t>& operands, uint32_t user_id) {
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == op) && (inst.operands.size() == (operands.size() + 1)) && std::equal(operands.begin(), operands.end(), inst.operands.begin() + 1)) {
+            return inst.operands[0];
+        }
+    }
+    const uint32_t id = mod.alloc_id();
+    spirv_inst_t inst(op, operands);
+    inst.operands.insert(inst.operands.begin(), id);
+    mod.insts.insert(mod.insts.begin() + mod.find_def(user_id), inst);
+    return id;
+}
+
+/* append the hoisted expressions as new members to a uniform block struct */
+static void append_hoisted_members(spirv_module_t& mod, const ub_block_t& block, const std::vector<ub_hoist_t>& hoists) {
+    uint32_t end = 0;
+    for (const spirv_inst_t& inst: mod.insts) {
+        if ((inst.op == spv::OpMemberDecorate) && (inst.operands[0] == block.type_id) && (inst.operands[2] == (uint32_t)spv::DecorationOffset)) {
+            end = std::max(end, inst.operands[3] + block.members[inst.operands[1]].size);
+        }
+    }
+    for (size_t i = 0; i < hoists.size(); i++) {
+        const ub_hoist_t& hoist = hoists[i];
+        const uint32_t member_index = (uint32_t)(block.members.size() + i);
+        uint32_t type_id = find_or_add_type(mod, spv::OpTypeFloat, { 32 }, block.type_id);
+        uint32_t size = 4;
+        uint32_t align = 4;
+        if (hoist.rows > 1) {
+            type_id = find_or_add_type(mod, spv::OpTypeVector, { type_id, hoist.rows }, block.type_id);
+            size = 4 * hoist.rows;
+            align = (hoist.rows == 3) ? 16 : size;
+        }
+        if (hoist.cols > 1) {
+            type_id = find_or_add_type(mod, spv::OpTypeMatrix, { type_id, hoist.cols }, block.type_id);
+            size = 16 * hoist.cols;
+            align = 16;
+        }
+        mod.insts[mod.find_def(block.type_id)].operands.push_back(type_id);
+        const uint32_t offset = (uint32_t)roundup((int)end, (int)align);
+        end = offset + size;
+        std::vector<uint32_t> name_operands = { block.type_id, member_index };
+        const std::vector<uint32_t> words = spirv_module_t::string_words(fmt::format("hoisted{}", i));
+        name_operands.insert(name_operands.end(), words.begin(), words.end());
+        insert_behind_last(mod, spv::OpName, spv::OpMemberName, spirv_inst_t(spv::OpMemberName, name_operands));
+        insert_behind_last(mod, spv::OpDecorate, spv::OpMemberDecorate, spirv_inst_t(spv::OpMemberDecorate, { block.type_id, member_index, (uint32_t)spv::DecorationOffset, offset }));
+        if (hoist.cols > 1) {
+            insert_behind_last(mod, spv::OpDecorate, spv::OpMemberDecorate, spirv_inst_t(spv::OpMemberDecorate, { block.type_id, member_index, (uint32_t)spv::DecorationColMajor }));
+            insert_behind_last(mod, spv::OpDecorate, spv::OpMemberDecorate, spirv_inst_t(spv::OpMemberDecorate, { block.type_id, member_index, (uint32_t)spv::DecorationMatrixStride, 16 }));
+        }
+    }
+}
+
+/* replace a hoisted value with a load from its new uniform block member */
+static void replace_hoisted_value(spirv_module_t& mod, const ub_expr_t& expr, uint32_t value_id, uint32_t member_index) {
+    int def_index = -1;
+    for (int i = 0; i < (int)mod.insts.size(); i++) {
+        if ((mod.insts[i].op == expr.op) && (mod.insts[i].operands.size() >= 2) && (mod.insts[i].operands[1] == value_id)) {
+            def_index = i;
+            break;
+        }
+    }
+    if (def_index < 0) {
+        return;
+    }
+    const uint32_t type_id = mod.insts[def_index].operands[0];
+    const uint32_t ptr_type_id = mod.find_or_add_global(spv::OpTypePointer, { (uint32_t)spv::StorageClassUniform, type_id }, 0);
+    const uint32_t int_type_id = mod.find_or_add_global(spv::OpTypeInt, { 32, 1 }, 0);
+    const uint32_t index_id = mod.find_or_add_global(spv::OpConstant, { int_type_id, member_index }, 1);
+    const uint32_t chain_id = mod.alloc_id();
+    // the global declarations have been inserted in front of the value
+    for (def_index = 0; def_index < (int)mod.insts.size(); def_index++) {
+        if ((mod.insts[def_index].op == expr.op) && (mod.insts[def_index].operands.size() >= 2) && (mod.insts[def_index].operands[1] == value_id)) {
+            break;
+        }
+    }
+    mod.insts[def_index] = spirv_inst_t(spv::OpAccessChain, { ptr_type_id, chain_id, expr.var_id, index_id });
+    mod.insts.insert(mod.insts.begin() + def_index + 1, spirv_inst_t(spv::OpLoad, { type_id, value_id, chain_id }));
+}
+
+/* Hoist the maximal uniform-only expressions out of the shaders: each expression
+    becomes a new uniform block member, which is computed on the CPU by a generated
+    [block]_prepare() function. All shaders which use a uniform block get the same
+    new members (from all shaders and shader languages), so that the uniform block
+    layout stays identical everywhere.
+*/
+void uniforms_t::hoist(const args_t& args, input_t& inp, std::array<spirv_t,slang_t::NUM>& spirv) {
+    std::vector<ub_bytecode_t> bytecodes = gather_bytecodes(args, spirv);
+    std::vector<spirv_module_t> mods(bytecodes.size());
+    std::vector<std::vector<ub_block_t>> blocks(bytecodes.size());
+    std::set<std::string> skipped;
+    for (size_t i = 0; i < bytecodes.size(); i++) {
+        if (!spirv_module_t::parse(*bytecodes[i].bytecode, mods[i])) {
+            continue;
+        }
+        blocks[i] = gather_blocks(mods[i]);
+        for (const ub_block_t& block: blocks[i]) {
+            if (!is_rewritable(mods[i], block)) {
+                skipped.insert(block.name);
+            }
+        }
+    }
+    // gather the hoisted expressions of each uniform block over all shaders
+    std::map<std::string, std::vector<ub_hoist_t>> hoists;
+    std::vector<std::vector<std::map<uint32_t, ub_expr_t>>> exprs(bytecodes.size());
+    std::vector<std::vector<std::set<uint32_t>>> roots(bytecodes.size());
+    for (size_t i = 0; i < bytecodes.size(); i++) {
+        for (const ub_block_t& block: blocks[i]) {
+            exprs[i].push_back(gather_exprs(mods[i], block));
+            roots[i].push_back(find_hoist_roots(mods[i], exprs[i].back()));
+            if (skipped.count(block.name) > 0) {
+                continue;
+            }
+            std::vector<ub_hoist_t>& block_hoists = hoists[block.name];
+            for (uint32_t root: roots[i].back()) {
+                const ub_expr_t& expr = exprs[i].back().at(root);
+                auto it = std::find_if(block_hoists.begin(), block_hoists.end(), [&expr](const ub_hoist_t& hoist) { return hoist.key == expr.key; });
+                if ((it != block_hoists.end()) || ((block.members.size() + block_hoists.size()) >= uniform_t::NUM)) {
+                    continue;
+                }
+                ub_hoist_t hoist;
+                hoist.key = expr.key;
+                hoist.cols = expr.cols;
+                hoist.rows = expr.rows;
+                std::set<uint32_t> emitted;
+                expr_code(exprs[i].back(), root, emitted, hoist.code);
+                hoist.code.push_back(fmt::format("memcpy(&out->hoisted{}, t{}, sizeof(t{}));", block_hoists.size(), root, root));
+                block_hoists.push_back(hoist);
+            }
+        }
+    }
+    // add the new uniform block members to all shaders, and replace the expressions
+    for (size_t i = 0; i < bytecodes.size(); i++) {
+        bool changed = false;
+        for (size_t block_index = 0; block_index < blocks[i].size(); block_index++) {
+            const ub_block_t& block = blocks[i][block_index];
+            if ((skipped.count(block.name) > 0) || hoists[block.name].empty()) {
+                continue;
+            }
+            const std::vector<ub_hoist_t>& block_hoists = hoists[block.name];
+            append_hoisted_members(mods[i], block, block_hoists);
+            for (uint32_t root: roots[i][block_index]) {
+                const ub_expr_t& expr = exprs[i][block_index].at(root);
+                auto it = std::find_if(block_hoists.begin(), block_hoists.end(), [&expr](const ub_hoist_t& hoist) { return hoist.key == expr.key; });
+                if (it != block_hoists.end()) {
+                    replace_hoisted_value(mods[i], expr, root, (uint32_t)(block.members.size() + (it - block_hoists.begin())));
+                }
+            }
+            changed = true;
+        }
+        if (changed) {
+            *bytecodes[i].bytecode = mods[i].assemble();
+            // remove the computations which only fed the hoisted expressions
+            spirv_t::optimize_linked(bytecodes[i].slang, spirv_t::opt_level(args, inp.snippets[bytecodes[i].blob->snippet_index]), *bytecodes[i].bytecode);
+        }
+    }
+    for (const auto& item: hoists) {
+        if (item.second.empty()) {
+            continue;
+        }
+        for (size_t i = 0; i < item.second.size(); i++) {
+            hoisted_t hoisted;
+            hoisted.block = item.first;
+            hoisted.name = fmt::format("hoisted{}", i);
+            hoisted.code = item.second[i].code;
+            inp.hoisted.push_back(hoisted);
+        }
+        if (args.report) {
+            fmt::print("sokol-shdc: uniform block '{}': {} uniform-only expressions hoisted into {}_prepare()\n", item.first, item.second.size(), item.first);
+        }
+    }
+}
+
+} // namespace shdc
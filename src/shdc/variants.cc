@@ -0,0 +1,153 @@
+/*
+    Shader variants from @variants: each permutation of the variant defines
+    is compiled into its own vertex/fragment shader snippet and program (see
+    expand_variants() in input.cc). Many permutations only differ in code
+    which the optimizer removes anyway (e.g. a define which is only used by
+    the other shader stage), variant shaders which compiled to identical SPIRV
+    in all shader languages are collapsed here into the first identical shader,
+    and variant programs which end up with identical shaders are collapsed
+    into the first identical program. The same happens for the shader copies
+    specialized by @specialize, if the specialization constants didn't change
+    the code.
+*/
+#include "shdc.h"
+#include "fmt/format.h"
+#include <algorithm>
+
+namespace shdc {
+
+/* the SPIRV instructions without the debug instructions which only refer to the source code */
+static std::vector<spirv_inst_t> variant_code(const std::vector<uint32_t>& bytecode) {
+    spirv_module_t mod;
+    if (!spirv_module_t::parse(bytecode, mod)) {
+        return { };
+    }
+    std::vector<spirv_inst_t> insts;
+    for (spirv_inst_t& inst: mod.insts) {
+        switch (inst.op) {
+            case spv::OpSource:
+            case spv::OpSourceContinued:
+            case spv::OpSourceExtension:
+            case spv::OpString:
+            case spv::OpLine:
+            case spv::OpNoLine:
+            case spv::OpModuleProcessed:
+                break;
+            default:
+                insts.push_back(std::move(inst));
+                break;
+        }
+    }
+    return insts;
+}
+
+static bool variant_same_code(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    if (a.empty() || b.empty()) {
+        return a.empty() && b.empty();
+    }
+    const std::vector<spirv_inst_t> a_insts = variant_code(a);
+    const std::vector<spirv_inst_t> b_insts = variant_code(b);
+    if (a_insts.empty() || (a_insts.size() != b_insts.size())) {
+        return false;
+    }
+    for (size_t i = 0; i < a_insts.size(); i++) {
+        if ((a_insts[i].op != b_insts[i].op) || (a_insts[i].operands != b_insts[i].operands)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* check if two snippets compiled to identical SPIRV in all shader languages */
+static bool variant_same_snippets(const args_t& args, const std::array<spirv_t,slang_t::NUM>& spirv, int snippet_index, int other_index) {
+    for (int i = 0; i < slang_t::NUM; i++) {
+        if (0 == (args.slang & slang_t::bit((slang_t::type_t)i))) {
+            continue;
+        }
+        const int blob_index = spirv[i].find_blob_by_snippet_index(snippet_index);
+        const int other_blob_index = spirv[i].find_blob_by_snippet_index(other_index);
+        if ((blob_index < 0) || (other_blob_index < 0)) {
+            return false;
+        }
+        const spirv_blob_t& blob = spirv[i].blobs[blob_index];
+        const spirv_blob_t& other_blob = spirv[i].blobs[other_blob_index];
+        if (!variant_same_code(blob.bytecode, other_blob.bytecode) ||
+            !variant_same_code(blob.fallback_bytecode, other_blob.fallback_bytecode))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void variants_t::dedup(const args_t& args, input_t& inp, std::array<spirv_t,slang_t::NUM>& spirv) {
+    // collapse variant snippets into the first identical snippet of the same original snippet
+    std::map<std::string, std::string> replaced;
+    for (int snippet_index = 0; snippet_index < (int)inp.snippets.size(); snippet_index++) {
+        const snippet_t& snippet = inp.snippets[snippet_index];
+        if (snippet.variant_index < 0) {
+            continue;
+        }
+        for (int other_index = 0; other_index < snippet_index; other_index++) {
+            const snippet_t& other = inp.snippets[other_index];
+            if ((other_index != snippet.variant_index) && (other.variant_index != snippet.variant_index)) {
+                continue;
+            }
+            if ((replaced.count(other.name) == 0) && variant_same_snippets(args, spirv, snippet_index, other_index)) {
+                replaced[snippet.name] = other.name;
+                break;
+            }
+        }
+    }
+    for (spirv_t& slang_spirv: spirv) {
+        for (auto it = slang_spirv.blobs.begin(); it != slang_spirv.blobs.end();) {
+            if (replaced.count(inp.snippets[it->snippet_index].name) > 0) {
+                it = slang_spirv.blobs.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+    for (auto& item: inp.programs) {
+        program_t& prog = item.second;
+        if (replaced.count(prog.vs_name) > 0) {
+            prog.vs_name = replaced.at(prog.vs_name);
+        }
+        if (replaced.count(prog.fs_name) > 0) {
+            prog.fs_name = replaced.at(prog.fs_name);
+        }
+    }
+
+    // collapse variant programs into the first program with the same shaders
+    std::vector<std::string> prog_names;
+    for (const auto& item: inp.programs) {
+        if (!item.second.variant_map.empty()) {
+            prog_names.push_back(item.first);
+        }
+    }
+    for (const std::string& prog_name: prog_names) {
+        program_t& prog = inp.programs.at(prog_name);
+        std::vector<std::string> unique;
+        for (auto& variant_item: prog.variant_map) {
+            const program_t& variant_prog = inp.programs.at(variant_item.second);
+            for (const std::string& other_name: unique) {
+                const program_t& other = inp.programs.at(other_name);
+                if ((other.vs_name == variant_prog.vs_name) && (other.fs_name == variant_prog.fs_name)) {
+                    inp.programs.erase(variant_item.second);
+                    variant_item.second = other_name;
+                    break;
+                }
+            }
+            if (std::find(unique.begin(), unique.end(), variant_item.second) == unique.end()) {
+                unique.push_back(variant_item.second);
+            }
+        }
+        if (args.report) {
+            fmt::print("sokol-shdc: program '{}' variants: {} permutations => {} unique programs\n",
+                prog.name, prog.variant_map.size(), unique.size());
+        }
+    }
+}
+
+} // namespace shdc
@@ -0,0 +1,44 @@
+//------------------------------------------------------------------------------
+//  Shader code to test @instance.
+//
+//  Compile with:
+//
+//      sokol-shdc -i instancing.glsl -o instancing.h -l glsl330 --report
+//
+//  'inst_pos' and 'inst_color' are per-instance inputs, they go into the
+//  packed instance struct 'vs_instance_t' in INSTANCE_BUFFER_vs = 1, the
+//  per-vertex inputs go into 'vs_vertex_t' in VERTEX_BUFFER_vs = 0, and
+//  vs_vertex_layout() steps buffer 1 per instance.
+//------------------------------------------------------------------------------
+@ctype mat4 hmm_mat4
+
+@vs vs
+@format color0 ubyte4n
+@instance inst_pos inst_color
+@format inst_color ubyte4n
+uniform vs_params {
+    mat4 mvp;
+};
+
+in vec4 position;
+in vec4 color0;
+in vec4 inst_pos;
+in vec4 inst_color;
+out vec4 color;
+
+void main() {
+    gl_Position = mvp * (position + vec4(inst_pos.xyz, 0.0));
+    color = color0 * inst_color;
+}
+@end
+
+@fs fs
+in vec4 color;
+out vec4 frag_color;
+
+void main() {
+    frag_color = color;
+}
+@end
+
+@program instancing vs fs
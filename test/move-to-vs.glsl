@@ -0,0 +1,51 @@
+//------------------------------------------------------------------------------
+//  Shader code to test @move_to_vs.
+//
+//  Compile with:
+//
+//      sokol-shdc -i move-to-vs.glsl -o move-to-vs.h -l glsl330:glsl100 --report
+//
+//  'uv * 4.0 + 0.5' and 'mix(color0, color1, 0.25)' are linear in the
+//  varyings and are moved into the vertex shader of the program 'moved',
+//  which replaces the varyings 'color0' and 'color1' with a single varying.
+//  The program 'unmoved' uses the same shaders without @move_to_vs.
+//------------------------------------------------------------------------------
+@ctype mat4 hmm_mat4
+
+@vs vs
+uniform vs_params {
+    mat4 mvp;
+};
+
+in vec4 position;
+in vec2 texcoord0;
+in vec4 color_a;
+in vec4 color_b;
+out vec2 uv;
+out vec4 color0;
+out vec4 color1;
+
+void main() {
+    gl_Position = mvp * position;
+    uv = texcoord0;
+    color0 = color_a;
+    color1 = color_b;
+}
+@end
+
+@fs fs
+uniform sampler2D tex;
+
+in vec2 uv;
+in vec4 color0;
+in vec4 color1;
+out vec4 frag_color;
+
+void main() {
+    frag_color = texture(tex, uv * 4.0 + 0.5) * mix(color0, color1, 0.25);
+}
+@end
+
+@program moved vs fs
+@program unmoved vs fs
+@move_to_vs moved
@@ -0,0 +1,59 @@
+//------------------------------------------------------------------------------
+//  Shader code to test @specialize.
+//
+//  Compile with:
+//
+//      sokol-shdc -i specialize.glsl -o specialize.h -l glsl330
+//
+//  Both programs share the same shaders. 'lit_fog' bakes use_fog=true
+//  (by name) and num_lights=4 (by constant_id) into copies of the shaders
+//  named 'vs_lit_fog' and 'fs_lit_fog', 'lit' keeps the default values.
+//------------------------------------------------------------------------------
+@ctype mat4 hmm_mat4
+@ctype vec4 hmm_vec4
+
+@vs vs
+uniform vs_params {
+    mat4 mvp;
+};
+
+in vec4 position;
+in vec3 normal;
+out vec3 nrm;
+out float depth;
+
+void main() {
+    gl_Position = mvp * position;
+    nrm = normal;
+    depth = gl_Position.z;
+}
+@end
+
+@fs fs
+layout(constant_id=0) const bool use_fog = false;
+layout(constant_id=1) const int num_lights = 1;
+
+uniform fs_params {
+    vec4 light_dir[4];
+    vec4 fog_color;
+};
+
+in vec3 nrm;
+in float depth;
+out vec4 frag_color;
+
+void main() {
+    vec3 color = vec3(0.1);
+    for (int i = 0; i < num_lights; i++) {
+        color += vec3(max(dot(normalize(nrm), light_dir[i].xyz), 0.0));
+    }
+    if (use_fog) {
+        color = mix(color, fog_color.rgb, clamp(depth * 0.01, 0.0, 1.0));
+    }
+    frag_color = vec4(color, 1.0);
+}
+@end
+
+@program lit vs fs
+@program lit_fog vs fs
+@specialize lit_fog use_fog=true 1=4
@@ -0,0 +1,64 @@
+//------------------------------------------------------------------------------
+//  Shader code to test --stable-slots and --slot-map.
+//
+//  Compile with:
+//
+//      sokol-shdc -i stable-slots.glsl -o stable-slots.h -l glsl330 --stable-slots
+//
+//  The fragment shader 'fs_albedo' only uses 'albedo_tex', and 'fs_detail'
+//  uses 'albedo_tex' and 'detail_tex'. Shaders with fewer images get their
+//  slots first, so 'albedo_tex' is in image slot 0 in both programs and
+//  'detail_tex' in image slot 1, and the image slots of each fragment shader
+//  are continuous as required by sokol-gfx:
+//
+//      SLOT_albedo_tex = 0
+//      SLOT_detail_tex = 1
+//
+//  'fs_params' is in uniform block slot 0 of both fragment shaders.
+//------------------------------------------------------------------------------
+@ctype mat4 hmm_mat4
+
+@vs vs
+uniform vs_params {
+    mat4 mvp;
+};
+
+in vec4 position;
+in vec2 texcoord0;
+out vec2 uv;
+
+void main() {
+    gl_Position = mvp * position;
+    uv = texcoord0;
+}
+@end
+
+@block fs_common
+uniform fs_params {
+    vec4 tint;
+};
+in vec2 uv;
+out vec4 frag_color;
+@end
+
+@fs fs_detail
+@include_block fs_common
+uniform sampler2D detail_tex;
+uniform sampler2D albedo_tex;
+
+void main() {
+    frag_color = texture(albedo_tex, uv) * texture(detail_tex, uv * 8.0) * tint;
+}
+@end
+
+@fs fs_albedo
+@include_block fs_common
+uniform sampler2D albedo_tex;
+
+void main() {
+    frag_color = texture(albedo_tex, uv) * tint;
+}
+@end
+
+@program detail vs fs_detail
+@program albedo vs fs_albedo
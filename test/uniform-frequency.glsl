@@ -0,0 +1,55 @@
+//------------------------------------------------------------------------------
+//  Shader code to test @per_frame, @per_material and @per_draw.
+//
+//  Compile with:
+//
+//      sokol-shdc -i uniform-frequency.glsl -o uniform-frequency.h -l glsl330 --report
+//
+//  'vs_params' is split into:
+//
+//      vs_params_per_frame:    view_proj, light_dir
+//      vs_params_per_material: tint
+//      vs_params_per_draw:     model (no annotation)
+//
+//  The fragment shader block 'fs_params' is updated per frame as a whole.
+//------------------------------------------------------------------------------
+@ctype mat4 hmm_mat4
+@ctype vec4 hmm_vec4
+
+@per_frame vs_params view_proj light_dir
+@per_material vs_params tint
+@per_frame fs_params
+
+@vs vs
+uniform vs_params {
+    mat4 view_proj;
+    vec4 light_dir;
+    vec4 tint;
+    mat4 model;
+};
+
+in vec4 position;
+in vec3 normal;
+out vec4 color;
+
+void main() {
+    gl_Position = view_proj * model * position;
+    float l = max(dot(normalize((model * vec4(normal, 0.0)).xyz), light_dir.xyz), 0.0);
+    color = tint * (0.2 + 0.8 * l);
+}
+@end
+
+@fs fs
+uniform fs_params {
+    vec4 ambient;
+};
+
+in vec4 color;
+out vec4 frag_color;
+
+void main() {
+    frag_color = color + ambient;
+}
+@end
+
+@program shape vs fs
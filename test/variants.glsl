@@ -0,0 +1,62 @@
+//------------------------------------------------------------------------------
+//  Shader code to test @variants.
+//
+//  Compile with:
+//
+//      sokol-shdc -i variants.glsl -o variants.h -l glsl330 --report
+//
+//  The fragment shader has the variant defines SHADOWS (0 or 1) and
+//  FOG (0, 1 or 2), so the program 'lit' is compiled as 6 permutations.
+//  The permutation with SHADOWS=0 and FOG=0 is 'lit' itself, the other
+//  permutations are programs named 'lit_v[mask]', and the shader desc of a
+//  permutation is returned by:
+//
+//      lit_shader_desc_variant(VARIANT_lit_SHADOWS_1 | VARIANT_lit_FOG_2)
+//------------------------------------------------------------------------------
+@ctype mat4 hmm_mat4
+@ctype vec4 hmm_vec4
+
+@vs vs
+uniform vs_params {
+    mat4 mvp;
+};
+
+in vec4 position;
+in vec2 texcoord0;
+out vec2 uv;
+out float depth;
+
+void main() {
+    gl_Position = mvp * position;
+    uv = texcoord0;
+    depth = gl_Position.z;
+}
+@end
+
+@fs fs
+uniform fs_params {
+    vec4 fog_color;
+};
+uniform sampler2D tex;
+uniform sampler2D shadow_map;
+
+in vec2 uv;
+in float depth;
+out vec4 frag_color;
+
+void main() {
+    vec4 color = texture(tex, uv);
+    #if SHADOWS
+    color.rgb *= texture(shadow_map, uv).r;
+    #endif
+    #if FOG == 1
+    color.rgb = mix(color.rgb, fog_color.rgb, clamp(depth * 0.01, 0.0, 1.0));
+    #elif FOG == 2
+    color.rgb = mix(color.rgb, fog_color.rgb, 1.0 - exp(-depth * 0.01));
+    #endif
+    frag_color = color;
+}
+@end
+
+@variants fs SHADOWS FOG:0,1,2
+@program lit vs fs
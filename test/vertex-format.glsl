@@ -0,0 +1,48 @@
+//------------------------------------------------------------------------------
+//  Shader code to test @format.
+//
+//  Compile with:
+//
+//      sokol-shdc -i vertex-format.glsl -o vertex-format.h -l glsl330 --report
+//
+//  The generated header contains the packed vertex struct 'vs_vertex_t'
+//  (24 bytes per vertex instead of 44 bytes with unpacked floats), the
+//  ATTR_FORMAT_vs_* constants and the layout function vs_vertex_layout():
+//
+//      typedef struct vs_vertex_t {
+//          float position[3];
+//          int16_t normal[4];
+//          uint8_t color0[4];
+//      } vs_vertex_t;
+//------------------------------------------------------------------------------
+@ctype mat4 hmm_mat4
+
+@vs vs
+@format position float3
+@format normal short4n
+@format color0 ubyte4n
+uniform vs_params {
+    mat4 mvp;
+};
+
+in vec3 position;
+in vec4 normal;
+in vec4 color0;
+out vec4 color;
+
+void main() {
+    gl_Position = mvp * vec4(position, 1.0);
+    color = color0 * (0.5 + 0.5 * normal.z);
+}
+@end
+
+@fs fs
+in vec4 color;
+out vec4 frag_color;
+
+void main() {
+    frag_color = color;
+}
+@end
+
+@program shape vs fs